@@ -12,11 +12,28 @@
 #include <algorithm>
 #include <math.h>
 #include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <SDL.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=2)
+#define SW_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+// the framebuffer is split into tiles of this size, which are painted in parallel
+#define SW_TILE_WIDTH 128
+#define SW_TILE_HEIGHT 64
+#define SW_MAX_THREADS 8
+
+struct SWRenderer;
+
 struct ImGui_ImplSW_Data
 {
     SDL_Window*  Window;
+    SWRenderer*  Renderer;
 
     ImGui_ImplSW_Data() { memset((void*)this, 0, sizeof(*this)); }
 };
@@ -31,6 +48,8 @@ struct PaintTarget
   uint32_t *pixels;
   int width;
   int height;
+  // the area which may be painted (usually a tile): [clipX0, clipX1) and [clipY0, clipY1)
+  int clipX0, clipY0, clipX1, clipY1;
 };
 
 // ----------------------------------------------------------------------------
@@ -87,6 +106,50 @@ static inline uint32_t blend(const ColorInt &target, const ColorInt &source)
   );
 }
 
+// fill count pixels with a color
+static inline void fill_span(uint32_t* dest, int count, uint32_t color)
+{
+  int i=0;
+#ifdef SW_HAVE_SSE2
+  const __m128i c=_mm_set1_epi32((int)color);
+  for (; i+4<=count; i+=4) {
+    _mm_storeu_si128((__m128i*)(dest+i),c);
+  }
+#endif
+  for (; i<count; i++) {
+    dest[i]=color;
+  }
+}
+
+#ifdef SW_HAVE_SSE2
+// blend a translucent color (0<alpha<255) over count pixels. same result as blend().
+static inline void blend_span(uint32_t* dest, int count, const ColorInt& color)
+{
+  const __m128i zero=_mm_setzero_si128();
+  const __m128i ia=_mm_set1_epi16(255-color.a);
+  // 16-bit lanes are B, G, R, A for each pixel
+  const short sr=color.r*color.a+255;
+  const short sg=color.g*color.a+255;
+  const short sb=color.b*color.a+255;
+  const __m128i sa=_mm_set_epi16(0,sr,sg,sb,0,sr,sg,sb);
+  const __m128i alphaMask=_mm_set1_epi32((int)0xff000000);
+  int i=0;
+  for (; i+4<=count; i+=4) {
+    const __m128i t=_mm_loadu_si128((const __m128i*)(dest+i));
+    __m128i lo=_mm_unpacklo_epi8(t,zero);
+    __m128i hi=_mm_unpackhi_epi8(t,zero);
+    lo=_mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(lo,ia),sa),8);
+    hi=_mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(hi,ia),sa),8);
+    // the target keeps its alpha
+    const __m128i res=_mm_packus_epi16(lo,hi);
+    _mm_storeu_si128((__m128i*)(dest+i),_mm_or_si128(_mm_andnot_si128(alphaMask,res),_mm_and_si128(alphaMask,t)));
+  }
+  for (; i<count; i++) {
+    dest[i]=blend(*(const ColorInt*)(&dest[i]),color);
+  }
+}
+#endif
+
 // ----------------------------------------------------------------------------
 // Used for interpolating vertex attributes (color and texture coordinates) in a triangle.
 
@@ -216,21 +279,23 @@ static void paint_uniform_rectangle(const PaintTarget &target,
   int max_y_i = (int)(max_f.y + 0.5f);
 
   // Clamp to render target:
-  min_x_i = std::max(min_x_i, 0);
-  min_y_i = std::max(min_y_i, 0);
-  max_x_i = std::min(max_x_i, target.width);
-  max_y_i = std::min(max_y_i, target.height);
+  min_x_i = std::max(min_x_i, target.clipX0);
+  min_y_i = std::max(min_y_i, target.clipY0);
+  max_x_i = std::min(max_x_i, target.clipX1);
+  max_y_i = std::min(max_y_i, target.clipY1);
+  if (min_x_i >= max_x_i || min_y_i >= max_y_i) return;
 
   if (color.a==255) {
     // fast path if alpha blending is not necessary
     for (int y = min_y_i; y < max_y_i; ++y) {
-      uint32_t* target_pixel = &target.pixels[y * target.width + min_x_i - 1];
-      for (int x = min_x_i; x < max_x_i; ++x) {
-        ++target_pixel;
-        *target_pixel = color.u32;
-      }
+      fill_span(&target.pixels[y * target.width + min_x_i], max_x_i - min_x_i, color.u32);
     }
   } else {
+#ifdef SW_HAVE_SSE2
+    for (int y = min_y_i; y < max_y_i; ++y) {
+      blend_span(&target.pixels[y * target.width + min_x_i], max_x_i - min_x_i, color);
+    }
+#else
     // We often blend the same colors over and over again, so optimize for this (saves 25% total cpu):
     uint32_t last_target_pixel = target.pixels[min_y_i * target.width + min_x_i];
     const ColorInt* lastColorRef = (const ColorInt*)(&last_target_pixel);
@@ -250,6 +315,7 @@ static void paint_uniform_rectangle(const PaintTarget &target,
         last_output = *target_pixel;
       }
     }
+#endif
   }
 }
 
@@ -308,12 +374,25 @@ static void paint_uniform_textured_rectangle(const PaintTarget &target,
   if (startY<0) startY=0;
   if (startY>texture.height-1) startY=texture.height-1;
 
-  int currentX = startX;
-  int currentY = startY * texture.width;
-
   float deltaX = delta_uv_per_pixel.x * texture.width;
   float deltaY = delta_uv_per_pixel.y * texture.height;
 
+  // clip against the tile.
+  // the texture is stepped one texel per pixel, so skip as many texels as pixels.
+  if (min_x_i < target.clipX0) {
+    if (deltaX != 0) startX = std::min(startX + (target.clipX0 - min_x_i), texture.width - 1);
+    min_x_i = target.clipX0;
+  }
+  if (min_y_i < target.clipY0) {
+    if (deltaY != 0) startY = std::min(startY + (target.clipY0 - min_y_i), texture.height - 1);
+    min_y_i = target.clipY0;
+  }
+  max_x_i = std::min(max_x_i, target.clipX1);
+  max_y_i = std::min(max_y_i, target.clipY1);
+
+  int currentX = startX;
+  int currentY = startY * texture.width;
+
   const ColorInt colorRef = ColorInt::bgra(min_v.col);
 
   for (int y = min_y_i; y < max_y_i; ++y) {
@@ -392,11 +471,12 @@ static void paint_triangle(const PaintTarget &target,
   int max_x_i = (int)(max_x_f + 1.0f);
   int max_y_i = (int)(max_y_f + 1.0f);
 
-  // Clip against render target:
-  min_x_i = std::max(min_x_i, 0);
-  min_y_i = std::max(min_y_i, 0);
-  max_x_i = std::min(max_x_i, target.width);
-  max_y_i = std::min(max_y_i, target.height);
+  // Clip against render target (tile):
+  min_x_i = std::max(min_x_i, target.clipX0);
+  min_y_i = std::max(min_y_i, target.clipY0);
+  max_x_i = std::min(max_x_i, target.clipX1);
+  max_y_i = std::min(max_y_i, target.clipY1);
+  if (min_x_i >= max_x_i || min_y_i >= max_y_i) return;
 
   // ------------------------------------------------------------------------
   // Set up interpolation of barycentric coordinates:
@@ -530,7 +610,120 @@ static void paint_triangle(const PaintTarget &target,
   }
 }
 
-static void paint_draw_cmd(const PaintTarget &target,
+// ----------------------------------------------------------------------------
+// Tiled rendering:
+// draw commands are first split into primitives (rectangles, text quads and triangles),
+// and each primitive is put into the bins of the tiles it touches.
+// tiles are then painted in parallel, each one in primitive order.
+// a tile is only painted if the hash of its primitives changed since the last frame.
+
+enum SWPrimType
+{
+  SW_PRIM_TRIANGLE=0,
+  SW_PRIM_RECT,
+  SW_PRIM_TEX_RECT
+};
+
+struct SWPrim
+{
+  // triangle: v[0..2]. text quad: v[0] and v[1] (corners). rectangle: v[0].col
+  ImDrawVert v[3];
+  ImVec4 clip;
+  // rectangle: clipped bounds
+  ImVec2 min, max;
+  const SWTexture* texture;
+  // affected pixels (conservative) [x0, x1) and [y0, y1)
+  int x0, y0, x1, y1;
+  unsigned char type;
+  uint64_t hash;
+};
+
+struct SWRenderer
+{
+  PaintTarget target;
+  std::vector<SWPrim> prims;
+  int tilesX, tilesY;
+  std::vector<std::vector<int>> bins;
+  std::vector<uint64_t> tileHash;
+  std::vector<int> dirtyTiles;
+  // what was on the surface the last frame. tiles can only be skipped if it didn't change.
+  uint32_t* lastPixels;
+  int lastWidth, lastHeight;
+  bool lastValid;
+
+  bool clearPending;
+  uint32_t clearColor;
+
+  // thread pool
+  std::vector<std::thread*> threads;
+  std::mutex lock;
+  std::condition_variable workCV, doneCV;
+  unsigned int jobSeq;
+  // workers may only join while the job is open. busy is the number of workers in it.
+  bool jobOpen;
+  int busy;
+  bool quit;
+  std::atomic<int> nextTile;
+
+  SWRenderer():
+    target{NULL,0,0,0,0,0,0},
+    tilesX(0),
+    tilesY(0),
+    lastPixels(NULL),
+    lastWidth(0),
+    lastHeight(0),
+    lastValid(false),
+    clearPending(false),
+    clearColor(0),
+    jobSeq(0),
+    jobOpen(false),
+    busy(0),
+    quit(false),
+    nextTile(0) {}
+};
+
+static std::atomic<uint32_t> textureVersion(0);
+
+uint32_t ImGui_ImplSW_NextTextureVersion()
+{
+  return ++textureVersion;
+}
+
+// FNV-1a
+static inline uint64_t hash_bytes(uint64_t h, const void* data, size_t len)
+{
+  const unsigned char* p = (const unsigned char*)data;
+  for (size_t i = 0; i < len; i++) {
+    h ^= p[i];
+    h *= 0x100000001b3ULL;
+  }
+  return h;
+}
+
+static void add_prim(SWRenderer* r, SWPrim& prim, int min_x_i, int min_y_i, int max_x_i, int max_y_i)
+{
+  prim.x0 = std::max(min_x_i, 0);
+  prim.y0 = std::max(min_y_i, 0);
+  prim.x1 = std::min(max_x_i, r->target.width);
+  prim.y1 = std::min(max_y_i, r->target.height);
+  if (prim.x0 >= prim.x1 || prim.y0 >= prim.y1) return;
+
+  uint64_t h = 0xcbf29ce484222325ULL;
+  h = hash_bytes(h, &prim.type, sizeof(prim.type));
+  h = hash_bytes(h, prim.v, sizeof(prim.v));
+  h = hash_bytes(h, &prim.clip, sizeof(prim.clip));
+  h = hash_bytes(h, &prim.min, sizeof(prim.min));
+  h = hash_bytes(h, &prim.max, sizeof(prim.max));
+  h = hash_bytes(h, &prim.texture, sizeof(prim.texture));
+  if (prim.texture) {
+    h = hash_bytes(h, &prim.texture->version, sizeof(prim.texture->version));
+  }
+  prim.hash = h;
+  r->prims.push_back(prim);
+}
+
+// decides how to paint a draw command (the decisions are the same as before tiling)
+static void bin_draw_cmd(SWRenderer* r,
   const ImDrawVert *vertices,
   const ImDrawIdx *idx_buffer,
   const ImDrawCmd &pcmd,
@@ -539,6 +732,10 @@ static void paint_draw_cmd(const PaintTarget &target,
   const SWTexture* texture = (const SWTexture*)(pcmd.GetTexID());
   IM_ASSERT(texture);
 
+  SWPrim prim;
+  memset((void*)&prim, 0, sizeof(prim));
+  prim.clip = pcmd.ClipRect;
+
   for (unsigned int i = 0; i + 3 <= pcmd.ElemCount;) {
     ImDrawVert v0 = vertices[idx_buffer[i + 0]];
     ImDrawVert v1 = vertices[idx_buffer[i + 1]];
@@ -557,7 +754,18 @@ static void paint_draw_cmd(const PaintTarget &target,
         const bool has_texture = v0.uv != white_uv || v1.uv != white_uv || v2.uv != white_uv || v3.uv != white_uv;
 
         if (has_uniform_color && has_texture) {
-          paint_uniform_textured_rectangle(target, *texture, pcmd.ClipRect, v0, v2);
+          if (v2.pos.x - v0.pos.x != 0 && v2.pos.y - v0.pos.y != 0) {
+            prim.type = SW_PRIM_TEX_RECT;
+            prim.v[0] = v0;
+            prim.v[1] = v2;
+            prim.v[2] = ImDrawVert();
+            prim.texture = texture;
+            add_prim(r, prim,
+              (int)std::max(v0.pos.x, prim.clip.x),
+              (int)std::max(v0.pos.y, prim.clip.y),
+              (int)(std::min(v2.pos.x, prim.clip.z - 0.5f) + 1.0f),
+              (int)(std::min(v2.pos.y, prim.clip.w - 0.5f) + 1.0f));
+          }
           i += 6;
           continue;
         }
@@ -600,8 +808,20 @@ static void paint_draw_cmd(const PaintTarget &target,
         }// Completely clipped
 
         if (has_uniform_color) {
-          const ColorInt colorRef = ColorInt::bgra(v0.col);
-          paint_uniform_rectangle(target, min, max, colorRef);
+          // transparent rectangles paint nothing
+          if ((v0.col >> IM_COL32_A_SHIFT) & 0xff) {
+            prim.type = SW_PRIM_RECT;
+            prim.v[0] = ImDrawVert();
+            prim.v[0].col = v0.col;
+            prim.v[1] = ImDrawVert();
+            prim.v[2] = ImDrawVert();
+            prim.min = min;
+            prim.max = max;
+            prim.texture = NULL;
+            add_prim(r, prim, (int)(min.x + 0.5f), (int)(min.y + 0.5f), (int)(max.x + 0.5f), (int)(max.y + 0.5f));
+            prim.min = ImVec2(0, 0);
+            prim.max = ImVec2(0, 0);
+          }
           i += 6;
           continue;
         }
@@ -609,12 +829,21 @@ static void paint_draw_cmd(const PaintTarget &target,
     }
 
     const bool has_texture = (v0.uv != white_uv || v1.uv != white_uv || v2.uv != white_uv);
-    paint_triangle(target, has_texture ? texture : nullptr, pcmd.ClipRect, v0, v1, v2);
+    prim.type = SW_PRIM_TRIANGLE;
+    prim.v[0] = v0;
+    prim.v[1] = v1;
+    prim.v[2] = v2;
+    prim.texture = has_texture ? texture : nullptr;
+    add_prim(r, prim,
+      (int)std::max(min3(v0.pos.x, v1.pos.x, v2.pos.x), prim.clip.x),
+      (int)std::max(min3(v0.pos.y, v1.pos.y, v2.pos.y), prim.clip.y),
+      (int)(std::min(max3(v0.pos.x, v1.pos.x, v2.pos.x), prim.clip.z - 0.5f) + 1.0f),
+      (int)(std::min(max3(v0.pos.y, v1.pos.y, v2.pos.y), prim.clip.w - 0.5f) + 1.0f));
     i += 3;
   }
 }
 
-static void paint_draw_list(const PaintTarget &target, const ImDrawList *cmd_list)
+static void bin_draw_list(SWRenderer* r, const ImDrawList *cmd_list)
 {
   const ImDrawIdx *idx_buffer = &cmd_list->IdxBuffer[0];
   const ImDrawVert *vertices = cmd_list->VtxBuffer.Data;
@@ -623,23 +852,166 @@ static void paint_draw_list(const PaintTarget &target, const ImDrawList *cmd_lis
   for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.size(); cmd_i++) {
     const ImDrawCmd &pcmd = cmd_list->CmdBuffer[cmd_i];
     if (pcmd.UserCallback) {
+      // callbacks are run once, in order, while binning
       pcmd.UserCallback(cmd_list, &pcmd);
     } else {
-      paint_draw_cmd(target, vertices, idx_buffer, pcmd, white_uv);
+      bin_draw_cmd(r, vertices, idx_buffer, pcmd, white_uv);
     }
     idx_buffer += pcmd.ElemCount;
   }
+}
+
+static void paint_prim(const PaintTarget &target, const SWPrim &prim)
+{
+  switch (prim.type) {
+    case SW_PRIM_RECT:
+      paint_uniform_rectangle(target, prim.min, prim.max, ColorInt::bgra(prim.v[0].col));
+      break;
+    case SW_PRIM_TEX_RECT:
+      paint_uniform_textured_rectangle(target, *prim.texture, prim.clip, prim.v[0], prim.v[1]);
+      break;
+    default:
+      paint_triangle(target, prim.texture, prim.clip, prim.v[0], prim.v[1], prim.v[2]);
+      break;
+  }
+}
+
+static void paint_tile(SWRenderer* r, int tile)
+{
+  PaintTarget target = r->target;
+  const int tx = tile % r->tilesX;
+  const int ty = tile / r->tilesX;
+  target.clipX0 = tx * SW_TILE_WIDTH;
+  target.clipY0 = ty * SW_TILE_HEIGHT;
+  target.clipX1 = std::min(target.clipX0 + SW_TILE_WIDTH, target.width);
+  target.clipY1 = std::min(target.clipY0 + SW_TILE_HEIGHT, target.height);
+
+  if (r->clearPending) {
+    for (int y = target.clipY0; y < target.clipY1; y++) {
+      fill_span(&target.pixels[y * target.width + target.clipX0], target.clipX1 - target.clipX0, r->clearColor);
+    }
+  }
+
+  for (int i: r->bins[tile]) {
+    paint_prim(target, r->prims[i]);
+  }
+}
+
+// paints dirty tiles until there are none left
+static void paint_tiles(SWRenderer* r)
+{
+  const int count = (int)r->dirtyTiles.size();
+  while (true) {
+    int i = r->nextTile.fetch_add(1);
+    if (i >= count) break;
+    paint_tile(r, r->dirtyTiles[i]);
+  }
+}
+
+static void tile_thread(SWRenderer* r)
+{
+  unsigned int lastSeq = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(r->lock);
+      while (!r->quit && r->jobSeq == lastSeq) r->workCV.wait(lock);
+      if (r->quit) return;
+      lastSeq = r->jobSeq;
+      // too late
+      if (!r->jobOpen) continue;
+      r->busy++;
+    }
+    paint_tiles(r);
+    {
+      std::lock_guard<std::mutex> lock(r->lock);
+      if (--r->busy == 0) r->doneCV.notify_all();
+    }
   }
+}
 
-static void paint_imgui(uint32_t *pixels, ImDrawData *drawData, int fb_width, int fb_height)
+static void paint_imgui(SWRenderer* r, uint32_t *pixels, ImDrawData *drawData, int fb_width, int fb_height)
 {
   if (fb_width <= 0 || fb_height <= 0) return;
 
-  PaintTarget target{ pixels, fb_width, fb_height };
+  r->target = PaintTarget{ pixels, fb_width, fb_height, 0, 0, fb_width, fb_height };
+
+  // a different surface has different contents
+  if (pixels != r->lastPixels || fb_width != r->lastWidth || fb_height != r->lastHeight) {
+    r->lastPixels = pixels;
+    r->lastWidth = fb_width;
+    r->lastHeight = fb_height;
+    r->lastValid = false;
+  }
+
+  const int tilesX = (fb_width + SW_TILE_WIDTH - 1) / SW_TILE_WIDTH;
+  const int tilesY = (fb_height + SW_TILE_HEIGHT - 1) / SW_TILE_HEIGHT;
+  if (tilesX != r->tilesX || tilesY != r->tilesY) {
+    r->tilesX = tilesX;
+    r->tilesY = tilesY;
+    r->bins.resize(tilesX * tilesY);
+    r->tileHash.resize(tilesX * tilesY);
+    r->lastValid = false;
+  }
+  for (std::vector<int>& i: r->bins) {
+    i.clear();
+  }
 
+  // split into primitives
+  r->prims.clear();
   for (int i = 0; i < drawData->CmdListsCount; ++i) {
-    paint_draw_list(target, drawData->CmdLists[i]);
+    bin_draw_list(r, drawData->CmdLists[i]);
+  }
+
+  // bin them
+  for (int i = 0; i < (int)r->prims.size(); i++) {
+    const SWPrim& prim = r->prims[i];
+    const int tx1 = (prim.x1 - 1) / SW_TILE_WIDTH;
+    const int ty1 = (prim.y1 - 1) / SW_TILE_HEIGHT;
+    for (int ty = prim.y0 / SW_TILE_HEIGHT; ty <= ty1; ty++) {
+      for (int tx = prim.x0 / SW_TILE_WIDTH; tx <= tx1; tx++) {
+        r->bins[ty * tilesX + tx].push_back(i);
+      }
+    }
+  }
+
+  // find out which tiles changed.
+  // without a clear we paint over the previous frame, so everything has to be painted.
+  r->dirtyTiles.clear();
+  for (int i = 0; i < tilesX * tilesY; i++) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    h = hash_bytes(h, &r->clearColor, sizeof(r->clearColor));
+    for (int j: r->bins[i]) {
+      h = (h ^ r->prims[j].hash) * 0x100000001b3ULL;
+    }
+    if (!r->lastValid || !r->clearPending || h != r->tileHash[i]) {
+      r->dirtyTiles.push_back(i);
+    }
+    r->tileHash[i] = h;
   }
+  r->lastValid = r->clearPending;
+
+  if (!r->dirtyTiles.empty()) {
+    r->nextTile = 0;
+    const bool useThreads = !r->threads.empty() && r->dirtyTiles.size() > 1;
+    if (useThreads) {
+      {
+        std::lock_guard<std::mutex> lock(r->lock);
+        r->jobSeq++;
+        r->jobOpen = true;
+      }
+      r->workCV.notify_all();
+    }
+    // help out
+    paint_tiles(r);
+    if (useThreads) {
+      // every tile has been taken. wait for the workers to finish theirs
+      std::unique_lock<std::mutex> lock(r->lock);
+      r->jobOpen = false;
+      while (r->busy > 0) r->doneCV.wait(lock);
+    }
+  }
+
+  r->clearPending = false;
 }
 
 /// NEW STUFF
@@ -661,6 +1033,14 @@ bool ImGui_ImplSW_Init(SDL_Window* win) {
 
   platform_io.Renderer_TextureMaxWidth = platform_io.Renderer_TextureMaxHeight = (int)4096;
 
+  bd->Renderer = new SWRenderer;
+  unsigned int threadCount = std::thread::hardware_concurrency();
+  if (threadCount > SW_MAX_THREADS) threadCount = SW_MAX_THREADS;
+  // the main thread paints as well
+  for (unsigned int i = 1; i < threadCount; i++) {
+    bd->Renderer->threads.push_back(new std::thread(tile_thread, bd->Renderer));
+  }
+
   return true;
 }
 
@@ -670,6 +1050,21 @@ void ImGui_ImplSW_Shutdown() {
   ImGuiIO& io = ImGui::GetIO();
 
   ImGui_ImplSW_DestroyDeviceObjects();
+
+  SWRenderer* r = bd->Renderer;
+  {
+    std::lock_guard<std::mutex> lock(r->lock);
+    r->quit = true;
+  }
+  r->workCV.notify_all();
+  for (std::thread* i: r->threads) {
+    i->join();
+    delete i;
+  }
+  r->threads.clear();
+  delete r;
+  bd->Renderer = nullptr;
+
   io.BackendRendererName = nullptr;
   io.BackendRendererUserData = nullptr;
   io.BackendFlags &= ~ImGuiBackendFlags_RendererHasTextures;
@@ -702,13 +1097,45 @@ void ImGui_ImplSW_RenderDrawData(ImDrawData* draw_data) {
   if (mustLock) {
     if (SDL_LockSurface(surf)!=0) return;
   }
-  paint_imgui((uint32_t*)surf->pixels,draw_data,surf->w,surf->h);
+  paint_imgui(bd->Renderer,(uint32_t*)surf->pixels,draw_data,surf->w,surf->h);
   // 0xAARRGGBB
   if (mustLock) {
     SDL_UnlockSurface(surf);
   }
 }
 
+bool ImGui_ImplSW_SetClearColor(uint32_t color) {
+  ImGui_ImplSW_Data* bd = ImGui_ImplSW_GetBackendData();
+  if (bd==NULL) return false;
+  bd->Renderer->clearPending = true;
+  bd->Renderer->clearColor = color;
+  return true;
+}
+
+void ImGui_ImplSW_FlushClear() {
+  ImGui_ImplSW_Data* bd = ImGui_ImplSW_GetBackendData();
+  if (bd==NULL) return;
+  SWRenderer* r = bd->Renderer;
+  if (!r->clearPending) return;
+  r->clearPending = false;
+  // whatever was retained is gone
+  r->lastValid = false;
+
+  SDL_Surface* surf = SDL_GetWindowSurface(bd->Window);
+  if (!surf) return;
+
+  bool mustLock=SDL_MUSTLOCK(surf);
+  if (mustLock) {
+    if (SDL_LockSurface(surf)!=0) return;
+  }
+  for (int y = 0; y < surf->h; y++) {
+    fill_span((uint32_t*)((unsigned char*)surf->pixels + y * surf->pitch), surf->w, r->clearColor);
+  }
+  if (mustLock) {
+    SDL_UnlockSurface(surf);
+  }
+}
+
 /// CREATE OBJECTS
 
 bool ImGui_ImplSW_CreateDeviceObjects() {
@@ -782,6 +1209,7 @@ void ImGui_ImplSW_UpdateTexture(ImTextureData* tex) {
         }
       }
     }
+    t->touch();
 
     tex->SetStatus(ImTextureStatus_OK);
   } else if (tex->Status==ImTextureStatus_WantDestroy && tex->UnusedFrames>0) {
@@ -19,24 +19,35 @@
 struct SDL_Window;
 struct ImDrawData;
 
+IMGUI_IMPL_API uint32_t ImGui_ImplSW_NextTextureVersion();
+
 struct SWTexture
 {
   uint32_t* pixels;
   int width;
   int height;
   bool managed, isAlpha;
+  // changes whenever the contents change. used to find out which tiles must be repainted.
+  uint32_t version;
+
+  // call after writing to pixels
+  void touch() {
+    version=ImGui_ImplSW_NextTextureVersion();
+  }
 
   SWTexture(uint32_t* pix, int w, int h, bool a=false):
     pixels(pix),
     width(w),
     height(h),
     managed(false),
-    isAlpha(a) {}
+    isAlpha(a),
+    version(ImGui_ImplSW_NextTextureVersion()) {}
   SWTexture(int w, int h, bool a=false):
     width(w),
     height(h),
     managed(true),
-    isAlpha(a) {
+    isAlpha(a),
+    version(ImGui_ImplSW_NextTextureVersion()) {
     pixels=new uint32_t[width*height];
     memset(pixels,0,width*height*sizeof(uint32_t));
   }
@@ -50,6 +61,13 @@ IMGUI_IMPL_API void     ImGui_ImplSW_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplSW_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplSW_RenderDrawData(ImDrawData* draw_data);
 
+// Clear the window surface to color (0xAARRGGBB) before the next RenderDrawData.
+// the clear is done per tile, which allows unchanged tiles to be kept.
+// returns false if the backend is not initialized.
+IMGUI_IMPL_API bool     ImGui_ImplSW_SetClearColor(uint32_t color);
+// Do a pending clear now (if RenderDrawData was not called after SetClearColor).
+IMGUI_IMPL_API void     ImGui_ImplSW_FlushClear();
+
 // Called by Init/NewFrame/Shutdown
 IMGUI_IMPL_API bool     ImGui_ImplSW_CreateDeviceObjects();
 IMGUI_IMPL_API void     ImGui_ImplSW_DestroyDeviceObjects();
@@ -45,6 +45,10 @@ void TAAudio::acceptDeviceStatus() {
   deviceStatus=TA_AUDIO_DEVICE_OK;
 }
 
+bool TAAudio::isRunning() {
+  return running;
+}
+
 int TAAudio::specialCommand(TAAudioCommand which) {
   return -1;
 }
@@ -0,0 +1,462 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <chrono>
+#include "../ta-log.h"
+#include "stream.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define STREAM_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define STREAM_SEND_FLAGS 0
+#endif
+
+// at least this many sample frames are sent at once
+#define STREAM_MIN_BATCH 4096
+// the ring buffer holds this many batches
+#define STREAM_RING_BATCHES 16
+
+static unsigned long long streamNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void taStreamThread(void* inst) {
+  TAAudioStream* in=(TAAudioStream*)inst;
+  in->runThread();
+}
+
+void TAAudioStream::runThread() {
+  startTime=streamNow();
+  timestamp=0;
+  batchPos=0;
+  while (running) {
+    onProcess(desc.bufsize);
+  }
+}
+
+void TAAudioStream::onProcess(unsigned int nframes) {
+  if (audioProcCallback!=NULL) {
+    if (midiIn!=NULL) midiIn->gather();
+    audioProcCallback(audioProcCallbackUser,inBufs,outBufs,desc.inChans,desc.outChans,nframes);
+  }
+
+  if (batch==NULL) return;
+
+  unsigned char* out=batch+sizeof(TAAudioStreamHeader)+batchPos*bytesPerFrame;
+  if (desc.outFormat==TA_AUDIO_FORMAT_S16) {
+    short* sb=(short*)out;
+    for (size_t i=0; i<desc.outChans; i++) {
+      const float* ob=outBufs[i];
+      for (size_t j=0; j<nframes; j++) {
+        sb[j*desc.outChans+i]=(short)(MAX(-1.0f,MIN(1.0f,ob[j]))*32767.0f);
+      }
+    }
+  } else {
+    float* fb=(float*)out;
+    for (size_t i=0; i<desc.outChans; i++) {
+      const float* ob=outBufs[i];
+      for (size_t j=0; j<nframes; j++) {
+        fb[j*desc.outChans+i]=ob[j];
+      }
+    }
+  }
+  batchPos+=nframes;
+
+  if (batchPos+desc.bufsize>batchFrames) {
+    flushBatch();
+  }
+}
+
+void TAAudioStream::flushBatch() {
+  if (batchPos==0) return;
+
+  TAAudioStreamPos pos;
+  if (positionCallback!=NULL) {
+    positionCallback(positionCallbackUser,pos);
+  }
+
+  TAAudioStreamHeader* h=(TAAudioStreamHeader*)batch;
+  if (pos.loops!=h->loops) pendingFlags|=TA_STREAM_FLAG_LOOPED;
+  h->magic=TA_STREAM_MAGIC;
+  h->version=TA_STREAM_VERSION;
+  h->format=desc.outFormat;
+  h->channels=desc.outChans;
+  h->rate=desc.rate;
+  h->frames=batchPos;
+  h->timestamp=timestamp;
+  h->wallClock=streamNow();
+  h->order=pos.order;
+  h->row=pos.row;
+  h->loops=pos.loops;
+  h->flags=pendingFlags|(pos.playing?TA_STREAM_FLAG_PLAYING:0);
+
+  if (writeOut(batch,sizeof(TAAudioStreamHeader)+batchPos*bytesPerFrame)) {
+    pendingFlags=0;
+  } else {
+    pendingFlags=TA_STREAM_FLAG_DISCONTINUITY;
+  }
+
+  timestamp+=batchPos;
+  batchPos=0;
+  pace();
+}
+
+void TAAudioStream::pace() {
+  if (!paceClock) return;
+  unsigned long long target=startTime+(unsigned long long)((double)timestamp*1000000000.0/desc.rate);
+  unsigned long long now=streamNow();
+  if (target>now) {
+    std::this_thread::sleep_for(std::chrono::nanoseconds(target-now));
+  }
+}
+
+bool TAAudioStream::writeOut(const unsigned char* buf, size_t len) {
+  switch (transport) {
+    case TA_STREAM_STDOUT:
+      if (fwrite(buf,1,len,stdout)!=len) return false;
+      fflush(stdout);
+      return true;
+    case TA_STREAM_SHM:
+      return writeRing(buf,len);
+    case TA_STREAM_UNIX:
+#ifndef _WIN32
+      while (fd<0) {
+        if (!running) return false;
+        if (acceptClient()) break;
+        // nobody is listening. drop the data if we're on the clock
+        if (paceClock) return false;
+      }
+
+      if (paceClock) {
+        // don't let a slow client hold back the clock
+        struct pollfd p;
+        p.fd=fd;
+        p.events=POLLOUT;
+        p.revents=0;
+        if (poll(&p,1,0)<=0 || !(p.revents&POLLOUT)) return false;
+      }
+
+      while (len>0) {
+        ssize_t result=send(fd,buf,len,STREAM_SEND_FLAGS);
+        if (result<0) {
+          if (errno==EINTR) continue;
+          logW("stream: client disconnected (%s)",strerror(errno));
+          close(fd);
+          fd=-1;
+          return false;
+        }
+        buf+=result;
+        len-=result;
+      }
+      return true;
+#endif
+      break;
+  }
+  return false;
+}
+
+bool TAAudioStream::writeRing(const unsigned char* buf, size_t len) {
+  if (ring==NULL) return false;
+
+  unsigned long long writePos=ring->writePos.load(std::memory_order_relaxed);
+  size_t offset=writePos%ring->capacity;
+  size_t skip=0;
+  if (ring->capacity-offset<len) {
+    // no room before the end. start over at the beginning
+    skip=ring->capacity-offset;
+  }
+
+  if (paceClock) {
+    // the consumer can't keep up. tell it we've overwritten data
+    if (writePos+skip+len-ring->readPos.load(std::memory_order_acquire)>ring->capacity) {
+      ((TAAudioStreamHeader*)buf)->flags|=TA_STREAM_FLAG_DISCONTINUITY;
+    }
+  } else {
+    // back-pressure
+    while (writePos+skip+len-ring->readPos.load(std::memory_order_acquire)>ring->capacity) {
+      if (!running) return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+  if (skip>0) {
+    if (skip>=sizeof(unsigned int)) {
+      memset(ringData+offset,0,sizeof(unsigned int));
+    }
+    writePos+=skip;
+    offset=0;
+  }
+  memcpy(ringData+offset,buf,len);
+  ring->writePos.store(writePos+len,std::memory_order_release);
+
+  return true;
+}
+
+bool TAAudioStream::acceptClient() {
+#ifndef _WIN32
+  if (listenFD<0) return false;
+  struct pollfd p;
+  p.fd=listenFD;
+  p.events=POLLIN;
+  p.revents=0;
+  // time out so that we can stop or keep pace while waiting
+  if (poll(&p,1,paceClock?0:100)<=0) return false;
+  fd=accept(listenFD,NULL,NULL);
+  if (fd<0) return false;
+#ifdef SO_NOSIGPIPE
+  int one=1;
+  setsockopt(fd,SOL_SOCKET,SO_NOSIGPIPE,&one,sizeof(one));
+#endif
+  logI("stream: client connected");
+  // let the client know where the stream starts
+  if (batch!=NULL) ((TAAudioStreamHeader*)batch)->flags|=TA_STREAM_FLAG_DISCONTINUITY;
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool TAAudioStream::openTransport() {
+  switch (transport) {
+    case TA_STREAM_STDOUT:
+      logV("opening stdout for audio...");
+      return true;
+    case TA_STREAM_UNIX: {
+#ifndef _WIN32
+      struct sockaddr_un addr;
+      if (path.size()>=sizeof(addr.sun_path)) {
+        logE("stream: socket path too long!");
+        return false;
+      }
+      memset(&addr,0,sizeof(addr));
+      addr.sun_family=AF_UNIX;
+      strncpy(addr.sun_path,path.c_str(),sizeof(addr.sun_path)-1);
+
+      listenFD=socket(AF_UNIX,SOCK_STREAM,0);
+      if (listenFD<0) {
+        logE("stream: could not create socket! (%s)",strerror(errno));
+        return false;
+      }
+      unlink(path.c_str());
+      if (bind(listenFD,(struct sockaddr*)&addr,sizeof(addr))<0) {
+        logE("stream: could not bind to %s! (%s)",path,strerror(errno));
+        close(listenFD);
+        listenFD=-1;
+        return false;
+      }
+      if (listen(listenFD,1)<0) {
+        logE("stream: could not listen! (%s)",strerror(errno));
+        close(listenFD);
+        listenFD=-1;
+        unlink(path.c_str());
+        return false;
+      }
+      logI("stream: listening on %s",path);
+      return true;
+#else
+      logE("stream: UNIX sockets are not supported on this platform!");
+      return false;
+#endif
+    }
+    case TA_STREAM_SHM: {
+#ifndef _WIN32
+      size_t capacity=(sizeof(TAAudioStreamHeader)+batchFrames*bytesPerFrame)*STREAM_RING_BATCHES;
+      ringSize=sizeof(TAAudioStreamRing)+capacity;
+      fd=open(path.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644);
+      if (fd<0) {
+        logE("stream: could not open %s! (%s)",path,strerror(errno));
+        return false;
+      }
+      if (ftruncate(fd,ringSize)<0) {
+        logE("stream: could not resize %s! (%s)",path,strerror(errno));
+        close(fd);
+        fd=-1;
+        return false;
+      }
+      void* mem=mmap(NULL,ringSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+      if (mem==MAP_FAILED) {
+        logE("stream: could not map %s! (%s)",path,strerror(errno));
+        close(fd);
+        fd=-1;
+        return false;
+      }
+      ring=(TAAudioStreamRing*)mem;
+      ringData=(unsigned char*)mem+sizeof(TAAudioStreamRing);
+      ring->capacity=capacity;
+      ring->writePos.store(0);
+      ring->readPos.store(0);
+      ring->version=TA_STREAM_VERSION;
+      // written last so that readers only see a complete header
+      std::atomic_thread_fence(std::memory_order_release);
+      ring->magic=TA_STREAM_RING_MAGIC;
+      logI("stream: ring buffer at %s (%d bytes)",path,capacity);
+      return true;
+#else
+      logE("stream: memory-mapped output is not supported on this platform!");
+      return false;
+#endif
+    }
+  }
+  return false;
+}
+
+void TAAudioStream::closeTransport() {
+#ifndef _WIN32
+  if (ring!=NULL) {
+    ring->magic=0;
+    munmap(ring,ringSize);
+    ring=NULL;
+    ringData=NULL;
+    ringSize=0;
+  }
+  if (fd>=0) {
+    close(fd);
+    fd=-1;
+  }
+  if (listenFD>=0) {
+    close(listenFD);
+    listenFD=-1;
+    unlink(path.c_str());
+  }
+#endif
+}
+
+void TAAudioStream::setPacing(bool clock) {
+  paceClock=clock;
+}
+
+void TAAudioStream::setPositionCallback(void (*callback)(void*,TAAudioStreamPos&), void* user) {
+  positionCallback=callback;
+  positionCallbackUser=user;
+}
+
+void* TAAudioStream::getContext() {
+  return NULL;
+}
+
+bool TAAudioStream::quit() {
+  if (!initialized) return false;
+
+  if (running) {
+    running=false;
+    if (outThread) {
+      outThread->join();
+      delete outThread;
+      outThread=NULL;
+    }
+  }
+
+  closeTransport();
+
+  for (int i=0; i<desc.outChans; i++) {
+    delete[] outBufs[i];
+  }
+
+  delete[] outBufs;
+
+  if (batch) {
+    delete[] batch;
+    batch=NULL;
+  }
+
+  initialized=false;
+  return true;
+}
+
+bool TAAudioStream::setRun(bool run) {
+  if (!initialized) return false;
+
+  if (running!=run) {
+    running=run;
+    if (running) {
+      outThread=new std::thread(taStreamThread,this);
+    } else if (outThread) {
+      outThread->join();
+      delete outThread;
+      outThread=NULL;
+    }
+  }
+
+  return running;
+}
+
+std::vector<String> TAAudioStream::listAudioDevices() {
+  std::vector<String> ret;
+
+  ret.push_back("stdout");
+
+  return ret;
+}
+
+bool TAAudioStream::init(TAAudioDesc& request, TAAudioDesc& response) {
+  if (initialized) {
+    logE("audio already initialized");
+    return false;
+  }
+
+  desc=request;
+  if (desc.outFormat!=TA_AUDIO_FORMAT_S16) desc.outFormat=TA_AUDIO_FORMAT_F32;
+  if (desc.bufsize<1) desc.bufsize=1024;
+
+  if (desc.deviceName.find("unix:")==0) {
+    transport=TA_STREAM_UNIX;
+    path=desc.deviceName.substr(5);
+  } else if (desc.deviceName.find("shm:")==0) {
+    transport=TA_STREAM_SHM;
+    path=desc.deviceName.substr(4);
+  } else {
+    transport=TA_STREAM_STDOUT;
+    path="";
+  }
+
+  bytesPerFrame=desc.outChans*((desc.outFormat==TA_AUDIO_FORMAT_S16)?sizeof(short):sizeof(float));
+  batchFrames=desc.bufsize*((STREAM_MIN_BATCH+desc.bufsize-1)/desc.bufsize);
+
+  if (!openTransport()) {
+    closeTransport();
+    return false;
+  }
+
+  if (desc.outChans>0) {
+    outBufs=new float*[desc.outChans];
+    for (int i=0; i<desc.outChans; i++) {
+      outBufs[i]=new float[desc.bufsize];
+    }
+
+    batch=new unsigned char[sizeof(TAAudioStreamHeader)+batchFrames*bytesPerFrame];
+    memset(batch,0,sizeof(TAAudioStreamHeader));
+  } else {
+    batch=NULL;
+  }
+
+  response=desc;
+  initialized=true;
+  return true;
+}
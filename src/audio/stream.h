@@ -0,0 +1,171 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// stream.h: streaming audio backend for headless use.
+// audio is sent in frames, each consisting of a TAAudioStreamHeader followed by
+// interleaved samples (F32 or S16, native endian).
+// device names select the transport:
+// - "stdout": standard output
+// - "unix:<path>": listen on a UNIX socket and stream to one client at a time
+// - "shm:<path>": memory-mapped ring buffer (see TAAudioStreamRing)
+
+#include "taAudio.h"
+#include <thread>
+#include <atomic>
+
+#define TA_STREAM_MAGIC 0x53525546 // "FURS"
+#define TA_STREAM_RING_MAGIC 0x52525546 // "FURR"
+#define TA_STREAM_VERSION 1
+
+// frame flags
+#define TA_STREAM_FLAG_PLAYING 1
+// the song looped during this frame
+#define TA_STREAM_FLAG_LOOPED 2
+// samples were lost before this frame (consumer too slow in clock-paced mode)
+#define TA_STREAM_FLAG_DISCONTINUITY 4
+
+enum TAAudioStreamTransport {
+  TA_STREAM_STDOUT=0,
+  TA_STREAM_UNIX,
+  TA_STREAM_SHM
+};
+
+/**
+ * position metadata. filled in by the position callback after every buffer.
+ */
+struct TAAudioStreamPos {
+  int order, row, loops;
+  bool playing;
+  TAAudioStreamPos():
+    order(0),
+    row(0),
+    loops(0),
+    playing(false) {}
+};
+
+/**
+ * frame header. all fields are native endian.
+ */
+struct TAAudioStreamHeader {
+  unsigned int magic;
+  unsigned short version;
+  // TAAudioFormat (F32 or S16)
+  unsigned char format;
+  unsigned char channels;
+  unsigned int rate;
+  // number of sample frames following this header
+  unsigned int frames;
+  // position of the first sample frame since the stream started
+  unsigned long long timestamp;
+  // steady clock time in nanoseconds when the frame was written
+  unsigned long long wallClock;
+  // position at the end of the frame
+  int order, row, loops;
+  unsigned int flags;
+};
+
+/**
+ * header of the memory-mapped ring buffer.
+ * the data area follows it and holds whole frames; a frame which does not fit
+ * before the end of the area starts at the beginning instead (readers skip to 0
+ * when there's no room for a header, or when they find a zero magic).
+ * writePos and readPos are running byte counts (not wrapped).
+ */
+struct TAAudioStreamRing {
+  unsigned int magic;
+  unsigned int version;
+  unsigned long long capacity;
+  // written by the producer
+  std::atomic<unsigned long long> writePos;
+  // written by the consumer. only used for back-pressure.
+  std::atomic<unsigned long long> readPos;
+};
+
+class TAAudioStream: public TAAudio {
+  std::thread* outThread;
+  TAAudioStreamTransport transport;
+  String path;
+  int fd, listenFD;
+
+  // memory-mapped ring
+  TAAudioStreamRing* ring;
+  unsigned char* ringData;
+  size_t ringSize;
+
+  // batch buffer (header and samples)
+  unsigned char* batch;
+  size_t batchFrames, batchPos;
+  size_t bytesPerFrame;
+
+  unsigned long long timestamp;
+  unsigned long long startTime;
+  unsigned int pendingFlags;
+  bool paceClock;
+
+  void (*positionCallback)(void*,TAAudioStreamPos&);
+  void* positionCallbackUser;
+
+  bool openTransport();
+  void closeTransport();
+  bool acceptClient();
+  bool writeOut(const unsigned char* buf, size_t len);
+  bool writeRing(const unsigned char* buf, size_t len);
+  void flushBatch();
+  void pace();
+
+  public:
+    void runThread();
+    void onProcess(unsigned int nframes);
+
+    /**
+     * set the pacing mode.
+     * @param clock if true, stream at the sample rate in real time.
+     * if false, stream as fast as the consumer takes the data.
+     */
+    void setPacing(bool clock);
+
+    /**
+     * set the callback which provides position metadata.
+     */
+    void setPositionCallback(void (*callback)(void*,TAAudioStreamPos&), void* user);
+
+    void* getContext();
+    bool quit();
+    bool setRun(bool run);
+    std::vector<String> listAudioDevices();
+    bool init(TAAudioDesc& request, TAAudioDesc& response);
+    TAAudioStream():
+      outThread(NULL),
+      transport(TA_STREAM_STDOUT),
+      fd(-1),
+      listenFD(-1),
+      ring(NULL),
+      ringData(NULL),
+      ringSize(0),
+      batch(NULL),
+      batchFrames(0),
+      batchPos(0),
+      bytesPerFrame(0),
+      timestamp(0),
+      startTime(0),
+      pendingFlags(0),
+      paceClock(false),
+      positionCallback(NULL),
+      positionCallbackUser(NULL) {}
+};
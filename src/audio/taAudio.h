@@ -195,6 +195,7 @@ class TAAudio {
     virtual std::vector<String> listAudioDevices();
     TAAudioDeviceStatus getDeviceStatus();
     void acceptDeviceStatus();
+    bool isRunning();
     bool initMidi(bool jack);
     void quitMidi();
     virtual bool init(TAAudioDesc& request, TAAudioDesc& response);
@@ -170,13 +170,16 @@ struct DivCSOptions {
   bool noCmdCallOpt;
   bool noDelayCondense;
   bool noSubBlock;
+  // 0 means as many as there are CPU cores
+  unsigned int subBlockThreads;
 
   DivCSOptions():
     longPointers(false),
     bigEndian(false),
     noCmdCallOpt(false),
     noDelayCondense(false),
-    noSubBlock(false) {}
+    noSubBlock(false),
+    subBlockThreads(0) {}
 };
 
 // command stream utilities
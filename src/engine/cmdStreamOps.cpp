@@ -18,7 +18,9 @@
  */
 
 #include "engine.h"
+#include "workPool.h"
 #include "../ta-log.h"
+#include <algorithm>
 #include <stack>
 #include <unordered_map>
 
@@ -655,14 +657,6 @@ void writeCommandValues(SafeWriter* w, const DivCommand& c, bool bigEndian) {
 
 using namespace DivCS;
 
-int estimateBlockSize(unsigned char* buf, size_t len, unsigned char* speedDial) {
-  int ret=0;
-  for (size_t i=0; i<len; i+=8) {
-    ret+=getInsLength(buf[i],buf[i+1],speedDial);
-  }
-  return ret;
-}
-
 void reloc8(unsigned char* buf, size_t len, unsigned int sourceAddr, unsigned int destAddr) {
   unsigned int delta=destAddr-sourceAddr;
   for (size_t i=0; i<len; i+=8) {
@@ -899,211 +893,313 @@ struct MatchBenefit {
     index(0), benefit(0), len(0) {}
 };
 
+// a repeat found in the suffix array.
+// occurrences are sa[lb..rb]. every length in [minLen..maxLen] (in commands) has the same set of occurrences.
+struct RepeatInterval {
+  unsigned int lb, rb;
+  unsigned int minLen, maxLen;
+  unsigned int orig;
+  RepeatInterval(unsigned int l, unsigned int r, unsigned int mi, unsigned int ma, unsigned int o):
+    lb(l), rb(r), minLen(mi), maxLen(ma), orig(o) {}
+};
+
+// shared by the benefit search tasks
+struct RepeatSearch {
+  const std::vector<RepeatInterval>* intervals;
+  const std::vector<unsigned int>* sa;
+  const std::vector<int>* sizeSum;
+  size_t begin, end;
+  MatchBenefit best;
+};
+
 #define OVERLAPS(a1,a2,b1,b2) ((b1)<(a2) && (b2)>(a1))
 
 #define MIN_MATCH_SIZE 32
 
-SafeWriter* findSubBlocks(SafeWriter* stream, std::vector<SafeWriter*>& subBlocks, unsigned char* speedDial, DivCSProgress* progress) {
+// minimum match size in commands
+#define MIN_MATCH_CMDS (MIN_MATCH_SIZE>>3)
+
+// amount of repeats every search task takes
+#define REPEAT_SEARCH_CHUNK 4096
+
+// count the matches which would be turned into calls, the same way findSubBlocks() does.
+// occ is sorted and contains orig.
+int countValidMatches(const std::vector<unsigned int>& occ, unsigned int orig, unsigned int len) {
+  int validCount=0;
+  unsigned int overlapPos=orig;
+  for (unsigned int i: occ) {
+    // self-overlapping (this also skips orig)
+    if (i<orig+len) continue;
+    if (!OVERLAPS(overlapPos,overlapPos+len,i,i+len)) {
+      validCount++;
+    }
+    overlapPos=i;
+  }
+  return validCount;
+}
+
+void searchRepeats(void* arg) {
+  RepeatSearch* s=(RepeatSearch*)arg;
+  const std::vector<RepeatInterval>& intervals=*s->intervals;
+  const std::vector<unsigned int>& sa=*s->sa;
+  const std::vector<int>& sizeSum=*s->sizeSum;
+  std::vector<unsigned int> occ;
+  std::vector<unsigned int> lens;
+
+  for (size_t i=s->begin; i<s->end; i++) {
+    const RepeatInterval& r=intervals[i];
+    occ.assign(sa.begin()+r.lb,sa.begin()+r.rb+1);
+    std::sort(occ.begin(),occ.end());
+
+    // the amount of valid matches only changes at the distance between two occurrences.
+    // a longer block is always better as long as that amount stays the same,
+    // so only the longest length before every change is worth testing.
+    lens.clear();
+    lens.push_back(r.maxLen);
+    for (size_t j=1; j<occ.size(); j++) {
+      unsigned int gap=occ[j]-occ[j-1];
+      if (gap>=r.minLen && gap<r.maxLen) lens.push_back(gap);
+      gap=occ[j]-r.orig;
+      if (gap>=r.minLen && gap<r.maxLen) lens.push_back(gap);
+    }
+    std::sort(lens.begin(),lens.end());
+    lens.erase(std::unique(lens.begin(),lens.end()),lens.end());
+
+    for (unsigned int len: lens) {
+      int validCount=countValidMatches(occ,r.orig,len);
+
+      // calculate (weighted) benefit
+      const int blockSize=sizeSum[r.orig+len]-sizeSum[r.orig];
+      const int gains=((blockSize-3)*validCount)-4;
+      int finalBenefit=gains*2+(len<<3)*3;
+      if (gains<1) finalBenefit=-1;
+
+      if (finalBenefit>s->best.benefit) {
+        s->best=MatchBenefit(i,finalBenefit,len);
+      }
+    }
+  }
+}
+
+// build a suffix array of a command stream, using commands (8 bytes each) as symbols.
+// this is prefix doubling with radix sort, O(n log n).
+void buildSuffixArray(unsigned char* buf, unsigned int n, std::vector<unsigned int>& sa, std::vector<unsigned int>& rank) {
+  std::vector<unsigned int> tmp(n);
+  std::vector<unsigned int> count;
+  sa.resize(n);
+  rank.resize(n);
+
+  // initial ranks (by command)
+  for (unsigned int i=0; i<n; i++) sa[i]=i;
+  std::sort(sa.begin(),sa.end(),[buf](unsigned int a, unsigned int b) {
+    return memcmp(&buf[a<<3],&buf[b<<3],8)<0;
+  });
+  unsigned int classes=0;
+  for (unsigned int i=0; i<n; i++) {
+    if (i>0 && memcmp(&buf[sa[i-1]<<3],&buf[sa[i]<<3],8)!=0) classes++;
+    rank[sa[i]]=classes;
+  }
+  classes++;
+
+  for (unsigned int k=1; classes<n; k<<=1) {
+    // sort by second key: suffixes without one go first
+    unsigned int p=0;
+    for (unsigned int i=n-k; i<n; i++) tmp[p++]=i;
+    for (unsigned int i=0; i<n; i++) {
+      if (sa[i]>=k) tmp[p++]=sa[i]-k;
+    }
+
+    // stable sort by first key
+    count.assign(classes+1,0);
+    for (unsigned int i=0; i<n; i++) count[rank[i]+1]++;
+    for (unsigned int i=1; i<=classes; i++) count[i]+=count[i-1];
+    for (unsigned int i=0; i<n; i++) sa[count[rank[tmp[i]]]++]=tmp[i];
+
+    // new ranks
+    tmp[sa[0]]=0;
+    classes=1;
+    for (unsigned int i=1; i<n; i++) {
+      unsigned int a=sa[i-1];
+      unsigned int b=sa[i];
+      if (rank[a]!=rank[b] || (a+k<n)!=(b+k<n) || (a+k<n && rank[a+k]!=rank[b+k])) classes++;
+      tmp[b]=classes-1;
+    }
+    rank.swap(tmp);
+  }
+}
+
+SafeWriter* findSubBlocks(SafeWriter* stream, std::vector<SafeWriter*>& subBlocks, unsigned char* speedDial, DivCSProgress* progress, DivWorkPool* pool) {
   unsigned char* buf=stream->getFinalBuf();
-  size_t matchSize=MIN_MATCH_SIZE;
-  std::vector<BlockMatch> matches;
+  unsigned int n=stream->size()>>3;
+  std::vector<unsigned int> sa;
+  std::vector<unsigned int> rank;
+  std::vector<unsigned int> lcp;
+  std::vector<unsigned int> cleanLen;
+  std::vector<int> sizeSum;
+  std::vector<RepeatInterval> intervals;
   std::vector<BlockMatch> workMatches;
-  std::vector<size_t> origs;
   MatchBenefit bestBenefit;
 
-  matches.clear();
-
   if (progress!=NULL) {
     progress->findTotal=stream->size();
     progress->optStage=0;
   }
 
-  // fast match algorithm
-  // search for small matches, and then find bigger ones
-  logD("finding possible matches");
-  for (size_t i=0; i<stream->size(); i+=8) {
-    if (!(i&2047)) {
-      if (progress!=NULL) progress->findCurrent=i;
+  if (n<MIN_MATCH_CMDS*2) return stream;
+
+  // suffix array algorithm
+  // every repeat is an interval of the suffix array where the longest common prefix is
+  // at least its length. all of them are found in one pass over the LCP array.
+  logD("building suffix array");
+  buildSuffixArray(buf,n,sa,rank);
+
+  // LCP array (Kasai's algorithm)
+  // lcp[i] is the common prefix length of sa[i-1] and sa[i]
+  lcp.resize(n+1);
+  lcp[0]=0;
+  lcp[n]=0;
+  unsigned int h=0;
+  for (unsigned int i=0; i<n; i++) {
+    if (rank[i]>0) {
+      unsigned int j=sa[rank[i]-1];
+      while (i+h<n && j+h<n && memcmp(&buf[(i+h)<<3],&buf[(j+h)<<3],8)==0) h++;
+      lcp[rank[i]]=h;
+      if (h>0) h--;
+    } else {
+      h=0;
     }
-    bool storedOrig=false;
-    for (size_t j=i+matchSize; j<stream->size(); j+=8) {
-      if (memcmp(&buf[i],&buf[j],matchSize)==0) {
-        if (!storedOrig) {
-          // store index to the first match somewhere else for the sake of speed
-          origs.push_back(matches.size());
-          storedOrig=true;
-        }
-        // store this match for later
-        matches.push_back(BlockMatch(i,j,matchSize));
-      }
+  }
+
+  // maximum block length at every position.
+  // blocks shall not contain calls, jmp, ret or stop.
+  cleanLen.resize(n+1);
+  cleanLen[n]=0;
+  for (unsigned int i=n; i>0; i--) {
+    unsigned char c=buf[(i-1)<<3];
+    if (c==0xd4 || c==0xd5 || c==0xd9 || c==0xda || c==0xdf) {
+      cleanLen[i-1]=0;
+    } else {
+      cleanLen[i-1]=cleanLen[i]+1;
     }
   }
 
-  logD("%d candidates",(int)matches.size());
-  logD("%d origs",(int)origs.size());
+  // block sizes after packing
+  sizeSum.resize(n+1);
+  sizeSum[0]=0;
+  for (unsigned int i=0; i<n; i++) {
+    sizeSum[i+1]=sizeSum[i]+getInsLength(buf[i<<3],buf[(i<<3)+1],speedDial);
+  }
 
   if (progress!=NULL) {
-    if ((int)matches.size()>progress->optTotal) progress->optTotal=matches.size();
-    progress->optCurrent=matches.size();
-    progress->origCount=origs.size();
     progress->findCurrent=stream->size();
     progress->optStage=1;
   }
 
-  // quit if there isn't anything
-  if (matches.empty()) return stream;
-
-  // search for bigger matches
-  for (size_t i=0; i<matches.size(); i++) {
-    if ((i&8191)==0) {
-      logV("match %d of %d",i,(int)matches.size());
-    }
-    if ((i&1023)==0) {
-      if (progress!=NULL) progress->expandCurrent=i;
-    }
-    BlockMatch& b=matches[i];
-
-    size_t finalLen=b.len;
-    size_t origPos=b.orig+b.len;
-    size_t blockPos=b.block+b.len;
-    while (true) {
-      // origPos is guaranteed to be before blockPos
-      if (blockPos>=stream->size()) {
-        break;
-      }
-
-      if (buf[origPos]!=buf[blockPos]) {
-        break;
+  // find repeats
+  // this is a bottom-up traversal of the LCP intervals, which correspond to the nodes of a suffix tree.
+  // the original block is the first occurrence of a repeat, which is tracked on the way up.
+  struct StackEntry {
+    unsigned int lcp, lb, first;
+    StackEntry(unsigned int l, unsigned int b, unsigned int f):
+      lcp(l), lb(b), first(f) {}
+  };
+  std::vector<StackEntry> stack;
+  stack.push_back(StackEntry(0,0,sa[0]));
+  for (unsigned int i=1; i<=n; i++) {
+    unsigned int lb=i-1;
+    unsigned int first=sa[i-1];
+    while (lcp[i]<stack.back().lcp) {
+      StackEntry top=stack.back();
+      if (first<top.first) top.first=first;
+      stack.pop_back();
+      unsigned int parentLcp=MAX(lcp[i],stack.back().lcp);
+      unsigned int minLen=MAX(parentLcp+1,MIN_MATCH_CMDS);
+      unsigned int maxLen=MIN(top.lcp,cleanLen[top.first]);
+      if (maxLen>=minLen) {
+        intervals.push_back(RepeatInterval(top.lb,i-1,minLen,maxLen,top.first));
       }
-      origPos++;
-      blockPos++;
-      finalLen++;
+      lb=top.lb;
+      first=top.first;
+    }
+    if (lcp[i]>stack.back().lcp) {
+      stack.push_back(StackEntry(lcp[i],lb,first));
+    } else if (first<stack.back().first) {
+      stack.back().first=first;
     }
-
-    finalLen&=~7;
-    b.len=finalLen;
   }
 
+  logD("%d repeats",(int)intervals.size());
+
   if (progress!=NULL) {
-    progress->expandCurrent=matches.size();
+    if ((int)intervals.size()>progress->optTotal) progress->optTotal=intervals.size();
+    progress->optCurrent=intervals.size();
+    progress->expandCurrent=intervals.size();
+    progress->origCount=intervals.size();
+    progress->origCurrent=0;
     progress->optStage=2;
   }
 
-  // new code MAN... WHY...
-  // basically the workflow should be:
-  // - test every block position
-  //   - test every length from MIN_MATCH_SIZE to largest length
-  //   - check for overlap, bad matches and all of that
-  //     - for bad matches, fortunately we can use length for a speed-up... but first make it right
-  //   - add weighted benefit to a list (DEBUG..... remove once it's stable)
-  // - pick largest benefit from list
-  // - make sub-blocks!!!
-  logD("testing %d match groups for benefit",(int)origs.size());
-  size_t origIndex=0;
-  for (size_t i=0; i<origs.size(); i++) {
-    size_t begin=origs[i];
-    size_t end=(i+1<origs.size())?origs[i+1]:matches.size();
-    size_t minSize=MIN_MATCH_SIZE;
-    std::vector<BlockMatch> testLenMatches;
-
-    if (progress!=NULL) progress->origCurrent=origIndex;
-
-    origIndex++;
-
-    if (!(i&255)) logV("orig %d of %d",(int)i,(int)origs.size());
-
-    // test all lengths
-    for (size_t len=minSize; true; len+=8) {
-      testLenMatches.clear();
-      // filter matches
-      for (size_t _k=begin; _k<end; _k++) {
-        BlockMatch& k=matches[_k];
-        // match length shall be greater than or equal to current length
-        if (len>k.len) continue;
-
-        // check for bad matches, which include:
-        // - match overlapping with itself
-        // - block only consisting of calls
-        // - block containing a ret, jmp or stop
-
-        // 1. self-overlapping
-        if (OVERLAPS(k.orig,k.orig+len,k.block,k.block+len)) continue;
-
-        // 2. only calls and jmp/ret/stop
-        bool metCriteria=true;
-        for (size_t l=k.orig; l<k.orig+len; l+=8) {
-          if (buf[l]==0xd4 || buf[l]==0xd5) {
-            metCriteria=false;
-            break;
-          }
-        }
-        if (!metCriteria) continue;
-
-        // 3. jmp/ret/stop
-        for (size_t l=k.orig; l<k.orig+len; l+=8) {
-          if (buf[l]==0xd9 || buf[l]==0xda || buf[l]==0xdf) {
-            metCriteria=false;
-            break;
-          }
-        }
-        if (!metCriteria) continue;
-
-        // all criteria met
-        testLenMatches.push_back(k);
-      }
-
-      // get out if no further matches (trying with bigger sizes is guaranteed to fail)
-      if (testLenMatches.empty()) {
-        break;
-      }
-
-      // check for overlapping matches
-      size_t overlapPos=testLenMatches[0].orig;
-      size_t validCount=0;
-      for (BlockMatch& k: testLenMatches) {
-        //logV("test %d with %d",(int)overlapPos,(int)k.block);
-        if (OVERLAPS(overlapPos,overlapPos+len,k.block,k.block+len)) {
-          k.done=true;
-          //logW("overlap");
-        } else {
-          validCount++;
-        }
-        overlapPos=k.block;
-      }
-
-
-      // calculate (weighted) benefit
-      const int blockSize=estimateBlockSize(&buf[testLenMatches[0].orig],len,speedDial);
-      const int gains=((blockSize-3)*validCount)-4;
-      int finalBenefit=gains*2+len*3;
-      if (gains<1) finalBenefit=-1;
+  // quit if there isn't anything
+  if (intervals.empty()) return stream;
+
+  // rank repeats by benefit
+  // this is split in chunks which may run in parallel. the results are merged in order,
+  // so the picked block does not depend on the thread count.
+  logD("testing %d repeats for benefit",(int)intervals.size());
+  std::vector<RepeatSearch> searches((intervals.size()+REPEAT_SEARCH_CHUNK-1)/REPEAT_SEARCH_CHUNK);
+  for (size_t i=0; i<searches.size(); i++) {
+    RepeatSearch& s=searches[i];
+    s.intervals=&intervals;
+    s.sa=&sa;
+    s.sizeSum=&sizeSum;
+    s.begin=i*REPEAT_SEARCH_CHUNK;
+    s.end=MIN(s.begin+REPEAT_SEARCH_CHUNK,intervals.size());
+    if (pool!=NULL && searches.size()>1) {
+      pool->push(searchRepeats,&s);
+    } else {
+      searchRepeats(&s);
+      if (progress!=NULL) progress->origCurrent=s.end;
+    }
+  }
+  if (pool!=NULL && searches.size()>1) pool->wait();
 
-      // check whether this set of matches has greater benefit
-      if (finalBenefit>bestBenefit.benefit) {
-        //logD("- %x (%d): %d = %d",(int)i,(int)len,(int)testLenMatches.size(),finalBenefit);
-        bestBenefit=MatchBenefit(begin,finalBenefit,len);
-        // copy matches so we don't have to select them later
-        workMatches=testLenMatches;
-      }
+  for (RepeatSearch& s: searches) {
+    if (s.best.benefit>bestBenefit.benefit) {
+      bestBenefit=s.best;
     }
   }
 
   // quit if there isn't benefit
   if (bestBenefit.benefit<1) return stream;
 
-  // quit if there's nothing to work on
-  if (workMatches.empty()) return stream;
-
   // pick best benefit
-  logI("BEST BENEFIT: %d in %x with size %u",bestBenefit.benefit,(int)bestBenefit.index,bestBenefit.len);
+  const RepeatInterval& best=intervals[bestBenefit.index];
+  size_t bestOrig=(size_t)best.orig<<3;
+  std::vector<unsigned int> occ(sa.begin()+best.lb,sa.begin()+best.rb+1);
+  std::sort(occ.begin(),occ.end());
 
   // work on matches with this benefit
-  size_t bestOrig=matches[bestBenefit.index].orig;
+  unsigned int overlapPos=best.orig;
+  for (unsigned int i: occ) {
+    if (i<best.orig+bestBenefit.len) continue;
+    BlockMatch m(bestOrig,(size_t)i<<3,bestBenefit.len<<3);
+    if (OVERLAPS(overlapPos,overlapPos+bestBenefit.len,i,i+bestBenefit.len)) {
+      m.done=true;
+    }
+    workMatches.push_back(m);
+    overlapPos=i;
+  }
+  bestBenefit.len<<=3;
+
+  // quit if there's nothing to work on
+  if (workMatches.empty()) return stream;
+
+  logI("BEST BENEFIT: %d in %x with size %u",bestBenefit.benefit,(int)bestOrig,bestBenefit.len);
   logI("match count %d",(int)workMatches.size());
 
   if (progress!=NULL) {
     progress->optStage=3;
-    progress->origCurrent=origs.size();
+    progress->origCurrent=intervals.size();
   }
 
   // make sub-block
@@ -1736,12 +1832,17 @@ SafeWriter* DivEngine::saveCommand(DivCSProgress* progress, DivCSOptions options
     // 6 is the minimum size that can be reliably optimized
     logI("finding sub-blocks");
 
+    // the benefit search may run in parallel
+    unsigned int threads=options.subBlockThreads;
+    if (threads==0) threads=std::thread::hardware_concurrency();
+    DivWorkPool* pool=(threads>1)?(new DivWorkPool(threads)):NULL;
+
     bool haveBlocks=false;
     subBlocks.clear();
     // repeat until no more sub-blocks are produced
     do {
       logD("iteration...");
-      globalStream=findSubBlocks(globalStream,subBlocks,sortedCmd,progress);
+      globalStream=findSubBlocks(globalStream,subBlocks,sortedCmd,progress,pool);
 
       haveBlocks=!subBlocks.empty();
       // insert sub-blocks and resolve symbols
@@ -1786,6 +1887,11 @@ SafeWriter* DivEngine::saveCommand(DivCSProgress* progress, DivCSOptions options
       }
     } while (haveBlocks);
 
+    if (pool!=NULL) {
+      delete pool;
+      pool=NULL;
+    }
+
     size_t afterSize=globalStream->size();
     logI("(before: %d - after: %d)",(int)beforeSize,(int)afterSize);
     assert(!(globalStream->size()&7));
@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <atomic>
 #include "../pch.h"
 #include "blip_buf.h"
 #include "config.h"
@@ -895,6 +896,11 @@ constexpr size_t OSCBUF_MASK=(UINTMAX_C(1)<<OSCBUF_PREC)-1;
  * this is a buffer for a channel's output.
  * it is used for the per-channel oscilloscope.
  * it should not be used for per-channel audio export as its output is optimized and may have a lower rate/quality.
+ *
+ * there is one writer (the dispatch, during acquire()) and any number of readers on other threads.
+ * readers should not look at needle. instead, call snapshot() to get a sequence number, read the data behind it
+ * (the lower 16 bits are the position) directly from the buffer, then call intact() to check whether the writer
+ * has overwritten any of it in the meantime.
  */
 struct DivDispatchOscBuffer {
   // the input rate of this osc buffer.
@@ -918,6 +924,30 @@ struct DivDispatchOscBuffer {
   // if you're wondering why, it's to speed up acquireDirect() by not having to fill in each sample.
   // actual -1 samples become -2 to avoid conflicts. see what I told you about optimization?
   short data[65536];
+  // total number of output samples written so far. the lower 16 bits match needle>>16.
+  // published with release semantics in end().
+  std::atomic<unsigned int> seq;
+  // how far the writer may have gone past seq (set in begin(), before any sample is written).
+  std::atomic<unsigned int> claim;
+
+  /**
+   * get the current sequence number for reading.
+   * the samples before (unsigned short)seq are safe to read, but check intact() afterwards.
+   * @return the sequence number.
+   */
+  inline unsigned int snapshot() const {
+    return seq.load(std::memory_order_acquire);
+  }
+  /**
+   * check whether the samples read after a snapshot are still valid.
+   * @param snap the value returned by snapshot().
+   * @param len how many samples before the snapshot position were read.
+   * @return whether none of them were overwritten.
+   */
+  inline bool intact(unsigned int snap, unsigned int len) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (claim.load(std::memory_order_relaxed)-snap)+len<=65536;
+  }
 
   /**
    * put a sample into the output buffer.
@@ -960,6 +990,10 @@ struct DivDispatchOscBuffer {
       end++;
     }
 
+    // let readers know which part we're about to touch
+    claim.store(seq.load(std::memory_order_relaxed)+(unsigned short)(end-(needle>>16)),std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
     //logD("C %d %d %d",len,calc,rate);
 
     if (end<start) {
@@ -979,8 +1013,10 @@ struct DivDispatchOscBuffer {
    */
   inline void end(size_t len) {
     size_t calc=len*rateMul;
+    unsigned short start=needle>>16;
     needle+=calc;
     mustNotKillNeedle=needle&0xffff;//(data[needle>>16]!=-1);
+    seq.store(seq.load(std::memory_order_relaxed)+(unsigned short)((needle>>16)-start),std::memory_order_release);
     //data[needle>>16]=lastSample;
   }
   /**
@@ -991,6 +1027,8 @@ struct DivDispatchOscBuffer {
     needle=0;
     readNeedle=0;
     mustNotKillNeedle=false;
+    seq.store(0,std::memory_order_release);
+    claim.store(0,std::memory_order_release);
     //lastSample=0;
   }
   /**
@@ -1010,7 +1048,9 @@ struct DivDispatchOscBuffer {
     readNeedle(0),
     //lastSample(0),
     follow(true),
-    mustNotKillNeedle(false) {
+    mustNotKillNeedle(false),
+    seq(0),
+    claim(0) {
     memset(data,-1,65536*sizeof(short));
   }
 };
@@ -1329,18 +1369,37 @@ class DivDispatch {
     virtual int getRegisterPoolDepth();
 
     /**
-     * get this dispatch's state. DO NOT IMPLEMENT YET.
-     * @return a pointer to the dispatch's state. must be deallocated manually!
+     * get this dispatch's state.
+     * this is used by the engine to create seek checkpoints.
+     * only the playback state (channels, macros and anything else altered by
+     * dispatch()/tick()) has to be saved. the emulated chip may be left alone,
+     * as it does not receive writes during a seek.
+     * @return a pointer to the dispatch's state, or NULL if this dispatch does
+     * not support state saves. must be deallocated using freeState()!
      */
     virtual void* getState();
 
     /**
-     * set this dispatch's state. DO NOT IMPLEMENT YET.
-     * @param state a pointer to a state pertaining to this dispatch,
-     * or NULL if this dispatch does not support state saves.
+     * whether this dispatch supports state saves (getState()/setState()).
+     * the engine only takes seek checkpoints if every dispatch does.
+     * @return whether state saves are supported. false by default.
+     */
+    virtual bool hasState();
+
+    /**
+     * set this dispatch's state.
+     * this is called after reset() and before the engine resumes a seek.
+     * @param state a pointer to a state previously returned by getState() on
+     * this dispatch.
      */
     virtual void setState(void* state);
 
+    /**
+     * deallocate a state returned by getState().
+     * @param state the state.
+     */
+    virtual void freeState(void* state);
+
     /**
      * mute a channel.
      * @param ch the channel to mute.
@@ -96,7 +96,9 @@
 #include "platform/multipcm.h"
 #include "platform/dummy.h"
 #include "../ta-log.h"
+#include "mixKernel.h"
 #include "song.h"
+#include <math.h>
 
 void DivDispatchContainer::setRates(double gotRate) {
   int outs=dispatch->getOutputCount();
@@ -106,6 +108,7 @@ void DivDispatchContainer::setRates(double gotRate) {
     blip_set_rates(bb[i],dispatch->rate,gotRate);
   }
   rateMemory=gotRate;
+  updateDirect();
 }
 
 void DivDispatchContainer::setQuality(bool lowQual, bool dcHiPass) {
@@ -115,6 +118,40 @@ void DivDispatchContainer::setQuality(bool lowQual, bool dcHiPass) {
     if (bb[i]==NULL) continue;
     blip_set_dc(bb[i],dcHiPass);
   }
+  updateDirect();
+}
+
+// highest multiple of the output rate which is decimated without blip_buf
+#define DIV_DIRECT_MAX_FACTOR 8
+
+// decide whether blip_buf can be bypassed.
+// this is possible when the chip runs at the output rate or an integer multiple of it,
+// and the dispatch doesn't write to blip_buf directly.
+void DivDispatchContainer::updateDirect() {
+  int prevFactor=directFactor;
+  directFactor=0;
+  if (dispatch!=NULL && rateMemory>0.0 && !dispatch->hasAcquireDirect()) {
+    double ratio=(double)dispatch->rate/rateMemory;
+    int factor=(int)round(ratio);
+    if (factor>=1 && factor<=DIV_DIRECT_MAX_FACTOR && (double)factor*rateMemory==(double)dispatch->rate) {
+      // decimation only averages samples, which is as good as the low quality setting
+      if (factor==1 || lowQuality) directFactor=factor;
+    }
+  }
+  if (directFactor!=prevFactor) {
+    logV("dispatch %p: direct output factor %d (rate %d, output rate %g)",(void*)this,directFactor,dispatch->rate,rateMemory);
+    memset(directSum,0,DIV_MAX_OUTPUTS*sizeof(int));
+  }
+}
+
+int DivDispatchContainer::samplesAvail() {
+  if (directFactor>0) return 0;
+  return blip_samples_avail(bb[0]);
+}
+
+int DivDispatchContainer::clocksNeeded(int samples) {
+  if (directFactor>0) return samples*directFactor;
+  return blip_clocks_needed(bb[0],samples);
 }
 
 void DivDispatchContainer::grow(size_t size) {
@@ -182,9 +219,57 @@ void DivDispatchContainer::flush(size_t offset, size_t count) {
   }
 }
 
+// fast path of fillBuf() which skips blip_buf.
+// the high-pass filter is the same one blip_buf applies in blip_read_samples().
+#define DIRECT_DELTA_BITS 15
+#define DIRECT_BASS_SHIFT 9
+
+void DivDispatchContainer::fillBufDirect(size_t runtotal, size_t offset, size_t size, int outs) {
+  if (size*directFactor>runtotal) {
+    logW("dispatch %p: not enough input for direct output! %d<%d",(void*)this,(int)runtotal,(int)(size*directFactor));
+    size=runtotal/directFactor;
+  }
+  if (dcOffCompensation && runtotal>0) {
+    dcOffCompensation=false;
+    if (hiPass) {
+      for (int i=0; i<outs; i++) {
+        if (bbIn[i]==NULL) continue;
+        prevSample[i]=bbIn[i][0];
+      }
+    }
+  }
+  for (int i=0; i<outs; i++) {
+    if (bbIn[i]==NULL) continue;
+    if (bbOut[i]==NULL) continue;
+    short* out=bbOut[i]+offset;
+    decimateShort(out,bbIn[i],directFactor,size);
+    if (hiPass) {
+      int sum=directSum[i];
+      int prev=prevSample[i];
+      for (size_t j=0; j<size; j++) {
+        sum+=(out[j]-prev)<<DIRECT_DELTA_BITS;
+        prev=out[j];
+        int s=sum>>DIRECT_DELTA_BITS;
+        if (s<-32768) s=-32768;
+        if (s>32767) s=32767;
+        out[j]=s;
+        sum-=s<<(DIRECT_DELTA_BITS-DIRECT_BASS_SHIFT);
+      }
+      directSum[i]=sum;
+      prevSample[i]=prev;
+    }
+    dispatch->postProcess(out,i,size,rateMemory);
+  }
+}
+
 void DivDispatchContainer::fillBuf(size_t runtotal, size_t offset, size_t size) {
   CHECK_MISSING_BUFS;
 
+  if (directFactor>0) {
+    fillBufDirect(runtotal,offset,size,outs);
+    return;
+  }
+
   if (!dispatch->hasAcquireDirect()) {
     if (dcOffCompensation && runtotal>0) {
       dcOffCompensation=false;
@@ -221,6 +306,7 @@ void DivDispatchContainer::clear() {
     if (bb[i]!=NULL) blip_clear(bb[i]);
     temp[i]=0;
     prevSample[i]=0;
+    directSum[i]=0;
   }
 
   if (dispatch->getDCOffRequired() && hiPass) {
@@ -228,9 +314,25 @@ void DivDispatchContainer::clear() {
   }
 }
 
+// reads an emulation core setting and remembers which one it was (used by benchmarkCores())
+// count is the number of cores this chip can pick from.
+// benchmarkCores() picks the core through benchCoreConf rather than the configuration.
+int DivDispatchContainer::getCoreConf(DivEngine* eng, const char* key, int def, int count) {
+  coreKey=key;
+  coreCount=count;
+  if (eng->benchCoreConf.has(key)) {
+    coreValue=eng->benchCoreConf.getInt(key,def);
+  } else {
+    coreValue=eng->getConfInt(key,def);
+  }
+  return coreValue;
+}
+
 void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, double gotRate, const DivConfig& flags, bool isRender) {
   // quit if we already initialized
   if (dispatch!=NULL) return;
+  coreKey=NULL;
+  coreCount=0;
 
   // initialize chip
   switch (sys) {
@@ -241,27 +343,27 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_YM2612:
       dispatch=new DivPlatformGenesis;
       if (isRender) {
-        ((DivPlatformGenesis*)dispatch)->setYMFM(eng->getConfInt("ym2612CoreRender",0));
+        ((DivPlatformGenesis*)dispatch)->setYMFM(getCoreConf(eng,"ym2612CoreRender",0,3));
       } else {
-        ((DivPlatformGenesis*)dispatch)->setYMFM(eng->getConfInt("ym2612Core",0));
+        ((DivPlatformGenesis*)dispatch)->setYMFM(getCoreConf(eng,"ym2612Core",0,3));
       }
       ((DivPlatformGenesis*)dispatch)->setSoftPCM(false);
       break;
     case DIV_SYSTEM_YM2612_EXT:
       dispatch=new DivPlatformGenesisExt;
       if (isRender) {
-        ((DivPlatformGenesisExt*)dispatch)->setYMFM(eng->getConfInt("ym2612CoreRender",0));
+        ((DivPlatformGenesisExt*)dispatch)->setYMFM(getCoreConf(eng,"ym2612CoreRender",0,3));
       } else {
-        ((DivPlatformGenesisExt*)dispatch)->setYMFM(eng->getConfInt("ym2612Core",0));
+        ((DivPlatformGenesisExt*)dispatch)->setYMFM(getCoreConf(eng,"ym2612Core",0,3));
       }
       ((DivPlatformGenesisExt*)dispatch)->setSoftPCM(false);
       break;
     case DIV_SYSTEM_YM2612_CSM:
       dispatch=new DivPlatformGenesisExt;
       if (isRender) {
-        ((DivPlatformGenesisExt*)dispatch)->setYMFM(eng->getConfInt("ym2612CoreRender",0));
+        ((DivPlatformGenesisExt*)dispatch)->setYMFM(getCoreConf(eng,"ym2612CoreRender",0,3));
       } else {
-        ((DivPlatformGenesisExt*)dispatch)->setYMFM(eng->getConfInt("ym2612Core",0));
+        ((DivPlatformGenesisExt*)dispatch)->setYMFM(getCoreConf(eng,"ym2612Core",0,3));
       }
       ((DivPlatformGenesisExt*)dispatch)->setSoftPCM(false);
       ((DivPlatformGenesisExt*)dispatch)->setCSMChannel(6);
@@ -269,27 +371,27 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_YM2612_DUALPCM:
       dispatch=new DivPlatformGenesis;
       if (isRender) {
-        ((DivPlatformGenesis*)dispatch)->setYMFM(eng->getConfInt("ym2612CoreRender",0));
+        ((DivPlatformGenesis*)dispatch)->setYMFM(getCoreConf(eng,"ym2612CoreRender",0,3));
       } else {
-        ((DivPlatformGenesis*)dispatch)->setYMFM(eng->getConfInt("ym2612Core",0));
+        ((DivPlatformGenesis*)dispatch)->setYMFM(getCoreConf(eng,"ym2612Core",0,3));
       }
       ((DivPlatformGenesis*)dispatch)->setSoftPCM(true);
       break;
     case DIV_SYSTEM_YM2612_DUALPCM_EXT:
       dispatch=new DivPlatformGenesisExt;
       if (isRender) {
-        ((DivPlatformGenesisExt*)dispatch)->setYMFM(eng->getConfInt("ym2612CoreRender",0));
+        ((DivPlatformGenesisExt*)dispatch)->setYMFM(getCoreConf(eng,"ym2612CoreRender",0,3));
       } else {
-        ((DivPlatformGenesisExt*)dispatch)->setYMFM(eng->getConfInt("ym2612Core",0));
+        ((DivPlatformGenesisExt*)dispatch)->setYMFM(getCoreConf(eng,"ym2612Core",0,3));
       }
       ((DivPlatformGenesisExt*)dispatch)->setSoftPCM(true);
       break;
     case DIV_SYSTEM_SMS:
       dispatch=new DivPlatformSMS;
       if (isRender) {
-        ((DivPlatformSMS*)dispatch)->setNuked(eng->getConfInt("snCoreRender",0));
+        ((DivPlatformSMS*)dispatch)->setNuked(getCoreConf(eng,"snCoreRender",0,2));
       } else {
-        ((DivPlatformSMS*)dispatch)->setNuked(eng->getConfInt("snCore",0));
+        ((DivPlatformSMS*)dispatch)->setNuked(getCoreConf(eng,"snCore",0,2));
       }
       break;
     case DIV_SYSTEM_GB:
@@ -306,9 +408,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_NES:
       dispatch=new DivPlatformNES;
       if (isRender) {
-        ((DivPlatformNES*)dispatch)->setNSFPlay(eng->getConfInt("nesCoreRender",0)==1);
+        ((DivPlatformNES*)dispatch)->setNSFPlay(getCoreConf(eng,"nesCoreRender",0,2)==1);
       } else {
-        ((DivPlatformNES*)dispatch)->setNSFPlay(eng->getConfInt("nesCore",0)==1);
+        ((DivPlatformNES*)dispatch)->setNSFPlay(getCoreConf(eng,"nesCore",0,2)==1);
       }
       ((DivPlatformNES*)dispatch)->set5E01(false);
       break;
@@ -316,10 +418,10 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_C64_PCM:
       dispatch=new DivPlatformC64;
       if (isRender) {
-        ((DivPlatformC64*)dispatch)->setCore(eng->getConfInt("c64CoreRender",1));
+        ((DivPlatformC64*)dispatch)->setCore(getCoreConf(eng,"c64CoreRender",1,3));
         ((DivPlatformC64*)dispatch)->setCoreQuality(eng->getConfInt("dsidQualityRender",3));
       } else {
-        ((DivPlatformC64*)dispatch)->setCore(eng->getConfInt("c64Core",0));
+        ((DivPlatformC64*)dispatch)->setCore(getCoreConf(eng,"c64Core",0,3));
         ((DivPlatformC64*)dispatch)->setCoreQuality(eng->getConfInt("dsidQuality",3));
       }
       ((DivPlatformC64*)dispatch)->setChipModel(true);
@@ -328,10 +430,10 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_C64_8580:
       dispatch=new DivPlatformC64;
       if (isRender) {
-        ((DivPlatformC64*)dispatch)->setCore(eng->getConfInt("c64CoreRender",1));
+        ((DivPlatformC64*)dispatch)->setCore(getCoreConf(eng,"c64CoreRender",1,3));
         ((DivPlatformC64*)dispatch)->setCoreQuality(eng->getConfInt("dsidQualityRender",3));
       } else {
-        ((DivPlatformC64*)dispatch)->setCore(eng->getConfInt("c64Core",0));
+        ((DivPlatformC64*)dispatch)->setCore(getCoreConf(eng,"c64Core",0,3));
         ((DivPlatformC64*)dispatch)->setCoreQuality(eng->getConfInt("dsidQuality",3));
       }
       ((DivPlatformC64*)dispatch)->setChipModel(false);
@@ -340,60 +442,60 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_YM2151:
       dispatch=new DivPlatformArcade;
       if (isRender) {
-        ((DivPlatformArcade*)dispatch)->setYMFM(eng->getConfInt("arcadeCoreRender",1)==0);
+        ((DivPlatformArcade*)dispatch)->setYMFM(getCoreConf(eng,"arcadeCoreRender",1,2)==0);
       } else {
-        ((DivPlatformArcade*)dispatch)->setYMFM(eng->getConfInt("arcadeCore",0)==0);
+        ((DivPlatformArcade*)dispatch)->setYMFM(getCoreConf(eng,"arcadeCore",0,2)==0);
       }
       break;
     case DIV_SYSTEM_YM2610_FULL:
       dispatch=new DivPlatformYM2610;
       if (isRender) {
-        ((DivPlatformYM2610*)dispatch)->setCombo(eng->getConfInt("opnbCoreRender",1));
+        ((DivPlatformYM2610*)dispatch)->setCombo(getCoreConf(eng,"opnbCoreRender",1,3));
       } else {
-        ((DivPlatformYM2610*)dispatch)->setCombo(eng->getConfInt("opnbCore",1));
+        ((DivPlatformYM2610*)dispatch)->setCombo(getCoreConf(eng,"opnbCore",1,3));
       }
       break;
     case DIV_SYSTEM_YM2610_FULL_EXT:
       dispatch=new DivPlatformYM2610Ext;
       if (isRender) {
-        ((DivPlatformYM2610Ext*)dispatch)->setCombo(eng->getConfInt("opnbCoreRender",1));
+        ((DivPlatformYM2610Ext*)dispatch)->setCombo(getCoreConf(eng,"opnbCoreRender",1,3));
       } else {
-        ((DivPlatformYM2610Ext*)dispatch)->setCombo(eng->getConfInt("opnbCore",1));
+        ((DivPlatformYM2610Ext*)dispatch)->setCombo(getCoreConf(eng,"opnbCore",1,3));
       }
       ((DivPlatformYM2610Ext*)dispatch)->setCSM(0);
       break;
     case DIV_SYSTEM_YM2610_CSM:
       dispatch=new DivPlatformYM2610Ext;
       if (isRender) {
-        ((DivPlatformYM2610Ext*)dispatch)->setCombo(eng->getConfInt("opnbCoreRender",1));
+        ((DivPlatformYM2610Ext*)dispatch)->setCombo(getCoreConf(eng,"opnbCoreRender",1,3));
       } else {
-        ((DivPlatformYM2610Ext*)dispatch)->setCombo(eng->getConfInt("opnbCore",1));
+        ((DivPlatformYM2610Ext*)dispatch)->setCombo(getCoreConf(eng,"opnbCore",1,3));
       }
       ((DivPlatformYM2610Ext*)dispatch)->setCSM(1);
       break;
     case DIV_SYSTEM_YM2610B:
       dispatch=new DivPlatformYM2610B;
       if (isRender) {
-        ((DivPlatformYM2610B*)dispatch)->setCombo(eng->getConfInt("opnbCoreRender",1));
+        ((DivPlatformYM2610B*)dispatch)->setCombo(getCoreConf(eng,"opnbCoreRender",1,3));
       } else {
-        ((DivPlatformYM2610B*)dispatch)->setCombo(eng->getConfInt("opnbCore",1));
+        ((DivPlatformYM2610B*)dispatch)->setCombo(getCoreConf(eng,"opnbCore",1,3));
       }
       break;
     case DIV_SYSTEM_YM2610B_EXT:
       dispatch=new DivPlatformYM2610BExt;
       if (isRender) {
-        ((DivPlatformYM2610BExt*)dispatch)->setCombo(eng->getConfInt("opnbCoreRender",1));
+        ((DivPlatformYM2610BExt*)dispatch)->setCombo(getCoreConf(eng,"opnbCoreRender",1,3));
       } else {
-        ((DivPlatformYM2610BExt*)dispatch)->setCombo(eng->getConfInt("opnbCore",1));
+        ((DivPlatformYM2610BExt*)dispatch)->setCombo(getCoreConf(eng,"opnbCore",1,3));
       }
       ((DivPlatformYM2610BExt*)dispatch)->setCSM(0);
       break;
     case DIV_SYSTEM_YM2610B_CSM:
       dispatch=new DivPlatformYM2610BExt;
       if (isRender) {
-        ((DivPlatformYM2610BExt*)dispatch)->setCombo(eng->getConfInt("opnbCoreRender",1));
+        ((DivPlatformYM2610BExt*)dispatch)->setCombo(getCoreConf(eng,"opnbCoreRender",1,3));
       } else {
-        ((DivPlatformYM2610BExt*)dispatch)->setCombo(eng->getConfInt("opnbCore",1));
+        ((DivPlatformYM2610BExt*)dispatch)->setCombo(getCoreConf(eng,"opnbCore",1,3));
       }
       ((DivPlatformYM2610BExt*)dispatch)->setCSM(1);
       break;
@@ -403,9 +505,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_AY8910:
       dispatch=new DivPlatformAY8910;
       if (isRender) {
-        ((DivPlatformAY8910*)dispatch)->setCore(eng->getConfInt("ayCoreRender",0)==1);
+        ((DivPlatformAY8910*)dispatch)->setCore(getCoreConf(eng,"ayCoreRender",0,2)==1);
       } else {
-        ((DivPlatformAY8910*)dispatch)->setCore(eng->getConfInt("ayCore",0)==1);
+        ((DivPlatformAY8910*)dispatch)->setCore(getCoreConf(eng,"ayCore",0,2)==1);
       }
       break;
     case DIV_SYSTEM_AY8930:
@@ -414,9 +516,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_FDS:
       dispatch=new DivPlatformFDS;
       if (isRender) {
-        ((DivPlatformFDS*)dispatch)->setNSFPlay(eng->getConfInt("fdsCoreRender",1)==1);
+        ((DivPlatformFDS*)dispatch)->setNSFPlay(getCoreConf(eng,"fdsCoreRender",1,2)==1);
       } else {
-        ((DivPlatformFDS*)dispatch)->setNSFPlay(eng->getConfInt("fdsCore",0)==1);
+        ((DivPlatformFDS*)dispatch)->setNSFPlay(getCoreConf(eng,"fdsCore",0,2)==1);
       }
       break;
     case DIV_SYSTEM_TIA:
@@ -425,52 +527,52 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_YM2203:
       dispatch=new DivPlatformYM2203;
       if (isRender) {
-        ((DivPlatformYM2203*)dispatch)->setCombo(eng->getConfInt("opn1CoreRender",1));
+        ((DivPlatformYM2203*)dispatch)->setCombo(getCoreConf(eng,"opn1CoreRender",1,3));
       } else {
-        ((DivPlatformYM2203*)dispatch)->setCombo(eng->getConfInt("opn1Core",1));
+        ((DivPlatformYM2203*)dispatch)->setCombo(getCoreConf(eng,"opn1Core",1,3));
       }
       break;
     case DIV_SYSTEM_YM2203_EXT:
       dispatch=new DivPlatformYM2203Ext;
       if (isRender) {
-        ((DivPlatformYM2203Ext*)dispatch)->setCombo(eng->getConfInt("opn1CoreRender",1));
+        ((DivPlatformYM2203Ext*)dispatch)->setCombo(getCoreConf(eng,"opn1CoreRender",1,3));
       } else {
-        ((DivPlatformYM2203Ext*)dispatch)->setCombo(eng->getConfInt("opn1Core",1));
+        ((DivPlatformYM2203Ext*)dispatch)->setCombo(getCoreConf(eng,"opn1Core",1,3));
       }
       ((DivPlatformYM2203Ext*)dispatch)->setCSM(0);
       break;
     case DIV_SYSTEM_YM2203_CSM:
       dispatch=new DivPlatformYM2203Ext;
       if (isRender) {
-        ((DivPlatformYM2203Ext*)dispatch)->setCombo(eng->getConfInt("opn1CoreRender",1));
+        ((DivPlatformYM2203Ext*)dispatch)->setCombo(getCoreConf(eng,"opn1CoreRender",1,3));
       } else {
-        ((DivPlatformYM2203Ext*)dispatch)->setCombo(eng->getConfInt("opn1Core",1));
+        ((DivPlatformYM2203Ext*)dispatch)->setCombo(getCoreConf(eng,"opn1Core",1,3));
       }
       ((DivPlatformYM2203Ext*)dispatch)->setCSM(1);
       break;
     case DIV_SYSTEM_YM2608:
       dispatch=new DivPlatformYM2608;
       if (isRender) {
-        ((DivPlatformYM2608*)dispatch)->setCombo(eng->getConfInt("opnaCoreRender",1));
+        ((DivPlatformYM2608*)dispatch)->setCombo(getCoreConf(eng,"opnaCoreRender",1,3));
       } else {
-        ((DivPlatformYM2608*)dispatch)->setCombo(eng->getConfInt("opnaCore",1));
+        ((DivPlatformYM2608*)dispatch)->setCombo(getCoreConf(eng,"opnaCore",1,3));
       }
       break;
     case DIV_SYSTEM_YM2608_EXT:
       dispatch=new DivPlatformYM2608Ext;
       if (isRender) {
-        ((DivPlatformYM2608Ext*)dispatch)->setCombo(eng->getConfInt("opnaCoreRender",1));
+        ((DivPlatformYM2608Ext*)dispatch)->setCombo(getCoreConf(eng,"opnaCoreRender",1,3));
       } else {
-        ((DivPlatformYM2608Ext*)dispatch)->setCombo(eng->getConfInt("opnaCore",1));
+        ((DivPlatformYM2608Ext*)dispatch)->setCombo(getCoreConf(eng,"opnaCore",1,3));
       }
       ((DivPlatformYM2608Ext*)dispatch)->setCSM(0);
       break;
     case DIV_SYSTEM_YM2608_CSM:
       dispatch=new DivPlatformYM2608Ext;
       if (isRender) {
-        ((DivPlatformYM2608Ext*)dispatch)->setCombo(eng->getConfInt("opnaCoreRender",1));
+        ((DivPlatformYM2608Ext*)dispatch)->setCombo(getCoreConf(eng,"opnaCoreRender",1,3));
       } else {
-        ((DivPlatformYM2608Ext*)dispatch)->setCombo(eng->getConfInt("opnaCore",1));
+        ((DivPlatformYM2608Ext*)dispatch)->setCombo(getCoreConf(eng,"opnaCore",1,3));
       }
       ((DivPlatformYM2608Ext*)dispatch)->setCSM(1);
       break;
@@ -479,9 +581,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_VRC7:
       dispatch=new DivPlatformOPLL;
       if (isRender) {
-        ((DivPlatformOPLL*)dispatch)->setCore(eng->getConfInt("opllCoreRender",0));
+        ((DivPlatformOPLL*)dispatch)->setCore(getCoreConf(eng,"opllCoreRender",0,2));
       } else {
-        ((DivPlatformOPLL*)dispatch)->setCore(eng->getConfInt("opllCore",0));
+        ((DivPlatformOPLL*)dispatch)->setCore(getCoreConf(eng,"opllCore",0,2));
       }
       ((DivPlatformOPLL*)dispatch)->setVRC7(sys==DIV_SYSTEM_VRC7);
       ((DivPlatformOPLL*)dispatch)->setProperDrums(sys==DIV_SYSTEM_OPLL_DRUMS);
@@ -490,72 +592,72 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(1,false);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2Core",0,3));
       }
       break;
     case DIV_SYSTEM_OPL_DRUMS:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(1,true);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2Core",0,3));
       }
       break;
     case DIV_SYSTEM_OPL2:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(2,false);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2Core",0,3));
       }
       break;
     case DIV_SYSTEM_OPL2_DRUMS:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(2,true);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2Core",0,3));
       }
       break;
     case DIV_SYSTEM_OPL3:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(3,false);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl3CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl3CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl3Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl3Core",0,3));
       }
       break;
     case DIV_SYSTEM_OPL3_DRUMS:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(3,true);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl3CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl3CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl3Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl3Core",0,3));
       }
       break;
     case DIV_SYSTEM_Y8950:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(8950,false);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2Core",0,3));
       }
       break;
     case DIV_SYSTEM_Y8950_DRUMS:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(8950,true);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2CoreRender",0,3));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl2Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl2Core",0,3));
       }
       break;
     case DIV_SYSTEM_OPZ:
@@ -588,9 +690,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_POKEY:
       dispatch=new DivPlatformPOKEY;
       if (isRender) {
-        ((DivPlatformPOKEY*)dispatch)->setAltASAP(eng->getConfInt("pokeyCoreRender",1)==1);
+        ((DivPlatformPOKEY*)dispatch)->setAltASAP(getCoreConf(eng,"pokeyCoreRender",1,2)==1);
       } else {
-        ((DivPlatformPOKEY*)dispatch)->setAltASAP(eng->getConfInt("pokeyCore",1)==1);
+        ((DivPlatformPOKEY*)dispatch)->setAltASAP(getCoreConf(eng,"pokeyCore",1,2)==1);
       }
       break;
     case DIV_SYSTEM_QSOUND:
@@ -732,9 +834,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_ESFM:
       dispatch=new DivPlatformESFM;
       if (isRender) {
-        ((DivPlatformESFM*)dispatch)->setFast(eng->getConfInt("esfmCoreRender",0));
+        ((DivPlatformESFM*)dispatch)->setFast(getCoreConf(eng,"esfmCoreRender",0,2));
       } else {
-        ((DivPlatformESFM*)dispatch)->setFast(eng->getConfInt("esfmCore",0));
+        ((DivPlatformESFM*)dispatch)->setFast(getCoreConf(eng,"esfmCore",0,2));
       }
       break;
     case DIV_SYSTEM_POWERNOISE:
@@ -754,9 +856,9 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
     case DIV_SYSTEM_5E01:
       dispatch=new DivPlatformNES;
       if (isRender) {
-        ((DivPlatformNES*)dispatch)->setNSFPlay(eng->getConfInt("nesCoreRender",0)==1);
+        ((DivPlatformNES*)dispatch)->setNSFPlay(getCoreConf(eng,"nesCoreRender",0,2)==1);
       } else {
-        ((DivPlatformNES*)dispatch)->setNSFPlay(eng->getConfInt("nesCore",0)==1);
+        ((DivPlatformNES*)dispatch)->setNSFPlay(getCoreConf(eng,"nesCore",0,2)==1);
       }
       ((DivPlatformNES*)dispatch)->set5E01(true);
       break;
@@ -770,18 +872,18 @@ void DivDispatchContainer::init(DivSystem sys, DivEngine* eng, int chanCount, do
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(4,false);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl4CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl4CoreRender",0,2));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl4Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl4Core",0,2));
       }
       break;
     case DIV_SYSTEM_OPL4_DRUMS:
       dispatch=new DivPlatformOPL;
       ((DivPlatformOPL*)dispatch)->setOPLType(4,true);
       if (isRender) {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl4CoreRender",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl4CoreRender",0,2));
       } else {
-        ((DivPlatformOPL*)dispatch)->setCore(eng->getConfInt("opl4Core",0));
+        ((DivPlatformOPL*)dispatch)->setCore(getCoreConf(eng,"opl4Core",0,2));
       }
       break;
     case DIV_SYSTEM_MULTIPCM:
@@ -820,7 +922,9 @@ void DivDispatchContainer::quit() {
   if (dispatch==NULL) return;
   dispatch->quit();
   delete dispatch;
-  dispatch=NULL;
+  coreKey=NULL;
+  coreCount=0;
+  coreKey=NULL;
 
   for (int i=0; i<DIV_MAX_OUTPUTS; i++) {
     if (bbOut[i]!=NULL) {
@@ -0,0 +1,103 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "editQueue.h"
+
+bool DivEditQueue::run(DivEdit* edit) {
+  int expected=DIV_EDIT_PENDING;
+  if (!edit->state.compare_exchange_strong(expected,DIV_EDIT_RUNNING)) return false;
+  edit->what();
+  edit->state.store(DIV_EDIT_DONE);
+  return true;
+}
+
+void DivEditQueue::collect() {
+  // applyPending() may be looking at these
+  if (applying.load()>0) return;
+  size_t kept=0;
+  for (size_t i=0; i<inFlight.size(); i++) {
+    DivEdit* edit=inFlight[i];
+    if (edit->released.load() && edit->popped.load() && edit->state.load()==DIV_EDIT_DONE) {
+      delete edit;
+    } else {
+      inFlight[kept++]=edit;
+    }
+  }
+  inFlight.resize(kept);
+}
+
+DivEdit* DivEditQueue::push(const std::function<void()>& what, bool wait) {
+  std::lock_guard<std::mutex> lock(pushLock);
+  collect();
+  unsigned int t=tail.load(std::memory_order_relaxed);
+  if (t-head.load()>=DIV_EDIT_QUEUE_SIZE) return NULL;
+  DivEdit* edit=new DivEdit(what,!wait);
+  inFlight.push_back(edit);
+  items[t&(DIV_EDIT_QUEUE_SIZE-1)].store(edit,std::memory_order_relaxed);
+  tail.store(t+1);
+  return edit;
+}
+
+void DivEditQueue::release(DivEdit* edit) {
+  edit->released.store(true);
+}
+
+void DivEditQueue::apply() {
+  unsigned int h=head.load(std::memory_order_relaxed);
+  unsigned int t=tail.load();
+  for (; h!=t; h++) {
+    DivEdit* edit=items[h&(DIV_EDIT_QUEUE_SIZE-1)].load(std::memory_order_relaxed);
+    run(edit);
+    edit->popped.store(true);
+  }
+  head.store(h);
+}
+
+void DivEditQueue::applyPending() {
+  // edits may push other edits, so don't hold the lock while running them
+  pushLock.lock();
+  std::vector<DivEdit*> pending=inFlight;
+  applying++;
+  pushLock.unlock();
+  for (DivEdit* i: pending) {
+    run(i);
+  }
+  applying--;
+}
+
+bool DivEditQueue::empty() {
+  return tail.load()==head.load();
+}
+
+DivEditQueue::DivEditQueue():
+  head(0),
+  tail(0),
+  applying(0) {
+  for (int i=0; i<DIV_EDIT_QUEUE_SIZE; i++) {
+    items[i]=NULL;
+  }
+}
+
+DivEditQueue::~DivEditQueue() {
+  for (DivEdit* i: inFlight) {
+    delete i;
+  }
+  inFlight.clear();
+}
@@ -0,0 +1,106 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef _EDIT_QUEUE_H
+#define _EDIT_QUEUE_H
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#define DIV_EDIT_QUEUE_SIZE 256
+
+enum DivEditState {
+  DIV_EDIT_PENDING=0,
+  DIV_EDIT_RUNNING,
+  DIV_EDIT_DONE
+};
+
+struct DivEdit {
+  std::function<void()> what;
+  std::atomic<int> state;
+  std::atomic<bool> popped, released;
+  DivEdit(const std::function<void()>& w, bool r):
+    what(w),
+    state(DIV_EDIT_PENDING),
+    popped(false),
+    released(r) {}
+};
+
+/**
+ * a queue of engine edits which the audio thread applies between buffers.
+ * an edit runs exactly once, either by the audio thread (apply()) or by the next
+ * thread which locks the engine (applyPending()) if the audio thread does not get to it.
+ * both shall keep each other out while doing so.
+ * apply() is wait-free and shall only be called by one thread at a time.
+ * every other function may be called from any thread.
+ */
+class DivEditQueue {
+  std::atomic<DivEdit*> items[DIV_EDIT_QUEUE_SIZE];
+  std::atomic<unsigned int> head, tail;
+
+  // edits which were pushed and not freed yet, in order
+  std::mutex pushLock;
+  std::vector<DivEdit*> inFlight;
+  std::atomic<int> applying;
+
+  /**
+   * run an edit if no one else did. returns whether it ran.
+   */
+  bool run(DivEdit* edit);
+
+  /**
+   * free edits which ran and left the queue. pushLock shall be held.
+   */
+  void collect();
+  public:
+    /**
+     * push an edit. returns NULL if the queue is full.
+     * if wait is true, the edit may be polled until it is passed to release().
+     * otherwise it is freed once it has run.
+     */
+    DivEdit* push(const std::function<void()>& what, bool wait=false);
+
+    /**
+     * stop polling an edit returned by push().
+     */
+    void release(DivEdit* edit);
+
+    /**
+     * run every edit in the queue. called by the audio thread.
+     */
+    void apply();
+
+    /**
+     * run every edit which is still pending, in order. called by lockAudio() once the audio thread is out.
+     */
+    void applyPending();
+
+    /**
+     * check whether there are edits in the queue.
+     */
+    bool empty();
+
+    DivEditQueue();
+    ~DivEditQueue();
+};
+
+#endif
@@ -24,6 +24,7 @@
 #include "instrument.h"
 #include "safeReader.h"
 #include "workPool.h"
+#include "mixKernel.h"
 #include "../ta-log.h"
 #include "../fileutils.h"
 #ifdef HAVE_SDL2
@@ -40,6 +41,7 @@
 #include "../audio/asio.h"
 #endif
 #include "../audio/pipe.h"
+#include "../audio/stream.h"
 #include <math.h>
 #include <float.h>
 #include <fmt/printf.h>
@@ -49,6 +51,14 @@ void process(void* u, float** in, float** out, int inChans, int outChans, unsign
   ((DivEngine*)u)->nextBuf(in,out,inChans,outChans,size);
 }
 
+void streamPosition(void* u, TAAudioStreamPos& pos) {
+  DivEngine* e=(DivEngine*)u;
+  pos.order=e->getOrder();
+  pos.row=e->getRow();
+  pos.loops=e->getLoopCount();
+  pos.playing=e->isPlaying();
+}
+
 const char* DivEngine::getEffectDesc(unsigned char effect, int chan, bool notNull) {
   switch (effect) {
     case 0x00:
@@ -184,17 +194,14 @@ const char* DivEngine::getEffectDesc(unsigned char effect, int chan, bool notNul
         if (sysDef==NULL) {
           return notNull?_("Invalid effect"):NULL;
         } else {
-          auto iter=sysDef->effectHandlers.find(effect);
-          if (iter!=sysDef->effectHandlers.end()) {
-            return iter->second.description;
+          if (sysDef->effectTable[effect]!=NULL) {
+            return sysDef->effectTable[effect]->description;
           }
-          iter=sysDef->postEffectHandlers.find(effect);
-          if (iter!=sysDef->postEffectHandlers.end()) {
-            return iter->second.description;
+          if (sysDef->postEffectTable[effect]!=NULL) {
+            return sysDef->postEffectTable[effect]->description;
           }
-          iter=sysDef->preEffectHandlers.find(effect);
-          if (iter!=sysDef->preEffectHandlers.end()) {
-            return iter->second.description;
+          if (sysDef->preEffectTable[effect]!=NULL) {
+            return sysDef->preEffectTable[effect]->description;
           }
         }
       }
@@ -203,24 +210,63 @@ const char* DivEngine::getEffectDesc(unsigned char effect, int chan, bool notNul
   return notNull?_("Invalid effect"):NULL;
 }
 
-void DivEngine::calcSongTimestamps() {
+void DivEngine::calcSongTimestamps(const bool* dirtyOrders) {
   if (curSubSong!=NULL) {
-    curSubSong->calcTimestamps(song.chans,song.grooves,song.compatFlags.jumpTreatment,song.compatFlags.ignoreJumpAtEnd,song.compatFlags.brokenSpeedSel,song.compatFlags.delayBehavior);
+    curSubSong->calcTimestamps(song.chans,song.grooves,song.compatFlags.jumpTreatment,song.compatFlags.ignoreJumpAtEnd,song.compatFlags.brokenSpeedSel,song.compatFlags.delayBehavior,0,dirtyOrders);
   }
 }
 
 #define EXPORT_BUFSIZE 2048
 
-double DivEngine::benchmarkPlayback() {
+static String _benchJSONString(const char* str) {
+  String ret="\"";
+  for (const char* i=str; *i; i++) {
+    if (*i=='"' || *i=='\\') {
+      ret+='\\';
+      ret+=*i;
+    } else if ((unsigned char)*i<0x20) {
+      ret+=fmt::sprintf("\\u%.4x",(int)*i);
+    } else {
+      ret+=*i;
+    }
+  }
+  ret+='"';
+  return ret;
+}
+
+static void _benchWriteJSON(String path, String json) {
+  if (path.empty()) return;
+  FILE* f=ps_fopen(path.c_str(),"wb");
+  if (f==NULL) {
+    logE("could not write benchmark results to %s: %s",path,strerror(errno));
+    return;
+  }
+  fputs(json.c_str(),f);
+  fputc('\n',f);
+  fclose(f);
+  logI("benchmark results written to %s.",path);
+}
+
+double DivEngine::benchmarkRun() {
   float* outBuf[2];
   outBuf[0]=new float[EXPORT_BUFSIZE];
   outBuf[1]=new float[EXPORT_BUFSIZE];
 
+  benchStats=DivBenchStats();
+  for (int i=0; i<song.systemLen; i++) {
+    disCont[i].timed=true;
+    disCont[i].acquireTime=0;
+    disCont[i].fillTime=0;
+    disCont[i].acquired=0;
+    disCont[i].rendered=0;
+  }
+
   curOrder=0;
   prevOrder=0;
   remainingLoops=1;
   playSub(false);
 
+  benchTimed=true;
   std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
 
   // benchmark
@@ -229,15 +275,204 @@ double DivEngine::benchmarkPlayback() {
   }
 
   std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
+  benchTimed=false;
+
+  for (int i=0; i<song.systemLen; i++) {
+    disCont[i].timed=false;
+  }
 
   delete[] outBuf[0];
   delete[] outBuf[1];
 
-  double t=(double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
-  printf("[RESULT] %fs\n",t);
+  return (double)(std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count())/1000000.0;
+}
+
+String DivEngine::benchmarkResult(double t, bool json) {
+  String ret;
+  double songLen=(double)benchStats.samples/got.rate;
+  double stageTime[5]={
+    benchStats.tick/1000000000.0,
+    benchStats.render/1000000000.0,
+    benchStats.mix/1000000000.0,
+    benchStats.osc/1000000000.0,
+    benchStats.total/1000000000.0
+  };
+  const char* stageName[5]={"tick","render","mix","osc","total"};
+
+  if (json) {
+    ret=fmt::sprintf("{\"time\":%f,\"songLength\":%f,\"rate\":%f,\"threads\":%d,\"stages\":{",t,songLen,got.rate,renderPoolThreads);
+    for (int i=0; i<5; i++) {
+      if (i>0) ret+=',';
+      ret+=fmt::sprintf("\"%s\":%f",stageName[i],stageTime[i]);
+    }
+    ret+="},\"chips\":[";
+    for (int i=0; i<song.systemLen; i++) {
+      DivDispatchContainer& dc=disCont[i];
+      double acquireTime=dc.acquireTime/1000000000.0;
+      double fillTime=dc.fillTime/1000000000.0;
+      if (i>0) ret+=',';
+      ret+=fmt::sprintf("{\"system\":%s,\"core\":%s,\"coreValue\":%d,\"acquire\":%f,\"fillBuf\":%f,\"clocks\":%d,\"samples\":%d,\"samplesPerSecond\":%f}",
+        _benchJSONString(getSystemName(song.system[i])),
+        (dc.coreKey==NULL)?String("null"):_benchJSONString(dc.coreKey),
+        dc.coreValue,
+        acquireTime,
+        fillTime,
+        dc.acquired,
+        dc.rendered,
+        (acquireTime+fillTime>0.0)?(dc.rendered/(acquireTime+fillTime)):0.0
+      );
+    }
+    ret+="]}";
+    return ret;
+  }
+
+  ret=fmt::sprintf("[RESULT] %fs (%.2fx realtime)\n",t,(t>0.0)?(songLen/t):0.0);
+  for (int i=0; i<4; i++) {
+    ret+=fmt::sprintf("[STAGE] %s: %fs (%.1f%%)\n",stageName[i],stageTime[i],(stageTime[4]>0.0)?(100.0*stageTime[i]/stageTime[4]):0.0);
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    DivDispatchContainer& dc=disCont[i];
+    double acquireTime=dc.acquireTime/1000000000.0;
+    double fillTime=dc.fillTime/1000000000.0;
+    String core;
+    if (dc.coreKey!=NULL) core=fmt::sprintf(" (%s=%d)",dc.coreKey,dc.coreValue);
+    ret+=fmt::sprintf("[CHIP] #%d %s%s: acquire %fs, fillBuf %fs, %.0f samples/s\n",
+      i+1,
+      getSystemName(song.system[i]),
+      core,
+      acquireTime,
+      fillTime,
+      (acquireTime+fillTime>0.0)?(dc.rendered/(acquireTime+fillTime)):0.0
+    );
+  }
+  return ret;
+}
+
+String DivEngine::profileResult() {
+  unsigned int count=profiler.getCount();
+  unsigned int overruns=profiler.getOverruns();
+  String ret=fmt::sprintf("[PROFILE] %u buffers, %u overruns (%.2f%%)\n",count,overruns,(count>0)?(100.0*overruns/count):0.0);
+  for (int i=0; i<DIV_PROFILE_STAGE_MAX; i++) {
+    ret+=fmt::sprintf("[STAGE] %s: avg %.1fus, p99 <%.1fus, blamed for %u overruns\n",
+      DivProfiler::getStageName(i),
+      profiler.getAverage(i)/1000.0,
+      profiler.getPercentile(i,0.99)/1000.0,
+      profiler.getBlame(i)
+    );
+  }
+  for (int i=0; i<song.systemLen; i++) {
+    int slot=DIV_PROFILE_STAGE_MAX+i;
+    ret+=fmt::sprintf("[CHIP] #%d %s: avg %.1fus, p99 <%.1fus, blamed for %u overruns\n",
+      i+1,
+      getSystemName(song.system[i]),
+      profiler.getAverage(slot)/1000.0,
+      profiler.getPercentile(slot,0.99)/1000.0,
+      profiler.getBlame(slot)
+    );
+  }
+  return ret;
+}
+
+double DivEngine::benchmarkPlayback(String jsonOut) {
+  double t=benchmarkRun();
+  printf("%s",benchmarkResult(t,false).c_str());
+  if (!jsonOut.empty()) {
+    _benchWriteJSON(jsonOut,benchmarkResult(t,true));
+  }
   return t;
 }
 
+void DivEngine::benchmarkCores(String jsonOut) {
+  // find out which core settings are used by the chips in this song
+  std::vector<const char*> keys;
+  for (int i=0; i<song.systemLen; i++) {
+    const char* key=disCont[i].coreKey;
+    if (key==NULL) continue;
+    bool found=false;
+    for (const char* j: keys) {
+      if (strcmp(j,key)==0) {
+        found=true;
+        break;
+      }
+    }
+    if (!found) keys.push_back(key);
+  }
+
+  if (keys.empty()) {
+    logW("none of the chips in this song have more than one emulation core.");
+  }
+
+  String json="{\"cores\":[";
+  bool first=true;
+  for (const char* key: keys) {
+    int count=0;
+    for (int i=0; i<song.systemLen; i++) {
+      if (disCont[i].coreKey!=NULL && strcmp(disCont[i].coreKey,key)==0) {
+        count=disCont[i].coreCount;
+        break;
+      }
+    }
+
+    // the core is picked through benchCoreConf, so the configuration is left alone
+    for (int i=0; i<count; i++) {
+      benchCoreConf.set(key,i);
+      quitDispatch();
+      initDispatch();
+      renderSamples();
+
+      printf("[CORE] %s=%d\n",key,i);
+      double t=benchmarkRun();
+      printf("%s",benchmarkResult(t,false).c_str());
+      if (!first) json+=',';
+      json+=fmt::sprintf("{\"setting\":%s,\"value\":%d,\"result\":%s}",_benchJSONString(key),i,benchmarkResult(t,true));
+      first=false;
+    }
+    // the other settings are measured with the configured core
+    benchCoreConf.remove(key);
+  }
+
+  // go back to the configured cores
+  if (!keys.empty()) {
+    quitDispatch();
+    initDispatch();
+    renderSamples();
+  }
+  json+="]}";
+
+  _benchWriteJSON(jsonOut,json);
+}
+
+void DivEngine::benchmarkThreads(String jsonOut) {
+  unsigned int prevThreads=renderPoolThreads;
+  unsigned int maxThreads=std::thread::hardware_concurrency();
+  if (maxThreads>(unsigned int)song.systemLen) maxThreads=song.systemLen;
+
+  String json="{\"threads\":[";
+  for (unsigned int i=0; i<=maxThreads; i++) {
+    // the render pool is created again by nextBuf()
+    renderPoolThreads=i;
+    if (renderPool!=NULL) {
+      delete renderPool;
+      renderPool=NULL;
+    }
+
+    printf("[THREADS] %d\n",i);
+    double t=benchmarkRun();
+    printf("%s",benchmarkResult(t,false).c_str());
+    if (i>0) json+=',';
+    json+=benchmarkResult(t,true);
+  }
+  json+="]}";
+
+  renderPoolThreads=prevThreads;
+  if (renderPool!=NULL) {
+    delete renderPool;
+    renderPool=NULL;
+  }
+
+  _benchWriteJSON(jsonOut,json);
+}
+
 double DivEngine::benchmarkSeek() {
   double t[20];
   curOrder=curSubSong->ordersLen-1;
@@ -280,35 +515,39 @@ double DivEngine::benchmarkWalk() {
 }
 
 void DivEngine::notifyInsChange(int ins) {
-  BUSY_BEGIN;
-  for (int i=0; i<song.systemLen; i++) {
-    disCont[i].dispatch->notifyInsChange(ins);
-  }
-  BUSY_END;
+  postEdit([this,ins]() {
+    checkpointsInvalid=true;
+    for (int i=0; i<song.systemLen; i++) {
+      disCont[i].dispatch->notifyInsChange(ins);
+    }
+  });
 }
 
 void DivEngine::notifyWaveChange(int wave) {
-  BUSY_BEGIN;
-  for (int i=0; i<song.systemLen; i++) {
-    disCont[i].dispatch->notifyWaveChange(wave);
-  }
-  BUSY_END;
+  postEdit([this,wave]() {
+    checkpointsInvalid=true;
+    for (int i=0; i<song.systemLen; i++) {
+      disCont[i].dispatch->notifyWaveChange(wave);
+    }
+  });
 }
 
 void DivEngine::notifySampleChange(int sample) {
-  BUSY_BEGIN;
-  for (int i=0; i<song.systemLen; i++) {
-    disCont[i].dispatch->notifySampleChange(sample);
-  }
-  BUSY_END;
+  postEdit([this,sample]() {
+    checkpointsInvalid=true;
+    for (int i=0; i<song.systemLen; i++) {
+      disCont[i].dispatch->notifySampleChange(sample);
+    }
+  });
 }
 
 void DivEngine::notifyPitchTable(int sample) {
-  BUSY_BEGIN;
-  for (int i=0; i<song.systemLen; i++) {
-    disCont[i].dispatch->notifyPitchTable(sample);
-  }
-  BUSY_END;
+  postEdit([this,sample]() {
+    checkpointsInvalid=true;
+    for (int i=0; i<song.systemLen; i++) {
+      disCont[i].dispatch->notifyPitchTable(sample);
+    }
+  });
 }
 
 int DivEngine::loadSampleROM(String path, ssize_t expectedSize, unsigned char*& ret) {
@@ -402,41 +641,24 @@ int DivEngine::loadSampleROMs() {
 }
 
 void DivEngine::renderSamplesP(int whichSample) {
-  BUSY_BEGIN;
-  renderSamples(whichSample);
-  BUSY_END;
+  unsigned int formatMask=getSampleFormatMask();
+  // render outside of the lock. only the buffers are swapped while locked.
+  // if a sample changed in the meantime, render it again (up to 3 times before doing so under the lock).
+  for (int i=0; i<4; i++) {
+    std::vector<DivSampleRenderJob*> jobs=prepareSampleRender(whichSample,formatMask);
+    BUSY_BEGIN;
+    bool again=finishSampleRender(jobs,formatMask,i<3);
+    BUSY_END;
+    if (!again) break;
+  }
 }
 
 void DivEngine::renderSamples(int whichSample) {
-  sPreview.sample=-1;
-  sPreview.pos=0;
-  sPreview.dir=false;
-
   logD("rendering samples...");
 
-  // step 0: make sample format mask
-  unsigned int formatMask=1U<<16; // 16-bit is always on
-  for (int i=0; i<song.systemLen; i++) {
-    const DivSysDef* s=getSystemDef(song.system[i]);
-    if (s==NULL) continue;
-    formatMask|=s->sampleFormatMask;
-  }
-
-  // step 1: render samples
-  if (whichSample==-1) {
-    for (int i=0; i<song.sampleLen; i++) {
-      song.sample[i]->render(formatMask);
-    }
-  } else if (whichSample>=0 && whichSample<song.sampleLen) {
-    song.sample[whichSample]->render(formatMask);
-  }
-
-  // step 2: render samples to dispatch
-  for (int i=0; i<song.systemLen; i++) {
-    if (disCont[i].dispatch!=NULL) {
-      disCont[i].dispatch->renderSamples(i);
-    }
-  }
+  unsigned int formatMask=getSampleFormatMask();
+  std::vector<DivSampleRenderJob*> jobs=prepareSampleRender(whichSample,formatMask);
+  finishSampleRender(jobs,formatMask);
 }
 
 String DivEngine::decodeSysDesc(String desc) {
@@ -729,6 +951,7 @@ void DivEngine::changeSong(size_t songIndex) {
   curRow=0;
   prevOrder=0;
   prevRow=0;
+  checkpointsInvalid=true;
 }
 
 void DivEngine::copyChannelP(int src, int dest) {
@@ -1658,6 +1881,15 @@ DivDispatchOscBuffer* DivEngine::getOscBuffer(int chan) {
   return disCont[song.dispatchOfChan[chan]].dispatch->getOscBuffer(song.dispatchChanOfChan[chan]);
 }
 
+unsigned int DivEngine::getOscSeq() {
+  return oscSeq.load(std::memory_order_acquire);
+}
+
+bool DivEngine::isOscIntact(unsigned int seq, unsigned int len) {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return (oscClaim.load(std::memory_order_relaxed)-seq)+len<=32768;
+}
+
 void DivEngine::enableCommandStream(bool enable) {
   cmdStreamEnabled=enable;
 }
@@ -1704,10 +1936,168 @@ void DivEngine::syncFilePlayer() {
   curFilePlayer->setPosSeconds(totalTime+filePlayerCue);
 }
 
+bool DivEngine::saveCheckpoint(int maxOrder) {
+  DivPlaybackCheckpoint* cp=new DivPlaybackCheckpoint;
+
+  // get dispatch states first. if any of them doesn't support it, give up
+  for (int i=0; i<song.systemLen; i++) {
+    cp->dispatchState[i]=disCont[i].dispatch->getState();
+    if (cp->dispatchState[i]==NULL) {
+      for (int j=0; j<i; j++) {
+        disCont[j].dispatch->freeState(cp->dispatchState[j]);
+      }
+      delete cp;
+      return false;
+    }
+  }
+  cp->systemLen=song.systemLen;
+  cp->maxOrder=maxOrder;
+  cp->rate=got.rate;
+
+  cp->subticks=subticks;
+  cp->ticks=ticks;
+  cp->curRow=curRow;
+  cp->curOrder=curOrder;
+  cp->prevRow=prevRow;
+  cp->prevOrder=prevOrder;
+  cp->totalLoops=totalLoops;
+  cp->lastLoopPos=lastLoopPos;
+  cp->nextSpeed=nextSpeed;
+  cp->prevSpeed=prevSpeed;
+  cp->elapsedBars=elapsedBars;
+  cp->elapsedBeats=elapsedBeats;
+  cp->curSpeed=curSpeed;
+  cp->changeOrd=changeOrd;
+  cp->changePos=changePos;
+  cp->totalTicksR=totalTicksR;
+  cp->curMidiClock=curMidiClock;
+  cp->curMidiTime=curMidiTime;
+  cp->curMidiTimePiece=curMidiTimePiece;
+  cp->curMidiTimeCode=curMidiTimeCode;
+  cp->cycles=cycles;
+  cp->midiClockCycles=midiClockCycles;
+  cp->midiTimeCycles=midiTimeCycles;
+  cp->divider=divider;
+  cp->clockDrift=clockDrift;
+  cp->midiClockDrift=midiClockDrift;
+  cp->midiTimeDrift=midiTimeDrift;
+  cp->totalTimeDrift=totalTimeDrift;
+  cp->totalTime=totalTime;
+  cp->extValue=extValue;
+  cp->pendingMetroTick=pendingMetroTick;
+  cp->arpLen=curSubSong->arpLen;
+  cp->extValuePresent=extValuePresent;
+  cp->endOfSong=endOfSong;
+  cp->shallStop=shallStop;
+  cp->shallStopSched=shallStopSched;
+  cp->firstTick=firstTick;
+  cp->speeds=speeds;
+  cp->virtualTempoN=virtualTempoN;
+  cp->virtualTempoD=virtualTempoD;
+  cp->tempoAccum=tempoAccum;
+  cp->chan.assign(chan,chan+song.chans);
+  int walkedLen=8192;
+  while (walkedLen>0 && walked[walkedLen-1]==0) walkedLen--;
+  cp->walked.assign(walked,walked+walkedLen);
+
+  checkpoints.push_back(cp);
+  return true;
+}
+
+DivPlaybackCheckpoint* DivEngine::loadCheckpoint(int goal) {
+  if (checkpoints.empty()) return NULL;
+  // checkpoints depend on the output rate (clock drift and MIDI clock)
+  if (checkpoints[0]->rate!=got.rate) {
+    clearCheckpoints();
+    return NULL;
+  }
+
+  // find the latest checkpoint which is reached before the goal order
+  // maxOrder never decreases, so stop at the first one we find
+  DivPlaybackCheckpoint* cp=NULL;
+  for (int i=(int)checkpoints.size()-1; i>=0; i--) {
+    if (checkpoints[i]->maxOrder<goal) {
+      cp=checkpoints[i];
+      break;
+    }
+  }
+  if (cp==NULL) return NULL;
+
+  for (int i=0; i<cp->systemLen; i++) {
+    disCont[i].dispatch->setState(cp->dispatchState[i]);
+  }
+
+  subticks=cp->subticks;
+  ticks=cp->ticks;
+  curRow=cp->curRow;
+  curOrder=cp->curOrder;
+  prevRow=cp->prevRow;
+  prevOrder=cp->prevOrder;
+  totalLoops=cp->totalLoops;
+  lastLoopPos=cp->lastLoopPos;
+  nextSpeed=cp->nextSpeed;
+  prevSpeed=cp->prevSpeed;
+  elapsedBars=cp->elapsedBars;
+  elapsedBeats=cp->elapsedBeats;
+  curSpeed=cp->curSpeed;
+  changeOrd=cp->changeOrd;
+  changePos=cp->changePos;
+  totalTicksR=cp->totalTicksR;
+  curMidiClock=cp->curMidiClock;
+  curMidiTime=cp->curMidiTime;
+  curMidiTimePiece=cp->curMidiTimePiece;
+  curMidiTimeCode=cp->curMidiTimeCode;
+  cycles=cp->cycles;
+  midiClockCycles=cp->midiClockCycles;
+  midiTimeCycles=cp->midiTimeCycles;
+  divider=cp->divider;
+  clockDrift=cp->clockDrift;
+  midiClockDrift=cp->midiClockDrift;
+  midiTimeDrift=cp->midiTimeDrift;
+  totalTimeDrift=cp->totalTimeDrift;
+  totalTime=cp->totalTime;
+  extValue=cp->extValue;
+  pendingMetroTick=cp->pendingMetroTick;
+  curSubSong->arpLen=cp->arpLen;
+  extValuePresent=cp->extValuePresent;
+  endOfSong=cp->endOfSong;
+  shallStop=cp->shallStop;
+  shallStopSched=cp->shallStopSched;
+  firstTick=cp->firstTick;
+  speeds=cp->speeds;
+  virtualTempoN=cp->virtualTempoN;
+  virtualTempoD=cp->virtualTempoD;
+  tempoAccum=cp->tempoAccum;
+  for (size_t i=0; i<cp->chan.size(); i++) {
+    chan[i]=cp->chan[i];
+  }
+  memset(walked,0,8192);
+  if (!cp->walked.empty()) memcpy(walked,cp->walked.data(),cp->walked.size());
+
+  logV("resuming from checkpoint at %d:%d (%d ticks)",curOrder,curRow,totalTicksR);
+  return cp;
+}
+
+void DivEngine::clearCheckpoints() {
+  for (DivPlaybackCheckpoint* i: checkpoints) {
+    for (int j=0; j<i->systemLen; j++) {
+      disCont[j].dispatch->freeState(i->dispatchState[j]);
+    }
+    delete i;
+  }
+  checkpoints.clear();
+  checkpointsInvalid=false;
+}
+
+void DivEngine::invalidateCheckpoints() {
+  checkpointsInvalid=true;
+}
+
 void DivEngine::playSub(bool preserveDrift, int goalRow) {
   logV("playSub() called");
   std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(false);
+  for (DivExportStem* i: exportStems) i->cont.dispatch->setSkipRegisterWrites(false);
   reset();
   if (preserveDrift && curOrder==0) {
     logV("preserveDrift && curOrder is true");
@@ -1753,14 +2143,30 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
   skipping=true;
   memset(walked,0,8192);
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(true);
+  for (DivExportStem* i: exportStems) i->cont.dispatch->setSkipRegisterWrites(true);
   logV("goal: %d goalRow: %d",goal,goalRow);
+  // resume from a checkpoint if there is one, and take new ones as we go.
+  // this is only done when walking from the beginning, and not during per-channel export (stems don't have checkpoints).
+  // every chip must support state saves as well (see DivDispatch::hasState()).
+  bool takeCheckpoints=!preserveDrift && exportStems.empty();
+  for (int i=0; i<song.systemLen && takeCheckpoints; i++) {
+    if (!disCont[i].dispatch->hasState()) takeCheckpoints=false;
+  }
+  int walkMaxOrder=0;
+  if (takeCheckpoints) {
+    if (checkpointsInvalid) clearCheckpoints();
+    DivPlaybackCheckpoint* cp=loadCheckpoint(goal);
+    if (cp!=NULL) walkMaxOrder=cp->maxOrder;
+  }
   while (playing && curOrder<goal) {
     if (nextTick(preserveDrift)) {
       skipping=false;
       cmdStream.clear();
       for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(false);
+      for (DivExportStem* i: exportStems) i->cont.dispatch->setSkipRegisterWrites(false);
       if (goal>0 || goalRow>0) {
         for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->forceIns();
+        for (DivExportStem* i: exportStems) i->cont.dispatch->forceIns();
       }
       return;
     }
@@ -1768,6 +2174,13 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
       runMidiClock(cycles);
       runMidiTime(cycles);
     }
+    if (takeCheckpoints) {
+      if (curOrder>walkMaxOrder) walkMaxOrder=curOrder;
+      int lastCheckpoint=checkpoints.empty()?0:checkpoints.back()->totalTicksR;
+      if (totalTicksR>=lastCheckpoint+DIV_CHECKPOINT_INTERVAL) {
+        if (!saveCheckpoint(walkMaxOrder)) takeCheckpoints=false;
+      }
+    }
   }
   int oldOrder=curOrder;
   while (playing && (curRow<goalRow || ticks>1)) {
@@ -1775,8 +2188,10 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
       skipping=false;
       cmdStream.clear();
       for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(false);
+      for (DivExportStem* i: exportStems) i->cont.dispatch->setSkipRegisterWrites(false);
       if (goal>0 || goalRow>0) {
         for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->forceIns();
+        for (DivExportStem* i: exportStems) i->cont.dispatch->forceIns();
       }
       return;
     }
@@ -1788,8 +2203,10 @@ void DivEngine::playSub(bool preserveDrift, int goalRow) {
     if (ticks-((tempoAccum+virtualTempoN)/MAX(1,virtualTempoD))<1 && curRow>=goalRow) break;
   }
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->setSkipRegisterWrites(false);
+  for (DivExportStem* i: exportStems) i->cont.dispatch->setSkipRegisterWrites(false);
   if (goal>0 || goalRow>0) {
     for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->forceIns();
+    for (DivExportStem* i: exportStems) i->cont.dispatch->forceIns();
   }
   for (int i=0; i<song.chans; i++) {
     chan[i].cut=-1;
@@ -2223,6 +2640,10 @@ void DivEngine::reset() {
     disCont[i].dispatch->reset();
     disCont[i].clear();
   }
+  for (DivExportStem* i: exportStems) {
+    i->cont.dispatch->reset();
+    i->cont.clear();
+  }
 }
 
 void DivEngine::syncReset() {
@@ -2348,27 +2769,27 @@ void DivEngine::noteToSplitNote(short note, short& outNote, short& outOctave) {
 }
 
 void DivEngine::previewSample(int sample, int note, int pStart, int pEnd) {
-  BUSY_BEGIN;
-  previewSampleNoLock(sample,note,pStart,pEnd);
-  BUSY_END;
+  postEdit([this,sample,note,pStart,pEnd]() {
+    previewSampleNoLock(sample,note,pStart,pEnd);
+  });
 }
 
 void DivEngine::stopSamplePreview() {
-  BUSY_BEGIN;
-  stopSamplePreviewNoLock();
-  BUSY_END;
+  postEdit([this]() {
+    stopSamplePreviewNoLock();
+  });
 }
 
 void DivEngine::previewWave(int wave, int note) {
-  BUSY_BEGIN;
-  previewWaveNoLock(wave,note);
-  BUSY_END;
+  postEdit([this,wave,note]() {
+    previewWaveNoLock(wave,note);
+  });
 }
 
 void DivEngine::stopWavePreview() {
-  BUSY_BEGIN;
-  stopWavePreviewNoLock();
-  BUSY_END;
+  postEdit([this]() {
+    stopWavePreviewNoLock();
+  });
 }
 
 void DivEngine::previewSampleNoLock(int sample, int note, int pStart, int pEnd) {
@@ -2504,6 +2925,10 @@ int DivEngine::getRow() {
   return prevRow;
 }
 
+int DivEngine::getLoopCount() {
+  return totalLoops;
+}
+
 void DivEngine::getPlayPos(int& order, int& row) {
   playPosLock.lock();
   order=prevOrder;
@@ -2553,10 +2978,12 @@ short DivEngine::getVirtualTempoD() {
 }
 
 void DivEngine::virtualTempoChanged() {
-  BUSY_BEGIN;
-  virtualTempoN=curSubSong->virtualTempoN;
-  virtualTempoD=curSubSong->virtualTempoD;
-  BUSY_END;
+  short n=curSubSong->virtualTempoN;
+  short d=curSubSong->virtualTempoD;
+  postEdit([this,n,d]() {
+    virtualTempoN=n;
+    virtualTempoD=d;
+  });
 }
 
 TimeMicros DivEngine::getCurTime() {
@@ -2568,9 +2995,9 @@ bool DivEngine::getRepeatPattern() {
 }
 
 void DivEngine::setRepeatPattern(bool value) {
-  BUSY_BEGIN;
-  repeatPattern=value;
-  BUSY_END;
+  postEdit([this,value]() {
+    repeatPattern=value;
+  });
 }
 
 bool DivEngine::hasExtValue() {
@@ -2598,59 +3025,66 @@ bool DivEngine::isChannelMuted(int chan) {
 }
 
 void DivEngine::toggleMute(int chan) {
-  muteChannel(chan,!isMuted[chan]);
+  // isMuted is read when the edit runs, as a previous one may still be queued
+  postEdit([this,chan]() {
+    muteChannelNoLock(chan,!isMuted[chan]);
+  });
 }
 
 void DivEngine::toggleSolo(int chan) {
-  bool solo=false;
-  for (int i=0; i<song.chans; i++) {
-    if (i==chan) {
-      solo=true;
-      continue;
-    } else {
-      if (!isMuted[i]) {
-        solo=false;
-        break;
-      }
-    }
-  }
-  BUSY_BEGIN;
-  if (!solo) {
+  postEdit([this,chan]() {
+    bool solo=false;
     for (int i=0; i<song.chans; i++) {
-      isMuted[i]=(i!=chan);
-      if (disCont[song.dispatchOfChan[i]].dispatch!=NULL && song.dispatchChanOfChan[i]>=0) {
-        disCont[song.dispatchOfChan[i]].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+      if (i==chan) {
+        solo=true;
+        continue;
+      } else {
+        if (!isMuted[i]) {
+          solo=false;
+          break;
+        }
       }
     }
-  } else {
-    for (int i=0; i<song.chans; i++) {
-      isMuted[i]=false;
-      if (disCont[song.dispatchOfChan[i]].dispatch!=NULL && song.dispatchChanOfChan[i]>=0) {
-        disCont[song.dispatchOfChan[i]].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+    if (!solo) {
+      for (int i=0; i<song.chans; i++) {
+        isMuted[i]=(i!=chan);
+        if (disCont[song.dispatchOfChan[i]].dispatch!=NULL && song.dispatchChanOfChan[i]>=0) {
+          disCont[song.dispatchOfChan[i]].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+        }
+      }
+    } else {
+      for (int i=0; i<song.chans; i++) {
+        isMuted[i]=false;
+        if (disCont[song.dispatchOfChan[i]].dispatch!=NULL && song.dispatchChanOfChan[i]>=0) {
+          disCont[song.dispatchOfChan[i]].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+        }
       }
     }
-  }
-  BUSY_END;
+  });
 }
 
 void DivEngine::muteChannel(int chan, bool mute) {
-  BUSY_BEGIN;
+  postEdit([this,chan,mute]() {
+    muteChannelNoLock(chan,mute);
+  });
+}
+
+void DivEngine::muteChannelNoLock(int chan, bool mute) {
   isMuted[chan]=mute;
   if (disCont[song.dispatchOfChan[chan]].dispatch!=NULL && song.dispatchChanOfChan[chan]>=0) {
     disCont[song.dispatchOfChan[chan]].dispatch->muteChannel(song.dispatchChanOfChan[chan],isMuted[chan]);
   }
-  BUSY_END;
 }
 
 void DivEngine::unmuteAll() {
-  BUSY_BEGIN;
-  for (int i=0; i<song.chans; i++) {
-    isMuted[i]=false;
-    if (disCont[song.dispatchOfChan[i]].dispatch!=NULL && song.dispatchChanOfChan[i]>=0) {
-      disCont[song.dispatchOfChan[i]].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+  postEdit([this]() {
+    for (int i=0; i<song.chans; i++) {
+      isMuted[i]=false;
+      if (disCont[song.dispatchOfChan[i]].dispatch!=NULL && song.dispatchChanOfChan[i]>=0) {
+        disCont[song.dispatchOfChan[i]].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+      }
     }
-  }
-  BUSY_END;
+  });
 }
 
 void DivEngine::dumpSongInfo() {
@@ -3295,13 +3729,16 @@ void DivEngine::exchangeIns(int one, int two) {
     for (size_t j=0; j<song.subsong.size(); j++) {
       for (int k=0; k<DIV_MAX_PATTERNS; k++) {
         if (song.subsong[j]->pat[i].data[k]==NULL) continue;
+        // make the data unique, or shared data would be exchanged twice
+        DivPattern* p=song.subsong[j]->pat[i].getPattern(k,true);
         for (int l=0; l<song.subsong[j]->patLen; l++) {
-          if (song.subsong[j]->pat[i].data[k]->newData[l][DIV_PAT_INS]==one) {
-            song.subsong[j]->pat[i].data[k]->newData[l][DIV_PAT_INS]=two;
-          } else if (song.subsong[j]->pat[i].data[k]->newData[l][DIV_PAT_INS]==two) {
-            song.subsong[j]->pat[i].data[k]->newData[l][DIV_PAT_INS]=one;
+          if (p->newData[l][DIV_PAT_INS]==one) {
+            p->newData[l][DIV_PAT_INS]=two;
+          } else if (p->newData[l][DIV_PAT_INS]==two) {
+            p->newData[l][DIV_PAT_INS]=one;
           }
         }
+        p->invalidateRowFlags();
       }
     }
   }
@@ -3578,26 +4015,26 @@ void DivEngine::patchDisconnectAll(unsigned int portSet) {
 
 void DivEngine::noteOn(int chan, int ins, int note, int vol) {
   if (chan<0 || chan>=song.chans) return;
-  BUSY_BEGIN;
-  pendingNotes.push_back(DivNoteEvent(chan,ins,note,vol,true));
-  if (!playing) {
-    reset();
-    freelance=true;
-    playing=true;
-  }
-  BUSY_END;
+  postEdit([this,chan,ins,note,vol]() {
+    pendingNotes.push_back(DivNoteEvent(chan,ins,note,vol,true));
+    if (!playing) {
+      reset();
+      freelance=true;
+      playing=true;
+    }
+  });
 }
 
 void DivEngine::noteOff(int chan) {
   if (chan<0 || chan>=song.chans) return;
-  BUSY_BEGIN;
-  pendingNotes.push_back(DivNoteEvent(chan,-1,-1,-1,false));
-  if (!playing) {
-    reset();
-    freelance=true;
-    playing=true;
-  }
-  BUSY_END;
+  postEdit([this,chan]() {
+    pendingNotes.push_back(DivNoteEvent(chan,-1,-1,-1,false));
+    if (!playing) {
+      reset();
+      freelance=true;
+      playing=true;
+    }
+  });
 }
 
 int DivEngine::getViableChannel(int chan, int off, int ins) {
@@ -3782,6 +4219,7 @@ void DivEngine::setOrder(unsigned char order) {
 
 void DivEngine::updateSysFlags(int system, bool restart, bool render) {
   BUSY_BEGIN_SOFT;
+  checkpointsInvalid=true;
   disCont[system].dispatch->setFlags(song.systemFlags[system]);
   disCont[system].setRates(got.rate);
   if (render) renderSamples();
@@ -3820,6 +4258,12 @@ void DivEngine::setAudio(DivAudioEngines which) {
   audioEngine=which;
 }
 
+void DivEngine::setAudioStream(String target, TAAudioFormat format, bool clockPace) {
+  streamTarget=target;
+  streamFormat=format;
+  streamClockPace=clockPace;
+}
+
 void DivEngine::setView(DivStatusView which) {
   view=which;
 }
@@ -3935,6 +4379,44 @@ void DivEngine::lockSave(const std::function<void()>& what) {
   saveLock.unlock();
 }
 
+bool DivEngine::shallQueueEdits() {
+  if (output==NULL) return false;
+  if (!output->isRunning()) return false;
+  if (audioEngine==DIV_AUDIO_DUMMY) return false;
+  if (exporting) return false;
+  return true;
+}
+
+void DivEngine::lockAudio(bool soft) {
+  // isBusy is only taken by threads which lock the engine, never by the audio thread
+  isBusy.lock();
+  audioLocked.store(soft?DIV_AUDIO_LOCK_SOFT:DIV_AUDIO_LOCK_HARD);
+  // nextBuf() sets audioInside before checking audioLocked, so either it sees the lock
+  // and stays out, or we see it inside and wait for the buffer to finish
+  while (audioInside.load()) {
+    std::this_thread::yield();
+  }
+  // queued edits go before anything else, so that they don't run after
+  // (for example) the instrument they refer to is deleted
+  editQueue.applyPending();
+}
+
+void DivEngine::unlockAudio() {
+  audioLocked.store(DIV_AUDIO_LOCK_NONE);
+  isBusy.unlock();
+}
+
+bool DivEngine::enterAudio(bool wait) {
+  while (true) {
+    audioInside.store(true);
+    int lock=audioLocked.load();
+    if (lock==DIV_AUDIO_LOCK_NONE) return true;
+    audioInside.store(false);
+    if (lock==DIV_AUDIO_LOCK_SOFT && !wait) return false;
+    std::this_thread::yield();
+  }
+}
+
 void DivEngine::lockEngine(const std::function<void()>& what) {
   BUSY_BEGIN;
   saveLock.lock();
@@ -3943,6 +4425,34 @@ void DivEngine::lockEngine(const std::function<void()>& what) {
   BUSY_END;
 }
 
+void DivEngine::freeRetiredPatterns() {
+  if (retiredPats.empty()) {
+    DivPattern::takeRetired(retiredPats);
+    if (retiredPats.empty()) return;
+    // if nextBuf() is not running, it will only see the current storage from now on.
+    // otherwise wait for the current buffer to finish.
+    if (audioInside.load()) {
+      retiredPasses=audioPasses.load();
+      return;
+    }
+  } else if (audioPasses.load()==retiredPasses) {
+    return;
+  }
+  for (DivPatternStorage* i: retiredPats) {
+    delete i;
+  }
+  retiredPats.clear();
+}
+
+void DivEngine::postEdit(const std::function<void()>& what) {
+  if (shallQueueEdits()) {
+    if (editQueue.push(what)!=NULL) return;
+  }
+  BUSY_BEGIN;
+  what();
+  BUSY_END;
+}
+
 TAAudioDesc& DivEngine::getAudioDescWant() {
   return want;
 }
@@ -4028,6 +4538,8 @@ void DivEngine::initDispatch(bool isRender) {
 void DivEngine::quitDispatch() {
   BUSY_BEGIN;
   logV("terminating dispatch...");
+  clearCheckpoints();
+  quitExportStems();
   for (int i=0; i<song.systemLen; i++) {
     disCont[i].quit();
   }
@@ -4112,6 +4624,7 @@ bool DivEngine::initAudioBackend() {
   if (previewVol<0.0f) previewVol=0.0f;
   if (previewVol>1.0f) previewVol=1.0f;
   renderPoolThreads=getConfInt("renderPoolThreads",0);
+  renderPoolBurst=getConfBool("renderPoolBurst",1);
 
   if (lowLatency) logI("using low latency mode.");
 
@@ -4172,6 +4685,13 @@ bool DivEngine::initAudioBackend() {
     case DIV_AUDIO_PIPE:
       output=new TAAudioPipe;
       break;
+    case DIV_AUDIO_STREAM: {
+      TAAudioStream* stream=new TAAudioStream;
+      stream->setPacing(streamClockPace);
+      stream->setPositionCallback(streamPosition,this);
+      output=stream;
+      break;
+    }
     case DIV_AUDIO_DUMMY:
       output=new TAAudio;
       break;
@@ -4193,6 +4713,11 @@ bool DivEngine::initAudioBackend() {
   want.wasapiEx=getConfBool("wasapiEx",0);
   want.name="Furnace";
 
+  if (audioEngine==DIV_AUDIO_STREAM) {
+    want.deviceName=streamTarget;
+    want.outFormat=streamFormat;
+  }
+
   if (want.outChans<1) want.outChans=1;
   if (want.outChans>16) want.outChans=16;
 
@@ -4387,6 +4912,8 @@ bool DivEngine::init() {
     haveAudio=true;
   }
 
+  logV("using %s mix kernel",mixKernelName());
+
   logV("creating blip_buf");
 
   samp_bb=blip_new(32768);
@@ -4464,6 +4991,10 @@ bool DivEngine::quit(bool saveConfig) {
     delete curFilePlayer;
     curFilePlayer=NULL;
   }
+  if (samplePool!=NULL) {
+    delete samplePool;
+    samplePool=NULL;
+  }
   if (yrw801ROM!=NULL) delete[] yrw801ROM;
   if (tg100ROM!=NULL) delete[] tg100ROM;
   if (mu5ROM!=NULL) delete[] mu5ROM;
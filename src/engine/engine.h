@@ -30,6 +30,8 @@
 #include "sysDef.h"
 #include "cmdStream.h"
 #include "filePlayer.h"
+#include "editQueue.h"
+#include "profiler.h"
 #include "../audio/taAudio.h"
 #include "blip_buf.h"
 #include <functional>
@@ -46,16 +48,34 @@ class DivWorkPool;
     warnings+=(String("\n")+x); \
   }
 
-#define BUSY_BEGIN softLocked=false; isBusy.lock();
-#define BUSY_BEGIN_SOFT softLocked=true; isBusy.lock();
-#define BUSY_END isBusy.unlock(); softLocked=false;
+// the audio thread waits for BUSY_BEGIN to end, and outputs silence while BUSY_BEGIN_SOFT is held.
+#define BUSY_BEGIN lockAudio(false);
+#define BUSY_BEGIN_SOFT lockAudio(true);
+#define BUSY_END unlockAudio();
 
-#define EXTERN_BUSY_BEGIN e->softLocked=false; e->isBusy.lock();
-#define EXTERN_BUSY_BEGIN_SOFT e->softLocked=true; e->isBusy.lock();
-#define EXTERN_BUSY_END e->isBusy.unlock(); e->softLocked=false;
+#define EXTERN_BUSY_BEGIN e->lockAudio(false);
+#define EXTERN_BUSY_BEGIN_SOFT e->lockAudio(true);
+#define EXTERN_BUSY_END e->unlockAudio();
+
+enum DivAudioLock {
+  DIV_AUDIO_LOCK_NONE=0,
+  DIV_AUDIO_LOCK_HARD,
+  DIV_AUDIO_LOCK_SOFT
+};
 
 #define DIV_UNSTABLE
 
+// interval between seek checkpoints, in ticks
+#define DIV_CHECKPOINT_INTERVAL 512
+
+// self-tests (see DivEngine::verify())
+#define DIV_VERIFY_POOL 1
+#define DIV_VERIFY_WALK 2
+#define DIV_VERIFY_PATTERNS 4
+#define DIV_VERIFY_EDITS 8
+#define DIV_VERIFY_ROWS 16
+#define DIV_VERIFY_ALL 31
+
 #define DIV_VERSION "dev248"
 #define DIV_ENGINE_VERSION 248
 // for imports
@@ -79,6 +99,7 @@ enum DivAudioEngines {
   DIV_AUDIO_PORTAUDIO=2,
   DIV_AUDIO_PIPE=3,
   DIV_AUDIO_ASIO=4,
+  DIV_AUDIO_STREAM=5,
 
   DIV_AUDIO_NULL=126,
   DIV_AUDIO_DUMMY=127
@@ -137,6 +158,8 @@ struct DivAudioExportOptions {
   bool channelMask[DIV_MAX_CHANS];
   int bitRate;
   float vbrQuality;
+  // per-channel export: how many engines render channels at once
+  int threads;
   DivAudioExportOptions():
     mode(DIV_EXPORT_MODE_ONE),
     format(DIV_EXPORT_FORMAT_WAV),
@@ -149,7 +172,8 @@ struct DivAudioExportOptions {
     orderBegin(-1),
     orderEnd(-1),
     bitRate(128000),
-    vbrQuality(6.0f) {
+    vbrQuality(6.0f),
+    threads(1) {
     for (int i=0; i<DIV_MAX_CHANS; i++) {
       channelMask[i]=true;
     }
@@ -269,6 +293,39 @@ struct DivNoteEvent {
     fromMIDI(false) {}
 };
 
+// a snapshot of the playback state, taken while seeking.
+// playSub() resumes from the closest one instead of walking from the beginning.
+struct DivPlaybackCheckpoint {
+  // the highest order visited until this checkpoint.
+  // the checkpoint is only valid for seeks to a later order.
+  int maxOrder;
+  int systemLen;
+  double rate;
+
+  int subticks, ticks, curRow, curOrder, prevRow, prevOrder, totalLoops, lastLoopPos, nextSpeed, prevSpeed, elapsedBars, elapsedBeats, curSpeed;
+  int changeOrd, changePos, totalTicksR, curMidiClock, curMidiTime, curMidiTimePiece, curMidiTimeCode;
+  int cycles, midiClockCycles, midiTimeCycles;
+  double divider, clockDrift, midiClockDrift, midiTimeDrift, totalTimeDrift;
+  TimeMicros totalTime;
+  unsigned char extValue, pendingMetroTick, arpLen;
+  bool extValuePresent, endOfSong, shallStop, shallStopSched, firstTick;
+  DivGroovePattern speeds;
+  short virtualTempoN, virtualTempoD;
+  short tempoAccum;
+  std::vector<DivChannelState> chan;
+  // the walked array up to its last non-zero byte (the rest is zero).
+  // only the orders visited so far are marked, so this is much smaller than 8192.
+  std::vector<unsigned char> walked;
+  void* dispatchState[DIV_MAX_CHIPS];
+
+  DivPlaybackCheckpoint():
+    maxOrder(0),
+    systemLen(0),
+    rate(0.0) {
+    memset(dispatchState,0,DIV_MAX_CHIPS*sizeof(void*));
+  }
+};
+
 struct DivDispatchContainer {
   DivDispatch* dispatch;
   blip_buffer_t* bb[DIV_MAX_OUTPUTS];
@@ -279,17 +336,37 @@ struct DivDispatchContainer {
   short* bbOut[DIV_MAX_OUTPUTS];
   bool lowQuality, dcOffCompensation, hiPass;
   double rateMemory;
+  // if the chip rate is an integer multiple of the output rate, blip_buf is bypassed and output is
+  // copied (or decimated) directly. this is the multiple, or 0 if blip_buf is used.
+  int directFactor;
+  // high-pass filter state of the direct path (same filter as blip_buf)
+  int directSum[DIV_MAX_OUTPUTS];
 
   // used in multi-thread
   int cycles;
   unsigned int size;
 
+  // benchmark statistics. only collected when timed is true.
+  // acquireTime and fillTime are in nanoseconds, acquired is in chip clocks and rendered is in output samples.
+  bool timed;
+  uint64_t acquireTime, fillTime, acquired, rendered;
+  // the emulation core setting this chip was created with (coreKey is NULL if it doesn't have one).
+  const char* coreKey;
+  int coreValue, coreCount;
+
+  int getCoreConf(DivEngine* eng, const char* key, int def, int count);
   void setRates(double gotRate);
   void setQuality(bool lowQual, bool dcHiPass);
+  void updateDirect();
+  // output samples which are ready to be flushed
+  int samplesAvail();
+  // chip clocks needed to render this many output samples
+  int clocksNeeded(int samples);
   void grow(size_t size);
   void acquire(size_t count);
   void flush(size_t offset, size_t count);
   void fillBuf(size_t runtotal, size_t offset, size_t size);
+  void fillBufDirect(size_t runtotal, size_t offset, size_t size, int outs);
   void clear();
   void init(DivSystem sys, DivEngine* eng, int chanCount, double gotRate, const DivConfig& flags, bool isRender=false);
   void quit();
@@ -304,17 +381,64 @@ struct DivDispatchContainer {
     dcOffCompensation(false),
     hiPass(true),
     rateMemory(0.0),
+    directFactor(0),
     cycles(0),
-    size(0) {
+    size(0),
+    timed(false),
+    acquireTime(0),
+    fillTime(0),
+    acquired(0),
+    rendered(0),
+    coreKey(NULL),
+    coreValue(0),
+    coreCount(0) {
     memset(bb,0,DIV_MAX_OUTPUTS*sizeof(blip_buffer_t*));
     memset(temp,0,DIV_MAX_OUTPUTS*sizeof(int));
     memset(prevSample,0,DIV_MAX_OUTPUTS*sizeof(int));
+    memset(directSum,0,DIV_MAX_OUTPUTS*sizeof(int));
     memset(bbIn,0,DIV_MAX_OUTPUTS*sizeof(short*));
     memset(bbInMapped,0,DIV_MAX_OUTPUTS*sizeof(short*));
     memset(bbOut,0,DIV_MAX_OUTPUTS*sizeof(short*));
   }
 };
 
+// an extra instance of a chip used by per-channel export.
+// it receives the same commands as the chip it mirrors, but only one channel (or FM operator group) is left unmuted.
+struct DivExportStem {
+  DivDispatchContainer cont;
+  // the system this stem mirrors and the first channel it outputs
+  int sys, chan;
+  DivExportStem():
+    sys(0),
+    chan(0) {}
+};
+
+// a chip output going to a system output, with volume and panning applied.
+// nextBuf() uses a list of these instead of walking the patchbay.
+struct DivMixGain {
+  int sys;
+  unsigned char srcSubPort, destSubPort;
+  float gain;
+  DivMixGain(int s, unsigned char src, unsigned char dest, float g):
+    sys(s),
+    srcSubPort(src),
+    destSubPort(dest),
+    gain(g) {}
+};
+
+// time spent in each stage of nextBuf() (in nanoseconds), collected during benchmark.
+// samples is the number of output samples rendered.
+struct DivBenchStats {
+  uint64_t tick, render, mix, osc, total, samples;
+  DivBenchStats():
+    tick(0),
+    render(0),
+    mix(0),
+    osc(0),
+    total(0),
+    samples(0) {}
+};
+
 struct DivEffectContainer {
   DivEffect* effect;
   float* in[DIV_MAX_OUTPUTS];
@@ -357,18 +481,19 @@ class DivEngine {
   bool metronome;
   bool exporting;
   bool stopExport;
+  bool exportFailed;
   bool halted;
   bool forceMono;
   bool clampSamples;
   bool cmdStreamEnabled;
-  bool softLocked;
   bool firstTick;
   bool skipping;
+  // whether seeking skips the effects of rows which have none (see DivPattern::getRowFlags()).
+  // only turned off by verifyRows().
+  bool seekRowFlags;
   bool midiIsDirect;
   bool midiIsDirectProgram;
   bool lowLatency;
-  bool systemsRegistered;
-  bool romExportsRegistered;
   bool hasLoadedSomething;
   bool midiOutClock;
   bool midiOutTime;
@@ -400,6 +525,9 @@ class DivEngine {
   DivHaltPositions haltOn;
   DivChannelState chan[DIV_MAX_CHANS];
   DivAudioEngines audioEngine;
+  String streamTarget;
+  TAAudioFormat streamFormat;
+  bool streamClockPace;
   DivAudioExportModes exportMode;
   DivAudioExportFormats exportFormat;
   DivAudioExportWavFormats wavFormat;
@@ -416,6 +544,17 @@ class DivEngine {
   unsigned char walked[8192];
   bool isMuted[DIV_MAX_CHANS];
   std::mutex isBusy, saveLock, playPosLock;
+  // engine lock handshake (see lockAudio()).
+  // audioLocked is set by the thread holding isBusy (DIV_AUDIO_LOCK_*). audioInside is set by nextBuf().
+  std::atomic<int> audioLocked;
+  std::atomic<bool> audioInside;
+  // number of buffers nextBuf() went through. used to tell when retired pattern storage is no longer read.
+  std::atomic<unsigned int> audioPasses;
+  // pattern storage taken by freeRetiredPatterns(), and the audioPasses value at that time
+  std::vector<DivPatternStorage*> retiredPats;
+  unsigned int retiredPasses;
+  // edits which the audio thread applies at the beginning of the next buffer
+  DivEditQueue editQueue;
   String configPath;
   String configFile;
   String lastError;
@@ -430,6 +569,9 @@ class DivEngine {
   static DivSystem sysFileMapFur[DIV_MAX_CHIP_DEFS];
   static DivSystem sysFileMapDMF[DIV_MAX_CHIP_DEFS];
   static DivROMExportDef* romExportDefs[DIV_ROM_MAX];
+  // the definitions are shared by every engine (e.g. export helpers) and registered once
+  static bool systemsRegistered;
+  static bool romExportsRegistered;
 
   DivCSPlayer* cmdStreamInt;
 
@@ -486,9 +628,37 @@ class DivEngine {
 
   size_t totalProcessed;
 
+  std::vector<DivPlaybackCheckpoint*> checkpoints;
+  // may be set from other threads (e.g. invalidateCheckpoints())
+  std::atomic<bool> checkpointsInvalid;
+
+  std::vector<DivExportStem*> exportStems;
+  // the channel which the chip itself renders during per-channel export (instead of a stem), or -1
+  int exportStemMain[DIV_MAX_CHIPS];
+  // whether all channels are rendered in a single pass (using the chips and the stems)
+  bool exportOnePass;
+
+  // compiled patchbay, and the values it was compiled from
+  std::vector<DivMixGain> mixGains;
+  std::vector<float> mixGainKey;
+  std::vector<unsigned int> mixGainPatchbay;
+  std::vector<DivEngine*> exportHelpers;
+
   unsigned int renderPoolThreads;
+  bool renderPoolBurst;
   DivWorkPool* renderPool;
 
+  // sample formats are rendered on this
+  DivWorkPool* samplePool;
+  std::mutex samplePoolLock;
+
+  bool benchTimed;
+  DivBenchStats benchStats;
+  // core settings used by benchmarkCores() in place of the configuration
+  DivConfig benchCoreConf;
+  // whether dispatch timing was enabled for the profiler
+  bool profilingChips;
+
   // MIDI stuff
   std::function<int(const TAMidiMessage&)> midiCallback=[](const TAMidiMessage&) -> int {return -3;};
 
@@ -504,6 +674,58 @@ class DivEngine {
   bool perSystemPreEffect(int ch, unsigned char effect, unsigned char effectVal);
   void reset();
   void playSub(bool preserveDrift, int goalRow=0);
+  // play the song once from the beginning and return the time it took. collects benchStats and per-chip timing.
+  double benchmarkRun();
+  // print (or produce JSON of) the statistics of the last benchmarkRun().
+  String benchmarkResult(double t, bool json);
+  // render the song for a while and hash every buffer. used by the self-tests.
+  void verifyRender(std::vector<uint64_t>& out);
+  // seek to an order and fill a VerifySeekState (see verify.cpp). used by verifyRows().
+  void verifySeek(int order, void* state);
+  // take a seek checkpoint. returns false if a dispatch does not support states.
+  bool saveCheckpoint(int maxOrder);
+  // restore the closest checkpoint which precedes the goal order.
+  // returns the checkpoint, or NULL if there is none.
+  DivPlaybackCheckpoint* loadCheckpoint(int goal);
+  // delete all checkpoints (UNSAFE)
+  void clearCheckpoints();
+  // set up rendering every channel in exportChannelMask in a single pass.
+  // the first channel of every chip is rendered by the chip itself, and the others by a stem each.
+  // a stem is a full copy of the chip, so only the sequencer is shared; emulation still costs one chip per channel.
+  // returns false on failure.
+  bool initExportStems();
+  // delete all export stems and unmute the chips.
+  void quitExportStems();
+  // render out of date sample formats in parallel, without touching the samples. does not need the lock.
+  // whichSample has the same meaning as in renderSamplesP().
+  std::vector<DivSampleRenderJob*> prepareSampleRender(int whichSample, unsigned int formatMask);
+  // put rendered formats into place, delete the jobs and update chip sample memory (UNSAFE)
+  // samples which changed while rendering are rendered here, unless retry is true. in that case
+  // nothing else is done and true is returned, so that the caller renders again outside the lock.
+  bool finishSampleRender(std::vector<DivSampleRenderJob*>& jobs, unsigned int formatMask, bool retry=false);
+  // mix the output of a chip (or a stem of it) into out through the patchbay.
+  void mixExportStem(int sys, DivDispatchContainer& cont, float** out, int outChans, unsigned int size);
+  // get the volume of a chip going to a system output, with panning applied.
+  float getChipOutputVol(int sys, unsigned char destSubPort);
+  // recompile mixGains if the patchbay, outputs or any volume/panning changed.
+  void updateMixGains(int outChans, float refPlayerVol);
+  // create a headless engine with a copy of the current song, used by multi-threaded export.
+  // returns NULL on failure.
+  DivEngine* createExportHelper();
+  // whether edits go through editQueue (audio is running) or take the lock directly.
+  bool shallQueueEdits();
+  // lock the engine. waits for nextBuf() to finish the current buffer, then runs queued edits.
+  // if soft is true, nextBuf() outputs silence until unlocked instead of waiting.
+  void lockAudio(bool soft);
+  void unlockAudio();
+  // called by nextBuf(). waits for the engine to be unlocked.
+  // returns false if the engine is soft-locked, unless wait is true.
+  bool enterAudio(bool wait);
+  // create a headless engine from a song saved by saveFur(). the snapshot is deleted.
+  // this may be called from any thread. returns NULL on failure.
+  static DivEngine* loadExportHelper(DivConfig& helperConf, SafeWriter* snapshot, int subSong);
+  // wait for all export helpers to finish and delete them.
+  void finishExportHelpers();
   void runMidiClock(int totalCycles=1);
   void runMidiTime(int totalCycles=1);
   bool shallSwitchCores();
@@ -586,6 +808,9 @@ class DivEngine {
   friend class DivExportZSM;
   friend class DivExportiPod;
   friend class DivExportGRUB;
+  friend class DivExportJob;
+  // reads benchCoreConf
+  friend struct DivDispatchContainer;
 
   public:
     DivSong song;
@@ -596,10 +821,14 @@ class DivEngine {
     bool keyHit[DIV_MAX_CHANS];
     float* oscBuf[DIV_MAX_OUTPUTS];
     float oscSize;
-    int oscReadPos, oscWritePos;
+    int oscReadPos;
     int tickMult;
     int lastNBIns, lastNBOuts, lastNBSize;
     std::atomic<size_t> processTime;
+    // per-stage and per-chip timing. see DivProfiler.
+    DivProfiler profiler;
+    // oscBuf sequence numbers. see getOscSeq().
+    std::atomic<unsigned int> oscSeq, oscClaim;
 
     float chipPeak[DIV_MAX_CHIPS][DIV_MAX_OUTPUTS];
 
@@ -685,9 +914,29 @@ class DivEngine {
     static void convertOldFlags(unsigned int oldFlags, DivConfig& newFlags, DivSystem sys);
 
     // benchmark (returns time in seconds)
-    double benchmarkPlayback();
+    // if jsonOut is not empty, results are written to that file as JSON as well.
+    double benchmarkPlayback(String jsonOut="");
     double benchmarkSeek();
     double benchmarkWalk();
+    // render the song once for every emulation core of the chips in it
+    void benchmarkCores(String jsonOut="");
+    // render the song once for every render thread count up to the number of CPUs
+    void benchmarkThreads(String jsonOut="");
+    // self-tests. they compare the optimized paths against plain ones using the current song.
+    // which is a combination of DIV_VERIFY_* flags. returns whether every test passed.
+    bool verify(int which);
+    // the work pool gives the same results as running everything in one thread
+    bool verifyPool();
+    // incremental timestamp calculation gives the same results as walking the whole song
+    bool verifyWalk();
+    // copies of patterns share storage until written to, and play the same as the originals
+    bool verifyPatterns();
+    // edits queued for the audio thread run once, in order, and like running them directly
+    bool verifyEdits();
+    // row flags match the pattern data, and seeking gives the same result without them
+    bool verifyRows();
+    // summarize what the profiler collected (per-stage and per-chip times, and overruns)
+    String profileResult();
 
     // returns the minimum VGM version which may carry the specified system, or 0 if none.
     int minVGMVersion(DivSystem which);
@@ -746,7 +995,12 @@ class DivEngine {
     unsigned int convertPanLinearToSplit(int val, unsigned char bits, int range);
 
     // calculate all song timestamps
-    void calcSongTimestamps();
+    // if dirtyOrders is not NULL (an array of DIV_MAX_PATTERNS bools), only the changed part of the song is walked again
+    void calcSongTimestamps(const bool* dirtyOrders=NULL);
+
+    // invalidate seek checkpoints. call this after editing the song.
+    // they will be deleted on the next seek.
+    void invalidateCheckpoints();
 
     // play (returns whether successful)
     bool play();
@@ -866,6 +1120,7 @@ class DivEngine {
 
     // set mute status
     void muteChannel(int chan, bool mute);
+    void muteChannelNoLock(int chan, bool mute);
 
     // unmute all
     void unmuteAll();
@@ -894,6 +1149,9 @@ class DivEngine {
     // get current row
     int getRow();
 
+    // get how many times the song has looped since playback started
+    int getLoopCount();
+
     // synchronous get order/row
     void getPlayPos(int& order, int& row);
     void getPlayPosTick(int& order, int& row, int& tick, int& speed);
@@ -951,6 +1209,9 @@ class DivEngine {
     // is exporting
     bool isExporting();
 
+    // whether the last audio export failed (e.g. a file could not be written)
+    bool hasExportFailed();
+
     // get how many loops is left
     void getLoopsLeft(int& loops);
 
@@ -1118,6 +1379,13 @@ class DivEngine {
     // get osc buffer
     DivDispatchOscBuffer* getOscBuffer(int chan);
 
+    // get the number of samples written to oscBuf so far (the write position is seq&0x7fff).
+    // the samples behind it may be read directly from oscBuf without locking; call isOscIntact() afterwards.
+    unsigned int getOscSeq();
+
+    // check whether len samples before seq are still the same as when getOscSeq() was called
+    bool isOscIntact(unsigned int seq, unsigned int len);
+
     // enable command stream dumping
     void enableCommandStream(bool enable);
 
@@ -1127,6 +1395,11 @@ class DivEngine {
     // set the audio system.
     void setAudio(DivAudioEngines which);
 
+    // set the streaming audio output.
+    // target is stdout, unix:<path> or shm:<path>. format is F32 or S16.
+    // if clockPace is true, audio is streamed in real time. otherwise it's paced by the consumer.
+    void setAudioStream(String target, TAAudioFormat format, bool clockPace);
+
     // set the view mode.
     void setView(DivStatusView which);
 
@@ -1295,8 +1568,20 @@ class DivEngine {
     void lockSave(const std::function<void()>& what);
 
     // perform secure/sync song operation (and lock audio too)
+    // the operation runs on the calling thread. the audio thread waits for it,
+    // so keep it short (e.g. prepare data outside and swap it in here).
     void lockEngine(const std::function<void()>& what);
 
+    // free pattern storage which patterns let go of (see DivPattern::releaseStorage()),
+    // once the audio thread can't be reading it anymore. call this regularly from the thread
+    // which edits the song (e.g. once per frame).
+    void freeRetiredPatterns();
+
+    // queue a small engine-side state change, which the audio thread applies before the
+    // next buffer. does not wait for it. what shall not touch GUI state, song data or do heavy work,
+    // nor lock the engine. queued edits run before any other engine lock is taken.
+    void postEdit(const std::function<void()>& what);
+
     // get audio desc want
     TAAudioDesc& getAudioDescWant();
 
@@ -1356,17 +1641,16 @@ class DivEngine {
       metronome(false),
       exporting(false),
       stopExport(false),
+      exportFailed(false),
       halted(false),
       forceMono(false),
       cmdStreamEnabled(false),
-      softLocked(false),
       firstTick(false),
       skipping(false),
+      seekRowFlags(true),
       midiIsDirect(false),
       midiIsDirectProgram(false),
       lowLatency(false),
-      systemsRegistered(false),
-      romExportsRegistered(false),
       hasLoadedSomething(false),
       midiOutClock(false),
       midiOutTime(false),
@@ -1420,6 +1704,8 @@ class DivEngine {
       view(DIV_STATUS_NOTHING),
       haltOn(DIV_HALT_NONE),
       audioEngine(DIV_AUDIO_NULL),
+      streamFormat(TA_AUDIO_FORMAT_F32),
+      streamClockPace(false),
       exportMode(DIV_EXPORT_MODE_ONE),
       exportFormat(DIV_EXPORT_FORMAT_WAV),
       wavFormat(DIV_EXPORT_WAV_S16),
@@ -1429,6 +1715,10 @@ class DivEngine {
       exportOutputs(2),
       exportBitRate(128000),
       exportVBRQuality(6.0f),
+      audioLocked(DIV_AUDIO_LOCK_NONE),
+      audioInside(false),
+      audioPasses(0),
+      retiredPasses(0),
       cmdStreamInt(NULL),
       midiBaseChan(0),
       midiPoly(true),
@@ -1456,19 +1746,26 @@ class DivEngine {
       filePlayerLoopTrail(0),
       curFilePlayerTrail(0),
       totalProcessed(0),
+      checkpointsInvalid(false),
+      exportOnePass(false),
       renderPoolThreads(0),
+      renderPoolBurst(true),
       renderPool(NULL),
+      samplePool(NULL),
+      benchTimed(false),
+      profilingChips(false),
       curOrders(NULL),
       curPat(NULL),
       tempIns(NULL),
       oscSize(1),
       oscReadPos(0),
-      oscWritePos(0),
       tickMult(1),
       lastNBIns(0),
       lastNBOuts(0),
       lastNBSize(0),
       processTime(0),
+      oscSeq(0),
+      oscClaim(0),
       yrw801ROM(NULL),
       tg100ROM(NULL),
       mu5ROM(NULL) {
@@ -1477,19 +1774,13 @@ class DivEngine {
       memset(vibTable,0,64*sizeof(short));
       memset(tremTable,0,128*sizeof(short));
       memset(effectSlotMap,-1,4096*sizeof(short));
-      memset(sysDefs,0,DIV_MAX_CHIP_DEFS*sizeof(void*));
-      memset(romExportDefs,0,DIV_ROM_MAX*sizeof(void*));
       memset(walked,0,8192);
       memset(oscBuf,0,DIV_MAX_OUTPUTS*(sizeof(float*)));
       memset(exportChannelMask,1,DIV_MAX_CHANS*sizeof(bool));
+      memset(exportStemMain,-1,DIV_MAX_CHIPS*sizeof(int));
       memset(chipPeak,0,DIV_MAX_CHIPS*DIV_MAX_OUTPUTS*sizeof(float));
       memset(filePlayerBuf,0,DIV_MAX_OUTPUTS*sizeof(float));
 
-      for (int i=0; i<DIV_MAX_CHIP_DEFS; i++) {
-        sysFileMapFur[i]=DIV_SYSTEM_NULL;
-        sysFileMapDMF[i]=DIV_SYSTEM_NULL;
-      }
-
       changeSong(0);
     }
 };
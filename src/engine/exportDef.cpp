@@ -20,6 +20,7 @@
 #include "engine.h"
 
 DivROMExportDef* DivEngine::romExportDefs[DIV_ROM_MAX];
+bool DivEngine::romExportsRegistered=false;
 
 const DivROMExportDef* DivEngine::getROMExportDef(DivROMExportOptions opt) {
   return romExportDefs[opt];
@@ -73,6 +74,8 @@ bool DivEngine::isROMExportViable(DivROMExportOptions opt)
 void DivEngine::registerROMExports() {
   logD("registering ROM exports...");
 
+  memset(romExportDefs,0,DIV_ROM_MAX*sizeof(void*));
+
   romExportDefs[DIV_ROM_AMIGA_VALIDATION]=new DivROMExportDef(
     "Amiga Validation", "tildearrow",
     "a test export for ensuring Amiga emulation is accurate. do not use!",
@@ -142,4 +145,6 @@ void DivEngine::registerROMExports() {
     },
     false, DIV_REQPOL_ANY
   );
+
+  romExportsRegistered=true;
 }
@@ -0,0 +1,264 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "exportJob.h"
+#include "engine.h"
+#include "../ta-log.h"
+#include <chrono>
+
+DivExportJobType DivExportJob::getType() {
+  return type;
+}
+
+String DivExportJob::getLastError() {
+  std::lock_guard<std::mutex> lock(resultLock);
+  return lastError;
+}
+
+String DivExportJob::getWarnings() {
+  std::lock_guard<std::mutex> lock(resultLock);
+  return warnings;
+}
+
+void DivExportJob::syncLog() {
+  if (romExport==NULL) return;
+  std::vector<String> newLines;
+  romExport->logLock.lock();
+  for (; romLogPos<romExport->exportLog.size(); romLogPos++) {
+    newLines.push_back(romExport->exportLog[romLogPos]);
+  }
+  romExport->logLock.unlock();
+  for (String& i: newLines) {
+    logAppend(i);
+  }
+}
+
+void DivExportJob::run() {
+  logAppend("loading song...");
+  DivEngine* newHelper=DivEngine::loadExportHelper(helperConf,snapshot,subSong);
+  snapshot=NULL;
+  if (newHelper==NULL) {
+    resultLock.lock();
+    lastError="could not load song into export engine";
+    resultLock.unlock();
+    logAppend("could not load song into export engine");
+    failed=true;
+    running=false;
+    return;
+  }
+  helperLock.lock();
+  helper=newHelper;
+  helperLock.unlock();
+
+  switch (type) {
+    case DIV_EXPORT_JOB_VGM: {
+      logAppend("writing VGM...");
+      SafeWriter* w=helper->saveVGM(vgmSystems,vgmLoop,vgmVersion,vgmPatternHints,vgmDirectStream,vgmTrailingTicks,vgmDPCM07,vgmCorrectedRate);
+      if (w==NULL) {
+        failed=true;
+      } else {
+        output.push_back(DivROMExportOutput("out.vgm",w));
+      }
+      break;
+    }
+    case DIV_EXPORT_JOB_CMD_STREAM: {
+      logAppend("writing command stream...");
+      SafeWriter* w=helper->saveCommand(&csProgress,csOptions);
+      if (w==NULL) {
+        failed=true;
+      } else {
+        output.push_back(DivROMExportOutput("out.fcs",w));
+      }
+      break;
+    }
+    case DIV_EXPORT_JOB_ROM:
+      if (romExport==NULL) {
+        helper->lastError="no ROM export";
+        failed=true;
+        break;
+      }
+      romExport->setConf(conf);
+      if (!romExport->go(helper)) {
+        helper->lastError="could not begin exporting process";
+        failed=true;
+        break;
+      }
+      // the ROM export is waited for (or aborted) from this thread only
+      while (romExport->isRunning()) {
+        if (mustAbort) break;
+        syncLog();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      }
+      if (mustAbort) {
+        romExport->abort();
+      } else {
+        romExport->wait();
+      }
+      syncLog();
+      failed=romExport->hasFailed();
+      if (!failed) {
+        output=romExport->getResult();
+      }
+      break;
+  }
+
+  String helperError=helper->getLastError();
+  String helperWarnings=helper->getWarnings();
+  resultLock.lock();
+  lastError=helperError;
+  warnings=helperWarnings;
+  resultLock.unlock();
+  if (failed) {
+    logAppendf("export failed! (%s)",helperError);
+  } else {
+    logAppend("finished!");
+  }
+
+  helperLock.lock();
+  helper=NULL;
+  helperLock.unlock();
+  newHelper->quit(false);
+  delete newHelper;
+
+  running=false;
+}
+
+bool DivExportJob::go(DivEngine* eng) {
+  // take a snapshot of the song now. everything else happens on the export thread
+  snapshot=eng->saveFur(true);
+  if (snapshot==NULL) {
+    resultLock.lock();
+    lastError="could not save song";
+    resultLock.unlock();
+    failed=true;
+    return false;
+  }
+  helperConf=eng->conf;
+  subSong=eng->getCurrentSubSong();
+  // the helper's song may not be looked at while it runs
+  ordersLen=eng->curSubSong->ordersLen;
+
+  running=true;
+  failed=false;
+  mustAbort=false;
+  exportThread=new std::thread(&DivExportJob::run,this);
+  return true;
+}
+
+bool DivExportJob::isRunning() {
+  return running;
+}
+
+bool DivExportJob::hasFailed() {
+  return failed;
+}
+
+void DivExportJob::abort() {
+  mustAbort=true;
+  wait();
+}
+
+void DivExportJob::wait() {
+  if (exportThread!=NULL) {
+    exportThread->join();
+    delete exportThread;
+    exportThread=NULL;
+  }
+}
+
+DivROMExportProgress DivExportJob::getProgress(int index) {
+  DivROMExportProgress ret;
+  ret.name="";
+  ret.amount=0.0f;
+
+  if (type==DIV_EXPORT_JOB_ROM) {
+    if (romExport==NULL) return ret;
+    helperLock.lock();
+    bool started=(helper!=NULL);
+    helperLock.unlock();
+    if (!started) {
+      if (index==0) {
+        ret.name="Load";
+        ret.amount=running?0.0f:1.0f;
+      }
+      return ret;
+    }
+    return romExport->getProgress(index);
+  }
+
+  if (index==0) {
+    ret.name="Export";
+    if (running) {
+      helperLock.lock();
+      if (helper!=NULL && ordersLen>0) {
+        int order=0, row=0;
+        helper->getPlayPos(order,row);
+        ret.amount=(float)order/(float)ordersLen;
+      }
+      helperLock.unlock();
+    } else {
+      ret.amount=1.0f;
+    }
+  } else if (index==1 && type==DIV_EXPORT_JOB_CMD_STREAM && !csOptions.noSubBlock) {
+    ret.name="Optimize";
+    if (csProgress.optStage>=2 && csProgress.origCount>0) {
+      ret.amount=(float)csProgress.origCurrent/(float)csProgress.origCount;
+    }
+    if (!running) ret.amount=1.0f;
+  }
+  return ret;
+}
+
+DivExportJob::DivExportJob(DivExportJobType t, DivROMExport* rom):
+  type(t),
+  romExport(rom),
+  helper(NULL),
+  snapshot(NULL),
+  subSong(0),
+  ordersLen(0),
+  exportThread(NULL),
+  romLogPos(0),
+  running(false),
+  failed(false),
+  mustAbort(false),
+  vgmLoop(true),
+  vgmVersion(0x171),
+  vgmPatternHints(false),
+  vgmDirectStream(false),
+  vgmTrailingTicks(-1),
+  vgmDPCM07(false),
+  vgmCorrectedRate(44100) {
+  for (int i=0; i<DIV_MAX_CHIPS; i++) {
+    vgmSystems[i]=true;
+  }
+}
+
+DivExportJob::~DivExportJob() {
+  wait();
+  if (snapshot!=NULL) {
+    snapshot->finish();
+    delete snapshot;
+    snapshot=NULL;
+  }
+  if (romExport!=NULL) {
+    delete romExport;
+    romExport=NULL;
+  }
+}
@@ -0,0 +1,91 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _EXPORT_JOB_H
+#define _EXPORT_JOB_H
+
+#include "export.h"
+#include "cmdStream.h"
+#include "defines.h"
+#include <thread>
+#include <atomic>
+
+enum DivExportJobType {
+  DIV_EXPORT_JOB_VGM=0,
+  DIV_EXPORT_JOB_CMD_STREAM,
+  DIV_EXPORT_JOB_ROM
+};
+
+/**
+ * an export which runs in the background on a copy of the song.
+ * go() saves the song and returns. the copy is loaded into a headless engine
+ * on the export thread, so the engine which started the job may keep playing
+ * and the song may be edited in the meantime. several jobs may run at once.
+ * the result has one output for VGM and command stream exports, or whatever
+ * the ROM export produced.
+ */
+class DivExportJob: public DivROMExport {
+  DivExportJobType type;
+  DivROMExport* romExport;
+  DivEngine* helper;
+  SafeWriter* snapshot;
+  DivConfig helperConf;
+  int subSong, ordersLen;
+  std::thread* exportThread;
+  std::mutex helperLock;
+  // lastError and warnings are written by the export thread and read by the GUI
+  std::mutex resultLock;
+  String lastError, warnings;
+  size_t romLogPos;
+  // written by the export thread and polled by the GUI
+  std::atomic<bool> running, failed, mustAbort;
+  void syncLog();
+  void run();
+  public:
+    // VGM export options (see DivEngine::saveVGM())
+    bool vgmSystems[DIV_MAX_CHIPS];
+    bool vgmLoop;
+    int vgmVersion;
+    bool vgmPatternHints;
+    bool vgmDirectStream;
+    int vgmTrailingTicks;
+    bool vgmDPCM07;
+    int vgmCorrectedRate;
+
+    // command stream export options and progress
+    DivCSOptions csOptions;
+    DivCSProgress csProgress;
+
+    DivExportJobType getType();
+    String getLastError();
+    String getWarnings();
+
+    bool go(DivEngine* eng);
+    bool isRunning();
+    bool hasFailed();
+    // VGM and command stream exports cannot be interrupted. this waits for them to finish.
+    void abort();
+    void wait();
+    DivROMExportProgress getProgress(int index=0);
+    // rom is the ROM export to run (from DivEngine::buildROM()) and will be owned by the job.
+    DivExportJob(DivExportJobType t, DivROMExport* rom=NULL);
+    ~DivExportJob();
+};
+
+#endif
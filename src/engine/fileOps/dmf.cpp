@@ -1726,6 +1726,7 @@ SafeWriter* DivEngine::saveDMF(unsigned char version) {
       DivPattern* origPat=curPat[i].getPattern(curOrders->ord[i][j],false);
       DivPattern* pat=new DivPattern;
       origPat->copyOn(pat);
+      pat->makeUnique();
 
       if (convertSampleUsage) {
         int convIns=-1;
@@ -521,6 +521,7 @@ void TFMParsePattern(struct TFMParsePatternInfo info) {
       DivPattern* newPat=info.ds->subsong[0]->pat[i].getPattern(info.maxPat,true);
       DivPattern* lastPat=info.ds->subsong[0]->pat[i].getPattern(lastPatNum, false);
       lastPat->copyOn(newPat);
+      newPat->makeUnique();
 
       info.ds->subsong[0]->orders.ord[i][info.ds->subsong[0]->ordersLen - 1] = info.maxPat;
       newPat->newData[info.patLens[lastPatNum]-1][DIV_PAT_FX(usedEffectsCol*2)] = 0x0B;
@@ -19,6 +19,7 @@
 
 #include "filePlayer.h"
 #include "filter.h"
+#include "mixKernel.h"
 #include "../ta-log.h"
 #include <inttypes.h>
 #include <chrono>
@@ -29,8 +30,11 @@
 
 #define DIV_FPCACHE_BLOCKS_FROM_FILL 3
 #define DIV_FPCACHE_DISCARD_SIZE 4096
+// how far ahead of the play position blocks are read (in seconds)
+#define DIV_FPCACHE_READ_AHEAD 3
 
 // 5MB should be enough
+// (more is used if the read-ahead window of a file with many channels doesn't fit)
 #define DIV_MAX_MEMORY (5<<20)
 
 #define DIV_NO_BLOCK (-10)
@@ -49,7 +53,7 @@ void DivFilePlayer::fillBlocksNear(ssize_t pos) {
   if (!si.seekable) return;
 
   ssize_t firstBlock=pos>>DIV_FPCACHE_BLOCK_SHIFT;
-  ssize_t lastBlock=firstBlock+DIV_FPCACHE_BLOCKS_FROM_FILL;
+  ssize_t lastBlock=firstBlock+readAheadBlocks;
   if (firstBlock<0) firstBlock=0;
   if (firstBlock>=(ssize_t)numBlocks) firstBlock=numBlocks-1;
   if (lastBlock<0) lastBlock=0;
@@ -81,27 +85,37 @@ void DivFilePlayer::fillBlocksNear(ssize_t pos) {
   if ((curSeek&DIV_FPCACHE_BLOCK_MASK)!=0 || (curSeek>>DIV_FPCACHE_BLOCK_SHIFT)!=firstBlock) {
     // we need to seek
     logV("- seeking");
-    // we seek to a previous position in order to compensate for possible decoding differences when seeking
-    // (usually in lossy codecs)
-    sf_count_t seekWhere=firstBlock<<DIV_FPCACHE_BLOCK_SHIFT;
-    if (seekWhere<DIV_FPCACHE_DISCARD_SIZE) {
-      curSeek=sf_seek(sf,0,SEEK_SET);
-      // discard
-      if (sf_readf_float(sf,discardBuf,seekWhere)!=seekWhere) {
-        // this is a problem
-      }
+    if (exactSeek) {
+      // uncompressed formats seek precisely
+      curSeek=sf_seek(sf,firstBlock<<DIV_FPCACHE_BLOCK_SHIFT,SEEK_SET);
     } else {
-      seekWhere-=DIV_FPCACHE_DISCARD_SIZE;
-      curSeek=sf_seek(sf,seekWhere,SEEK_SET);
-      // discard
-      if (sf_readf_float(sf,discardBuf,DIV_FPCACHE_DISCARD_SIZE)!=DIV_FPCACHE_DISCARD_SIZE) {
-        // this is a problem
+      // we seek to a previous position in order to compensate for possible decoding differences when seeking
+      // (usually in lossy codecs)
+      sf_count_t seekWhere=firstBlock<<DIV_FPCACHE_BLOCK_SHIFT;
+      if (seekWhere<DIV_FPCACHE_DISCARD_SIZE) {
+        curSeek=sf_seek(sf,0,SEEK_SET);
+        // discard
+        if (sf_readf_float(sf,discardBuf,seekWhere)!=seekWhere) {
+          // this is a problem
+        }
+      } else {
+        seekWhere-=DIV_FPCACHE_DISCARD_SIZE;
+        curSeek=sf_seek(sf,seekWhere,SEEK_SET);
+        // discard
+        if (sf_readf_float(sf,discardBuf,DIV_FPCACHE_DISCARD_SIZE)!=DIV_FPCACHE_DISCARD_SIZE) {
+          // this is a problem
+        }
       }
     }
   }
 
   // read blocks
   for (ssize_t i=firstBlock; i<=lastBlock; i++) {
+    // stop reading ahead if the position changed in the meantime (e.g. while scrubbing)
+    if (i>=firstBlock+DIV_FPCACHE_BLOCKS_FROM_FILL && wantBlock!=DIV_NO_BLOCK) {
+      logV("- new request. stopping");
+      break;
+    }
     if (!blocks[i]) {
       blocks[i]=new float[DIV_FPCACHE_BLOCK_SIZE*si.channels];
       memset(blocks[i],0,DIV_FPCACHE_BLOCK_SIZE*si.channels*sizeof(float));
@@ -112,6 +126,13 @@ void DivFilePlayer::fillBlocksNear(ssize_t pos) {
       // we've reached end of file
     }
   }
+
+  // let the OS read the next part of the file in the background
+  if (sfw.isMapped() && si.frames>0) {
+    sf_count_t filePos=sfw.ioTell();
+    size_t bytesPerBlock=(size_t)(((double)sfw.getFileSize()*DIV_FPCACHE_BLOCK_SIZE)/(double)si.frames);
+    sfw.prefetch(filePos,bytesPerBlock*DIV_FPCACHE_BLOCKS_FROM_FILL);
+  }
 }
 
 void DivFilePlayer::collectGarbage(ssize_t pos) {
@@ -125,7 +146,7 @@ void DivFilePlayer::collectGarbage(ssize_t pos) {
   if (!si.seekable) return;
 
   size_t memUsage=getMemUsage();
-  if (memUsage<DIV_MAX_MEMORY) return;
+  if (memUsage<memLimit) return;
 
   pos>>=DIV_FPCACHE_BLOCK_SHIFT;
   if (pos<0) pos=0;
@@ -145,9 +166,9 @@ void DivFilePlayer::collectGarbage(ssize_t pos) {
     delete[] block;
 
     memUsage-=DIV_FPCACHE_BLOCK_SIZE*si.channels*sizeof(float);
-    if (memUsage<DIV_MAX_MEMORY) return;
+    if (memUsage<memLimit) return;
   }
-  for (ssize_t i=numBlocks-1; i>pos+DIV_FPCACHE_BLOCKS_FROM_FILL; i--) {
+  for (ssize_t i=numBlocks-1; i>pos+readAheadBlocks; i--) {
     if (!blocks[i]) continue;
     if (priorityBlock[i]) continue;
     logV("erasing block %d",(int)i);
@@ -156,7 +177,7 @@ void DivFilePlayer::collectGarbage(ssize_t pos) {
     delete[] block;
 
     memUsage-=DIV_FPCACHE_BLOCK_SIZE*si.channels*sizeof(float);
-    if (memUsage<DIV_MAX_MEMORY) return;
+    if (memUsage<memLimit) return;
   }
 }
 
@@ -178,16 +199,82 @@ void DivFilePlayer::runCacheThread() {
   logV("DivFilePlayer: cache thread over.");
 }
 
-float DivFilePlayer::getSampleAt(ssize_t pos, int ch) {
-  if (blocks==NULL) return 0.0f;
-  ssize_t blockIndex=pos>>DIV_FPCACHE_BLOCK_SHIFT;
-  if (blockIndex<0 || blockIndex>=(ssize_t)numBlocks) return 0.0f;
+// copy a span of the file to spanBuf, one channel after another.
+// missing blocks and positions outside of the file are read as silence.
+void DivFilePlayer::gatherSpan(ssize_t start, size_t len, int chans) {
+  if (spanBufLen<len*chans) {
+    delete[] spanBuf;
+    spanBufLen=len*chans;
+    spanBuf=new float[spanBufLen];
+  }
+
+  size_t done=0;
+  while (done<len) {
+    ssize_t pos=start+(ssize_t)done;
+    size_t run=len-done;
+    float* block=NULL;
+    size_t posInBlock=0;
+    if (pos<0) {
+      if (run>(size_t)(-pos)) run=-pos;
+    } else {
+      ssize_t blockIndex=pos>>DIV_FPCACHE_BLOCK_SHIFT;
+      posInBlock=pos&DIV_FPCACHE_BLOCK_MASK;
+      if (run>DIV_FPCACHE_BLOCK_SIZE-posInBlock) run=DIV_FPCACHE_BLOCK_SIZE-posInBlock;
+      if (blocks!=NULL && blockIndex<(ssize_t)numBlocks) block=blocks[blockIndex];
+    }
+
+    for (int ch=0; ch<chans; ch++) {
+      float* dest=spanBuf+ch*len+done;
+      if (block==NULL) {
+        memset(dest,0,run*sizeof(float));
+      } else if (si.channels==1) {
+        memcpy(dest,block+posInBlock,run*sizeof(float));
+      } else {
+        const float* src=block+posInBlock*si.channels+ch;
+        for (size_t k=0; k<run; k++) {
+          dest[k]=*src;
+          src+=si.channels;
+        }
+      }
+    }
+    done+=run;
+  }
+}
+
+// resample len samples from the play position to buf (starting at offset) and advance.
+void DivFilePlayer::mixSpan(float** buf, int chans, unsigned int offset, unsigned int len, float vol) {
+  // input samples needed (8 taps starting 3 samples before the play position)
+  size_t inLen=(size_t)(((uint64_t)rateAccum+(uint64_t)len*(uint64_t)si.samplerate)/(uint64_t)outRate)+8;
+  // mono files are resampled once and copied to every output
+  int inChans=MIN(chans,(si.channels==1)?1:si.channels);
+
+  gatherSpan(playPos-3,inLen,inChans);
+
+  size_t consumed=0;
+  int phase=rateAccum;
+  for (int j=0; j<inChans; j++) {
+    phase=rateAccum;
+    consumed=resampleSinc8(buf[j]+offset,spanBuf+j*inLen,sincTable,len,&phase,si.samplerate,outRate,vol);
+  }
+  for (int j=inChans; j<chans; j++) {
+    if (si.channels==1) {
+      memcpy(buf[j]+offset,buf[0]+offset,len*sizeof(float));
+    } else {
+      memset(buf[j]+offset,0,len*sizeof(float));
+    }
+  }
 
-  float* block=blocks[blockIndex];
-  size_t posInBlock=(pos&DIV_FPCACHE_BLOCK_MASK)*si.channels+ch;
-  if (block==NULL) return 0.0f;
+  playPos+=consumed;
+  rateAccum=phase;
+}
 
-  return block[posInBlock];
+void DivFilePlayer::requestBlock() {
+  ssize_t blockIndex=playPos>>DIV_FPCACHE_BLOCK_SHIFT;
+  if (blockIndex!=lastWantBlock) {
+    wantBlock=playPos;
+    cacheCV.notify_one();
+    lastWantBlock=blockIndex;
+  }
 }
 
 void DivFilePlayer::mix(float** buf, int chans, unsigned int size) {
@@ -207,7 +294,9 @@ void DivFilePlayer::mix(float** buf, int chans, unsigned int size) {
     cacheCV.notify_one();
   }
 
-  for (unsigned int i=0; i<size; i++) {
+  // the buffer is processed in spans which end where a pending event is
+  unsigned int i=0;
+  while (i<size) {
     // acknowledge pending events
     if (pendingPosOffset==i) {
       pendingPosOffset=UINT_MAX;
@@ -221,76 +310,23 @@ void DivFilePlayer::mix(float** buf, int chans, unsigned int size) {
       playing=false;
     }
 
-    ssize_t blockIndex=playPos>>DIV_FPCACHE_BLOCK_SHIFT;
-    if (blockIndex!=lastWantBlock) {
-      wantBlock=playPos;
-      cacheCV.notify_one();
-      lastWantBlock=blockIndex;
-    }
-
-    if (playing) {
-      // sinc interpolation
-      float x[8];
-
-      unsigned int n=(8192*rateAccum)/outRate;
-      n&=8191;
-      float* t1=&sincTable[(8191-n)<<2];
-      float* t2=&sincTable[n<<2];
-      if (si.channels==1) {
-        // mono optimization
-        for (int k=0; k<8; k++) {
-          x[k]=getSampleAt(playPos+k-3,0);
-        }
+    unsigned int spanEnd=size;
+    if (pendingPosOffset>i && pendingPosOffset<spanEnd) spanEnd=pendingPosOffset;
+    if (pendingPlayOffset>i && pendingPlayOffset<spanEnd) spanEnd=pendingPlayOffset;
+    if (pendingStopOffset>i && pendingStopOffset<spanEnd) spanEnd=pendingStopOffset;
 
-        float s=(
-          x[0]*t2[3]+
-          x[1]*t2[2]+
-          x[2]*t2[1]+
-          x[3]*t2[0]+
-          x[4]*t1[0]+
-          x[5]*t1[1]+
-          x[6]*t1[2]+
-          x[7]*t1[3]
-        )*actualVolume;
-
-        for (int j=0; j<chans; j++) {
-          buf[j][i]=s;
-        }
-      } else for (int j=0; j<chans; j++) {
-        if (j>=si.channels) {
-          buf[j][i]=0.0f;
-          continue;
-        }
+    requestBlock();
 
-        for (int k=0; k<8; k++) {
-          x[k]=getSampleAt(playPos+k-3,j);
-        }
-        buf[j][i]=(
-          x[0]*t2[3]+
-          x[1]*t2[2]+
-          x[2]*t2[1]+
-          x[3]*t2[0]+
-          x[4]*t1[0]+
-          x[5]*t1[1]+
-          x[6]*t1[2]+
-          x[7]*t1[3]
-        )*actualVolume;
-      }
-
-      // advance
-      rateAccum+=si.samplerate;
-      while (rateAccum>=outRate) {
-        rateAccum-=outRate;
-        playPos++;
-        /*if (playPos>=(ssize_t)si.frames) {
-          playPos=0;
-        }*/
-      }
+    if (playing) {
+      mixSpan(buf,chans,i,spanEnd-i,actualVolume);
+      // the span may have crossed into another block
+      requestBlock();
     } else {
       for (int j=0; j<chans; j++) {
-        buf[j][i]=0.0f;
+        memset(buf[j]+i,0,(spanEnd-i)*sizeof(float));
       }
     }
+    i=spanEnd;
   }
 }
 
@@ -432,6 +468,10 @@ bool DivFilePlayer::closeFile() {
   delete[] discardBuf;
   discardBuf=NULL;
 
+  delete[] spanBuf;
+  spanBuf=NULL;
+  spanBufLen=0;
+
   return true;
 }
 
@@ -439,7 +479,7 @@ bool DivFilePlayer::loadFile(const char* path) {
   if (sf!=NULL) closeFile();
 
   logD("DivFilePlayer: opening file...");
-  sf=sfw.doOpen(path,SFM_READ,&si);
+  sf=sfw.doOpen(path,SFM_READ,&si,true);
   if (sf==NULL) {
     logE("could not open file!");
     return false;
@@ -449,6 +489,33 @@ bool DivFilePlayer::loadFile(const char* path) {
   logV("- channels: %d",si.channels);
   logV("- rate: %d",si.samplerate);
 
+  // PCM data can be seeked to precisely, so there's no need to discard anything after seeking
+  switch (si.format&SF_FORMAT_SUBMASK) {
+    case SF_FORMAT_PCM_S8:
+    case SF_FORMAT_PCM_16:
+    case SF_FORMAT_PCM_24:
+    case SF_FORMAT_PCM_32:
+    case SF_FORMAT_PCM_U8:
+    case SF_FORMAT_FLOAT:
+    case SF_FORMAT_DOUBLE:
+    case SF_FORMAT_ULAW:
+    case SF_FORMAT_ALAW:
+      exactSeek=true;
+      break;
+    default:
+      exactSeek=false;
+      break;
+  }
+  logV("- exact seek: %s",exactSeek?"yes":"no");
+
+  // the read-ahead window is a fixed amount of time
+  readAheadBlocks=(DIV_FPCACHE_READ_AHEAD*si.samplerate+DIV_FPCACHE_BLOCK_MASK)>>DIV_FPCACHE_BLOCK_SHIFT;
+  if (readAheadBlocks<DIV_FPCACHE_BLOCKS_FROM_FILL) readAheadBlocks=DIV_FPCACHE_BLOCKS_FROM_FILL;
+  memLimit=DIV_MAX_MEMORY;
+  // window plus a couple blocks behind the play position
+  size_t windowSize=(readAheadBlocks+3)*DIV_FPCACHE_BLOCK_SIZE*si.channels*sizeof(float);
+  if (memLimit<windowSize) memLimit=windowSize;
+
   numBlocks=(DIV_FPCACHE_BLOCK_MASK+si.frames)>>DIV_FPCACHE_BLOCK_SHIFT;
   blocks=new float*[numBlocks];
   priorityBlock=new bool[numBlocks];
@@ -527,10 +594,15 @@ void DivFilePlayer::setActive(bool active) {
 
 DivFilePlayer::DivFilePlayer():
   discardBuf(NULL),
+  spanBuf(NULL),
+  spanBufLen(0),
   blocks(NULL),
   priorityBlock(NULL),
   numBlocks(0),
   sf(NULL),
+  exactSeek(false),
+  readAheadBlocks(DIV_FPCACHE_BLOCKS_FROM_FILL),
+  memLimit(DIV_MAX_MEMORY),
   playPos(0),
   lastWantBlock(DIV_NO_BLOCK),
   wantBlock(DIV_NO_BLOCK),
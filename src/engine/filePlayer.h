@@ -38,6 +38,9 @@ struct SF_INFO {
 class DivFilePlayer {
   float* sincTable;
   float* discardBuf;
+  // input of the resampler (see gatherSpan())
+  float* spanBuf;
+  size_t spanBufLen;
   float** blocks;
   bool* priorityBlock;
   size_t numBlocks;
@@ -45,6 +48,11 @@ class DivFilePlayer {
   SFWrapper sfw;
   SNDFILE* sf;
   SF_INFO si;
+  // whether seeking is sample-accurate (uncompressed formats)
+  bool exactSeek;
+  // how many blocks are read ahead of the play position
+  ssize_t readAheadBlocks;
+  size_t memLimit;
 
   ssize_t playPos;
   ssize_t lastWantBlock;
@@ -70,7 +78,9 @@ class DivFilePlayer {
 
   void fillBlocksNear(ssize_t pos);
   void collectGarbage(ssize_t pos);
-  float getSampleAt(ssize_t pos, int ch);
+  void gatherSpan(ssize_t start, size_t len, int chans);
+  void mixSpan(float** buf, int chans, unsigned int offset, unsigned int len, float vol);
+  void requestBlock();
 
   public:
     void runCacheThread();
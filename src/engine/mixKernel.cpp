@@ -0,0 +1,308 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "mixKernel.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || (defined(__i386__) && defined(__SSE2__))
+#define MIX_HAVE_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define MIX_HAVE_AVX2
+#include <immintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__aarch64__)
+#define MIX_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+// generic implementation
+static void mixShortToFloatC(float* out, const short* in, float gain, size_t len) {
+  for (size_t i=0; i<len; i++) {
+    out[i]+=(float)in[i]*gain;
+  }
+}
+
+static void mixFloatC(float* out, const float* in, float gain, size_t len) {
+  for (size_t i=0; i<len; i++) {
+    out[i]+=in[i]*gain;
+  }
+}
+
+static void decimateShortC(short* out, const short* in, int factor, size_t len) {
+  if (factor<=1) {
+    memcpy(out,in,len*sizeof(short));
+    return;
+  }
+  // powers of 2 are shifted (rounding down) so that the SIMD versions match
+  int shift=-1;
+  for (int i=0; i<16; i++) {
+    if (factor==(1<<i)) {
+      shift=i;
+      break;
+    }
+  }
+  for (size_t i=0; i<len; i++) {
+    int sum=0;
+    for (int j=0; j<factor; j++) {
+      sum+=in[j];
+    }
+    out[i]=(shift>=0)?(sum>>shift):(sum/factor);
+    in+=factor;
+  }
+}
+
+// only used when there's no SIMD version
+#if !defined(MIX_HAVE_SSE2) && !defined(MIX_HAVE_NEON)
+static size_t resampleSinc8C(float* out, const float* in, const float* table, size_t len, int* phase, int inRate, int outRate, float gain) {
+  size_t pos=0;
+  int p=*phase;
+  for (size_t i=0; i<len; i++) {
+    unsigned int n=(8192*(unsigned int)p)/outRate;
+    n&=8191;
+    const float* t1=&table[(8191-n)<<2];
+    const float* t2=&table[n<<2];
+    const float* x=in+pos;
+    out[i]=(
+      x[0]*t2[3]+
+      x[1]*t2[2]+
+      x[2]*t2[1]+
+      x[3]*t2[0]+
+      x[4]*t1[0]+
+      x[5]*t1[1]+
+      x[6]*t1[2]+
+      x[7]*t1[3]
+    )*gain;
+
+    p+=inRate;
+    while (p>=outRate) {
+      p-=outRate;
+      pos++;
+    }
+  }
+  *phase=p;
+  return pos;
+}
+#endif
+
+#ifdef MIX_HAVE_SSE2
+static void mixShortToFloatSSE2(float* out, const short* in, float gain, size_t len) {
+  const __m128 g=_mm_set1_ps(gain);
+  size_t i=0;
+  for (; i+8<=len; i+=8) {
+    __m128i s=_mm_loadu_si128((const __m128i*)(in+i));
+    // sign-extend to 32-bit
+    __m128 lo=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s,s),16));
+    __m128 hi=_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s,s),16));
+    _mm_storeu_ps(out+i,_mm_add_ps(_mm_loadu_ps(out+i),_mm_mul_ps(lo,g)));
+    _mm_storeu_ps(out+i+4,_mm_add_ps(_mm_loadu_ps(out+i+4),_mm_mul_ps(hi,g)));
+  }
+  mixShortToFloatC(out+i,in+i,gain,len-i);
+}
+
+static void mixFloatSSE2(float* out, const float* in, float gain, size_t len) {
+  const __m128 g=_mm_set1_ps(gain);
+  size_t i=0;
+  for (; i+4<=len; i+=4) {
+    _mm_storeu_ps(out+i,_mm_add_ps(_mm_loadu_ps(out+i),_mm_mul_ps(_mm_loadu_ps(in+i),g)));
+  }
+  mixFloatC(out+i,in+i,gain,len-i);
+}
+
+static void decimateShortSSE2(short* out, const short* in, int factor, size_t len) {
+  const __m128i one=_mm_set1_epi16(1);
+  size_t i=0;
+  if (factor==2) {
+    for (; i+8<=len; i+=8) {
+      // madd adds adjacent pairs into 32-bit lanes
+      __m128i lo=_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(in+i*2)),one);
+      __m128i hi=_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(in+i*2+8)),one);
+      _mm_storeu_si128((__m128i*)(out+i),_mm_packs_epi32(_mm_srai_epi32(lo,1),_mm_srai_epi32(hi,1)));
+    }
+  } else if (factor==4) {
+    for (; i+8<=len; i+=8) {
+      __m128i s[4];
+      for (int j=0; j<4; j++) {
+        __m128i pairs=_mm_madd_epi16(_mm_loadu_si128((const __m128i*)(in+i*4+j*8)),one);
+        // lanes 0 and 2 get the sums of four samples
+        pairs=_mm_add_epi32(pairs,_mm_srli_epi64(pairs,32));
+        s[j]=_mm_shuffle_epi32(pairs,_MM_SHUFFLE(3,1,2,0));
+      }
+      __m128i lo=_mm_unpacklo_epi64(s[0],s[1]);
+      __m128i hi=_mm_unpacklo_epi64(s[2],s[3]);
+      _mm_storeu_si128((__m128i*)(out+i),_mm_packs_epi32(_mm_srai_epi32(lo,2),_mm_srai_epi32(hi,2)));
+    }
+  }
+  decimateShortC(out+i,in+i*factor,factor,len-i);
+}
+
+static size_t resampleSinc8SSE2(float* out, const float* in, const float* table, size_t len, int* phase, int inRate, int outRate, float gain) {
+  size_t pos=0;
+  int p=*phase;
+  for (size_t i=0; i<len; i++) {
+    unsigned int n=(8192*(unsigned int)p)/outRate;
+    n&=8191;
+    // the first half of the window uses t2 in reverse
+    __m128 t1=_mm_loadu_ps(&table[(8191-n)<<2]);
+    __m128 t2=_mm_loadu_ps(&table[n<<2]);
+    t2=_mm_shuffle_ps(t2,t2,_MM_SHUFFLE(0,1,2,3));
+    __m128 sum=_mm_add_ps(_mm_mul_ps(_mm_loadu_ps(in+pos),t2),_mm_mul_ps(_mm_loadu_ps(in+pos+4),t1));
+    // horizontal sum
+    sum=_mm_add_ps(sum,_mm_movehl_ps(sum,sum));
+    sum=_mm_add_ss(sum,_mm_shuffle_ps(sum,sum,_MM_SHUFFLE(1,1,1,1)));
+    out[i]=_mm_cvtss_f32(sum)*gain;
+
+    p+=inRate;
+    while (p>=outRate) {
+      p-=outRate;
+      pos++;
+    }
+  }
+  *phase=p;
+  return pos;
+}
+#endif
+
+#ifdef MIX_HAVE_AVX2
+__attribute__((target("avx2"))) static void mixShortToFloatAVX2(float* out, const short* in, float gain, size_t len) {
+  const __m256 g=_mm256_set1_ps(gain);
+  size_t i=0;
+  for (; i+16<=len; i+=16) {
+    __m256 lo=_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in+i))));
+    __m256 hi=_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(in+i+8))));
+    _mm256_storeu_ps(out+i,_mm256_add_ps(_mm256_loadu_ps(out+i),_mm256_mul_ps(lo,g)));
+    _mm256_storeu_ps(out+i+8,_mm256_add_ps(_mm256_loadu_ps(out+i+8),_mm256_mul_ps(hi,g)));
+  }
+  mixShortToFloatSSE2(out+i,in+i,gain,len-i);
+}
+
+__attribute__((target("avx2"))) static void mixFloatAVX2(float* out, const float* in, float gain, size_t len) {
+  const __m256 g=_mm256_set1_ps(gain);
+  size_t i=0;
+  for (; i+8<=len; i+=8) {
+    _mm256_storeu_ps(out+i,_mm256_add_ps(_mm256_loadu_ps(out+i),_mm256_mul_ps(_mm256_loadu_ps(in+i),g)));
+  }
+  mixFloatSSE2(out+i,in+i,gain,len-i);
+}
+
+static bool haveAVX2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#ifdef MIX_HAVE_NEON
+static void mixShortToFloatNEON(float* out, const short* in, float gain, size_t len) {
+  const float32x4_t g=vdupq_n_f32(gain);
+  size_t i=0;
+  for (; i+8<=len; i+=8) {
+    int16x8_t s=vld1q_s16(in+i);
+    float32x4_t lo=vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+    float32x4_t hi=vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+    vst1q_f32(out+i,vmlaq_f32(vld1q_f32(out+i),lo,g));
+    vst1q_f32(out+i+4,vmlaq_f32(vld1q_f32(out+i+4),hi,g));
+  }
+  mixShortToFloatC(out+i,in+i,gain,len-i);
+}
+
+static void mixFloatNEON(float* out, const float* in, float gain, size_t len) {
+  const float32x4_t g=vdupq_n_f32(gain);
+  size_t i=0;
+  for (; i+4<=len; i+=4) {
+    vst1q_f32(out+i,vmlaq_f32(vld1q_f32(out+i),vld1q_f32(in+i),g));
+  }
+  mixFloatC(out+i,in+i,gain,len-i);
+}
+
+static void decimateShortNEON(short* out, const short* in, int factor, size_t len) {
+  size_t i=0;
+  if (factor==2) {
+    for (; i+8<=len; i+=8) {
+      // split even and odd samples, then halving add (rounds down)
+      int16x8x2_t s=vld2q_s16(in+i*2);
+      vst1q_s16(out+i,vhaddq_s16(s.val[0],s.val[1]));
+    }
+  }
+  decimateShortC(out+i,in+i*factor,factor,len-i);
+}
+
+static size_t resampleSinc8NEON(float* out, const float* in, const float* table, size_t len, int* phase, int inRate, int outRate, float gain) {
+  size_t pos=0;
+  int p=*phase;
+  for (size_t i=0; i<len; i++) {
+    unsigned int n=(8192*(unsigned int)p)/outRate;
+    n&=8191;
+    // the first half of the window uses t2 in reverse
+    float32x4_t t1=vld1q_f32(&table[(8191-n)<<2]);
+    float32x4_t t2=vrev64q_f32(vld1q_f32(&table[n<<2]));
+    t2=vcombine_f32(vget_high_f32(t2),vget_low_f32(t2));
+    float32x4_t sum=vmlaq_f32(vmulq_f32(vld1q_f32(in+pos),t2),vld1q_f32(in+pos+4),t1);
+    float32x2_t half=vadd_f32(vget_low_f32(sum),vget_high_f32(sum));
+    out[i]=vget_lane_f32(vpadd_f32(half,half),0)*gain;
+
+    p+=inRate;
+    while (p>=outRate) {
+      p-=outRate;
+      pos++;
+    }
+  }
+  *phase=p;
+  return pos;
+}
+#endif
+
+// pick the implementation once at startup
+#if defined(MIX_HAVE_AVX2)
+static const bool useAVX2=haveAVX2();
+void (*mixShortToFloat)(float*,const short*,float,size_t)=useAVX2?mixShortToFloatAVX2:mixShortToFloatSSE2;
+void (*mixFloat)(float*,const float*,float,size_t)=useAVX2?mixFloatAVX2:mixFloatSSE2;
+void (*decimateShort)(short*,const short*,int,size_t)=decimateShortSSE2;
+size_t (*resampleSinc8)(float*,const float*,const float*,size_t,int*,int,int,float)=resampleSinc8SSE2;
+
+const char* mixKernelName() {
+  return useAVX2?"AVX2":"SSE2";
+}
+#elif defined(MIX_HAVE_SSE2)
+void (*mixShortToFloat)(float*,const short*,float,size_t)=mixShortToFloatSSE2;
+void (*mixFloat)(float*,const float*,float,size_t)=mixFloatSSE2;
+void (*decimateShort)(short*,const short*,int,size_t)=decimateShortSSE2;
+size_t (*resampleSinc8)(float*,const float*,const float*,size_t,int*,int,int,float)=resampleSinc8SSE2;
+
+const char* mixKernelName() {
+  return "SSE2";
+}
+#elif defined(MIX_HAVE_NEON)
+void (*mixShortToFloat)(float*,const short*,float,size_t)=mixShortToFloatNEON;
+void (*mixFloat)(float*,const float*,float,size_t)=mixFloatNEON;
+void (*decimateShort)(short*,const short*,int,size_t)=decimateShortNEON;
+size_t (*resampleSinc8)(float*,const float*,const float*,size_t,int*,int,int,float)=resampleSinc8NEON;
+
+const char* mixKernelName() {
+  return "NEON";
+}
+#else
+void (*mixShortToFloat)(float*,const short*,float,size_t)=mixShortToFloatC;
+void (*mixFloat)(float*,const float*,float,size_t)=mixFloatC;
+void (*decimateShort)(short*,const short*,int,size_t)=decimateShortC;
+size_t (*resampleSinc8)(float*,const float*,const float*,size_t,int*,int,int,float)=resampleSinc8C;
+
+const char* mixKernelName() {
+  return "generic";
+}
+#endif
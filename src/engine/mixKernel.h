@@ -0,0 +1,43 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _MIXKERNEL_H
+#define _MIXKERNEL_H
+
+#include <stddef.h>
+
+// out[i]+=in[i]*gain, for len samples.
+// these point to the fastest implementation available on this CPU.
+extern void (*mixShortToFloat)(float* out, const short* in, float gain, size_t len);
+extern void (*mixFloat)(float* out, const float* in, float gain, size_t len);
+
+// out[i]=average of in[i*factor] to in[i*factor+factor-1], for len output samples.
+// factor 1 is a copy.
+extern void (*decimateShort)(short* out, const short* in, int factor, size_t len);
+
+// 8-tap sinc resampling of a contiguous span (see DivFilterTables::getSincTable8()).
+// in points to the input sample 3 before the current position.
+// phase goes up by inRate every output sample, and the position moves forward when it reaches outRate.
+// writes len samples multiplied by gain, updates phase and returns how many input samples were consumed.
+extern size_t (*resampleSinc8)(float* out, const float* in, const float* table, size_t len, int* phase, int inRate, int outRate, float gain);
+
+// returns the name of the implementation in use.
+const char* mixKernelName();
+
+#endif
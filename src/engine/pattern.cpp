@@ -20,10 +20,36 @@
 #include "engine.h"
 #include "../ta-log.h"
 
+// storage which no pattern refers to anymore (see DivPattern::releaseStorage())
+// declared before emptyPat, which may be retired on exit.
+static std::mutex retiredLock;
+static std::vector<DivPatternStorage*> retired;
+
 static DivPattern emptyPat;
 
-DivPattern::DivPattern() {
-  clear();
+DivPattern::DivPattern():
+  storage(new DivPatternStorage) {
+  storage->refs=1;
+  newData=storage->data;
+  memset(newData,-1,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
+}
+
+DivPattern::DivPattern(const DivPattern& other):
+  name(other.name),
+  storage(other.storage) {
+  storage->refs++;
+  newData=storage->data;
+}
+
+DivPattern& DivPattern::operator=(const DivPattern& other) {
+  if (this!=&other) other.copyOn(this);
+  return *this;
+}
+
+DivPattern::~DivPattern() {
+  releaseStorage(storage);
+  storage=NULL;
+  newData=NULL;
 }
 
 DivPattern* DivChannelData::getPattern(int index, bool create) {
@@ -33,6 +59,8 @@ DivPattern* DivChannelData::getPattern(int index, bool create) {
     } else {
       return &emptyPat;
     }
+  } else if (create) {
+    data[index]->makeUnique();
   }
   return data[index];
 }
@@ -45,7 +73,7 @@ std::vector<std::pair<int,int>> DivChannelData::optimize() {
       for (int j=0; j<DIV_MAX_PATTERNS; j++) {
         if (j==i) continue;
         if (data[j]==NULL) continue;
-        if (memcmp(data[i]->newData,data[j]->newData,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short))==0) {
+        if (data[i]->storage==data[j]->storage || memcmp(data[i]->newData,data[j]->newData,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short))==0) {
           delete data[j];
           data[j]=NULL;
           logV("%d == %d",i,j);
@@ -93,13 +121,93 @@ bool DivPattern::isEmpty() {
   return true;
 }
 
-void DivPattern::copyOn(DivPattern* dest) {
+void DivPattern::copyOn(DivPattern* dest) const {
   dest->name=name;
-  memcpy(dest->newData,newData,sizeof(newData));
+  if (dest->storage==storage) return;
+  releaseStorage(dest->storage);
+  dest->storage=storage;
+  dest->newData=storage->data;
+  storage->refs++;
+}
+
+void DivPattern::makeUnique() {
+  // the caller is about to write
+  if (storage->refs<=1) {
+    invalidateRowFlags();
+    return;
+  }
+  DivPatternStorage* oldStorage=storage;
+  DivPatternStorage* newStorage=new DivPatternStorage;
+  memcpy(newStorage->data,oldStorage->data,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
+  newStorage->refs=1;
+  storage=newStorage;
+  newData=storage->data;
+  // the others may have let go of the old storage in the meantime
+  releaseStorage(oldStorage);
+}
+
+void DivPattern::releaseStorage(DivPatternStorage* storage) {
+  if (--storage->refs>0) return;
+  std::lock_guard<std::mutex> lock(retiredLock);
+  retired.push_back(storage);
+}
+
+void DivPattern::takeRetired(std::vector<DivPatternStorage*>& dest) {
+  std::lock_guard<std::mutex> lock(retiredLock);
+  dest.insert(dest.end(),retired.begin(),retired.end());
+  retired.clear();
 }
 
 void DivPattern::clear() {
+  if (storage->refs>1) {
+    // no need to copy the data we're about to erase
+    DivPatternStorage* oldStorage=storage;
+    storage=new DivPatternStorage;
+    storage->refs=1;
+    newData=storage->data;
+    releaseStorage(oldStorage);
+  }
   memset(newData,-1,DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short));
+  invalidateRowFlags();
+}
+
+void DivPattern::invalidateRowFlags() {
+  storage->rowFlagsGen++;
+}
+
+unsigned char DivPattern::getRowFlags(int row) {
+  if (storage->rowFlagsBuilt.load(std::memory_order_acquire)!=storage->rowFlagsGen.load(std::memory_order_acquire)) {
+    buildRowFlags();
+  }
+  return storage->rowFlags[row].load(std::memory_order_relaxed);
+}
+
+void DivPattern::buildRowFlags() {
+  std::lock_guard<std::mutex> lock(storage->rowFlagsLock);
+  // someone else may have built it while we waited
+  unsigned int gen=storage->rowFlagsGen.load(std::memory_order_acquire);
+  if (storage->rowFlagsBuilt.load(std::memory_order_relaxed)==gen) return;
+  for (int i=0; i<DIV_MAX_ROWS; i++) {
+    const short* row=newData[i];
+    unsigned char flags=0;
+    if (row[DIV_PAT_NOTE]!=-1 || row[DIV_PAT_INS]!=-1 || row[DIV_PAT_VOL]!=-1) flags|=DIV_ROW_NOTE;
+    for (int j=0; j<DIV_MAX_EFFECTS; j++) {
+      short effect=row[DIV_PAT_FX(j)];
+      // an effect value without an effect does nothing
+      if (effect==-1) continue;
+      flags|=DIV_ROW_FX;
+      switch (effect) {
+        case 0x09: case 0x0f: case 0xfd: case 0xfe:
+        case 0x0b: case 0x0d: case 0xed:
+        case 0xc0: case 0xc1: case 0xc2: case 0xc3:
+        case 0xf0: case 0xff:
+          flags|=DIV_ROW_FX_FLOW;
+          break;
+      }
+    }
+    storage->rowFlags[i].store(flags,std::memory_order_relaxed);
+  }
+  storage->rowFlagsBuilt.store(gen,std::memory_order_release);
 }
 
 DivChannelData::DivChannelData():
@@ -19,6 +19,37 @@
 
 #include "safeReader.h"
 #include "../pch.h"
+#include <atomic>
+
+// row summary flags (see DivPattern::getRowFlags())
+// note, instrument or volume
+#define DIV_ROW_NOTE 1
+// any effect
+#define DIV_ROW_FX 2
+// an effect which changes speed, tempo, tick rate or position, or delays the row (09, 0F, FD, FE, 0B, 0D, ED, Cx, F0 and FF)
+#define DIV_ROW_FX_FLOW 4
+
+/**
+ * storage for pattern data.
+ * it may be shared by several patterns (copy-on-write).
+ */
+struct DivPatternStorage {
+  short data[DIV_MAX_ROWS][DIV_MAX_COLS];
+  // number of patterns sharing this storage. atomic since patterns may be copied or released outside the engine lock.
+  std::atomic<int> refs;
+  // one DIV_ROW_* combination per row. only valid if rowFlagsBuilt matches rowFlagsGen.
+  // atomic since a thread may read them while another one builds them again.
+  std::atomic<unsigned char> rowFlags[DIV_MAX_ROWS];
+  // bumped on every invalidation. rowFlagsBuilt is the value rowFlags was built for,
+  // so an invalidation which happens while building is not lost.
+  std::atomic<unsigned int> rowFlagsGen, rowFlagsBuilt;
+  // held while building rowFlags, so that only one thread does so.
+  std::mutex rowFlagsLock;
+  DivPatternStorage():
+    refs(1),
+    rowFlagsGen(1),
+    rowFlagsBuilt(0) {}
+};
 
 struct DivPattern {
   String name;
@@ -36,8 +67,16 @@ struct DivPattern {
    * use the DIV_PAT_* macros in defines.h for convenience.
    *
    * if a cell is -1, it means "empty".
+   *
+   * the data may be shared with other patterns (e.g. after copyOn()).
+   * only write to it after getting this pattern with getPattern(index,true) or calling makeUnique().
+   */
+  short (*newData)[DIV_MAX_COLS];
+
+  /**
+   * do NOT access directly! use newData instead.
    */
-  short newData[DIV_MAX_ROWS][DIV_MAX_COLS];
+  DivPatternStorage* storage;
 
   /**
    * check whether this pattern is empty.
@@ -45,6 +84,28 @@ struct DivPattern {
    */
   bool isEmpty();
 
+  /**
+   * get a summary of what a row contains (DIV_ROW_* flags), so that walkers can skip rows
+   * without reading every cell.
+   * the summary is built on first use (by one thread at a time) and thrown away by
+   * invalidateRowFlags(), makeUnique() and clear().
+   * @param row the row.
+   * @return the flags.
+   */
+  unsigned char getRowFlags(int row);
+
+  /**
+   * build the row summary if it's out of date. used by getRowFlags().
+   */
+  void buildRowFlags();
+
+  /**
+   * throw away the row summary. it is built again on the next getRowFlags().
+   * makeUnique() (and getPattern(index,true)) already do this, but call it after writing
+   * to newData as well, since the summary may be built while writing.
+   */
+  void invalidateRowFlags();
+
   /**
    * clear the pattern.
    */
@@ -52,10 +113,34 @@ struct DivPattern {
 
   /**
    * copy this pattern to another.
+   * the data is shared until either pattern is written to.
    * @param dest the destination pattern.
    */
-  void copyOn(DivPattern* dest);
+  void copyOn(DivPattern* dest) const;
+
+  /**
+   * make sure the data of this pattern isn't shared with any other pattern,
+   * and throw away the row summary.
+   * call this before writing to newData (and invalidateRowFlags() after).
+   */
+  void makeUnique();
+
+  /**
+   * let go of pattern storage. if this was the last reference, the storage is retired
+   * rather than freed, as the audio thread may still be reading it.
+   * see DivEngine::freeRetiredPatterns().
+   */
+  static void releaseStorage(DivPatternStorage* storage);
+
+  /**
+   * move every retired storage to dest.
+   */
+  static void takeRetired(std::vector<DivPatternStorage*>& dest);
+
   DivPattern();
+  DivPattern(const DivPattern& other);
+  DivPattern& operator=(const DivPattern& other);
+  ~DivPattern();
 };
 
 struct DivChannelData {
@@ -69,7 +154,8 @@ struct DivChannelData {
   /**
    * get a pattern from this channel, or the empty pattern if not initialized.
    * @param index the pattern ID.
-   * @param create whether to initialize a new pattern if not init'ed. always use true if you're going to modify it!
+   * @param create whether to initialize a new pattern if not init'ed (and make its data unique).
+   * always use true if you're going to modify it!
    * @return a DivPattern.
    */
   DivPattern* getPattern(int index, bool create);
@@ -78,9 +78,16 @@ void* DivDispatch::getState() {
   return NULL;
 }
 
+bool DivDispatch::hasState() {
+  return false;
+}
+
 void DivDispatch::setState(void* state) {
 }
 
+void DivDispatch::freeState(void* state) {
+}
+
 void DivDispatch::muteChannel(int ch, bool mute) {
 }
 
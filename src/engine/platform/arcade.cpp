@@ -955,6 +955,33 @@ int DivPlatformArcade::getRegisterPoolSize() {
   return 256;
 }
 
+bool DivPlatformArcade::hasState() {
+  return true;
+}
+
+void* DivPlatformArcade::getState() {
+  State* s=new State;
+  for (int i=0; i<8; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->amDepth=amDepth;
+  s->pmDepth=pmDepth;
+  return s;
+}
+
+void DivPlatformArcade::setState(void* state) {
+  State* s=(State*)state;
+  for (int i=0; i<8; i++) {
+    chan[i]=s->chan[i];
+  }
+  amDepth=s->amDepth;
+  pmDepth=s->pmDepth;
+}
+
+void DivPlatformArcade::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformArcade::poke(unsigned int addr, unsigned short val) {
   immWrite(addr,val);
 }
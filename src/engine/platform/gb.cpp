@@ -647,6 +647,41 @@ int DivPlatformGB::getRegisterPoolSize() {
   return 64;
 }
 
+bool DivPlatformGB::hasState() {
+  return true;
+}
+
+void* DivPlatformGB::getState() {
+  State* s=new State;
+  for (int i=0; i<4; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->ws=ws;
+  s->lastPan=lastPan;
+  s->doubleWave=doubleWave;
+  s->lastDoubleWave=lastDoubleWave;
+  s->antiClickPeriodCount=antiClickPeriodCount;
+  s->antiClickWavePos=antiClickWavePos;
+  return s;
+}
+
+void DivPlatformGB::setState(void* state) {
+  State* s=(State*)state;
+  for (int i=0; i<4; i++) {
+    chan[i]=s->chan[i];
+  }
+  ws=s->ws;
+  lastPan=s->lastPan;
+  doubleWave=s->doubleWave;
+  lastDoubleWave=s->lastDoubleWave;
+  antiClickPeriodCount=s->antiClickPeriodCount;
+  antiClickWavePos=s->antiClickWavePos;
+}
+
+void DivPlatformGB::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformGB::reset() {
   for (int i=0; i<4; i++) {
     chan[i]=DivPlatformGB::Channel(parent->song.compatFlags.linearPitch);
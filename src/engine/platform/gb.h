@@ -74,6 +74,14 @@ class DivPlatformGB: public DivDispatch {
 
   int antiClickPeriodCount, antiClickWavePos;
 
+  struct State {
+    Channel chan[4];
+    DivWaveSynth ws;
+    unsigned char lastPan;
+    bool doubleWave, lastDoubleWave;
+    int antiClickPeriodCount, antiClickWavePos;
+  };
+
   int coreQuality;
   GB_gameboy_t* gb;
   GB_model_t model;
@@ -92,6 +100,10 @@ class DivPlatformGB: public DivDispatch {
     DivDispatchOscBuffer* getOscBuffer(int chan);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    void* getState();
+    bool hasState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
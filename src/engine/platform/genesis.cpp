@@ -1702,6 +1702,40 @@ int DivPlatformGenesis::getRegisterPoolSize() {
   return 512;
 }
 
+void DivPlatformGenesis::saveState(State* s) {
+  for (int i=0; i<10; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->lfoValue=lfoValue;
+  s->extMode=extMode;
+}
+
+void DivPlatformGenesis::loadState(State* s) {
+  for (int i=0; i<10; i++) {
+    chan[i]=s->chan[i];
+  }
+  lfoValue=s->lfoValue;
+  extMode=s->extMode;
+}
+
+bool DivPlatformGenesis::hasState() {
+  return true;
+}
+
+void* DivPlatformGenesis::getState() {
+  State* s=new State;
+  saveState(s);
+  return s;
+}
+
+void DivPlatformGenesis::setState(void* state) {
+  loadState((State*)state);
+}
+
+void DivPlatformGenesis::freeState(void* state) {
+  delete (State*)state;
+}
+
 float DivPlatformGenesis::getPostAmp() {
   return 2.0f;
 }
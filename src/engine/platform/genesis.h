@@ -86,7 +86,16 @@ class DivPlatformGenesis: public DivPlatformOPN {
     int interruptSimCycles;
   
     unsigned char dacVolTable[128];
+
+    struct State {
+      Channel chan[10];
+      unsigned char lfoValue;
+      bool extMode;
+    };
   
+    void saveState(State* s);
+    void loadState(State* s);
+
     friend void putDispatchChip(void*,int);
     friend void putDispatchChan(void*,int,int);
 
@@ -111,6 +120,10 @@ class DivPlatformGenesis: public DivPlatformOPN {
     virtual int mapVelocity(int ch, float vel);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    bool hasState();
+    void* getState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
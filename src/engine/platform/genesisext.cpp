@@ -848,6 +848,29 @@ int DivPlatformGenesisExt::mapVelocity(int ch, float vel) {
   return DivPlatformGenesis::mapVelocity(ch,vel);
 }
 
+void* DivPlatformGenesisExt::getState() {
+  StateExt* s=new StateExt;
+  saveState(s);
+  for (int i=0; i<4; i++) {
+    s->opChan[i]=opChan[i];
+  }
+  s->lastExtChPan=lastExtChPan;
+  return s;
+}
+
+void DivPlatformGenesisExt::setState(void* state) {
+  StateExt* s=(StateExt*)state;
+  loadState(s);
+  for (int i=0; i<4; i++) {
+    opChan[i]=s->opChan[i];
+  }
+  lastExtChPan=s->lastExtChPan;
+}
+
+void DivPlatformGenesisExt::freeState(void* state) {
+  delete (StateExt*)state;
+}
+
 void DivPlatformGenesisExt::reset() {
   DivPlatformGenesis::reset();
 
@@ -808,6 +808,38 @@ int DivPlatformPCE::getRegisterPoolSize() {
   return 112;
 }
 
+bool DivPlatformPCE::hasState() {
+  return true;
+}
+
+void* DivPlatformPCE::getState() {
+  // copy the channel and LFO state.
+  // the macro interpreters point into their own channel, but that is fine
+  // since the state is only restored into this very dispatch.
+  State* s=new State;
+  for (int i=0; i<6; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->lfoMode=lfoMode;
+  s->lfoSpeed=lfoSpeed;
+  s->updateLFO=updateLFO;
+  return s;
+}
+
+void DivPlatformPCE::setState(void* state) {
+  State* s=(State*)state;
+  for (int i=0; i<6; i++) {
+    chan[i]=s->chan[i];
+  }
+  lfoMode=s->lfoMode;
+  lfoSpeed=s->lfoSpeed;
+  updateLFO=s->updateLFO;
+}
+
+void DivPlatformPCE::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformPCE::reset() {
   // reset everything to initial state.
 
@@ -124,6 +124,14 @@ class DivPlatformPCE: public DivDispatch {
   // regPool contains a copy of all registers so we can display them in the GUI.
   unsigned char regPool[128];
 
+  // playback state, used by the engine for seek checkpoints (see getState()).
+  // the emulator and the register pool are not part of it.
+  struct State {
+    Channel chan[6];
+    unsigned char lfoMode, lfoSpeed;
+    bool updateLFO;
+  };
+
   // private functions.
   void updateWave(int ch);
   // these two were used in the debug window. keep them here just in case.
@@ -144,6 +152,10 @@ class DivPlatformPCE: public DivDispatch {
     float getGain(int ch, int vol);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    void* getState();
+    bool hasState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
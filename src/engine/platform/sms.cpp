@@ -525,6 +525,37 @@ int DivPlatformSMS::getRegisterPoolSize() {
   return stereo?9:8;
 }
 
+bool DivPlatformSMS::hasState() {
+  return true;
+}
+
+void* DivPlatformSMS::getState() {
+  State* s=new State;
+  for (int i=0; i<4; i++) {
+    s->chan[i]=chan[i];
+  }
+  s->lastPan=lastPan;
+  s->oldValue=oldValue;
+  s->snNoiseMode=snNoiseMode;
+  s->updateSNMode=updateSNMode;
+  return s;
+}
+
+void DivPlatformSMS::setState(void* state) {
+  State* s=(State*)state;
+  for (int i=0; i<4; i++) {
+    chan[i]=s->chan[i];
+  }
+  lastPan=s->lastPan;
+  oldValue=s->oldValue;
+  snNoiseMode=s->snNoiseMode;
+  updateSNMode=s->updateSNMode;
+}
+
+void DivPlatformSMS::freeState(void* state) {
+  delete (State*)state;
+}
+
 void DivPlatformSMS::reset() {
   memset(regPool,0,16);
   chanLatch=0;
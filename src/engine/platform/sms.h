@@ -65,6 +65,11 @@ class DivPlatformSMS: public DivDispatch {
   };
   FixedQueue<QueuedWrite,128> writes;
   DivPitchTable tonePitchTable, noisePitchTable;
+  struct State {
+    Channel chan[4];
+    unsigned char lastPan, oldValue, snNoiseMode;
+    bool updateSNMode;
+  };
   friend void putDispatchChip(void*,int);
   friend void putDispatchChan(void*,int,int);
 
@@ -86,6 +91,10 @@ class DivPlatformSMS: public DivDispatch {
     float getGain(int ch, int vol);
     unsigned char* getRegisterPool();
     int getRegisterPoolSize();
+    void* getState();
+    bool hasState();
+    void setState(void* state);
+    void freeState(void* state);
     void reset();
     void forceIns();
     void tick(bool sysTick=true);
@@ -134,6 +134,39 @@ int vic_sound_machine_calculate_samples(sound_vic20_t *snd, int16_t *pbuf, int n
     return s;
 }
 
+/* number of cycles which can be run before any counter reaches zero.
+   no channel output changes before then. */
+uint32_t vic_sound_cycles_to_edge(sound_vic20_t *snd)
+{
+    int j;
+    int ret = 0x7fff;
+
+    for (j = 0; j < 4; j++) {
+        if (snd->ch[j].ctr - 1 < ret) {
+            ret = snd->ch[j].ctr - 1;
+        }
+    }
+    return (ret < 0) ? 0 : (uint32_t)ret;
+}
+
+/* unfiltered output of the cycles run since the last call. */
+int16_t vic_sound_machine_output(sound_vic20_t *snd)
+{
+    float v;
+
+    if (snd->accum_cycles <= 0) {
+        return 0;
+    }
+    v = voltagefunction[(((snd->accum * 7) / snd->accum_cycles) + 1) * snd->volume];
+    snd->accum = 0;
+    snd->accum_cycles = 0;
+
+    if (v > 32767) {
+        return 32767;
+    }
+    return (int16_t)v;
+}
+
 void vic_sound_clock(sound_vic20_t *snd, uint32_t cycles)
 {
     uint32_t i;
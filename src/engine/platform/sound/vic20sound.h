@@ -68,6 +68,8 @@ int vic_sound_machine_init(sound_vic20_t *snd, int speed, int cycles_per_sec, bo
 void vic_sound_machine_store(sound_vic20_t *snd, uint16_t addr, uint8_t value);
 int vic_sound_machine_calculate_samples(sound_vic20_t *snd, int16_t *pbuf, int nr, int soc, int scc, uint32_t delta_t);
 void vic_sound_clock(sound_vic20_t *snd, uint32_t cycles);
+uint32_t vic_sound_cycles_to_edge(sound_vic20_t *snd);
+int16_t vic_sound_machine_output(sound_vic20_t *snd);
 
 #ifdef __cplusplus
 };
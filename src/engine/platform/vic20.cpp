@@ -40,36 +40,38 @@ const char** DivPlatformVIC20::getRegisterSheet() {
   return regCheatSheetVIC;
 }
 
-void DivPlatformVIC20::acquire(short** buf, size_t len) {
+void DivPlatformVIC20::runWaveWrite() {
   const unsigned char loadFreq[3] = {0x7e, 0x7d, 0x7b};
   const unsigned char wavePatterns[16] = {
     0b0,     0b10,    0b100,   0b110,   0b1000,  0b1010,   0b1011,   0b1110,
     0b10010, 0b10100, 0b10110, 0b11000, 0b11010, 0b100100, 0b101010, 0b101100
   };
 
+  hasWaveWrite=false;
+  for (int i=0; i<3; i++) {
+    if (chan[i].waveWriteCycle>=0) {
+      if (chan[i].waveWriteCycle>=16*7) {
+        // empty shift register first
+        rWrite(10+i,126);
+      } else if (chan[i].waveWriteCycle>=16) {
+        unsigned bit=8-(chan[i].waveWriteCycle/16);
+        rWrite(10+i,loadFreq[i]|((wavePatterns[chan[i].wave]<<bit)&0x80));
+      } else {
+        rWrite(10+i,255-chan[i].freq);
+      }
+      chan[i].waveWriteCycle-=SAMP_DIVIDER;
+      hasWaveWrite=true;
+    }
+  }
+}
+
+void DivPlatformVIC20::acquire(short** buf, size_t len) {
   for (int i=0; i<4; i++) {
     oscBuf[i]->begin(len);
   }
 
   for (size_t h=0; h<len; h++) {
-    if (hasWaveWrite) {
-      hasWaveWrite=false;
-      for (int i=0; i<3; i++) {
-        if (chan[i].waveWriteCycle>=0) {
-          if (chan[i].waveWriteCycle>=16*7) {
-            // empty shift register first
-            rWrite(10+i,126);
-          } else if (chan[i].waveWriteCycle>=16) {
-            unsigned bit=8-(chan[i].waveWriteCycle/16);
-            rWrite(10+i,loadFreq[i]|((wavePatterns[chan[i].wave]<<bit)&0x80));
-          } else {
-            rWrite(10+i,255-chan[i].freq);
-          }
-          chan[i].waveWriteCycle-=SAMP_DIVIDER;
-          hasWaveWrite=true;
-        }
-      }
-    }
+    if (hasWaveWrite) runWaveWrite();
     short samp;
     vic_sound_machine_calculate_samples(vic,&samp,1,1,0,SAMP_DIVIDER);
     buf[0][h]=samp;
@@ -83,6 +85,46 @@ void DivPlatformVIC20::acquire(short** buf, size_t len) {
   }
 }
 
+// used when the filter is off.
+// the output only changes when a counter runs out, so we run the chip until then and only
+// send the changes to blip_buf.
+void DivPlatformVIC20::acquireDirect(blip_buffer_t** bb, size_t len) {
+  for (int i=0; i<4; i++) {
+    oscBuf[i]->begin(len);
+  }
+
+  for (size_t h=0; h<len; h++) {
+    int advance=1;
+    if (hasWaveWrite) {
+      runWaveWrite();
+    } else {
+      advance=vic_sound_cycles_to_edge(vic)/SAMP_DIVIDER;
+      if (advance>(int)(len-h)) advance=len-h;
+      if (advance<1) advance=1;
+    }
+
+    vic_sound_clock(vic,advance*SAMP_DIVIDER);
+    int out=vic_sound_machine_output(vic);
+    if (out!=lastOut) {
+      blip_add_delta(bb[0],h,out-lastOut);
+      lastOut=out;
+    }
+    for (int i=0; i<4; i++) {
+      oscBuf[i]->putSample(h,vic->ch[i].out?(vic->volume<<11):0);
+    }
+
+    h+=advance-1;
+  }
+
+  for (int i=0; i<4; i++) {
+    oscBuf[i]->end(len);
+  }
+}
+
+bool DivPlatformVIC20::hasAcquireDirect() {
+  return filterOff;
+}
+
 void DivPlatformVIC20::calcAndWriteOutVol(int ch, int env) {
   chan[ch].outVol=MIN(chan[ch].vol*env/15,15);
   writeOutVol(ch);
@@ -334,6 +376,7 @@ void DivPlatformVIC20::reset() {
   }
   vic_sound_machine_init(vic,rate,chipClock,filterOff);
   hasWaveWrite=false;
+  lastOut=0;
   rWrite(14,15);
   // hack: starting noise channel right away after this would result in a dead
   // channel as the LFSR state is 0, so clock it a bit
@@ -39,14 +39,17 @@ class DivPlatformVIC20: public DivDispatch {
   bool isMuted[4];
   bool hasWaveWrite;
   bool filterOff;
+  int lastOut;
 
   unsigned char regPool[16];
   sound_vic20_t* vic;
   void updateWave(int ch);
+  void runWaveWrite();
   friend void putDispatchChip(void*,int);
   friend void putDispatchChan(void*,int,int);
   public:
     void acquire(short** buf, size_t len);
+    void acquireDirect(blip_buffer_t** bb, size_t len);
     int dispatch(DivCommand c);
     bool isVolGlobal();
     SharedChannel* getChanState(int chan);
@@ -66,6 +69,7 @@ class DivPlatformVIC20: public DivDispatch {
     void poke(unsigned int addr, unsigned short val);
     void poke(std::vector<DivRegWrite>& wlist);
     const char** getRegisterSheet();
+    bool hasAcquireDirect();
     int init(DivEngine* parent, int channels, int sugRate, const DivConfig& flags);
     void quit();
     ~DivPlatformVIC20();
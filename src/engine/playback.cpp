@@ -28,6 +28,7 @@
 #include "dispatch.h"
 #include "engine.h"
 #include "workPool.h"
+#include "mixKernel.h"
 #include "../ta-log.h"
 #include <math.h>
 
@@ -505,31 +506,41 @@ int DivEngine::dispatchCmd(DivCommand c) {
   // c.dis is a copy of c.chan because we'll use it in the next call
   c.chan=song.dispatchChanOfChan[c.dis];
 
+  // during per-channel export, mirror the command to the stems of this chip.
+  // their return values are ignored.
+  for (DivExportStem* i: exportStems) {
+    if (i->sys==song.dispatchOfChan[c.dis]) i->cont.dispatch->dispatch(c);
+  }
+
   // dispatch command to chip dispatch
   return disCont[song.dispatchOfChan[c.dis]].dispatch->dispatch(c);
 }
 
+// maps the effect value using the handler's functions.
+// returns false if the handler refuses the value.
+static inline bool mapEffectVal(const EffectHandler* handler, unsigned char effect, unsigned char effectVal, int& val, int& val2) {
+  val=handler->val?handler->val(effect,effectVal):effectVal;
+  if (val==DIV_EFFECT_UNHANDLED) return false;
+  val2=handler->val2?handler->val2(effect,effectVal):0;
+  if (val2==DIV_EFFECT_UNHANDLED) return false;
+  return true;
+}
+
 // this function handles per-chip normal effects
 bool DivEngine::perSystemEffect(int ch, unsigned char effect, unsigned char effectVal) {
   // don't process invalid chips
   DivSysDef* sysDef=sysDefs[song.sysOfChan[ch]];
   if (sysDef==NULL) return false;
   // find the effect handler
-  auto iter=sysDef->effectHandlers.find(effect);
-  if (iter==sysDef->effectHandlers.end()) return false;
-  EffectHandler handler=iter->second;
+  const EffectHandler* handler=sysDef->effectTable[effect];
+  if (handler==NULL) return false;
   int val=0;
   int val2=0;
   // map values using the handler's function
-  try {
-    val=handler.val?handler.val(effect,effectVal):effectVal;
-    val2=handler.val2?handler.val2(effect,effectVal):0;
-  } catch (DivDoNotHandleEffect& e) {
-    return false;
-  }
+  if (!mapEffectVal(handler,effect,effectVal,val,val2)) return false;
   // dispatch command
   // wouldn't this cause problems if it were to return 0?
-  return dispatchCmd(DivCommand(handler.dispatchCmd,ch,val,val2));
+  return dispatchCmd(DivCommand(handler->dispatchCmd,ch,val,val2));
 }
 
 // this handles per-chip post effects...
@@ -538,40 +549,28 @@ bool DivEngine::perSystemPostEffect(int ch, unsigned char effect, unsigned char
   DivSysDef* sysDef=sysDefs[song.sysOfChan[ch]];
   if (sysDef==NULL) return false;
   // find the effect handler
-  auto iter=sysDef->postEffectHandlers.find(effect);
-  if (iter==sysDef->postEffectHandlers.end()) return false;
-  EffectHandler handler=iter->second;
+  const EffectHandler* handler=sysDef->postEffectTable[effect];
+  if (handler==NULL) return false;
   int val=0;
   int val2=0;
   // map values using the handler's function
-  try {
-    val=handler.val?handler.val(effect,effectVal):effectVal;
-    val2=handler.val2?handler.val2(effect,effectVal):0;
-  } catch (DivDoNotHandleEffect& e) {
-    return true;
-  }
+  if (!mapEffectVal(handler,effect,effectVal,val,val2)) return true;
   // dispatch command
   // wouldn't this cause problems if it were to return 0?
-  return dispatchCmd(DivCommand(handler.dispatchCmd,ch,val,val2));
+  return dispatchCmd(DivCommand(handler->dispatchCmd,ch,val,val2));
 }
 
 // ...and this handles chip pre-effects
 bool DivEngine::perSystemPreEffect(int ch, unsigned char effect, unsigned char effectVal) {
   DivSysDef* sysDef=sysDefs[song.sysOfChan[ch]];
   if (sysDef==NULL) return false;
-  auto iter=sysDef->preEffectHandlers.find(effect);
-  if (iter==sysDef->preEffectHandlers.end()) return false;
-  EffectHandler handler=iter->second;
+  const EffectHandler* handler=sysDef->preEffectTable[effect];
+  if (handler==NULL) return false;
   int val=0;
   int val2=0;
-  try {
-    val=handler.val?handler.val(effect,effectVal):effectVal;
-    val2=handler.val2?handler.val2(effect,effectVal):0;
-  } catch (DivDoNotHandleEffect& e) {
-    return false;
-  }
+  if (!mapEffectVal(handler,effect,effectVal,val,val2)) return false;
   // wouldn't this cause problems if it were to return 0?
-  return dispatchCmd(DivCommand(handler.dispatchCmd,ch,val,val2));
+  return dispatchCmd(DivCommand(handler->dispatchCmd,ch,val,val2));
 }
 
 // this is called by nextRow() before it calls processRow()
@@ -580,6 +579,8 @@ void DivEngine::processRowPre(int i) {
   int whatOrder=curOrder;
   int whatRow=curRow;
   DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
+  // while seeking, skip rows without effects
+  if (skipping && seekRowFlags && !(pat->getRowFlags(whatRow)&DIV_ROW_FX)) return;
   // check all effects
   for (int j=0; j<curPat[i].effectCols; j++) {
     short effect=pat->newData[whatRow][DIV_PAT_FX(j)];
@@ -610,6 +611,10 @@ void DivEngine::processRow(int i, bool afterDelay) {
   int whatOrder=afterDelay?chan[i].delayOrder:curOrder;
   int whatRow=afterDelay?chan[i].delayRow:curRow;
   DivPattern* pat=curPat[i].getPattern(curOrders->ord[i][whatOrder],false);
+  // while seeking, rows without effects skip the effect loops.
+  // the row summary isn't used during normal playback, as the pattern may be written to at the same time.
+  int fxCols=curPat[i].effectCols;
+  if (skipping && seekRowFlags && !(pat->getRowFlags(whatRow)&DIV_ROW_FX)) fxCols=0;
   // pre effects
   // these include song control ones such as speed, tempo or jumps which shall not be delayed
   // it also includes EDxx (delay) itself so we can handle it
@@ -617,7 +622,7 @@ void DivEngine::processRow(int i, bool afterDelay) {
     // set to true if we found an EDxx effect
     bool returnAfterPre=false;
     // check all effects
-    for (int j=0; j<curPat[i].effectCols; j++) {
+    for (int j=0; j<fxCols; j++) {
       short effect=pat->newData[whatRow][DIV_PAT_FX(j)];
       short effectVal=pat->newData[whatRow][DIV_PAT_FXVAL(j)];
 
@@ -867,7 +872,7 @@ void DivEngine::processRow(int i, bool afterDelay) {
   int volPortaTarget=-1;
   bool noApplyVolume=false;
   // here we read all effects and check for a volume slide with target/volume "portamento"/"scivolando" (a term I invented as an equivalent)
-  for (int j=0; j<curPat[i].effectCols; j++) {
+  for (int j=0; j<fxCols; j++) {
     short effect=pat->newData[whatRow][DIV_PAT_FX(j)];
     if (effect==0xd3 || effect==0xd4) { // vol porta
       volPortaTarget=pat->newData[whatRow][DIV_PAT_VOL]<<8; // can be -256
@@ -911,7 +916,7 @@ void DivEngine::processRow(int i, bool afterDelay) {
   bool sampleOffSet=false;
 
   // effects
-  for (int j=0; j<curPat[i].effectCols; j++) {
+  for (int j=0; j<fxCols; j++) {
     short effect=pat->newData[whatRow][DIV_PAT_FX(j)];
     short effectVal=pat->newData[whatRow][DIV_PAT_FXVAL(j)];
 
@@ -1676,7 +1681,7 @@ void DivEngine::processRow(int i, bool afterDelay) {
   chan[i].noteOnInhibit=false;
 
   // post effects
-  for (int j=0; j<curPat[i].effectCols; j++) {
+  for (int j=0; j<fxCols; j++) {
     short effect=pat->newData[whatRow][DIV_PAT_FX(j)];
     short effectVal=pat->newData[whatRow][DIV_PAT_FXVAL(j)];
 
@@ -2602,6 +2607,7 @@ bool DivEngine::nextTick(bool noAccum, bool inhibitLowLat) {
 
   // tick all chip dispatches (the argument determines whether it is a system tick or a sub-tick)
   for (int i=0; i<song.systemLen; i++) disCont[i].dispatch->tick(subticks==tickMult);
+  for (DivExportStem* i: exportStems) i->cont.dispatch->tick(subticks==tickMult);
 
   // update playback time
   if (!freelance) {
@@ -2802,13 +2808,170 @@ void DivEngine::runMidiTime(int totalCycles) {
   }
 }
 
-// these two functions are either leftovers or something or they are there for test purposes.
-// I don't remember very well.
+// acquire and fillBuf with timing, used during benchmark.
+static void _runDispatchTimed(DivDispatchContainer* dc, int total) {
+  std::chrono::steady_clock::time_point ts_begin=std::chrono::steady_clock::now();
+  dc->acquire(total);
+  std::chrono::steady_clock::time_point ts_acquired=std::chrono::steady_clock::now();
+  dc->fillBuf(total,dc->runPos,dc->cycles);
+  std::chrono::steady_clock::time_point ts_end=std::chrono::steady_clock::now();
+
+  dc->acquireTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_acquired-ts_begin).count();
+  dc->fillTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_end-ts_acquired).count();
+  dc->acquired+=total;
+  dc->rendered+=dc->cycles;
+}
+
+// render tasks for the thread pool.
+// _runDispatch1 runs a dispatch until the next tick, and _runDispatch2 runs it until the end of the audio buffer.
 void _runDispatch1(void* d) {
+  DivDispatchContainer* dc=(DivDispatchContainer*)d;
+
+  int lastAvail=dc->samplesAvail();
+  if (lastAvail>0) {
+    if (lastAvail>=dc->cycles) {
+      dc->flush(dc->runPos,dc->cycles);
+      dc->runPos+=dc->cycles;
+      return;
+    } else {
+      dc->flush(dc->runPos,lastAvail);
+      dc->runPos+=lastAvail;
+      dc->cycles-=lastAvail;
+    }
+  }
+
+  // if the buffer is too small, resize it
+  int total=dc->clocksNeeded(dc->cycles);
+  if (total>(int)dc->bbInLen) {
+    logD("growing dispatch %p bbIn to %d",(void*)dc,total+256);
+    dc->grow(total+256);
+  }
+  if (dc->timed) {
+    _runDispatchTimed(dc,total);
+  } else {
+    dc->acquire(total);
+    dc->fillBuf(total,dc->runPos,dc->cycles);
+  }
+  // advance run position
+  dc->runPos+=dc->cycles;
 }
 
 void _runDispatch2(void* d) {
+  DivDispatchContainer* dc=(DivDispatchContainer*)d;
 
+  int lastAvail=dc->samplesAvail();
+  if (lastAvail>0) {
+    if (lastAvail>=dc->cycles) {
+      dc->flush(dc->runPos,dc->cycles);
+      dc->runPos+=dc->cycles;
+      return;
+    } else {
+      dc->flush(dc->runPos,lastAvail);
+      dc->runPos+=lastAvail;
+      dc->cycles-=lastAvail;
+    }
+  }
+
+  int total=dc->clocksNeeded(dc->cycles);
+  if (total>(int)dc->bbInLen) {
+    logD("growing dispatch %p bbIn to %d",(void*)dc,total+256);
+    dc->grow(total+256);
+  }
+  if (dc->timed) {
+    _runDispatchTimed(dc,total);
+  } else {
+    dc->acquire(total);
+    dc->fillBuf(total,dc->runPos,dc->cycles);
+  }
+}
+
+float DivEngine::getChipOutputVol(int sys, unsigned char destSubPort) {
+  float vol=song.systemVol[sys]*disCont[sys].dispatch->getPostAmp()*song.masterVol;
+
+  // apply panning
+  switch (destSubPort&3) {
+    case 0:
+      vol*=MIN(1.0f,1.0f-song.systemPan[sys])*MIN(1.0f,1.0f+song.systemPanFR[sys]);
+      break;
+    case 1:
+      vol*=MIN(1.0f,1.0f+song.systemPan[sys])*MIN(1.0f,1.0f+song.systemPanFR[sys]);
+      break;
+    case 2:
+      vol*=MIN(1.0f,1.0f-song.systemPan[sys])*MIN(1.0f,1.0f-song.systemPanFR[sys]);
+      break;
+    case 3:
+      vol*=MIN(1.0f,1.0f+song.systemPan[sys])*MIN(1.0f,1.0f-song.systemPanFR[sys]);
+      break;
+  }
+  return vol;
+}
+
+void DivEngine::updateMixGains(int outChans, float refPlayerVol) {
+  // check whether anything changed since the last time
+  bool changed=false;
+  size_t keyPos=0;
+  auto checkKey=[this,&changed,&keyPos](float val) {
+    if (keyPos>=mixGainKey.size()) {
+      mixGainKey.push_back(val);
+      changed=true;
+    } else if (mixGainKey[keyPos]!=val) {
+      mixGainKey[keyPos]=val;
+      changed=true;
+    }
+    keyPos++;
+  };
+
+  checkKey(outChans);
+  checkKey(song.systemLen);
+  checkKey(song.masterVol);
+  checkKey(refPlayerVol);
+  for (int i=0; i<song.systemLen; i++) {
+    checkKey(song.systemVol[i]);
+    checkKey(song.systemPan[i]);
+    checkKey(song.systemPanFR[i]);
+    checkKey(disCont[i].dispatch->getPostAmp());
+    checkKey(disCont[i].dispatch->getOutputCount());
+  }
+  if (keyPos!=mixGainKey.size()) {
+    mixGainKey.resize(keyPos);
+    changed=true;
+  }
+  if (mixGainPatchbay!=song.patchbay) {
+    mixGainPatchbay=song.patchbay;
+    changed=true;
+  }
+
+  if (!changed) return;
+
+  // compile the chip connections
+  mixGains.clear();
+  for (unsigned int i: song.patchbay) {
+    const unsigned short srcPort=i>>16;
+    const unsigned short destPort=i&0xffff;
+
+    const unsigned short srcPortSet=srcPort>>4;
+    const unsigned char srcSubPort=srcPort&15;
+    const unsigned char destSubPort=destPort&15;
+
+    if ((destPort>>4)!=0x000) continue;
+    if (destSubPort>=outChans) continue;
+    if (srcPortSet>=song.systemLen) continue;
+    if (srcSubPort>=disCont[srcPortSet].dispatch->getOutputCount()) continue;
+
+    // this also converts the chip output to float
+    float gain=getChipOutputVol(srcPortSet,destSubPort)*refPlayerVol/32768.0f;
+
+    // merge duplicate connections
+    bool merged=false;
+    for (DivMixGain& j: mixGains) {
+      if (j.sys==srcPortSet && j.srcSubPort==srcSubPort && j.destSubPort==destSubPort) {
+        j.gain+=gain;
+        merged=true;
+        break;
+      }
+    }
+    if (!merged) mixGains.push_back(DivMixGain(srcPortSet,srcSubPort,destSubPort,gain));
+  }
 }
 
 // this fills the audio buffer and runs tbe engine.
@@ -2833,25 +2996,47 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     }
   }
 
-  // check the mutex.
-  // soft-locking happens when synchronizedSoft is called.
-  if (softLocked) {
-    // in this case we just return
-    if (!isBusy.try_lock()) {
-      logV("audio is soft-locked (%d)",softLockCount++);
-      return;
-    }
-  } else {
-    isBusy.lock();
+  // check whether the engine is locked.
+  // soft-locking happens when synchronizedSoft is called. in this case we just return,
+  // unless exporting (which has to render every buffer).
+  if (!enterAudio(exporting)) {
+    logV("audio is soft-locked (%d)",softLockCount++);
+    return;
   }
   got.bufsize=size;
 
+  // apply pending edits
+  if (!editQueue.empty()) {
+    editQueue.apply();
+  }
+
   // this is used to calculate audio load
   std::chrono::steady_clock::time_point ts_processBegin=std::chrono::steady_clock::now();
 
+  // stage times are measured during benchmark (see benchmarkRun()) and while profiling
+  bool profiling=profiler.isEnabled();
+  bool timed=benchTimed || profiling;
+  std::chrono::steady_clock::time_point ts_stage=ts_processBegin;
+  if (profiling) {
+    profiler.begin(size,(unsigned int)(1000000000.0*(double)size/got.rate));
+    if (!benchTimed) {
+      for (int i=0; i<song.systemLen; i++) {
+        disCont[i].timed=true;
+      }
+    }
+  } else if (profilingChips) {
+    // profiling was just turned off
+    if (!benchTimed) {
+      for (int i=0; i<song.systemLen; i++) {
+        disCont[i].timed=false;
+      }
+    }
+  }
+  profilingChips=profiling;
+
   // set up the render thread pool
   if (renderPool==NULL) {
-    unsigned int howManyThreads=song.systemLen;
+    unsigned int howManyThreads=song.systemLen+exportStems.size();
     if (howManyThreads<2) howManyThreads=0;
     if (howManyThreads>renderPoolThreads) howManyThreads=renderPoolThreads;
     renderPool=new DivWorkPool(howManyThreads);
@@ -2935,6 +3120,12 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     //logD("%.2x",msg.type);
     output->midiIn->queue.pop();
   }
+
+  if (profiling) {
+    std::chrono::steady_clock::time_point ts_now=std::chrono::steady_clock::now();
+    profiler.addStage(DIV_PROFILE_MIDI,std::chrono::duration_cast<std::chrono::nanoseconds>(ts_now-ts_stage).count());
+    ts_stage=ts_now;
+  }
   
   // process sample/wave preview (not during audio export)
   if (((sPreview.sample>=0 && sPreview.sample<(int)song.sample.size()) || (sPreview.wave>=0 && sPreview.wave<(int)song.wave.size())) && !exporting) {
@@ -3092,14 +3283,31 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     memset(samp_bbOut,0,size*sizeof(short));
   }
 
+  if (profiling) {
+    std::chrono::steady_clock::time_point ts_now=std::chrono::steady_clock::now();
+    profiler.addStage(DIV_PROFILE_PREVIEW,std::chrono::duration_cast<std::chrono::nanoseconds>(ts_now-ts_stage).count());
+    ts_stage=ts_now;
+  }
+
   // process audio (run the engine)
+  // time spent in nextTick() and the MIDI clock is subtracted from the render time
+  uint64_t tickTime=0;
+  uint64_t midiClockTime=0;
+  if (benchTimed) ts_stage=std::chrono::steady_clock::now();
   bool mustPlay=playing && !halted;
   if (mustPlay) {
     // logic starts here
+    // keep the render threads awake until the buffer is filled.
+    // there is a wait for every tick, and waking threads up each time is expensive.
+    if (renderPoolBurst) renderPool->beginBurst();
+
     // first reset the run position of all dispatches
     for (int i=0; i<song.systemLen; i++) {
       disCont[i].runPos=0;
     }
+    for (DivExportStem* i: exportStems) {
+      i->cont.runPos=0;
+    }
 
     // resize the metronome tick buffer if necessary
     if (metroTickLen<size) {
@@ -3128,7 +3336,15 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       // 2. check whether we gonna tick
       if (cycles<=0) {
         // we have to tick
-        if (nextTick()) {
+        bool songEnded;
+        if (timed) {
+          std::chrono::steady_clock::time_point ts_tickBegin=std::chrono::steady_clock::now();
+          songEnded=nextTick();
+          tickTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ts_tickBegin).count();
+        } else {
+          songEnded=nextTick();
+        }
+        if (songEnded) {
           /*totalTicks=0;
           totalSeconds=0;*/
           // used by audio export to determine how many samples to write (otherwise it'll add silence at the end)
@@ -3172,10 +3388,19 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
         // we don't have to tick yet. run chip dispatches.
         // 3. run MIDI clock
         int midiTotal=MIN(cycles,runLeftG);
-        runMidiClock(midiTotal);
+        if (profiling) {
+          std::chrono::steady_clock::time_point ts_midiBegin=std::chrono::steady_clock::now();
+          runMidiClock(midiTotal);
 
-        // 4. run MIDI timecode
-        runMidiTime(midiTotal);
+          // 4. run MIDI timecode
+          runMidiTime(midiTotal);
+          midiClockTime+=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ts_midiBegin).count();
+        } else {
+          runMidiClock(midiTotal);
+
+          // 4. run MIDI timecode
+          runMidiTime(midiTotal);
+        }
 
         // 5. tick the clock and fill buffers as needed
         // check which is nearest: a tick or end of audio buffer
@@ -3185,33 +3410,12 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
           for (int i=0; i<song.systemLen; i++) {
             disCont[i].cycles=cycles;
             disCont[i].size=size;
-            renderPool->push([](void* d) {
-              DivDispatchContainer* dc=(DivDispatchContainer*)d;
-
-              int lastAvail=blip_samples_avail(dc->bb[0]);
-              if (lastAvail>0) {
-                if (lastAvail>=dc->cycles) {
-                  dc->flush(dc->runPos,dc->cycles);
-                  dc->runPos+=dc->cycles;
-                  return;
-                } else {
-                  dc->flush(dc->runPos,lastAvail);
-                  dc->runPos+=lastAvail;
-                  dc->cycles-=lastAvail;
-                }
-              }
-              
-              // if the buffer is too small, resize it
-              int total=blip_clocks_needed(dc->bb[0],dc->cycles);
-              if (total>(int)dc->bbInLen) {
-                logD("growing dispatch %p bbIn to %d",(void*)dc,total+256);
-                dc->grow(total+256);
-              }
-              dc->acquire(total);
-              dc->fillBuf(total,dc->runPos,dc->cycles);
-              // advance run position
-              dc->runPos+=dc->cycles;
-            },&disCont[i]);
+            renderPool->push(_runDispatch1,&disCont[i]);
+          }
+          for (DivExportStem* i: exportStems) {
+            i->cont.cycles=cycles;
+            i->cont.size=size;
+            renderPool->push(_runDispatch1,&i->cont);
           }
           renderPool->wait();
           runLeftG-=cycles;
@@ -3222,30 +3426,11 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
           cycles-=runLeftG;
           for (int i=0; i<song.systemLen; i++) {
             disCont[i].cycles=runLeftG;
-            renderPool->push([](void* d) {
-              DivDispatchContainer* dc=(DivDispatchContainer*)d;
-
-              int lastAvail=blip_samples_avail(dc->bb[0]);
-              if (lastAvail>0) {
-                if (lastAvail>=dc->cycles) {
-                  dc->flush(dc->runPos,dc->cycles);
-                  dc->runPos+=dc->cycles;
-                  return;
-                } else {
-                  dc->flush(dc->runPos,lastAvail);
-                  dc->runPos+=lastAvail;
-                  dc->cycles-=lastAvail;
-                }
-              }
-
-              int total=blip_clocks_needed(dc->bb[0],dc->cycles);
-              if (total>(int)dc->bbInLen) {
-                logD("growing dispatch %p bbIn to %d",(void*)dc,total+256);
-                dc->grow(total+256);
-              }
-              dc->acquire(total);
-              dc->fillBuf(total,dc->runPos,dc->cycles);
-            },&disCont[i]);
+            renderPool->push(_runDispatch2,&disCont[i]);
+          }
+          for (DivExportStem* i: exportStems) {
+            i->cont.cycles=runLeftG;
+            renderPool->push(_runDispatch2,&i->cont);
           }
           // at this point runLeftG will be zero and we can break out of the loop
           runLeftG=0;
@@ -3280,6 +3465,25 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       },&disCont[i]);*/
     }
     renderPool->wait();
+    renderPool->endBurst();
+  }
+
+  if (timed) {
+    std::chrono::steady_clock::time_point ts_now=std::chrono::steady_clock::now();
+    uint64_t renderTime=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_now-ts_stage).count()-tickTime;
+    if (benchTimed) {
+      benchStats.tick+=tickTime;
+      benchStats.render+=renderTime;
+    }
+    if (profiling) {
+      profiler.addStage(DIV_PROFILE_TICK,tickTime);
+      profiler.addStage(DIV_PROFILE_MIDI,midiClockTime);
+      profiler.addStage(DIV_PROFILE_RENDER,renderTime-midiClockTime);
+      for (int i=0; i<song.systemLen; i++) {
+        profiler.setChip(i,disCont[i].acquireTime,disCont[i].fillTime);
+      }
+    }
+    ts_stage=ts_now;
   }
 
   // process file player
@@ -3299,6 +3503,12 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     }
   }
 
+  if (profiling) {
+    std::chrono::steady_clock::time_point ts_now=std::chrono::steady_clock::now();
+    profiler.addStage(DIV_PROFILE_FILE_PLAYER,std::chrono::duration_cast<std::chrono::nanoseconds>(ts_now-ts_stage).count());
+    ts_stage=ts_now;
+  }
+
   // process metronome
   // resize the metronome's audio buffer if necessary
   if (metroBufLen<size || metroBuf==NULL) {
@@ -3336,6 +3546,12 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     }
   }
 
+  if (profiling) {
+    std::chrono::steady_clock::time_point ts_now=std::chrono::steady_clock::now();
+    profiler.addStage(DIV_PROFILE_METRONOME,std::chrono::duration_cast<std::chrono::nanoseconds>(ts_now-ts_stage).count());
+    ts_stage=ts_now;
+  }
+
   // calculate volume of reference file player (so we can attenuate the rest according to the mix slider)
   // -1 to 0: player volume goes from 0% to 100%
   // 0 to +1: tracker volume goes from 100% to 0%
@@ -3350,6 +3566,16 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
   }
 
   // now mix everything (resolve patchbay)
+  // chip outputs go through the compiled patchbay
+  if (playing && !halted) {
+    updateMixGains(outChans,refPlayerVol);
+    for (const DivMixGain& i: mixGains) {
+      const short* src=disCont[i.sys].bbOut[i.srcSubPort];
+      if (src==NULL) continue;
+      mixShortToFloat(out[i.destSubPort],src,i.gain,size);
+    }
+  }
+
   for (unsigned int i: song.patchbay) {
     // there are 4096 portsets. each portset may have up to 16 outputs (subports).
     const unsigned short srcPort=i>>16;
@@ -3367,46 +3593,16 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     if (destPortSet==0x000) {
       if (destSubPort>=outChans) continue;
 
-      // chip outputs
-      if (srcPortSet<song.systemLen && playing && !halted) {
-        if (srcSubPort<disCont[srcPortSet].dispatch->getOutputCount()) {
-          float vol=song.systemVol[srcPortSet]*disCont[srcPortSet].dispatch->getPostAmp()*song.masterVol*refPlayerVol;
-
-          // apply volume and panning
-          switch (destSubPort&3) {
-            case 0:
-              vol*=MIN(1.0f,1.0f-song.systemPan[srcPortSet])*MIN(1.0f,1.0f+song.systemPanFR[srcPortSet]);
-              break;
-            case 1:
-              vol*=MIN(1.0f,1.0f+song.systemPan[srcPortSet])*MIN(1.0f,1.0f+song.systemPanFR[srcPortSet]);
-              break;
-            case 2:
-              vol*=MIN(1.0f,1.0f-song.systemPan[srcPortSet])*MIN(1.0f,1.0f-song.systemPanFR[srcPortSet]);
-              break;
-            case 3:
-              vol*=MIN(1.0f,1.0f+song.systemPan[srcPortSet])*MIN(1.0f,1.0f-song.systemPanFR[srcPortSet]);
-              break;
-          }
-
-          for (size_t j=0; j<size; j++) {
-            out[destSubPort][j]+=((float)disCont[srcPortSet].bbOut[srcSubPort][j]/32768.0)*vol;
-          }
-        }
-      } else if (srcPortSet==0xffc) {
+      // chip outputs were mixed above
+      if (srcPortSet==0xffc) {
         // file player
-        for (size_t j=0; j<size; j++) {
-          out[destSubPort][j]+=filePlayerBuf[srcSubPort][j];
-        }
+        mixFloat(out[destSubPort],filePlayerBuf[srcSubPort],1.0f,size);
       } else if (srcPortSet==0xffd) {
         // sample preview
-        for (size_t j=0; j<size; j++) {
-          out[destSubPort][j]+=previewVol*(samp_bbOut[j]/32768.0);
-        }
+        mixShortToFloat(out[destSubPort],samp_bbOut,previewVol/32768.0f,size);
       } else if (srcPortSet==0xffe && playing && !halted) {
         // metronome
-        for (size_t j=0; j<size; j++) {
-          out[destSubPort][j]+=metroBuf[j];
-        }
+        mixFloat(out[destSubPort],metroBuf,1.0f,size);
       }
 
       // nothing/invalid
@@ -3415,14 +3611,28 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     // nothing/invalid
   }
 
+  if (timed) {
+    std::chrono::steady_clock::time_point ts_now=std::chrono::steady_clock::now();
+    uint64_t mixTime=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_now-ts_stage).count();
+    if (benchTimed) benchStats.mix+=mixTime;
+    if (profiling) profiler.addStage(DIV_PROFILE_MIX,mixTime);
+    ts_stage=ts_now;
+  }
+
   // dump to oscillator buffer (a ring buffer)
-  for (unsigned int i=0; i<size; i++) {
-    for (int j=0; j<outChans; j++) {
-      if (oscBuf[j]==NULL) continue;
+  // readers on other threads check oscClaim to find out whether we've written over what they read
+  unsigned int oscPrevSeq=oscSeq.load(std::memory_order_relaxed);
+  oscClaim.store(oscPrevSeq+size,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (int j=0; j<outChans; j++) {
+    if (oscBuf[j]==NULL) continue;
+    unsigned int oscWritePos=oscPrevSeq&0x7fff;
+    for (unsigned int i=0; i<size; i++) {
       oscBuf[j][oscWritePos]=out[j][i];
+      oscWritePos=(oscWritePos+1)&0x7fff;
     }
-    if (++oscWritePos>=32768) oscWritePos=0;
   }
+  oscSeq.store(oscPrevSeq+size,std::memory_order_release);
   oscSize=size;
 
   // get per-chip peaks
@@ -3475,6 +3685,12 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
     }
   }
 
+  if (timed) {
+    uint64_t oscTime=std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ts_stage).count();
+    if (benchTimed) benchStats.osc+=oscTime;
+    if (profiling) profiler.addStage(DIV_PROFILE_OSC,oscTime);
+  }
+
   // clamp output (if enabled)
   if (clampSamples) {
     for (size_t i=0; i<size; i++) {
@@ -3484,10 +3700,19 @@ void DivEngine::nextBuf(float** in, float** out, int inChans, int outChans, unsi
       }
     }
   }
-  isBusy.unlock();
+  audioInside.store(false);
+  audioPasses++;
 
   std::chrono::steady_clock::time_point ts_processEnd=std::chrono::steady_clock::now();
 
   // this is shown in the GUI as audio load
   processTime=std::chrono::duration_cast<std::chrono::nanoseconds>(ts_processEnd-ts_processBegin).count();
+  if (benchTimed) {
+    benchStats.total+=processTime;
+    benchStats.samples+=size;
+  }
+  if (profiling) {
+    profiler.addStage(DIV_PROFILE_TOTAL,processTime);
+    profiler.end(song.systemLen);
+  }
 }
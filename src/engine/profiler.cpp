@@ -0,0 +1,219 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "profiler.h"
+#include <string.h>
+
+static const char* stageNames[DIV_PROFILE_STAGE_MAX]={
+  "tick",
+  "MIDI",
+  "preview",
+  "render",
+  "file player",
+  "metronome",
+  "mix",
+  "oscilloscope",
+  "total"
+};
+
+static inline int bucketOf(unsigned int ns) {
+  int ret=0;
+  while (ns>>=1) ret++;
+  return ret;
+}
+
+void DivProfiler::count1(int slot, unsigned int ns) {
+  // only the audio thread writes, so there's no need for fetch_add
+  std::atomic<unsigned int>& b=hist[slot][bucketOf(ns)];
+  b.store(b.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+  sum[slot].store(sum[slot].load(std::memory_order_relaxed)+ns,std::memory_order_relaxed);
+}
+
+void DivProfiler::clear() {
+  for (int i=0; i<DIV_PROFILE_SLOTS; i++) {
+    for (int j=0; j<DIV_PROFILE_BUCKETS; j++) {
+      hist[i][j].store(0,std::memory_order_relaxed);
+    }
+    sum[i].store(0,std::memory_order_relaxed);
+    blame[i].store(0,std::memory_order_relaxed);
+  }
+  count.store(0,std::memory_order_relaxed);
+  overruns.store(0,std::memory_order_relaxed);
+}
+
+void DivProfiler::enable(bool on) {
+  enabled.store(on,std::memory_order_relaxed);
+}
+
+bool DivProfiler::isEnabled() {
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void DivProfiler::reset() {
+  resetPending.store(true,std::memory_order_relaxed);
+}
+
+void DivProfiler::begin(unsigned int size, unsigned int budget) {
+  if (resetPending.exchange(false,std::memory_order_relaxed)) {
+    clear();
+  }
+  memset(&cur,0,sizeof(DivProfileFrame));
+  cur.size=size;
+  cur.budget=budget;
+}
+
+void DivProfiler::addStage(DivProfileStage stage, unsigned int ns) {
+  cur.stage[stage]+=ns;
+}
+
+void DivProfiler::setChip(int chip, unsigned long long acquireTime, unsigned long long fillTime) {
+  if (chip<0 || chip>=DIV_MAX_CHIPS) return;
+  // the counters go back to zero when a benchmark begins
+  cur.chipAcquire[chip]=(acquireTime>=lastAcquire[chip])?(acquireTime-lastAcquire[chip]):acquireTime;
+  cur.chipFill[chip]=(fillTime>=lastFill[chip])?(fillTime-lastFill[chip]):fillTime;
+  lastAcquire[chip]=acquireTime;
+  lastFill[chip]=fillTime;
+}
+
+void DivProfiler::end(int chips) {
+  if (chips>DIV_MAX_CHIPS) chips=DIV_MAX_CHIPS;
+  cur.chips=chips;
+
+  // histograms
+  for (int i=0; i<DIV_PROFILE_STAGE_MAX; i++) {
+    count1(i,cur.stage[i]);
+  }
+  for (int i=0; i<chips; i++) {
+    count1(DIV_PROFILE_STAGE_MAX+i,cur.chipAcquire[i]+cur.chipFill[i]);
+  }
+  count.store(count.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+
+  // find out who is responsible for an overrun
+  if (cur.stage[DIV_PROFILE_TOTAL]>cur.budget) {
+    int worst=0;
+    for (int i=1; i<DIV_PROFILE_TOTAL; i++) {
+      if (cur.stage[i]>cur.stage[worst]) worst=i;
+    }
+    if (worst==DIV_PROFILE_RENDER && chips>0) {
+      int worstChip=0;
+      for (int i=1; i<chips; i++) {
+        if (cur.chipAcquire[i]+cur.chipFill[i]>cur.chipAcquire[worstChip]+cur.chipFill[worstChip]) worstChip=i;
+      }
+      worst=DIV_PROFILE_STAGE_MAX+worstChip;
+    }
+    blame[worst].store(blame[worst].load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+    overruns.store(overruns.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+  }
+
+  // publish the frame
+  // readers check claim to find out whether we've written over what they read
+  unsigned int prevSeq=seq.load(std::memory_order_relaxed);
+  claim.store(prevSeq+1,std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  frames[prevSeq&(DIV_PROFILE_FRAMES-1)]=cur;
+  seq.store(prevSeq+1,std::memory_order_release);
+}
+
+int DivProfiler::getFrames(DivProfileFrame* dest, int max) {
+  unsigned int last=seq.load(std::memory_order_acquire);
+  if (max>DIV_PROFILE_FRAMES-1) max=DIV_PROFILE_FRAMES-1;
+  if ((unsigned int)max>last) max=last;
+  if (max<=0) return 0;
+
+  unsigned int first=last-max;
+  for (int i=0; i<max; i++) {
+    dest[i]=frames[(first+i)&(DIV_PROFILE_FRAMES-1)];
+  }
+
+  // drop the frames which were overwritten while copying
+  std::atomic_thread_fence(std::memory_order_acquire);
+  unsigned int lost=claim.load(std::memory_order_relaxed)-first;
+  if (lost<=DIV_PROFILE_FRAMES) return max;
+  lost-=DIV_PROFILE_FRAMES;
+  if (lost>=(unsigned int)max) return 0;
+  memmove(dest,dest+lost,(max-lost)*sizeof(DivProfileFrame));
+  return max-lost;
+}
+
+void DivProfiler::getHistogram(int slot, unsigned int* dest) {
+  if (slot<0 || slot>=DIV_PROFILE_SLOTS) {
+    memset(dest,0,DIV_PROFILE_BUCKETS*sizeof(unsigned int));
+    return;
+  }
+  for (int i=0; i<DIV_PROFILE_BUCKETS; i++) {
+    dest[i]=hist[slot][i].load(std::memory_order_relaxed);
+  }
+}
+
+unsigned long long DivProfiler::getPercentile(int slot, double fraction) {
+  unsigned int h[DIV_PROFILE_BUCKETS];
+  unsigned long long total=0;
+  getHistogram(slot,h);
+  for (int i=0; i<DIV_PROFILE_BUCKETS; i++) {
+    total+=h[i];
+  }
+  if (total==0) return 0;
+
+  unsigned long long goal=(unsigned long long)(fraction*(double)total);
+  unsigned long long acc=0;
+  for (int i=0; i<DIV_PROFILE_BUCKETS; i++) {
+    acc+=h[i];
+    if (acc>goal || acc==total) return 2ULL<<i;
+  }
+  return 2ULL<<(DIV_PROFILE_BUCKETS-1);
+}
+
+double DivProfiler::getAverage(int slot) {
+  if (slot<0 || slot>=DIV_PROFILE_SLOTS) return 0.0;
+  unsigned int c=count.load(std::memory_order_relaxed);
+  if (c==0) return 0.0;
+  return (double)sum[slot].load(std::memory_order_relaxed)/(double)c;
+}
+
+unsigned int DivProfiler::getCount() {
+  return count.load(std::memory_order_relaxed);
+}
+
+unsigned int DivProfiler::getOverruns() {
+  return overruns.load(std::memory_order_relaxed);
+}
+
+unsigned int DivProfiler::getBlame(int slot) {
+  if (slot<0 || slot>=DIV_PROFILE_SLOTS) return 0;
+  return blame[slot].load(std::memory_order_relaxed);
+}
+
+const char* DivProfiler::getStageName(int stage) {
+  if (stage<0 || stage>=DIV_PROFILE_STAGE_MAX) return "???";
+  return stageNames[stage];
+}
+
+DivProfiler::DivProfiler():
+  enabled(false),
+  resetPending(false),
+  seq(0),
+  claim(0),
+  count(0),
+  overruns(0) {
+  memset(frames,0,sizeof(frames));
+  memset(&cur,0,sizeof(DivProfileFrame));
+  memset(lastAcquire,0,sizeof(lastAcquire));
+  memset(lastFill,0,sizeof(lastFill));
+  clear();
+}
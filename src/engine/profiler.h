@@ -0,0 +1,178 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+#include "defines.h"
+#include <atomic>
+
+// how many audio buffers are kept. must be a power of 2
+#define DIV_PROFILE_FRAMES 256
+// histogram bucket N counts times in [2^N, 2^(N+1)) nanoseconds
+#define DIV_PROFILE_BUCKETS 32
+
+enum DivProfileStage {
+  DIV_PROFILE_TICK=0,
+  DIV_PROFILE_MIDI,
+  // sample/wave preview
+  DIV_PROFILE_PREVIEW,
+  // chip rendering (wall time, including waiting for the render threads)
+  DIV_PROFILE_RENDER,
+  DIV_PROFILE_FILE_PLAYER,
+  DIV_PROFILE_METRONOME,
+  DIV_PROFILE_MIX,
+  // oscilloscope copy, chip peaks and mono downmix
+  DIV_PROFILE_OSC,
+  DIV_PROFILE_TOTAL,
+
+  DIV_PROFILE_STAGE_MAX
+};
+
+// histogram/blame slots: stages first, then one per chip
+#define DIV_PROFILE_SLOTS (DIV_PROFILE_STAGE_MAX+DIV_MAX_CHIPS)
+
+/**
+ * timings of one audio buffer, in nanoseconds.
+ */
+struct DivProfileFrame {
+  unsigned int stage[DIV_PROFILE_STAGE_MAX];
+  unsigned int chipAcquire[DIV_MAX_CHIPS];
+  unsigned int chipFill[DIV_MAX_CHIPS];
+  // time available to process this buffer
+  unsigned int budget;
+  unsigned int size;
+  int chips;
+};
+
+/**
+ * per-stage and per-chip timing of nextBuf().
+ * only the audio thread writes (begin()/add*()/end()). any thread may read.
+ * frames go into a ring which is read without locking (like the oscilloscope buffer),
+ * and every time is also counted in a histogram so that rare spikes aren't lost.
+ */
+class DivProfiler {
+  std::atomic<bool> enabled;
+  std::atomic<bool> resetPending;
+
+  DivProfileFrame frames[DIV_PROFILE_FRAMES];
+  // frame sequence numbers. seq is the number of complete frames.
+  // claim is increased before a frame is written to.
+  std::atomic<unsigned int> seq, claim;
+
+  std::atomic<unsigned int> hist[DIV_PROFILE_SLOTS][DIV_PROFILE_BUCKETS];
+  // sum of times (for averages) and frame count
+  std::atomic<unsigned long long> sum[DIV_PROFILE_SLOTS];
+  std::atomic<unsigned int> count;
+  // buffers which took longer than the budget, and the slot blamed for each
+  std::atomic<unsigned int> overruns;
+  std::atomic<unsigned int> blame[DIV_PROFILE_SLOTS];
+
+  // frame being written
+  DivProfileFrame cur;
+  // last cumulative dispatch times, used to calculate per-buffer ones
+  unsigned long long lastAcquire[DIV_MAX_CHIPS];
+  unsigned long long lastFill[DIV_MAX_CHIPS];
+
+  void count1(int slot, unsigned int ns);
+  void clear();
+
+  public:
+    /**
+     * enable or disable profiling.
+     */
+    void enable(bool on);
+    bool isEnabled();
+
+    /**
+     * clear the histograms and overrun counts. takes effect on the next buffer.
+     */
+    void reset();
+
+    /**
+     * begin a buffer (audio thread only).
+     * @param size buffer size in samples.
+     * @param budget time available to process it in nanoseconds.
+     */
+    void begin(unsigned int size, unsigned int budget);
+
+    /**
+     * add time to a stage of the current buffer (audio thread only).
+     */
+    void addStage(DivProfileStage stage, unsigned int ns);
+
+    /**
+     * set the time of a chip from the cumulative times of its DivDispatchContainer (audio thread only).
+     */
+    void setChip(int chip, unsigned long long acquireTime, unsigned long long fillTime);
+
+    /**
+     * finish the current buffer and publish it (audio thread only).
+     * @param chips number of chips.
+     */
+    void end(int chips);
+
+    /**
+     * copy the most recent frames, oldest first.
+     * @return the number of frames copied (up to max).
+     */
+    int getFrames(DivProfileFrame* dest, int max);
+
+    /**
+     * get the histogram of a slot (a DivProfileStage, or DIV_PROFILE_STAGE_MAX+chip).
+     * @param dest an array of DIV_PROFILE_BUCKETS values.
+     */
+    void getHistogram(int slot, unsigned int* dest);
+
+    /**
+     * get an upper bound of the time a slot stays under in the given fraction of buffers (e.g. 0.99).
+     * @return time in nanoseconds, or 0 if nothing was recorded.
+     */
+    unsigned long long getPercentile(int slot, double fraction);
+
+    /**
+     * get the average time of a slot in nanoseconds.
+     */
+    double getAverage(int slot);
+
+    /**
+     * get the number of buffers recorded since the last reset.
+     */
+    unsigned int getCount();
+
+    /**
+     * get the number of buffers which took longer than their budget.
+     */
+    unsigned int getOverruns();
+
+    /**
+     * get how many overruns a slot was blamed for.
+     * the slowest stage is blamed, unless it is DIV_PROFILE_RENDER, in which case the slowest chip is.
+     */
+    unsigned int getBlame(int slot);
+
+    /**
+     * get the name of a stage.
+     */
+    static const char* getStageName(int stage);
+
+    DivProfiler();
+};
+
+#endif
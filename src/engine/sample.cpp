@@ -22,6 +22,8 @@
 #include "../fileutils.h"
 #include <math.h>
 #include <string.h>
+#include <limits.h>
+#include <utility>
 #ifdef HAVE_SNDFILE
 #include "sfWrapper.h"
 #endif
@@ -450,6 +452,132 @@ void DivSample::setSampleCount(unsigned int count) {
   if ((!isLoopable()) || loopEnd<0 || loopEnd>(int)samples) loopEnd=samples;
 }
 
+void DivSample::invalidatePeaks(unsigned int begin, unsigned int end) {
+  if (begin>=end) return;
+  if (peakDirtyStart>=peakDirtyEnd) {
+    peakDirtyStart=begin;
+    peakDirtyEnd=end;
+    return;
+  }
+  if (begin<peakDirtyStart) peakDirtyStart=begin;
+  if (end>peakDirtyEnd) peakDirtyEnd=end;
+}
+
+void DivSample::updatePeaks() {
+  // the last block changes when the length does
+  if (peakSamples!=samples) {
+    unsigned int from=MIN(peakSamples,samples);
+    if (from>0) from--;
+    invalidatePeaks(from,samples);
+    peakSamples=samples;
+  }
+  if (peakDirtyStart>=peakDirtyEnd) return;
+
+  bool is8Bit=(depth==DIV_SAMPLE_DEPTH_8BIT);
+  if ((is8Bit && data8==NULL) || (!is8Bit && data16==NULL)) {
+    for (int i=0; i<DIV_SAMPLE_PEAK_LEVELS; i++) {
+      peaks[i].clear();
+    }
+    peakDirtyStart=0;
+    peakDirtyEnd=0;
+    return;
+  }
+
+  unsigned int size=(samples+DIV_SAMPLE_PEAK_BLOCK-1)>>DIV_SAMPLE_PEAK_SHIFT;
+  for (int i=0; i<DIV_SAMPLE_PEAK_LEVELS; i++) {
+    peaks[i].resize(size);
+    size=(size>1)?((size+1)>>1):0;
+  }
+
+  // first level
+  unsigned int lo=peakDirtyStart>>DIV_SAMPLE_PEAK_SHIFT;
+  unsigned int hi=(MIN(peakDirtyEnd,samples)+DIV_SAMPLE_PEAK_BLOCK-1)>>DIV_SAMPLE_PEAK_SHIFT;
+  for (unsigned int i=lo; i<hi; i++) {
+    unsigned int begin=i<<DIV_SAMPLE_PEAK_SHIFT;
+    unsigned int end=MIN(begin+DIV_SAMPLE_PEAK_BLOCK,samples);
+    int candMin=INT_MAX;
+    int candMax=INT_MIN;
+    if (is8Bit) {
+      for (unsigned int j=begin; j<end; j++) {
+        if (candMin>data8[j]) candMin=data8[j];
+        if (candMax<data8[j]) candMax=data8[j];
+      }
+      candMin*=256;
+      candMax*=256;
+    } else {
+      for (unsigned int j=begin; j<end; j++) {
+        if (candMin>data16[j]) candMin=data16[j];
+        if (candMax<data16[j]) candMax=data16[j];
+      }
+    }
+    peaks[0][i].min=candMin;
+    peaks[0][i].max=candMax;
+  }
+
+  // the rest
+  for (int i=1; i<DIV_SAMPLE_PEAK_LEVELS; i++) {
+    if (peaks[i].empty()) break;
+    lo>>=1;
+    hi=(hi+1)>>1;
+    if (hi>peaks[i].size()) hi=peaks[i].size();
+    for (unsigned int j=lo; j<hi; j++) {
+      DivSamplePeak p=peaks[i-1][j<<1];
+      if (((j<<1)|1)<peaks[i-1].size()) {
+        const DivSamplePeak& p1=peaks[i-1][(j<<1)|1];
+        if (p.min>p1.min) p.min=p1.min;
+        if (p.max<p1.max) p.max=p1.max;
+      }
+      peaks[i][j]=p;
+    }
+  }
+
+  peakDirtyStart=0;
+  peakDirtyEnd=0;
+}
+
+bool DivSample::getPeak(unsigned int begin, unsigned int end, int& min, int& max) {
+  if (end>samples) end=samples;
+  if (begin>=end) return false;
+  bool is8Bit=(depth==DIV_SAMPLE_DEPTH_8BIT);
+  if ((is8Bit && data8==NULL) || (!is8Bit && data16==NULL)) return false;
+
+  min=INT_MAX;
+  max=INT_MIN;
+
+  // samples outside of whole blocks
+  while (begin<end && (begin&(DIV_SAMPLE_PEAK_BLOCK-1))) {
+    int val=is8Bit?(data8[begin]*256):data16[begin];
+    if (min>val) min=val;
+    if (max<val) max=val;
+    begin++;
+  }
+  while (begin<end && (end&(DIV_SAMPLE_PEAK_BLOCK-1))) {
+    end--;
+    int val=is8Bit?(data8[end]*256):data16[end];
+    if (min>val) min=val;
+    if (max<val) max=val;
+  }
+
+  // whole blocks, going up a level whenever possible
+  begin>>=DIV_SAMPLE_PEAK_SHIFT;
+  end>>=DIV_SAMPLE_PEAK_SHIFT;
+  for (int i=0; i<DIV_SAMPLE_PEAK_LEVELS && begin<end; i++) {
+    if (begin&1) {
+      if (min>peaks[i][begin].min) min=peaks[i][begin].min;
+      if (max<peaks[i][begin].max) max=peaks[i][begin].max;
+      begin++;
+    }
+    if (end&1) {
+      end--;
+      if (min>peaks[i][end].min) min=peaks[i][end].min;
+      if (max<peaks[i][end].max) max=peaks[i][end].max;
+    }
+    begin>>=1;
+    end>>=1;
+  }
+  return true;
+}
+
 bool DivSample::save(const char* path) {
 #ifndef HAVE_SNDFILE
   logE("Furnace was not compiled with libsndfile!");
@@ -658,6 +786,7 @@ bool DivSample::initInternal(DivSampleDepth d, int count) {
     default:
       return false;
   }
+  renderHash[d]=0;
   return true;
 }
 
@@ -668,6 +797,7 @@ bool DivSample::init(int count) {
   }
   if (!initInternal(depth,count)) return false;
   setSampleCount(count);
+  invalidatePeaks();
   return true;
 }
 
@@ -703,6 +833,7 @@ bool DivSample::resize(unsigned int count) {
 bool DivSample::strip(unsigned int begin, unsigned int end) {
   if (begin>samples) begin=samples;
   if (end>samples) end=samples;
+  invalidatePeaks(begin);
   int count=samples-(end-begin);
   if (count<=0) {
     loopStart=-1;
@@ -776,6 +907,7 @@ bool DivSample::trim(unsigned int begin, unsigned int end) {
   int count=end-begin;
   if (count==0) return true;
   if (begin==0 && end==samples) return true;
+  invalidatePeaks();
   if (((int)begin<loopStart && (int)end<loopStart) || ((int)begin>loopEnd && (int)end>loopEnd)) {
     loopStart=-1;
     loopEnd=-1;
@@ -819,6 +951,7 @@ bool DivSample::trim(unsigned int begin, unsigned int end) {
 bool DivSample::insert(unsigned int pos, unsigned int length) {
   unsigned int count=samples+length;
   if (pos>samples) pos=samples;
+  invalidatePeaks(pos);
 
   if (depth==DIV_SAMPLE_DEPTH_8BIT) {
     if (data8!=NULL) {
@@ -859,6 +992,7 @@ bool DivSample::insert(unsigned int pos, unsigned int length) {
 }
 
 void DivSample::convert(DivSampleDepth newDepth, unsigned int formatMask) {
+  invalidatePeaks();
   render(formatMask|(1U<<newDepth));
   depth=newDepth;
   switch (depth) {
@@ -904,6 +1038,7 @@ void DivSample::convert(DivSampleDepth newDepth, unsigned int formatMask) {
 
 #define RESAMPLE_BEGIN \
   if (samples<1) return true; \
+  invalidatePeaks(); \
   int finalCount=(double)samples*(tRate/sRate); \
   signed char* oldData8=data8; \
   short* oldData16=data16; \
@@ -1233,8 +1368,6 @@ bool DivSample::resample(double sRate, double tRate, int filter) {
   return false;
 }
 
-#define NOT_IN_FORMAT(x) (depth!=x && formatMask&(1U<<(unsigned int)x))
-
 union IntFloat {
   unsigned int i;
   float f;
@@ -1271,320 +1404,485 @@ signed char adpcmKTable[16]={
   0, 1, 2, 4, 8, 16, 32, 64, -128, -64, -32, -16, -8, -4, -2, -1
 };
 
-void DivSample::render(unsigned int formatMask) {
-  // step 1: convert to 16-bit if needed
-  if (depth!=DIV_SAMPLE_DEPTH_16BIT) {
-    if (!initInternal(DIV_SAMPLE_DEPTH_16BIT,samples)) return;
-    switch (depth) {
-      case DIV_SAMPLE_DEPTH_1BIT: // 1-bit
-        for (unsigned int i=0; i<samples; i++) {
-          data16[i]=((data1[i>>3]>>(i&7))&1)?0x7fff:-0x7fff;
-        }
-        break;
-      case DIV_SAMPLE_DEPTH_1BIT_DPCM: { // DPCM
-        int accum=0;
-        for (unsigned int i=0; i<samples; i++) {
-          accum+=((dataDPCM[i>>3]>>(i&7))&1)?1:-1;
-          if (accum>63) accum=63;
-          if (accum<-64) accum=-64;
-          data16[i]=accum*512;
-        }
-        break;
+bool DivSample::renderDecode(DivSample* dest) {
+  if (!dest->initInternal(DIV_SAMPLE_DEPTH_16BIT,samples)) return false;
+  switch (depth) {
+    case DIV_SAMPLE_DEPTH_1BIT: // 1-bit
+      for (unsigned int i=0; i<samples; i++) {
+        dest->data16[i]=((data1[i>>3]>>(i&7))&1)?0x7fff:-0x7fff;
       }
-      case DIV_SAMPLE_DEPTH_YMZ_ADPCM: // YMZ ADPCM
-        ymz_decode(dataZ,data16,samples);
-        break;
-      case DIV_SAMPLE_DEPTH_QSOUND_ADPCM: // QSound ADPCM
-        bs_decode(dataQSoundA,data16,samples);
-        break;
-      case DIV_SAMPLE_DEPTH_ADPCM_A: // ADPCM-A
-        yma_decode(dataA,data16,samples);
-        break;
-      case DIV_SAMPLE_DEPTH_ADPCM_B: // ADPCM-B
-        ymb_decode(dataB,data16,samples);
-        break;
-      case DIV_SAMPLE_DEPTH_ADPCM_K: { // K05 ADPCM
-        signed char s=0;
-        for (unsigned int i=0; i<samples; i++) {
-          unsigned char nibble=dataK[i>>1];
-          if (i&1) { // TODO: is this right?
-            nibble>>=4;
-          } else {
-            nibble&=15;
-          }
-          s+=adpcmKTable[nibble];
-          data16[i]=s<<8;
-        }
-        break;
+      break;
+    case DIV_SAMPLE_DEPTH_1BIT_DPCM: { // DPCM
+      int accum=0;
+      for (unsigned int i=0; i<samples; i++) {
+        accum+=((dataDPCM[i>>3]>>(i&7))&1)?1:-1;
+        if (accum>63) accum=63;
+        if (accum<-64) accum=-64;
+        dest->data16[i]=accum*512;
       }
-      case DIV_SAMPLE_DEPTH_8BIT: // 8-bit PCM
-        for (unsigned int i=0; i<samples; i++) {
-          data16[i]=data8[i]<<8;
-        }
-        break;
-      case DIV_SAMPLE_DEPTH_BRR: // BRR
-        brrDecode(dataBRR,data16,lengthBRR,brrEmphasis);
-        break;
-      case DIV_SAMPLE_DEPTH_VOX: // VOX
-        oki_decode(dataVOX,data16,samples);
-        break;
-      case DIV_SAMPLE_DEPTH_MULAW: // 8-bit µ-law PCM
-        for (unsigned int i=0; i<samples; i++) {
-          IntFloat s;
-          s.i=(dataMuLaw[i]^0xff);
-          s.i=0x3f800000+(((s.i<<24)&0x80000000)|((s.i&0x7f)<<19));
-          data16[i]=(short)(s.f*128.0f);
-        }
-        break;
-      case DIV_SAMPLE_DEPTH_C219: // 8-bit C219 "μ-law" PCM
-        for (unsigned int i=0; i<samples; i++) {
-          data16[i]=c219Table[dataC219[i]&0x7f];
-          if (dataC219[i]&0x80) data16[i]=-data16[i];
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_YMZ_ADPCM: // YMZ ADPCM
+      ymz_decode(dataZ,dest->data16,samples);
+      break;
+    case DIV_SAMPLE_DEPTH_QSOUND_ADPCM: // QSound ADPCM
+      bs_decode(dataQSoundA,dest->data16,samples);
+      break;
+    case DIV_SAMPLE_DEPTH_ADPCM_A: // ADPCM-A
+      yma_decode(dataA,dest->data16,samples);
+      break;
+    case DIV_SAMPLE_DEPTH_ADPCM_B: // ADPCM-B
+      ymb_decode(dataB,dest->data16,samples);
+      break;
+    case DIV_SAMPLE_DEPTH_ADPCM_K: { // K05 ADPCM
+      signed char s=0;
+      for (unsigned int i=0; i<samples; i++) {
+        unsigned char nibble=dataK[i>>1];
+        if (i&1) { // TODO: is this right?
+          nibble>>=4;
+        } else {
+          nibble&=15;
         }
-        break;
-      case DIV_SAMPLE_DEPTH_IMA_ADPCM: // IMA ADPCM
-        if (adpcm_decode_block(data16,dataIMA,lengthIMA,samples)==0) logE("oh crap!");
-        break;
-      case DIV_SAMPLE_DEPTH_12BIT: // 12-bit PCM (MultiPCM)
-        for (unsigned int i=0, j=0; i<samples; i+=2, j+=3) {
-          data16[i+0]=(data12[j+0]<<8)|(data12[j+1]&0xf0);
-          if (i+1<samples) {
-            data16[i+1]=(data12[j+2]<<8)|((data12[j+1]<<4)&0xf0);
-          }
+        s+=adpcmKTable[nibble];
+        dest->data16[i]=s<<8;
+      }
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_8BIT: // 8-bit PCM
+      for (unsigned int i=0; i<samples; i++) {
+        dest->data16[i]=data8[i]<<8;
+      }
+      break;
+    case DIV_SAMPLE_DEPTH_BRR: // BRR
+      brrDecode(dataBRR,dest->data16,lengthBRR,brrEmphasis);
+      break;
+    case DIV_SAMPLE_DEPTH_VOX: // VOX
+      oki_decode(dataVOX,dest->data16,samples);
+      break;
+    case DIV_SAMPLE_DEPTH_MULAW: // 8-bit µ-law PCM
+      for (unsigned int i=0; i<samples; i++) {
+        IntFloat s;
+        s.i=(dataMuLaw[i]^0xff);
+        s.i=0x3f800000+(((s.i<<24)&0x80000000)|((s.i&0x7f)<<19));
+        dest->data16[i]=(short)(s.f*128.0f);
+      }
+      break;
+    case DIV_SAMPLE_DEPTH_C219: // 8-bit C219 "μ-law" PCM
+      for (unsigned int i=0; i<samples; i++) {
+        dest->data16[i]=c219Table[dataC219[i]&0x7f];
+        if (dataC219[i]&0x80) dest->data16[i]=-dest->data16[i];
+      }
+      break;
+    case DIV_SAMPLE_DEPTH_IMA_ADPCM: // IMA ADPCM
+      if (adpcm_decode_block(dest->data16,dataIMA,lengthIMA,samples)==0) logE("oh crap!");
+      break;
+    case DIV_SAMPLE_DEPTH_12BIT: // 12-bit PCM (MultiPCM)
+      for (unsigned int i=0, j=0; i<samples; i+=2, j+=3) {
+        dest->data16[i+0]=(data12[j+0]<<8)|(data12[j+1]&0xf0);
+        if (i+1<samples) {
+          dest->data16[i+1]=(data12[j+2]<<8)|((data12[j+1]<<4)&0xf0);
         }
-        break;
-      case DIV_SAMPLE_DEPTH_4BIT: {
-        unsigned short nibble=0;
-        for (unsigned int i=0; i<samples; i++) {
-          if (i&1) {
-            nibble=data4[i>>1]&0xf;
-          } else {
-            nibble=data4[i>>1]>>4;
-          }
-          data16[i]=((nibble<<12)|(nibble<<8)|(nibble<<4)|nibble)^0x8000;
+      }
+      break;
+    case DIV_SAMPLE_DEPTH_4BIT: {
+      unsigned short nibble=0;
+      for (unsigned int i=0; i<samples; i++) {
+        if (i&1) {
+          nibble=data4[i>>1]&0xf;
+        } else {
+          nibble=data4[i>>1]>>4;
         }
-        break;
+        dest->data16[i]=((nibble<<12)|(nibble<<8)|(nibble<<4)|nibble)^0x8000;
       }
-      default:
-        return;
+      break;
     }
+    default:
+      return false;
   }
+  return true;
+}
 
-  // step 2: render to other formats
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_1BIT)) { // 1-bit
-    if (!initInternal(DIV_SAMPLE_DEPTH_1BIT,samples)) return;
-    for (unsigned int i=0; i<samples; i++) {
-      if (data16[i]>0) {
-        data1[i>>3]|=1<<(i&7);
-      }
-    }
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_1BIT_DPCM)) { // DPCM
-    if (!initInternal(DIV_SAMPLE_DEPTH_1BIT_DPCM,samples)) return;
-    int accum=63;
-    int next=63;
-    
-    for (unsigned int i=0; (i<samples && (i>>3)<lengthDPCM); i++) {
-      next=((unsigned short)(data16[i]^0x8000))>>9;
-      if (next>accum) {
-        dataDPCM[i>>3]|=1<<(i&7);
-        accum++;
-      } else {
-        dataDPCM[i>>3]&=~(1<<(i&7));
-        accum--;
+bool DivSample::renderEncode(DivSampleDepth d, short* src, DivSample* dest) {
+  switch (d) {
+    case DIV_SAMPLE_DEPTH_1BIT: { // 1-bit
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_1BIT,samples)) return false;
+      for (unsigned int i=0; i<samples; i++) {
+        if (src[i]>0) {
+          dest->data1[i>>3]|=1<<(i&7);
+        }
       }
-      if (accum<0) accum=0;
-      if (accum>127) accum=127;
+      break;
     }
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_YMZ_ADPCM)) { // YMZ ADPCM
-    if (!initInternal(DIV_SAMPLE_DEPTH_YMZ_ADPCM,samples)) return;
-    ymz_encode(data16,dataZ,(samples+7)&(~0x7));
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_QSOUND_ADPCM)) { // QSound ADPCM
-    if (!initInternal(DIV_SAMPLE_DEPTH_QSOUND_ADPCM,samples)) return;
-    bs_encode(data16,dataQSoundA,samples);
-  }
-  // TODO: pad to 256.
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_A)) { // ADPCM-A
-    if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_A,samples)) return;
-    yma_encode(data16,dataA,(samples+511)&(~0x1ff));
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_B)) { // ADPCM-B
-    if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_B,samples)) return;
-    ymb_encode(data16,dataB,(samples+511)&(~0x1ff));
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_ADPCM_K)) { // K05 ADPCM
-    if (!initInternal(DIV_SAMPLE_DEPTH_ADPCM_K,samples)) return;
-    signed char accum=0;
-    unsigned char out=0;
-    for (unsigned int i=0; i<samples; i++) {
-      signed char target=data16[i]>>8;
-      short delta=target-accum;
-      unsigned char next=0;
-
-      if (delta!=0) {
-        int b=bsr((delta>=0)?delta:-delta);
-        if (delta>=0) {
-          if (b>7) b=7;
-          next=b&15;
-
-          // test previous
-          if (next>1) {
-            const signed char t1=accum+adpcmKTable[next];
-            const signed char t2=accum+adpcmKTable[next-1];
-            const signed char d1=((t1-target)<0)?(target-t1):(t1-target);
-            const signed char d2=((t2-target)<0)?(target-t2):(t2-target);
-
-            if (d2<d1) next--;
-          }
+    case DIV_SAMPLE_DEPTH_1BIT_DPCM: { // DPCM
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_1BIT_DPCM,samples)) return false;
+      int accum=63;
+      int next=63;
+      
+      for (unsigned int i=0; (i<samples && (i>>3)<dest->lengthDPCM); i++) {
+        next=((unsigned short)(src[i]^0x8000))>>9;
+        if (next>accum) {
+          dest->dataDPCM[i>>3]|=1<<(i&7);
+          accum++;
         } else {
-          if (b>8) b=8;
-          next=(16-b)&15;
-
-          // test next
-          if (next<15) {
-            const signed char t1=accum+adpcmKTable[next];
-            const signed char t2=accum+adpcmKTable[next+1];
-            const signed char d1=((t1-target)<0)?(target-t1):(t1-target);
-            const signed char d2=((t2-target)<0)?(target-t2):(t2-target);
-
-            if (d2<d1) next++;
-          }
+          dest->dataDPCM[i>>3]&=~(1<<(i&7));
+          accum--;
         }
+        if (accum<0) accum=0;
+        if (accum>127) accum=127;
+      }
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_YMZ_ADPCM: { // YMZ ADPCM
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_YMZ_ADPCM,samples)) return false;
+      ymz_encode(src,dest->dataZ,(samples+7)&(~0x7));
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_QSOUND_ADPCM: { // QSound ADPCM
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_QSOUND_ADPCM,samples)) return false;
+      bs_encode(src,dest->dataQSoundA,samples);
+      break;
+    }
+    // TODO: pad to 256.
+    case DIV_SAMPLE_DEPTH_ADPCM_A: { // ADPCM-A
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_ADPCM_A,samples)) return false;
+      yma_encode(src,dest->dataA,(samples+511)&(~0x1ff));
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_ADPCM_B: { // ADPCM-B
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_ADPCM_B,samples)) return false;
+      ymb_encode(src,dest->dataB,(samples+511)&(~0x1ff));
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_ADPCM_K: { // K05 ADPCM
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_ADPCM_K,samples)) return false;
+      signed char accum=0;
+      unsigned char out=0;
+      for (unsigned int i=0; i<samples; i++) {
+        signed char target=src[i]>>8;
+        short delta=target-accum;
+        unsigned char next=0;
 
-        /*if (accum+adpcmKTable[next]>=128 || accum+adpcmKTable[next]<-128) {
+        if (delta!=0) {
+          int b=bsr((delta>=0)?delta:-delta);
           if (delta>=0) {
-            next--;
+            if (b>7) b=7;
+            next=b&15;
+
+            // test previous
+            if (next>1) {
+              const signed char t1=accum+adpcmKTable[next];
+              const signed char t2=accum+adpcmKTable[next-1];
+              const signed char d1=((t1-target)<0)?(target-t1):(t1-target);
+              const signed char d2=((t2-target)<0)?(target-t2):(t2-target);
+
+              if (d2<d1) next--;
+            }
           } else {
-            next++;
-            if (next>15) next=15;
+            if (b>8) b=8;
+            next=(16-b)&15;
+
+            // test next
+            if (next<15) {
+              const signed char t1=accum+adpcmKTable[next];
+              const signed char t2=accum+adpcmKTable[next+1];
+              const signed char d1=((t1-target)<0)?(target-t1):(t1-target);
+              const signed char d2=((t2-target)<0)?(target-t2):(t2-target);
+
+              if (d2<d1) next++;
+            }
           }
-        }*/
-      }
 
-      out>>=4;
-      out|=next<<4;
-      accum+=adpcmKTable[next];
+          /*if (accum+adpcmKTable[next]>=128 || accum+adpcmKTable[next]<-128) {
+            if (delta>=0) {
+              next--;
+            } else {
+              next++;
+              if (next>15) next=15;
+            }
+          }*/
+        }
+
+        out>>=4;
+        out|=next<<4;
+        accum+=adpcmKTable[next];
 
-      if (i&1) {
-        dataK[i>>1]=out;
-        out=0;
+        if (i&1) {
+          dest->dataK[i>>1]=out;
+          out=0;
+        }
       }
+      break;
     }
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_8BIT)) { // 8-bit PCM
-    if (!initInternal(DIV_SAMPLE_DEPTH_8BIT,samples)) return;
-    if (dither) {
-      unsigned short lfsr=0x6438;
-      unsigned short lfsr1=0x1283;
-      signed char errorLast=0;
-      signed char errorCur=0;
+    case DIV_SAMPLE_DEPTH_8BIT: { // 8-bit PCM
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_8BIT,samples)) return false;
+      if (dither) {
+        unsigned short lfsr=0x6438;
+        unsigned short lfsr1=0x1283;
+        signed char errorLast=0;
+        signed char errorCur=0;
+        for (unsigned int i=0; i<samples; i++) {
+          signed char val=CLAMP(src[i]+128,-32768,32767)>>8;
+          errorLast=errorCur;
+          errorCur=(val<<8)-src[i];
+          dest->data8[i]=CLAMP(val-((((errorLast+errorCur)>>1)+(lfsr&0xff))>>8),-128,127);
+          lfsr=(lfsr<<1)|(((lfsr>>1)^(lfsr>>2)^(lfsr>>4)^(lfsr>>15))&1);
+          lfsr1=(lfsr1<<1)|(((lfsr1>>1)^(lfsr1>>2)^(lfsr1>>4)^(lfsr1>>15))&1);
+        }
+      } else {
+        for (unsigned int i=0; i<samples; i++) {
+          dest->data8[i]=src[i]>>8;
+        }
+      }
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_BRR: { // BRR
+      int sampleCount=isLoopable()?loopEnd:samples;
+      if (sampleCount>(int)samples) sampleCount=samples;
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_BRR,sampleCount)) return false;
+      brrEncode(src,dest->dataBRR,sampleCount,loop?loopStart:-1,brrEmphasis,brrNoFilter);
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_VOX: { // VOX
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_VOX,samples)) return false;
+      oki_encode(src,dest->dataVOX,samples);
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_MULAW: { // µ-law
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_MULAW,samples)) return false;
       for (unsigned int i=0; i<samples; i++) {
-        signed char val=CLAMP(data16[i]+128,-32768,32767)>>8;
-        errorLast=errorCur;
-        errorCur=(val<<8)-data16[i];
-        data8[i]=CLAMP(val-((((errorLast+errorCur)>>1)+(lfsr&0xff))>>8),-128,127);
-        lfsr=(lfsr<<1)|(((lfsr>>1)^(lfsr>>2)^(lfsr>>4)^(lfsr>>15))&1);
-        lfsr1=(lfsr1<<1)|(((lfsr1>>1)^(lfsr1>>2)^(lfsr1>>4)^(lfsr1>>15))&1);
+        IntFloat s;
+        s.f=src[i];
+        s.i&=0x7fffffff;
+        if (s.f>32639.0f) s.f=32639.0f;
+        s.f/=128.0f;
+        s.f+=1.0f;
+        s.i-=0x3f800000;
+        dest->dataMuLaw[i]=(((src[i]<0)?0x80:0)|(s.i&0x03f80000)>>19)^0xff;
       }
-    } else {
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_C219: { // C219
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_C219,samples)) return false;
       for (unsigned int i=0; i<samples; i++) {
-        data8[i]=data16[i]>>8;
+        short s=src[i];
+        unsigned char x=0;
+        bool negate=s&0x8000;
+        if (negate) {
+          s^=0xffff;
+        }
+        if (s==0) {
+          x=0;
+        } else if (s>17152) { // 100+
+          x=((s-17152)>>9)+100;
+        } else {
+          int b=bsr(s)-1;
+          x=((s-(c219Table[c219HighBitPos[b]]))>>c219ShiftToVal[b])+c219HighBitPos[b];
+        }
+        if (x>127) x=127;
+        dest->dataC219[i]=x|(negate?0x80:0);
       }
+      break;
     }
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_BRR)) { // BRR
-    int sampleCount=isLoopable()?loopEnd:samples;
-    if (sampleCount>(int)samples) sampleCount=samples;
-    if (!initInternal(DIV_SAMPLE_DEPTH_BRR,sampleCount)) return;
-    brrEncode(data16,dataBRR,sampleCount,loop?loopStart:-1,brrEmphasis,brrNoFilter);
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_VOX)) { // VOX
-    if (!initInternal(DIV_SAMPLE_DEPTH_VOX,samples)) return;
-    oki_encode(data16,dataVOX,samples);
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_MULAW)) { // µ-law
-    if (!initInternal(DIV_SAMPLE_DEPTH_MULAW,samples)) return;
-    for (unsigned int i=0; i<samples; i++) {
-      IntFloat s;
-      s.f=data16[i];
-      s.i&=0x7fffffff;
-      if (s.f>32639.0f) s.f=32639.0f;
-      s.f/=128.0f;
-      s.f+=1.0f;
-      s.i-=0x3f800000;
-      dataMuLaw[i]=(((data16[i]<0)?0x80:0)|(s.i&0x03f80000)>>19)^0xff;
+    case DIV_SAMPLE_DEPTH_IMA_ADPCM: { // IMA ADPCM
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_IMA_ADPCM,samples)) return false;
+      int delta[2];
+      delta[0]=0;
+      delta[1]=0;
+
+      void* codec=adpcm_create_context(1,1,NOISE_SHAPING_OFF,delta);
+      if (codec==NULL) {
+        logE("oh no IMA encoder could not be created!");
+      } else {
+        size_t whyPointer=0;
+        adpcm_encode_block(codec,dest->dataIMA,&whyPointer,src,samples);
+        if (whyPointer!=dest->lengthIMA) logW("IMA length mismatch! %d -> %d!=%d",(int)samples,(int)whyPointer,(int)dest->lengthIMA);
+
+        adpcm_free_context(codec);
+      }
+      break;
     }
-  }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_C219)) { // C219
-    if (!initInternal(DIV_SAMPLE_DEPTH_C219,samples)) return;
-    for (unsigned int i=0; i<samples; i++) {
-      short s=data16[i];
-      unsigned char x=0;
-      bool negate=s&0x8000;
-      if (negate) {
-        s^=0xffff;
+    case DIV_SAMPLE_DEPTH_12BIT: { // 12-bit PCM (MultiPCM)
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_12BIT,samples)) return false;
+      for (unsigned int i=0, j=0; i<samples; i+=2, j+=3) {
+        dest->data12[j+0]=src[i+0]>>8;
+        dest->data12[j+1]=((src[i+0]>>4)&0xf)|(i+1<samples?(src[i+1]>>4)&0xf:0);
+        if (i+1<samples) {
+          dest->data12[j+2]=src[i+1]>>8;
+        } else {
+          dest->data12[j+2]=0;
+        }
       }
-      if (s==0) {
-        x=0;
-      } else if (s>17152) { // 100+
-        x=((s-17152)>>9)+100;
-      } else {
-        int b=bsr(s)-1;
-        x=((s-(c219Table[c219HighBitPos[b]]))>>c219ShiftToVal[b])+c219HighBitPos[b];
+      break;
+    }
+    case DIV_SAMPLE_DEPTH_4BIT: {
+      if (!dest->initInternal(DIV_SAMPLE_DEPTH_4BIT,samples)) return false;
+      unsigned char _sample=0, sample4=0;
+      unsigned short* samplePtr = (unsigned short*)src;
+      for (unsigned int i=0; i<samples; i+=2) {
+        _sample=(*samplePtr++^0x8000)>>12;
+        sample4=_sample<<4;
+        if (i+1<samples) {
+          _sample=(*samplePtr++^0x8000)>>12;
+          sample4|=_sample;
+        }
+        dest->data4[i>>1]=sample4;
       }
-      if (x>127) x=127;
-      dataC219[i]=x|(negate?0x80:0);
+      break;
     }
+    default:
+      return false;
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_IMA_ADPCM)) { // IMA ADPCM
-    if (!initInternal(DIV_SAMPLE_DEPTH_IMA_ADPCM,samples)) return;
-    int delta[2];
-    delta[0]=0;
-    delta[1]=0;
-
-    void* codec=adpcm_create_context(1,1,NOISE_SHAPING_OFF,delta);
-    if (codec==NULL) {
-      logE("oh no IMA encoder could not be created!");
-    } else {
-      size_t whyPointer=0;
-      adpcm_encode_block(codec,dataIMA,&whyPointer,data16,samples);
-      if (whyPointer!=lengthIMA) logW("IMA length mismatch! %d -> %d!=%d",(int)samples,(int)whyPointer,(int)lengthIMA);
+  return true;
+}
 
-      adpcm_free_context(codec);
-    }
+void DivSample::render(unsigned int formatMask) {
+  unsigned long long hash=getRenderHash();
+  unsigned int needed=getRenderNeeded(formatMask,hash);
+
+  // step 1: convert to 16-bit if needed
+  if (needed&(1U<<DIV_SAMPLE_DEPTH_16BIT)) {
+    if (!renderDecode(this)) return;
+    renderHash[DIV_SAMPLE_DEPTH_16BIT]=hash;
+    if (depth!=DIV_SAMPLE_DEPTH_8BIT) invalidatePeaks();
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_12BIT)) { // 12-bit PCM (MultiPCM)
-    if (!initInternal(DIV_SAMPLE_DEPTH_12BIT,samples)) return;
-    for (unsigned int i=0, j=0; i<samples; i+=2, j+=3) {
-      data12[j+0]=data16[i+0]>>8;
-      data12[j+1]=((data16[i+0]>>4)&0xf)|(i+1<samples?(data16[i+1]>>4)&0xf:0);
-      if (i+1<samples) {
-        data12[j+2]=data16[i+1]>>8;
-      } else {
-        data12[j+2]=0;
-      }
-    }
+
+  // step 2: render to other formats
+  for (int i=0; i<DIV_SAMPLE_DEPTH_16BIT; i++) {
+    if (!(needed&(1U<<i))) continue;
+    if (!renderEncode((DivSampleDepth)i,data16,this)) return;
+    renderHash[i]=hash;
   }
-  if (NOT_IN_FORMAT(DIV_SAMPLE_DEPTH_4BIT)) {
-    if (!initInternal(DIV_SAMPLE_DEPTH_4BIT,samples)) return;
-    unsigned char _sample=0, sample4=0;
-    unsigned short* samplePtr = (unsigned short*)data16;
-    for (unsigned int i=0; i<samples; i+=2) {
-      _sample=(*samplePtr++^0x8000)>>12;
-      sample4=_sample<<4;
-      if (i+1<samples) {
-        _sample=(*samplePtr++^0x8000)>>12;
-        sample4|=_sample;
-      }
-      data4[i>>1]=sample4;
+}
+
+unsigned long long DivSample::getRenderHash() {
+  unsigned long long h=0xcbf29ce484222325ULL;
+  unsigned char* buf=(unsigned char*)getCurBuf();
+  unsigned int len=getCurBufLen();
+  int params[10]={
+    (int)depth,
+    (int)samples,
+    loopStart,
+    loopEnd,
+    (int)loopMode,
+    loop,
+    brrEmphasis,
+    brrNoFilter,
+    dither,
+    buf!=NULL
+  };
+
+  // FNV-1a, on 64-bit words for speed
+  if (buf!=NULL) {
+    unsigned int i=0;
+    for (; i+8<=len; i+=8) {
+      unsigned long long w;
+      memcpy(&w,&buf[i],8);
+      h=(h^w)*0x100000001b3ULL;
+      h^=h>>32;
     }
+    for (; i<len; i++) {
+      h=(h^buf[i])*0x100000001b3ULL;
+    }
+  }
+  for (int i=0; i<10; i++) {
+    h=(h^(unsigned int)params[i])*0x100000001b3ULL;
   }
+
+  // 0 means "not rendered"
+  if (h==0) h=1;
+  return h;
 }
 
-void* DivSample::getCurBuf() {
-  switch (depth) {
+unsigned int DivSample::getRenderNeeded(unsigned int formatMask, unsigned long long hash) {
+  unsigned int needed=0;
+  // the other formats are rendered from 16-bit
+  formatMask|=1U<<DIV_SAMPLE_DEPTH_16BIT;
+  for (int i=0; i<DIV_SAMPLE_DEPTH_MAX; i++) {
+    if (i==depth) continue;
+    if (!(formatMask&(1U<<i))) continue;
+    // there is no format 2
+    if (i==2) continue;
+    if (renderHash[i]==hash && getBuf((DivSampleDepth)i)!=NULL) continue;
+    needed|=1U<<i;
+  }
+  return needed;
+}
+
+void DivSample::swapBuffer(DivSampleDepth d, DivSample* other) {
+  switch (d) {
+    case DIV_SAMPLE_DEPTH_1BIT:
+      std::swap(data1,other->data1);
+      std::swap(length1,other->length1);
+      break;
+    case DIV_SAMPLE_DEPTH_1BIT_DPCM:
+      std::swap(dataDPCM,other->dataDPCM);
+      std::swap(lengthDPCM,other->lengthDPCM);
+      break;
+    case DIV_SAMPLE_DEPTH_YMZ_ADPCM:
+      std::swap(dataZ,other->dataZ);
+      std::swap(lengthZ,other->lengthZ);
+      break;
+    case DIV_SAMPLE_DEPTH_QSOUND_ADPCM:
+      std::swap(dataQSoundA,other->dataQSoundA);
+      std::swap(lengthQSoundA,other->lengthQSoundA);
+      break;
+    case DIV_SAMPLE_DEPTH_ADPCM_A:
+      std::swap(dataA,other->dataA);
+      std::swap(lengthA,other->lengthA);
+      break;
+    case DIV_SAMPLE_DEPTH_ADPCM_B:
+      std::swap(dataB,other->dataB);
+      std::swap(lengthB,other->lengthB);
+      break;
+    case DIV_SAMPLE_DEPTH_ADPCM_K:
+      std::swap(dataK,other->dataK);
+      std::swap(lengthK,other->lengthK);
+      break;
+    case DIV_SAMPLE_DEPTH_8BIT:
+      std::swap(data8,other->data8);
+      std::swap(length8,other->length8);
+      break;
+    case DIV_SAMPLE_DEPTH_BRR:
+      std::swap(dataBRR,other->dataBRR);
+      std::swap(lengthBRR,other->lengthBRR);
+      break;
+    case DIV_SAMPLE_DEPTH_VOX:
+      std::swap(dataVOX,other->dataVOX);
+      std::swap(lengthVOX,other->lengthVOX);
+      break;
+    case DIV_SAMPLE_DEPTH_MULAW:
+      std::swap(dataMuLaw,other->dataMuLaw);
+      std::swap(lengthMuLaw,other->lengthMuLaw);
+      break;
+    case DIV_SAMPLE_DEPTH_C219:
+      std::swap(dataC219,other->dataC219);
+      std::swap(lengthC219,other->lengthC219);
+      break;
+    case DIV_SAMPLE_DEPTH_IMA_ADPCM:
+      std::swap(dataIMA,other->dataIMA);
+      std::swap(lengthIMA,other->lengthIMA);
+      break;
+    case DIV_SAMPLE_DEPTH_12BIT:
+      std::swap(data12,other->data12);
+      std::swap(length12,other->length12);
+      break;
+    case DIV_SAMPLE_DEPTH_4BIT:
+      std::swap(data4,other->data4);
+      std::swap(length4,other->length4);
+      break;
+    case DIV_SAMPLE_DEPTH_16BIT:
+      std::swap(data16,other->data16);
+      std::swap(length16,other->length16);
+      if (depth!=DIV_SAMPLE_DEPTH_8BIT) invalidatePeaks();
+      break;
+    default:
+      return;
+  }
+  std::swap(renderHash[d],other->renderHash[d]);
+}
+
+void* DivSample::getBuf(DivSampleDepth d) {
+  switch (d) {
     case DIV_SAMPLE_DEPTH_1BIT:
       return data1;
     case DIV_SAMPLE_DEPTH_1BIT_DPCM:
@@ -1623,8 +1921,8 @@ void* DivSample::getCurBuf() {
   return NULL;
 }
 
-unsigned int DivSample::getCurBufLen() {
-  switch (depth) {
+unsigned int DivSample::getBufLen(DivSampleDepth d) {
+  switch (d) {
     case DIV_SAMPLE_DEPTH_1BIT:
       return length1;
     case DIV_SAMPLE_DEPTH_1BIT_DPCM:
@@ -1663,6 +1961,55 @@ unsigned int DivSample::getCurBufLen() {
   return 0;
 }
 
+DivSample* DivSample::makeEditCopy() {
+  DivSample* ret=new DivSample;
+  ret->name=name;
+  ret->centerRate=centerRate;
+  ret->loopStart=loopStart;
+  ret->loopEnd=loopEnd;
+  ret->legacyRate=legacyRate;
+  ret->depth=depth;
+  ret->loop=loop;
+  ret->brrEmphasis=brrEmphasis;
+  ret->brrNoFilter=brrNoFilter;
+  ret->dither=dither;
+  ret->loopMode=loopMode;
+  memcpy(ret->renderOn,renderOn,sizeof(renderOn));
+  if (getCurBuf()!=NULL) {
+    ret->initInternal(depth,samples);
+    memcpy(ret->getCurBuf(),getCurBuf(),MIN(ret->getCurBufLen(),getCurBufLen()));
+  }
+  ret->samples=samples;
+  return ret;
+}
+
+void DivSample::takeEditCopy(DivSample* copy) {
+  for (int i=0; i<DIV_SAMPLE_DEPTH_MAX; i++) {
+    if (copy->getBuf((DivSampleDepth)i)==NULL) continue;
+    swapBuffer((DivSampleDepth)i,copy);
+  }
+  centerRate=copy->centerRate;
+  loopStart=copy->loopStart;
+  loopEnd=copy->loopEnd;
+  legacyRate=copy->legacyRate;
+  depth=copy->depth;
+  loop=copy->loop;
+  brrEmphasis=copy->brrEmphasis;
+  brrNoFilter=copy->brrNoFilter;
+  dither=copy->dither;
+  loopMode=copy->loopMode;
+  samples=copy->samples;
+  invalidatePeaks();
+}
+
+void* DivSample::getCurBuf() {
+  return getBuf(depth);
+}
+
+unsigned int DivSample::getCurBufLen() {
+  return getBufLen(depth);
+}
+
 DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
   DivSampleHistory* h;
   if (data) {
@@ -1691,6 +2038,7 @@ DivSampleHistory* DivSample::prepareUndo(bool data, bool doNotPush) {
 
 #define applyHistory \
   depth=h->depth; \
+  invalidatePeaks(); \
   if (h->hasSample) { \
     initInternal(h->depth,h->samples); \
     samples=h->samples; \
@@ -25,6 +25,13 @@
 #include "safeWriter.h"
 #include "dataErrors.h"
 #include "../fixedQueue.h"
+#include <vector>
+
+// the first level of the peak summary covers blocks of 1<<DIV_SAMPLE_PEAK_SHIFT samples
+#define DIV_SAMPLE_PEAK_SHIFT 4
+#define DIV_SAMPLE_PEAK_BLOCK (1U<<DIV_SAMPLE_PEAK_SHIFT)
+// enough for 16777216 samples
+#define DIV_SAMPLE_PEAK_LEVELS 21
 
 enum DivSampleLoopMode: unsigned char {
   DIV_SAMPLE_LOOP_FORWARD=0,
@@ -62,6 +69,13 @@ enum DivResampleFilters {
   DIV_RESAMPLE_BEST
 };
 
+struct DivSamplePeak {
+  short min, max;
+  DivSamplePeak():
+    min(0),
+    max(0) {}
+};
+
 struct DivSampleHistory {
   unsigned char* data;
   unsigned int length, samples;
@@ -153,6 +167,18 @@ struct DivSample {
 
   unsigned int samples;
 
+  // min/max summary of the sample data (data8 if 8-bit, data16 otherwise) for drawing.
+  // every level halves the resolution of the previous one.
+  // 8-bit values are scaled to 16-bit.
+  std::vector<DivSamplePeak> peaks[DIV_SAMPLE_PEAK_LEVELS];
+  // range of samples which changed since the last updatePeaks()
+  unsigned int peakDirtyStart, peakDirtyEnd;
+  // sample count at the last updatePeaks()
+  unsigned int peakSamples;
+
+  // hash of the data each format was rendered from (see getRenderHash()), or 0 if not rendered.
+  unsigned long long renderHash[DIV_SAMPLE_DEPTH_MAX];
+
   FixedQueue<DivSampleHistory*,128> undoHist;
   FixedQueue<DivSampleHistory*,128> redoHist;
 
@@ -298,9 +324,102 @@ struct DivSample {
 
   /**
    * initialize the rest of sample formats for this sample.
+   * formats which are up to date are not rendered again.
    */
   void render(unsigned int formatMask=0xffffffff);
 
+  /**
+   * calculate a hash of the sample data and of every parameter which affects rendering.
+   * @return the hash. never 0.
+   */
+  unsigned long long getRenderHash();
+
+  /**
+   * get the formats which have to be rendered.
+   * @param formatMask the formats to consider.
+   * @param hash the result of getRenderHash().
+   * @return a mask of formats which are out of date.
+   */
+  unsigned int getRenderNeeded(unsigned int formatMask, unsigned long long hash);
+
+  /**
+   * decode the sample to 16-bit.
+   * this only reads from this sample, so it may be done in parallel with other renders.
+   * @param dest the sample where the result will be stored. may be this one.
+   * @return whether it was successful.
+   */
+  bool renderDecode(DivSample* dest);
+
+  /**
+   * encode 16-bit sample data into another format.
+   * this only reads from this sample, so it may be done in parallel with other renders.
+   * @param d the format.
+   * @param src the 16-bit data.
+   * @param dest the sample where the result will be stored. may be this one.
+   * @return whether it was successful.
+   */
+  bool renderEncode(DivSampleDepth d, short* src, DivSample* dest);
+
+  /**
+   * swap the data of a format with another sample.
+   * used to put a format rendered elsewhere into place.
+   * @param d the format.
+   * @param other the other sample.
+   */
+  void swapBuffer(DivSampleDepth d, DivSample* other);
+
+  /**
+   * make a copy of this sample which can be edited without locking the engine.
+   * only the data of the current format and the parameters are copied (not the history).
+   * @return the copy. put it into place with takeEditCopy().
+   */
+  DivSample* makeEditCopy();
+
+  /**
+   * put the data and the parameters of a copy made by makeEditCopy() into place.
+   * formats which exist in the copy replace the ones in this sample (the old ones go to the copy).
+   * this is cheap, so it may be done while the engine is locked.
+   * @param copy the copy, which shall be deleted afterwards.
+   */
+  void takeEditCopy(DivSample* copy);
+
+  /**
+   * mark a range of samples as changed, so that the peak summary is updated.
+   * this is cheap. call it after writing to the sample data directly.
+   * @param begin the first sample.
+   * @param end the sample after the last one. the default means "until the end".
+   */
+  void invalidatePeaks(unsigned int begin=0, unsigned int end=0xffffffff);
+
+  /**
+   * update the parts of the peak summary which changed.
+   * the cost depends on the size of the changed range.
+   */
+  void updatePeaks();
+
+  /**
+   * get the minimum and maximum of a range of samples using the peak summary.
+   * call updatePeaks() first.
+   * @param begin the first sample.
+   * @param end the sample after the last one.
+   * @param min where the minimum will be stored (16-bit).
+   * @param max where the maximum will be stored (16-bit).
+   * @return false if the range is empty.
+   */
+  bool getPeak(unsigned int begin, unsigned int end, int& min, int& max);
+
+  /**
+   * get the sample data for a format.
+   * @return the sample data, or NULL if not created.
+   */
+  void* getBuf(DivSampleDepth d);
+
+  /**
+   * get the sample data length for a format.
+   * @return the sample data length.
+   */
+  unsigned int getBufLen(DivSampleDepth d);
+
   /**
    * get the sample data for the current depth.
    * @return the sample data, or NULL if not created.
@@ -378,14 +497,42 @@ struct DivSample {
     lengthIMA(0),
     length12(0),
     length4(0),
-    samples(0) {
+    samples(0),
+    peakDirtyStart(0),
+    peakDirtyEnd(0xffffffff),
+    peakSamples(0) {
     for (int i=0; i<DIV_MAX_CHIPS; i++) {
       for (int j=0; j<DIV_MAX_SAMPLE_TYPE; j++) {
         renderOn[j][i]=true;
       }
     }
+    for (int i=0; i<DIV_SAMPLE_DEPTH_MAX; i++) {
+      renderHash[i]=0;
+    }
   }
   ~DivSample();
 };
 
+/**
+ * formats of a sample which are rendered elsewhere, and put into place afterwards.
+ */
+struct DivSampleRenderJob {
+  DivSample* sample;
+  // holds the rendered formats
+  DivSample stage;
+  // result of sample->getRenderHash() before rendering
+  unsigned long long hash;
+  // formats to render
+  unsigned int needed;
+  bool ok[DIV_SAMPLE_DEPTH_MAX];
+  DivSampleRenderJob(DivSample* s, unsigned long long h, unsigned int n):
+    sample(s),
+    hash(h),
+    needed(n) {
+    for (int i=0; i<DIV_SAMPLE_DEPTH_MAX; i++) {
+      ok[i]=false;
+    }
+  }
+};
+
 #endif
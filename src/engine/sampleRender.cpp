@@ -0,0 +1,168 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "engine.h"
+#include "workPool.h"
+#include "../ta-log.h"
+
+struct DivSampleRenderTask {
+  DivSampleRenderJob* job;
+  DivSampleDepth format;
+  DivSampleRenderTask(DivSampleRenderJob* j, DivSampleDepth f):
+    job(j),
+    format(f) {}
+};
+
+static void _renderSampleTask(void* arg) {
+  DivSampleRenderTask* task=(DivSampleRenderTask*)arg;
+  DivSampleRenderJob* job=task->job;
+  DivSample* s=job->sample;
+
+  if (task->format==DIV_SAMPLE_DEPTH_16BIT) {
+    job->ok[task->format]=s->renderDecode(&job->stage);
+    return;
+  }
+
+  // render from the freshly decoded data if there is
+  short* src=s->data16;
+  if (job->needed&(1U<<DIV_SAMPLE_DEPTH_16BIT)) {
+    if (!job->ok[DIV_SAMPLE_DEPTH_16BIT]) return;
+    src=job->stage.data16;
+  }
+  job->ok[task->format]=s->renderEncode(task->format,src,&job->stage);
+}
+
+// run tasks in batches so that the work queues do not fill up
+static void _runSampleTasks(DivWorkPool* pool, std::vector<DivSampleRenderTask>& tasks) {
+  for (size_t i=0; i<tasks.size(); i+=DIV_WORK_QUEUE_SIZE) {
+    for (size_t j=i; j<tasks.size() && j<i+DIV_WORK_QUEUE_SIZE; j++) {
+      pool->push(_renderSampleTask,&tasks[j]);
+    }
+    pool->wait();
+  }
+}
+
+std::vector<DivSampleRenderJob*> DivEngine::prepareSampleRender(int whichSample, unsigned int formatMask) {
+  std::vector<DivSampleRenderJob*> jobs;
+  std::vector<DivSampleRenderTask> decodeTasks;
+  std::vector<DivSampleRenderTask> encodeTasks;
+
+  int first=0;
+  int last=song.sampleLen;
+  if (whichSample>=0) {
+    if (whichSample>=song.sampleLen) return jobs;
+    first=whichSample;
+    last=whichSample+1;
+  } else if (whichSample!=-1) {
+    return jobs;
+  }
+
+  // skip formats which are up to date
+  for (int i=first; i<last; i++) {
+    DivSample* s=song.sample[i];
+    unsigned long long hash=s->getRenderHash();
+    unsigned int needed=s->getRenderNeeded(formatMask,hash);
+    if (needed==0) continue;
+    jobs.push_back(new DivSampleRenderJob(s,hash,needed));
+  }
+  if (jobs.empty()) return jobs;
+
+  for (DivSampleRenderJob* job: jobs) {
+    if (job->needed&(1U<<DIV_SAMPLE_DEPTH_16BIT)) {
+      decodeTasks.push_back(DivSampleRenderTask(job,DIV_SAMPLE_DEPTH_16BIT));
+    }
+    for (int i=0; i<DIV_SAMPLE_DEPTH_16BIT; i++) {
+      if (job->needed&(1U<<i)) {
+        encodeTasks.push_back(DivSampleRenderTask(job,(DivSampleDepth)i));
+      }
+    }
+  }
+
+  logD("rendering %d formats of %d samples...",(int)(decodeTasks.size()+encodeTasks.size()),(int)jobs.size());
+
+  // renderSamplesP() may be running on another thread
+  std::lock_guard<std::mutex> lock(samplePoolLock);
+  if (samplePool==NULL) {
+    unsigned int threads=std::thread::hardware_concurrency();
+    if (threads<2) threads=0;
+    samplePool=new DivWorkPool(threads);
+  }
+
+  // every format is rendered from 16-bit, so decode first
+  _runSampleTasks(samplePool,decodeTasks);
+  _runSampleTasks(samplePool,encodeTasks);
+
+  return jobs;
+}
+
+bool DivEngine::finishSampleRender(std::vector<DivSampleRenderJob*>& jobs, unsigned int formatMask, bool retry) {
+  bool changed=false;
+
+  sPreview.sample=-1;
+  sPreview.pos=0;
+  sPreview.dir=false;
+  checkpointsInvalid=true;
+
+  // step 1: put rendered formats into place
+  for (DivSampleRenderJob* job: jobs) {
+    DivSample* s=job->sample;
+    bool exists=false;
+    for (DivSample* i: song.sample) {
+      if (i==s) {
+        exists=true;
+        break;
+      }
+    }
+    if (!exists) {
+      // sample was deleted while rendering
+      delete job;
+      continue;
+    }
+
+    if (s->getRenderHash()!=job->hash) {
+      // sample was changed while rendering
+      logV("sample changed while rendering. rendering again...");
+      if (retry) {
+        changed=true;
+      } else {
+        s->render(formatMask);
+      }
+    } else {
+      for (int i=0; i<DIV_SAMPLE_DEPTH_MAX; i++) {
+        if (!(job->needed&(1U<<i))) continue;
+        if (!job->ok[i]) continue;
+        s->swapBuffer((DivSampleDepth)i,&job->stage);
+        s->renderHash[i]=job->hash;
+      }
+    }
+
+    // this deletes the old buffers
+    delete job;
+  }
+  jobs.clear();
+  if (changed) return true;
+
+  // step 2: render samples to dispatch
+  for (int i=0; i<song.systemLen; i++) {
+    if (disCont[i].dispatch!=NULL) {
+      disCont[i].dispatch->renderSamples(i);
+    }
+  }
+  return false;
+}
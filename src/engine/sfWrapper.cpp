@@ -21,6 +21,9 @@
 #include "../fileutils.h"
 #include "../ta-log.h"
 #include "sndfile.h"
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
 
 sf_count_t _vioGetSize(void* user) {
   return ((SFWrapper*)user)->ioGetSize();
@@ -54,6 +57,14 @@ sf_count_t SFWrapper::ioGetSize() {
 }
 
 sf_count_t SFWrapper::ioSeek(sf_count_t offset, int whence) {
+  if (mapped!=NULL) {
+    sf_count_t newPos=offset;
+    if (whence==SEEK_CUR) newPos+=mapPos;
+    if (whence==SEEK_END) newPos+=len;
+    if (newPos<0) return -1;
+    mapPos=newPos;
+    return mapPos;
+  }
   fseek(f,offset,whence);
   long ret=ftell(f);
   if (ret<0) {
@@ -63,6 +74,13 @@ sf_count_t SFWrapper::ioSeek(sf_count_t offset, int whence) {
 }
 
 sf_count_t SFWrapper::ioRead(void* ptr, sf_count_t count) {
+  if (mapped!=NULL) {
+    if (mapPos>=len || count<=0) return 0;
+    if ((size_t)count>len-mapPos) count=len-mapPos;
+    memcpy(ptr,mapped+mapPos,count);
+    mapPos+=count;
+    return count;
+  }
   return fread(ptr,1,count,f);
 }
 
@@ -71,16 +89,44 @@ sf_count_t SFWrapper::ioWrite(const void* ptr, sf_count_t count) {
 }
 
 sf_count_t SFWrapper::ioTell() {
+  if (mapped!=NULL) return mapPos;
   return ftell(f);
 }
 
+void SFWrapper::prefetch(size_t offset, size_t count) {
+#ifndef _WIN32
+  if (mapped==NULL) return;
+  if (offset>=len) return;
+  if (count>len-offset) count=len-offset;
+  // madvise() wants a page-aligned address
+  size_t pageMask=4095;
+  size_t alignedOffset=offset&(~pageMask);
+  madvise(mapped+alignedOffset,count+(offset-alignedOffset),MADV_WILLNEED);
+#endif
+}
+
+bool SFWrapper::isMapped() {
+  return (mapped!=NULL);
+}
+
+size_t SFWrapper::getFileSize() {
+  return len;
+}
+
 int SFWrapper::doClose() {
   int ret=sf_close(sf);
+#ifndef _WIN32
+  if (mapped!=NULL) {
+    munmap(mapped,len);
+    mapped=NULL;
+    mapPos=0;
+  }
+#endif
   fclose(f);
   return ret;
 }
 
-SNDFILE* SFWrapper::doOpen(const char* path, int mode, SF_INFO* sfinfo) {
+SNDFILE* SFWrapper::doOpen(const char* path, int mode, SF_INFO* sfinfo, bool map) {
   vio.get_filelen=_vioGetSize;
   vio.read=_vioRead;
   vio.seek=_vioSeek;
@@ -126,10 +172,28 @@ SNDFILE* SFWrapper::doOpen(const char* path, int mode, SF_INFO* sfinfo) {
     return NULL;
   }
 
+#ifndef _WIN32
+  if (map && mode==SFM_READ && len>0) {
+    void* m=mmap(NULL,len,PROT_READ,MAP_PRIVATE,fileno(f),0);
+    if (m==MAP_FAILED) {
+      logW("SFWrapper: could not map file (%s). using regular I/O.",strerror(errno));
+    } else {
+      mapped=(unsigned char*)m;
+      mapPos=0;
+    }
+  }
+#endif
+
   sf=sf_open_virtual(&vio,mode,sfinfo,this);
   if (sf!=NULL) fileMode=mode;
   if (sf==NULL) {
     logE("SFWrapper: WHY IS IT NULL?!");
+#ifndef _WIN32
+    if (mapped!=NULL) {
+      munmap(mapped,len);
+      mapped=NULL;
+    }
+#endif
   }
   return sf;
 }
@@ -33,6 +33,9 @@
 class SFWrapper {
   FILE* f;
   size_t len;
+  // memory-mapped file contents (read mode only, NULL if not mapped)
+  unsigned char* mapped;
+  size_t mapPos;
   SF_VIRTUAL_IO vio;
   SNDFILE* sf;
   int fileMode;
@@ -44,11 +47,25 @@ class SFWrapper {
     sf_count_t ioWrite(const void* ptr, sf_count_t count);
     sf_count_t ioTell();
 
+    /**
+     * tell the OS that a region of the file will be read soon.
+     * does nothing if the file isn't memory-mapped.
+     */
+    void prefetch(size_t offset, size_t count);
+    bool isMapped();
+    size_t getFileSize();
+
     int doClose();
-    SNDFILE* doOpen(const char* path, int mode, SF_INFO* sfinfo);
+    /**
+     * open a file.
+     * @param map whether to memory-map the file (read mode only). falls back to regular I/O if not possible.
+     */
+    SNDFILE* doOpen(const char* path, int mode, SF_INFO* sfinfo, bool map=false);
     SFWrapper():
       f(NULL),
       len(0),
+      mapped(NULL),
+      mapPos(0),
       sf(NULL),
       fileMode(0) {}
 };
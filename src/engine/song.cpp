@@ -38,9 +38,12 @@ DivSongTimestamps::DivSongTimestamps():
   totalTicks(0),
   totalRows(0),
   isLoopDefined(false),
-  isLoopable(true) {
+  isLoopable(true),
+  walkHz(0.0f),
+  walkValid(false) {
   memset(orders,0,DIV_MAX_PATTERNS*sizeof(void*));
   memset(maxRow,0,DIV_MAX_PATTERNS);
+  memset(walkParams,0,11*sizeof(int));
 }
 
 DivSongTimestamps::~DivSongTimestamps() {
@@ -52,10 +55,71 @@ DivSongTimestamps::~DivSongTimestamps() {
   }
 }
 
-void DivSubSong::calcTimestamps(int chans, std::vector<DivGroovePattern>& grooves, int jumpTreatment, int ignoreJumpAtEnd, int brokenSpeedSel, int delayBehavior, int firstPat) {
+bool DivSongWalkState::sameAs(const DivSongWalkState& other) const {
+  if (curOrder!=other.curOrder || curRow!=other.curRow) return false;
+  if (prevOrder!=other.prevOrder || prevRow!=other.prevRow) return false;
+  if (totalRows!=other.totalRows || totalTicks!=other.totalTicks) return false;
+  if (totalTime.seconds!=other.totalTime.seconds || totalTime.micros!=other.totalTime.micros) return false;
+  if (totalMicrosOff!=other.totalMicrosOff || divider!=other.divider) return false;
+  if (curVirtualTempoN!=other.curVirtualTempoN || curVirtualTempoD!=other.curVirtualTempoD) return false;
+  if (nextSpeed!=other.nextSpeed || ticks!=other.ticks || tempoAccum!=other.tempoAccum || curSpeed!=other.curSpeed) return false;
+  if (changeOrd!=other.changeOrd || changePos!=other.changePos) return false;
+  if (shallStopSched!=other.shallStopSched || songWillEnd!=other.songWillEnd) return false;
+  if (loopEndOrder!=other.loopEndOrder || loopEndRow!=other.loopEndRow || isLoopDefined!=other.isLoopDefined) return false;
+  if (curSpeeds.len!=other.curSpeeds.len) return false;
+  if (memcmp(curSpeeds.val,other.curSpeeds.val,16*sizeof(unsigned short))!=0) return false;
+  if (memcmp(rowDelay,other.rowDelay,DIV_MAX_CHANS)!=0) return false;
+  if (memcmp(delayOrder,other.delayOrder,DIV_MAX_CHANS)!=0) return false;
+  if (memcmp(delayRow,other.delayRow,DIV_MAX_CHANS)!=0) return false;
+  if (memcmp(walked,other.walked,8192)!=0) return false;
+  return true;
+}
+
+void DivSubSong::calcTimestamps(int chans, std::vector<DivGroovePattern>& grooves, int jumpTreatment, int ignoreJumpAtEnd, int brokenSpeedSel, int delayBehavior, int firstPat, const bool* dirtyOrders) {
   // reduced version of the playback routine for calculation.
   std::chrono::high_resolution_clock::time_point timeStart=std::chrono::high_resolution_clock::now();
 
+  // find out whether we can resume the previous walk
+  int params[11]={chans,jumpTreatment,ignoreJumpAtEnd,brokenSpeedSel,delayBehavior,firstPat,patLen,ordersLen,virtualTempoN,virtualTempoD,(int)grooves.size()};
+  bool resume=false;
+  size_t resumeAt=0;
+  if (dirtyOrders!=NULL && ts.walkValid && hz==ts.walkHz && memcmp(params,ts.walkParams,11*sizeof(int))==0 && speeds.len==ts.walkSpeeds.len && memcmp(speeds.val,ts.walkSpeeds.val,16*sizeof(unsigned short))==0) {
+    // start from the first time the walk went through a changed order
+    for (size_t i=0; i<ts.walkStates.size(); i++) {
+      if (dirtyOrders[ts.walkStates[i].curOrder]) {
+        resume=true;
+        resumeAt=i;
+        break;
+      }
+    }
+    if (!resume) {
+      logV("calcTimestamps(): no walked orders changed");
+      return;
+    }
+  }
+  memcpy(ts.walkParams,params,11*sizeof(int));
+  ts.walkHz=hz;
+  ts.walkSpeeds=speeds;
+  ts.walkValid=false;
+
+  // keep the previous walk around in case we converge with it
+  std::vector<DivSongWalkState> oldStates;
+  std::vector<DivSongTimestamps::WalkRow> oldLog;
+  DivSongTimestamps oldTs;
+  bool converged=false;
+  ts.walkStates.swap(oldStates);
+  ts.rowLog.swap(oldLog);
+  if (resume) {
+    oldTs.totalTime=ts.totalTime;
+    oldTs.totalTicks=ts.totalTicks;
+    oldTs.totalRows=ts.totalRows;
+    oldTs.loopStart=ts.loopStart;
+    oldTs.loopEnd=ts.loopEnd;
+    oldTs.isLoopDefined=ts.isLoopDefined;
+    oldTs.isLoopable=ts.isLoopable;
+    oldTs.loopStartTime=ts.loopStartTime;
+  }
+
   // reset state
   ts.totalTime=TimeMicros(0,0);
   ts.totalTicks=0;
@@ -72,46 +136,96 @@ void DivSubSong::calcTimestamps(int chans, std::vector<DivGroovePattern>& groove
     }
   }
 
+  // log a row and its timestamp
+  auto applyRow=[this](const DivSongTimestamps::WalkRow& r) {
+    if (r.time.seconds!=-1) {
+      if (ts.orders[r.order]==NULL) {
+        ts.orders[r.order]=new TimeMicros[DIV_MAX_ROWS];
+        for (int i=0; i<DIV_MAX_ROWS; i++) {
+          ts.orders[r.order][i].seconds=-1;
+        }
+      }
+      ts.orders[r.order][r.row]=r.time;
+    }
+    if (ts.maxRow[r.order]<r.row) ts.maxRow[r.order]=r.row;
+  };
+
   // walking state
-  unsigned char wsWalked[8192];
-  memset(wsWalked,0,8192);
-  if (firstPat>0) {
-    memset(wsWalked,255,32*firstPat);
+  DivSongWalkState ws;
+  if (resume) {
+    ws=oldStates[resumeAt];
+    ts.walkStates.assign(oldStates.begin(),oldStates.begin()+resumeAt);
+    ts.rowLog.assign(oldLog.begin(),oldLog.begin()+ws.rowLogPos);
+    for (DivSongTimestamps::WalkRow& i: ts.rowLog) {
+      applyRow(i);
+    }
+    ts.totalTime=ws.totalTime;
+    ts.totalTicks=ws.totalTicks;
+    ts.totalRows=ws.totalRows;
+    ts.loopEnd.order=ws.loopEndOrder;
+    ts.loopEnd.row=ws.loopEndRow;
+    ts.isLoopDefined=ws.isLoopDefined;
+    logV("calcTimestamps(): resuming from order %d (%d/%d)",ws.curOrder,(int)resumeAt,(int)oldStates.size());
+  } else {
+    memset(ws.walked,0,8192);
+    if (firstPat>0) {
+      memset(ws.walked,255,32*firstPat);
+    }
+    ws.curOrder=firstPat;
+    ws.curRow=0;
+    ws.prevOrder=firstPat;
+    ws.prevRow=0;
+    ws.curSpeeds=speeds;
+    ws.curVirtualTempoN=virtualTempoN;
+    ws.curVirtualTempoD=virtualTempoD;
+    ws.nextSpeed=ws.curSpeeds.val[0];
+    ws.divider=hz;
+    ws.totalMicrosOff=0.0;
+    ws.ticks=1;
+    ws.tempoAccum=0;
+    ws.curSpeed=0;
+    ws.changeOrd=-1;
+    ws.changePos=0;
+    ws.shallStopSched=false;
+    ws.songWillEnd=false;
+    memset(ws.rowDelay,0,DIV_MAX_CHANS);
+    memset(ws.delayOrder,0,DIV_MAX_CHANS);
+    memset(ws.delayRow,0,DIV_MAX_CHANS);
+    if (ws.divider<1) ws.divider=1;
   }
-  int curOrder=firstPat;
-  int curRow=0;
-  int prevOrder=firstPat;
-  int prevRow=0;
-  DivGroovePattern curSpeeds=speeds;
-  int curVirtualTempoN=virtualTempoN;
-  int curVirtualTempoD=virtualTempoD;
-  int nextSpeed=curSpeeds.val[0];
-  double divider=hz;
-  double totalMicrosOff=0.0;
-  int ticks=1;
-  int tempoAccum=0;
-  int curSpeed=0;
-  int changeOrd=-1;
-  int changePos=0;
-  unsigned char rowDelay[DIV_MAX_CHANS];
-  unsigned char delayOrder[DIV_MAX_CHANS];
-  unsigned char delayRow[DIV_MAX_CHANS];
-  bool shallStopSched=false;
+  unsigned char* wsWalked=ws.walked;
+  int& curOrder=ws.curOrder;
+  int& curRow=ws.curRow;
+  int& prevOrder=ws.prevOrder;
+  int& prevRow=ws.prevRow;
+  DivGroovePattern& curSpeeds=ws.curSpeeds;
+  int& curVirtualTempoN=ws.curVirtualTempoN;
+  int& curVirtualTempoD=ws.curVirtualTempoD;
+  int& nextSpeed=ws.nextSpeed;
+  double& divider=ws.divider;
+  double& totalMicrosOff=ws.totalMicrosOff;
+  int& ticks=ws.ticks;
+  int& tempoAccum=ws.tempoAccum;
+  int& curSpeed=ws.curSpeed;
+  int& changeOrd=ws.changeOrd;
+  int& changePos=ws.changePos;
+  unsigned char* rowDelay=ws.rowDelay;
+  unsigned char* delayOrder=ws.delayOrder;
+  unsigned char* delayRow=ws.delayRow;
+  bool& shallStopSched=ws.shallStopSched;
+  bool& songWillEnd=ws.songWillEnd;
   bool shallStop=false;
-  bool songWillEnd=false;
   bool endOfSong=false;
   bool rowChanged=false;
-
-  memset(rowDelay,0,DIV_MAX_CHANS);
-  memset(delayOrder,0,DIV_MAX_CHANS);
-  memset(delayRow,0,DIV_MAX_CHANS);
-  if (divider<1) divider=1;
+  int lastStateOrder=-1;
 
   auto tinyProcessRow=[&,this](int i, bool afterDelay) {
     // if this is after delay, use the order/row where delay occurred
     int whatOrder=afterDelay?delayOrder[i]:curOrder;
     int whatRow=afterDelay?delayRow[i]:curRow;
     DivPattern* p=pat[i].getPattern(orders.ord[i][whatOrder],false);
+    // nothing to do in rows without speed, tempo or jump effects
+    if (!(p->getRowFlags(whatRow)&DIV_ROW_FX_FLOW)) return;
     // pre effects
     if (!afterDelay) {
       // set to true if we found an EDxx effect
@@ -351,6 +465,56 @@ void DivSubSong::calcTimestamps(int chans, std::vector<DivGroovePattern>& groove
 
   // MAKE IT WORK
   while (!endOfSong) {
+    // take a snapshot of the walker whenever we enter an order
+    if (curOrder!=lastStateOrder) {
+      ws.totalTime=ts.totalTime;
+      ws.totalTicks=ts.totalTicks;
+      ws.totalRows=ts.totalRows;
+      ws.loopEndOrder=ts.loopEnd.order;
+      ws.loopEndRow=ts.loopEnd.row;
+      ws.isLoopDefined=ts.isLoopDefined;
+      ws.rowLogPos=ts.rowLog.size();
+
+      // if we're back on track and the rest of the previous walk didn't go through
+      // any changed order, it is still valid and we can stop here.
+      if (resume && ts.walkStates.size()>resumeAt) {
+        for (size_t i=resumeAt+1; i<oldStates.size(); i++) {
+          DivSongWalkState& old=oldStates[i];
+          if (old.totalRows>ws.totalRows) break;
+          if (!ws.sameAs(old)) continue;
+
+          bool clean=true;
+          for (int j=0; j<chans; j++) {
+            if (old.rowDelay[j]>0 && dirtyOrders[old.delayOrder[j]]) {
+              clean=false;
+              break;
+            }
+          }
+          for (size_t j=i; j<oldStates.size() && clean; j++) {
+            if (dirtyOrders[oldStates[j].curOrder]) clean=false;
+          }
+          if (!clean) break;
+
+          size_t logBase=old.rowLogPos;
+          for (size_t j=i; j<oldStates.size(); j++) {
+            ts.walkStates.push_back(oldStates[j]);
+            ts.walkStates.back().rowLogPos=ts.rowLog.size()+(oldStates[j].rowLogPos-logBase);
+          }
+          for (size_t j=logBase; j<oldLog.size(); j++) {
+            ts.rowLog.push_back(oldLog[j]);
+            applyRow(oldLog[j]);
+          }
+          logV("calcTimestamps(): converged at order %d (%d/%d)",curOrder,(int)i,(int)oldStates.size());
+          converged=true;
+          break;
+        }
+        if (converged) break;
+      }
+
+      ts.walkStates.push_back(ws);
+      lastStateOrder=curOrder;
+    }
+
     // if the virtual tempo nominator is zero, the song will go on forever.
     if (curVirtualTempoN<1) {
       ts.totalTime.seconds=INT_MAX;
@@ -416,13 +580,8 @@ void DivSubSong::calcTimestamps(int chans, std::vector<DivGroovePattern>& groove
 
     // log row time here
     if (rowChanged && !endOfSong) {
-      if (ts.orders[prevOrder]==NULL) {
-        ts.orders[prevOrder]=new TimeMicros[DIV_MAX_ROWS];
-        for (int i=0; i<DIV_MAX_ROWS; i++) {
-          ts.orders[prevOrder][i].seconds=-1;
-        }
-      }
-      ts.orders[prevOrder][prevRow]=ts.totalTime;
+      ts.rowLog.push_back(DivSongTimestamps::WalkRow(prevOrder,prevRow,ts.totalTime));
+      applyRow(ts.rowLog.back());
       rowChanged=false;
     }
 
@@ -447,10 +606,27 @@ void DivSubSong::calcTimestamps(int chans, std::vector<DivGroovePattern>& groove
     if (ts.maxRow[curOrder]<curRow) ts.maxRow[curOrder]=curRow;
   }
 
-  ts.totalRows--;
-  ts.loopStart.order=prevOrder;
-  ts.loopStart.row=prevRow;
-  ts.loopStartTime=ts.getTimes(ts.loopStart.order,ts.loopStart.row);
+  if (converged) {
+    // the previous walk finished the job for us
+    ts.totalTime=oldTs.totalTime;
+    ts.totalTicks=oldTs.totalTicks;
+    ts.totalRows=oldTs.totalRows;
+    ts.loopStart=oldTs.loopStart;
+    ts.loopEnd=oldTs.loopEnd;
+    ts.isLoopDefined=oldTs.isLoopDefined;
+    ts.isLoopable=oldTs.isLoopable;
+    ts.loopStartTime=oldTs.loopStartTime;
+  } else {
+    // the last position counts towards maxRow but doesn't have a timestamp
+    if (endOfSong) {
+      ts.rowLog.push_back(DivSongTimestamps::WalkRow(curOrder,curRow,TimeMicros(-1,0)));
+    }
+    ts.totalRows--;
+    ts.loopStart.order=prevOrder;
+    ts.loopStart.row=prevRow;
+    ts.loopStartTime=ts.getTimes(ts.loopStart.order,ts.loopStart.row);
+  }
+  ts.walkValid=true;
 
   std::chrono::high_resolution_clock::time_point timeEnd=std::chrono::high_resolution_clock::now();
   logV("calcTimestamps() took %dµs",std::chrono::duration_cast<std::chrono::microseconds>(timeEnd-timeStart).count());
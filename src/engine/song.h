@@ -72,6 +72,34 @@ struct DivGroovePattern {
   }
 };
 
+// state of the timestamp walker, taken whenever it enters an order.
+// used for incremental timestamp calculation.
+struct DivSongWalkState {
+  int curOrder, curRow, prevOrder, prevRow;
+  DivGroovePattern curSpeeds;
+  int curVirtualTempoN, curVirtualTempoD;
+  int nextSpeed;
+  double divider, totalMicrosOff;
+  int ticks, tempoAccum, curSpeed;
+  int changeOrd, changePos;
+  unsigned char rowDelay[DIV_MAX_CHANS];
+  unsigned char delayOrder[DIV_MAX_CHANS];
+  unsigned char delayRow[DIV_MAX_CHANS];
+  bool shallStopSched, songWillEnd;
+  // results so far
+  TimeMicros totalTime;
+  uint64_t totalTicks;
+  int totalRows;
+  int loopEndOrder, loopEndRow;
+  bool isLoopDefined;
+  // position in the row log
+  size_t rowLogPos;
+  unsigned char walked[8192];
+
+  // returns whether the future of both walks is the same (ignoring rowLogPos).
+  bool sameAs(const DivSongWalkState& other) const;
+};
+
 struct DivSongTimestamps {
   // song duration (in seconds and microseconds)
   TimeMicros totalTime;
@@ -101,6 +129,22 @@ struct DivSongTimestamps {
   // call this function to get the timestamp of a row.
   TimeMicros getTimes(int order, int row);
 
+  // walker states and the rows it went through (in order).
+  // these are kept so that calcTimestamps() can resume from the first edited order.
+  std::vector<DivSongWalkState> walkStates;
+  struct WalkRow {
+    unsigned char order, row;
+    TimeMicros time;
+    WalkRow(unsigned char o, unsigned char r, TimeMicros t):
+      order(o), row(r), time(t) {}
+  };
+  std::vector<WalkRow> rowLog;
+  // parameters of the last calculation. if any differs, everything is walked again.
+  int walkParams[11];
+  float walkHz;
+  DivGroovePattern walkSpeeds;
+  bool walkValid;
+
   DivSongTimestamps();
   ~DivSongTimestamps();
 };
@@ -130,8 +174,11 @@ struct DivSubSong {
 
   /**
    * calculate timestamps (loop position, song length and more).
+   * @param dirtyOrders if not NULL, an array of DIV_MAX_PATTERNS bools telling which orders changed since
+   * the last call. only the part of the song starting from the first one of these is walked again,
+   * and only until the walk converges with the previous one.
    */
-  void calcTimestamps(int chans, std::vector<DivGroovePattern>& grooves, int jumpTreatment, int ignoreJumpAtEnd, int brokenSpeedSel, int delayBehavior, int firstPat=0);
+  void calcTimestamps(int chans, std::vector<DivGroovePattern>& grooves, int jumpTreatment, int ignoreJumpAtEnd, int brokenSpeedSel, int delayBehavior, int firstPat=0, const bool* dirtyOrders=NULL);
 
   /**
    * read sub-song data.
@@ -26,6 +26,7 @@
 DivSysDef* DivEngine::sysDefs[DIV_MAX_CHIP_DEFS];
 DivSystem DivEngine::sysFileMapFur[DIV_MAX_CHIP_DEFS];
 DivSystem DivEngine::sysFileMapDMF[DIV_MAX_CHIP_DEFS];
+bool DivEngine::systemsRegistered=false;
 
 DivSystem DivEngine::systemFromFileFur(unsigned char val) {
   return sysFileMapFur[val];
@@ -402,12 +403,12 @@ template<const int shift> int effectValShift(unsigned char, unsigned char val) {
 };
 
 template<const int maxOp> int effectOpVal(unsigned char, unsigned char val) {
-  if ((val>>4)>maxOp) throw DivDoNotHandleEffect();
+  if ((val>>4)>maxOp) return DIV_EFFECT_UNHANDLED;
   return (val>>4)-1;
 };
 
 template<const int maxOp> int effectOpValNoZero(unsigned char, unsigned char val) {
-  if ((val>>4)<1 || (val>>4)>maxOp) throw DivDoNotHandleEffect();
+  if ((val>>4)<1 || (val>>4)>maxOp) return DIV_EFFECT_UNHANDLED;
   return (val>>4)-1;
 };
 
@@ -454,6 +455,12 @@ template<int type, DivInstrumentType insType, DivInstrumentType insType2=DIV_INS
 void DivEngine::registerSystems() {
   logD("registering systems...");
 
+  memset(sysDefs,0,DIV_MAX_CHIP_DEFS*sizeof(void*));
+  for (int i=0; i<DIV_MAX_CHIP_DEFS; i++) {
+    sysFileMapFur[i]=DIV_SYSTEM_NULL;
+    sysFileMapDMF[i]=DIV_SYSTEM_NULL;
+  }
+
   // Common effect handler maps
 
   EffectHandlerMap ayPostEffectHandlerMap={
@@ -25,6 +25,9 @@
 #include <functional>
 #include <initializer_list>
 
+// an EffectValConversion returns this to leave the effect unhandled
+#define DIV_EFFECT_UNHANDLED (-0x7fffffff-1)
+
 typedef int EffectValConversion(unsigned char,unsigned char);
 
 struct EffectHandler {
@@ -44,9 +47,6 @@ struct EffectHandler {
   val2(val2_) {}
 };
 
-struct DivDoNotHandleEffect {
-};
-
 typedef std::unordered_map<unsigned char,const EffectHandler> EffectHandlerMap;
 
 enum DivChanTypes {
@@ -120,6 +120,16 @@ struct DivSysDef {
   const EffectHandlerMap effectHandlers;
   const EffectHandlerMap postEffectHandlers;
   const EffectHandlerMap preEffectHandlers;
+
+  // the handlers above indexed by effect (NULL if there isn't one), so playback doesn't have to search the maps
+  const EffectHandler* effectTable[256];
+  const EffectHandler* postEffectTable[256];
+  const EffectHandler* preEffectTable[256];
+
+  // the tables point into the maps
+  DivSysDef(const DivSysDef&)=delete;
+  DivSysDef& operator=(const DivSysDef&)=delete;
+
   DivSysDef(
     const char* sysName, const char* sysNameJ, unsigned char fileID, unsigned char fileID_DMF, int chans, int minCh, int maxCh,
     bool isFMChip, bool isSTDChip, unsigned int vgmVer, bool compound, unsigned int formatMask, unsigned short waveWid, unsigned short waveHei,
@@ -147,6 +157,14 @@ struct DivSysDef {
     effectHandlers(fxHandlers_),
     postEffectHandlers(postFxHandlers_),
     preEffectHandlers(preFxHandlers_) {
+    for (int i=0; i<256; i++) {
+      effectTable[i]=NULL;
+      postEffectTable[i]=NULL;
+      preEffectTable[i]=NULL;
+    }
+    for (const auto& i: effectHandlers) effectTable[i.first]=&i.second;
+    for (const auto& i: postEffectHandlers) postEffectTable[i.first]=&i.second;
+    for (const auto& i: preEffectHandlers) preEffectTable[i.first]=&i.second;
   }
 };
 
@@ -0,0 +1,679 @@
+/**
+ * Furnace Tracker - multi-system chiptune tracker
+ * Copyright (C) 2021-2026 tildearrow and contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+// self-tests which compare the optimized playback paths against plain ones.
+// see test/furnace-verify.sh.
+
+#include "engine.h"
+#include "workPool.h"
+#include "../ta-log.h"
+
+#define VERIFY_BUFSIZE 2048
+// how much of the song is rendered when comparing renders (in seconds)
+#define VERIFY_RENDER_TIME 60
+#define VERIFY_TASKS 1000
+#define VERIFY_EDITS 20000
+// buffer size used by the audio thread while verifying edits. small, so that it applies edits often.
+#define VERIFY_EDIT_BUFSIZE 64
+
+struct VerifyTask {
+  int cost;
+  int runs;
+  unsigned int result;
+  VerifyTask():
+    cost(0),
+    runs(0),
+    result(0) {}
+};
+
+static void _verifyTask(void* t) {
+  VerifyTask* task=(VerifyTask*)t;
+  unsigned int x=task->cost;
+  for (int i=0; i<task->cost*64; i++) {
+    x=x*1103515245+12345;
+  }
+  task->result=x;
+  task->runs++;
+}
+
+// push every task (in rounds of uneven size, some larger than a queue) and wait for them
+static void _verifyRunTasks(DivWorkPool* pool, VerifyTask* tasks, bool burst) {
+  int pos=0;
+  int round=1;
+  while (pos<VERIFY_TASKS) {
+    if (burst) pool->beginBurst();
+    for (int i=0; i<round && pos<VERIFY_TASKS; i++) {
+      pool->push(_verifyTask,&tasks[pos++]);
+    }
+    pool->wait();
+    if (burst) pool->endBurst();
+    round=(round*7)%(DIV_WORK_QUEUE_SIZE*2)+1;
+  }
+}
+
+static uint64_t _verifyHash(float** buf, int chans, int size) {
+  // FNV-1a
+  uint64_t ret=0xcbf29ce484222325ULL;
+  for (int i=0; i<chans; i++) {
+    const unsigned char* data=(const unsigned char*)buf[i];
+    for (size_t j=0; j<size*sizeof(float); j++) {
+      ret^=data[j];
+      ret*=0x100000001b3ULL;
+    }
+  }
+  return ret;
+}
+
+// compare two renders made by verifyRender(). logs where they differ.
+static bool _verifyCompareRenders(const char* what, std::vector<uint64_t>& base, std::vector<uint64_t>& other) {
+  for (size_t i=0; i<base.size() && i<other.size(); i++) {
+    if (other[i]!=base[i]) {
+      logE("%s: render differs at sample %d",what,(int)(i*VERIFY_BUFSIZE));
+      return false;
+    }
+  }
+  if (other.size()!=base.size()) {
+    logE("%s: render length differs",what);
+    return false;
+  }
+  return true;
+}
+
+void DivEngine::verifyRender(std::vector<uint64_t>& out) {
+  float* outBuf[2];
+  outBuf[0]=new float[VERIFY_BUFSIZE];
+  outBuf[1]=new float[VERIFY_BUFSIZE];
+
+  out.clear();
+  curOrder=0;
+  prevOrder=0;
+  remainingLoops=1;
+  playSub(false);
+
+  size_t maxBufs=(size_t)(got.rate*VERIFY_RENDER_TIME/VERIFY_BUFSIZE);
+  while (playing && out.size()<maxBufs) {
+    nextBuf(NULL,outBuf,0,2,VERIFY_BUFSIZE);
+    out.push_back(_verifyHash(outBuf,2,VERIFY_BUFSIZE));
+  }
+  if (playing) stop();
+
+  delete[] outBuf[0];
+  delete[] outBuf[1];
+}
+
+bool DivEngine::verifyPool() {
+  unsigned int threads=std::thread::hardware_concurrency();
+  if (threads<2) threads=2;
+
+  // every task shall run exactly once, and give the same result as when running them in this thread
+  VerifyTask* expected=new VerifyTask[VERIFY_TASKS];
+  VerifyTask* tasks=new VerifyTask[VERIFY_TASKS];
+  for (int i=0; i<VERIFY_TASKS; i++) {
+    // one expensive task every now and then
+    expected[i].cost=(i%17==0)?500:(i%5);
+  }
+  DivWorkPool* serialPool=new DivWorkPool(0);
+  _verifyRunTasks(serialPool,expected,false);
+  delete serialPool;
+
+  bool ret=true;
+  for (int burst=0; burst<2 && ret; burst++) {
+    for (int i=0; i<VERIFY_TASKS; i++) {
+      tasks[i]=VerifyTask();
+      tasks[i].cost=expected[i].cost;
+    }
+    DivWorkPool* pool=new DivWorkPool(threads);
+    _verifyRunTasks(pool,tasks,burst);
+    delete pool;
+    for (int i=0; i<VERIFY_TASKS; i++) {
+      if (tasks[i].runs!=1 || tasks[i].result!=expected[i].result) {
+        logE("pool (%d threads%s): task %d ran %d times (result %.8x, expected %.8x)",threads,burst?", burst":"",i,tasks[i].runs,tasks[i].result,expected[i].result);
+        ret=false;
+        break;
+      }
+    }
+  }
+  delete[] expected;
+  delete[] tasks;
+  if (!ret) return false;
+
+  // rendering with the render pool shall give the same output as without
+  if (song.systemLen<2) {
+    logI("pool: the song only has one chip. not comparing renders.");
+    return true;
+  }
+  unsigned int prevThreads=renderPoolThreads;
+  bool prevBurst=renderPoolBurst;
+  std::vector<uint64_t> base, base2, pooled;
+
+  // the render pool is created again by nextBuf()
+  renderPoolThreads=0;
+  if (renderPool!=NULL) {
+    delete renderPool;
+    renderPool=NULL;
+  }
+  verifyRender(base);
+  verifyRender(base2);
+  if (base!=base2) {
+    logW("pool: rendering the song twice doesn't give the same output. not comparing renders.");
+  } else {
+    for (int burst=0; burst<2 && ret; burst++) {
+      renderPoolThreads=threads;
+      renderPoolBurst=burst;
+      if (renderPool!=NULL) {
+        delete renderPool;
+        renderPool=NULL;
+      }
+      verifyRender(pooled);
+      ret=_verifyCompareRenders(burst?"pool (render threads, burst)":"pool (render threads)",base,pooled);
+    }
+  }
+
+  renderPoolThreads=prevThreads;
+  renderPoolBurst=prevBurst;
+  if (renderPool!=NULL) {
+    delete renderPool;
+    renderPool=NULL;
+  }
+  return ret;
+}
+
+// compare two sets of song timestamps. returns a description of the first difference, or NULL if they are the same.
+static const char* _verifyTimestamps(DivSongTimestamps& a, DivSongTimestamps& b) {
+  if (a.totalTime.seconds!=b.totalTime.seconds || a.totalTime.micros!=b.totalTime.micros) return "total time";
+  if (a.totalTicks!=b.totalTicks) return "total ticks";
+  if (a.totalRows!=b.totalRows) return "total rows";
+  if (a.loopStart.order!=b.loopStart.order || a.loopStart.row!=b.loopStart.row) return "loop start";
+  if (a.loopEnd.order!=b.loopEnd.order || a.loopEnd.row!=b.loopEnd.row) return "loop end";
+  if (a.isLoopDefined!=b.isLoopDefined || a.isLoopable!=b.isLoopable) return "loop flags";
+  if (a.loopStartTime.seconds!=b.loopStartTime.seconds || a.loopStartTime.micros!=b.loopStartTime.micros) return "loop start time";
+  if (memcmp(a.maxRow,b.maxRow,DIV_MAX_PATTERNS)!=0) return "furthest rows";
+  for (int i=0; i<DIV_MAX_PATTERNS; i++) {
+    for (int j=0; j<DIV_MAX_ROWS; j++) {
+      TimeMicros ta=a.getTimes(i,j);
+      TimeMicros tb=b.getTimes(i,j);
+      if (ta.seconds!=tb.seconds || ta.micros!=tb.micros) return "row times";
+    }
+  }
+  return NULL;
+}
+
+// copy the results of a timestamp calculation (not the walk states)
+static void _verifyCopyTimestamps(DivSongTimestamps& dest, DivSongTimestamps& src) {
+  dest.totalTime=src.totalTime;
+  dest.totalTicks=src.totalTicks;
+  dest.totalRows=src.totalRows;
+  dest.loopStart=src.loopStart;
+  dest.loopEnd=src.loopEnd;
+  dest.isLoopDefined=src.isLoopDefined;
+  dest.isLoopable=src.isLoopable;
+  dest.loopStartTime=src.loopStartTime;
+  memcpy(dest.maxRow,src.maxRow,DIV_MAX_PATTERNS);
+  for (int i=0; i<DIV_MAX_PATTERNS; i++) {
+    if (dest.orders[i]) {
+      delete[] dest.orders[i];
+      dest.orders[i]=NULL;
+    }
+    if (src.orders[i]) {
+      dest.orders[i]=new TimeMicros[DIV_MAX_ROWS];
+      memcpy(dest.orders[i],src.orders[i],DIV_MAX_ROWS*sizeof(TimeMicros));
+    }
+  }
+}
+
+bool DivEngine::verifyWalk() {
+  if (curSubSong==NULL) return true;
+  DivSongTimestamps& ts=curSubSong->ts;
+  bool dirty[DIV_MAX_PATTERNS];
+
+  // walk the whole song
+  calcSongTimestamps();
+  DivSongTimestamps orig;
+  _verifyCopyTimestamps(orig,ts);
+
+  // nothing changed
+  memset(dirty,0,DIV_MAX_PATTERNS*sizeof(bool));
+  calcSongTimestamps(dirty);
+  const char* diff=_verifyTimestamps(ts,orig);
+  if (diff!=NULL) {
+    logE("walk: %s changed without any edits",diff);
+    return false;
+  }
+
+  // put a speed, skip or jump effect in some orders, and compare the incremental walk against a full one.
+  // then take the effect away and compare against the original.
+  int chanEffect=curPat[0].effectCols-1;
+  const short effects[3][2]={
+    {0x0f,3},
+    {0x0d,0},
+    {0x0b,0}
+  };
+  int step=MAX(1,curSubSong->ordersLen/32);
+  bool ret=true;
+  for (int i=0; i<curSubSong->ordersLen && ret; i+=step) {
+    int patIndex=curOrders->ord[0][i];
+    DivPattern* pat=curPat[0].getPattern(patIndex,true);
+    short* cell=pat->newData[0];
+    short oldEffect=cell[DIV_PAT_FX(chanEffect)];
+    short oldEffectVal=cell[DIV_PAT_FXVAL(chanEffect)];
+    const short* effect=effects[(i/step)%3];
+
+    memset(dirty,0,DIV_MAX_PATTERNS*sizeof(bool));
+    for (int j=0; j<curSubSong->ordersLen; j++) {
+      if (curOrders->ord[0][j]==patIndex) dirty[j]=true;
+    }
+
+    cell[DIV_PAT_FX(chanEffect)]=effect[0];
+    cell[DIV_PAT_FXVAL(chanEffect)]=effect[1];
+    pat->invalidateRowFlags();
+    calcSongTimestamps(dirty);
+    DivSongTimestamps incremental;
+    _verifyCopyTimestamps(incremental,ts);
+    calcSongTimestamps();
+    diff=_verifyTimestamps(incremental,ts);
+    if (diff!=NULL) {
+      logE("walk: after putting %.2X%.2X in order %d, %s differ from a full walk",effect[0],effect[1],i,diff);
+      ret=false;
+    }
+
+    cell[DIV_PAT_FX(chanEffect)]=oldEffect;
+    cell[DIV_PAT_FXVAL(chanEffect)]=oldEffectVal;
+    pat->invalidateRowFlags();
+    calcSongTimestamps(dirty);
+    diff=_verifyTimestamps(ts,orig);
+    if (ret && diff!=NULL) {
+      logE("walk: after taking %.2X%.2X away from order %d, %s differ from the original",effect[0],effect[1],i,diff);
+      ret=false;
+    }
+  }
+
+  // leave complete timestamps behind
+  calcSongTimestamps();
+  return ret;
+}
+
+bool DivEngine::verifyPatterns() {
+  static short base[DIV_MAX_ROWS][DIV_MAX_COLS];
+  const size_t patSize=DIV_MAX_ROWS*DIV_MAX_COLS*sizeof(short);
+  bool ret=true;
+
+  // copies share storage until either side is written to, and writes never leak to the other side
+  for (DivSubSong* sub: song.subsong) {
+    for (int i=0; i<song.chans && ret; i++) {
+      for (int j=0; j<DIV_MAX_PATTERNS && ret; j++) {
+        DivPattern* pat=sub->pat[i].data[j];
+        if (pat==NULL) continue;
+        memcpy(base,pat->newData,patSize);
+        // a cell which differs from the original
+        short* origCell=&base[j%DIV_MAX_ROWS][DIV_PAT_NOTE];
+        short newCell=(*origCell==-1)?DIV_NOTE_OFF:-1;
+
+        DivPattern copy(*pat);
+        DivPattern assigned;
+        assigned=*pat;
+        DivPattern copiedOn;
+        pat->copyOn(&copiedOn);
+        if (copy.storage!=pat->storage || assigned.storage!=pat->storage || copiedOn.storage!=pat->storage) {
+          logE("patterns: copy of pattern %d in channel %d doesn't share storage",j,i+1);
+          ret=false;
+          break;
+        }
+        if (memcmp(copy.newData,base,patSize)!=0 || memcmp(assigned.newData,base,patSize)!=0 || memcmp(copiedOn.newData,base,patSize)!=0) {
+          logE("patterns: copy of pattern %d in channel %d differs from the original",j,i+1);
+          ret=false;
+          break;
+        }
+
+        // write to a copy
+        copy.makeUnique();
+        copy.newData[j%DIV_MAX_ROWS][DIV_PAT_NOTE]=newCell;
+        copy.invalidateRowFlags();
+        if (copy.storage==pat->storage || memcmp(pat->newData,base,patSize)!=0 || memcmp(assigned.newData,base,patSize)!=0) {
+          logE("patterns: writing to a copy of pattern %d in channel %d changed the original",j,i+1);
+          ret=false;
+          break;
+        }
+
+        // write to the original, then undo it
+        pat->makeUnique();
+        pat->newData[j%DIV_MAX_ROWS][DIV_PAT_NOTE]=newCell;
+        pat->invalidateRowFlags();
+        bool leaked=(memcmp(assigned.newData,base,patSize)!=0 || memcmp(copiedOn.newData,base,patSize)!=0);
+        pat->newData[j%DIV_MAX_ROWS][DIV_PAT_NOTE]=*origCell;
+        pat->invalidateRowFlags();
+        if (leaked) {
+          logE("patterns: writing to pattern %d in channel %d changed its copies",j,i+1);
+          ret=false;
+          break;
+        }
+
+        // clearing a copy
+        assigned.clear();
+        if (!assigned.isEmpty() || memcmp(pat->newData,base,patSize)!=0 || memcmp(copiedOn.newData,base,patSize)!=0) {
+          logE("patterns: clearing a copy of pattern %d in channel %d went wrong",j,i+1);
+          ret=false;
+          break;
+        }
+      }
+    }
+  }
+  if (!ret) return false;
+
+  // make every pattern of the current sub-song shared, then unique again (like an edit would),
+  // and compare the render against the one before
+  if (curSubSong==NULL) return true;
+  std::vector<uint64_t> render, render2, shared, unique;
+  verifyRender(render);
+  verifyRender(render2);
+  if (render!=render2) {
+    logW("patterns: rendering the song twice doesn't give the same output. not comparing renders.");
+  } else {
+    DivChannelData* copies=new DivChannelData[song.chans];
+    for (int i=0; i<song.chans; i++) {
+      for (int j=0; j<DIV_MAX_PATTERNS; j++) {
+        if (curPat[i].data[j]==NULL) continue;
+        copies[i].data[j]=new DivPattern(*curPat[i].data[j]);
+      }
+    }
+    verifyRender(shared);
+    ret=_verifyCompareRenders("patterns (shared)",render,shared);
+
+    if (ret) {
+      for (int i=0; i<song.chans; i++) {
+        for (int j=0; j<DIV_MAX_PATTERNS; j++) {
+          if (curPat[i].data[j]==NULL) continue;
+          curPat[i].getPattern(j,true);
+          if (curPat[i].data[j]->storage==copies[i].data[j]->storage) {
+            logE("patterns: pattern %d in channel %d is still shared after getPattern(%d,true)",j,i+1,j);
+            ret=false;
+          }
+        }
+      }
+    }
+    if (ret) {
+      verifyRender(unique);
+      ret=_verifyCompareRenders("patterns (unique)",render,unique);
+    }
+
+    for (int i=0; i<song.chans; i++) {
+      copies[i].wipePatterns();
+    }
+    delete[] copies;
+  }
+
+  // nothing is playing, so this frees everything right away
+  freeRetiredPatterns();
+  return ret;
+}
+
+bool DivEngine::verifyEdits() {
+  // play the part of the audio thread
+  std::atomic<bool> audioRunning(true);
+  std::thread audioThread([this,&audioRunning]() {
+    float* outBuf[2];
+    outBuf[0]=new float[VERIFY_EDIT_BUFSIZE];
+    outBuf[1]=new float[VERIFY_EDIT_BUFSIZE];
+    while (audioRunning.load()) {
+      nextBuf(NULL,outBuf,0,2,VERIFY_EDIT_BUFSIZE);
+    }
+    delete[] outBuf[0];
+    delete[] outBuf[1];
+  });
+
+  // post edits like postEdit() does while audio is running, and lock the engine now and then.
+  // every edit shall run exactly once and in order, and leave the engine in the same state
+  // as running them directly.
+  std::vector<int> done;
+  bool expectedMuted[DIV_MAX_CHANS];
+  memcpy(expectedMuted,isMuted,DIV_MAX_CHANS*sizeof(bool));
+  bool ret=true;
+  unsigned int seed=1;
+  for (int i=0; i<VERIFY_EDITS && ret; i++) {
+    seed=seed*1103515245+12345;
+    int ch=(seed>>16)%song.chans;
+    bool mute=(seed>>8)&1;
+    expectedMuted[ch]=mute;
+    std::function<void()> edit=[this,&done,i,ch,mute]() {
+      done.push_back(i);
+      muteChannelNoLock(ch,mute);
+    };
+    if (editQueue.push(edit)==NULL) {
+      BUSY_BEGIN;
+      edit();
+      BUSY_END;
+    }
+
+    if ((i%97)==0 || (i%89)==0) {
+      if ((i%97)==0) {
+        BUSY_BEGIN;
+      } else {
+        BUSY_BEGIN_SOFT;
+      }
+      // locking runs whatever is left in the queue
+      if ((int)done.size()!=i+1) {
+        logE("edits: %d edits ran after locking the engine (expected %d)",(int)done.size(),i+1);
+        ret=false;
+      }
+      BUSY_END;
+    }
+  }
+
+  audioRunning.store(false);
+  audioThread.join();
+
+  BUSY_BEGIN;
+  if (ret) {
+    for (size_t i=0; i<done.size(); i++) {
+      if (done[i]!=(int)i) {
+        logE("edits: edit %d ran in place of edit %d",done[i],(int)i);
+        ret=false;
+        break;
+      }
+    }
+  }
+  if (ret && done.size()!=VERIFY_EDITS) {
+    logE("edits: %d edits ran (expected %d)",(int)done.size(),VERIFY_EDITS);
+    ret=false;
+  }
+  if (ret && memcmp(isMuted,expectedMuted,DIV_MAX_CHANS*sizeof(bool))!=0) {
+    logE("edits: channel mute state differs from running the edits directly");
+    ret=false;
+  }
+  for (int i=0; i<song.chans; i++) {
+    muteChannelNoLock(i,false);
+  }
+  BUSY_END;
+  return ret;
+}
+
+// row flags worked out from the cells, the slow way
+static unsigned char _verifyRowFlags(const short* row) {
+  unsigned char ret=0;
+  if (row[DIV_PAT_NOTE]!=-1 || row[DIV_PAT_INS]!=-1 || row[DIV_PAT_VOL]!=-1) ret|=DIV_ROW_NOTE;
+  for (int i=0; i<DIV_MAX_EFFECTS; i++) {
+    short effect=row[DIV_PAT_FX(i)];
+    if (effect==-1) continue;
+    ret|=DIV_ROW_FX;
+    // the effects handled by the timestamp walker
+    if (effect==0x09 || effect==0x0f || effect==0xfd || effect==0xfe || effect==0x0b || effect==0x0d || effect==0xed || (effect>=0xc0 && effect<=0xc3) || effect==0xf0 || effect==0xff) {
+      ret|=DIV_ROW_FX_FLOW;
+    }
+  }
+  return ret;
+}
+
+// what a seek leaves behind
+struct VerifySeekState {
+  int curOrder, curRow, ticks, curSpeed, tempoAccum, totalTicksR;
+  DivGroovePattern speeds;
+  std::vector<int> chanState;
+  std::vector<uint64_t> render;
+};
+
+void DivEngine::verifySeek(int order, void* state) {
+  VerifySeekState* s=(VerifySeekState*)state;
+  float* outBuf[2];
+  outBuf[0]=new float[VERIFY_BUFSIZE];
+  outBuf[1]=new float[VERIFY_BUFSIZE];
+
+  // don't resume from a checkpoint
+  clearCheckpoints();
+  curOrder=order;
+  prevOrder=order;
+  remainingLoops=-1;
+  playSub(false);
+
+  s->curOrder=curOrder;
+  s->curRow=curRow;
+  s->ticks=ticks;
+  s->curSpeed=curSpeed;
+  s->tempoAccum=tempoAccum;
+  s->totalTicksR=totalTicksR;
+  s->speeds=speeds;
+  s->chanState.clear();
+  for (int i=0; i<song.chans; i++) {
+    DivChannelState& c=chan[i];
+    int vals[10]={c.note,c.lastIns,c.pitch,c.portaNote,c.volume,c.vibratoDepth,c.arp,c.panL,c.panR,c.keyOn};
+    s->chanState.insert(s->chanState.end(),vals,vals+10);
+  }
+
+  // a bit of the song after the seek
+  s->render.clear();
+  for (int i=0; i<16 && playing; i++) {
+    nextBuf(NULL,outBuf,0,2,VERIFY_BUFSIZE);
+    s->render.push_back(_verifyHash(outBuf,2,VERIFY_BUFSIZE));
+  }
+  if (playing) stop();
+
+  delete[] outBuf[0];
+  delete[] outBuf[1];
+}
+
+bool DivEngine::verifyRows() {
+  bool ret=true;
+
+  // the row flags shall match the cells, also after writing to a pattern
+  for (DivSubSong* sub: song.subsong) {
+    for (int i=0; i<song.chans && ret; i++) {
+      for (int j=0; j<DIV_MAX_PATTERNS && ret; j++) {
+        DivPattern* pat=sub->pat[i].data[j];
+        if (pat==NULL) continue;
+        for (int k=0; k<DIV_MAX_ROWS; k++) {
+          if (pat->getRowFlags(k)!=_verifyRowFlags(pat->newData[k])) {
+            logE("rows: flags of row %d in pattern %d of channel %d are %d (expected %d)",k,j,i+1,pat->getRowFlags(k),_verifyRowFlags(pat->newData[k]));
+            ret=false;
+            break;
+          }
+        }
+        if (!ret) break;
+
+        // put a speed effect everywhere in a copy, then clear it
+        DivPattern copy(*pat);
+        copy.makeUnique();
+        for (int k=0; k<DIV_MAX_ROWS; k++) {
+          copy.newData[k][DIV_PAT_FX(j%DIV_MAX_EFFECTS)]=0x0f;
+        }
+        copy.invalidateRowFlags();
+        for (int k=0; k<DIV_MAX_ROWS; k++) {
+          if (copy.getRowFlags(k)!=_verifyRowFlags(copy.newData[k])) {
+            logE("rows: flags of row %d in a copy of pattern %d of channel %d are out of date after writing to it",k,j,i+1);
+            ret=false;
+            break;
+          }
+        }
+        copy.clear();
+        if (ret && copy.getRowFlags(j%DIV_MAX_ROWS)!=0) {
+          logE("rows: flags of a copy of pattern %d of channel %d are out of date after clearing it",j,i+1);
+          ret=false;
+        }
+        if (ret && pat->getRowFlags(j%DIV_MAX_ROWS)!=_verifyRowFlags(pat->newData[j%DIV_MAX_ROWS])) {
+          logE("rows: writing to a copy of pattern %d of channel %d changed its flags",j,i+1);
+          ret=false;
+        }
+      }
+    }
+  }
+  freeRetiredPatterns();
+  if (!ret || curSubSong==NULL) return ret;
+
+  // seeking shall end up in the same place with and without skipping rows
+  VerifySeekState fast, slow, fast2;
+  bool compareRender=true;
+  int step=MAX(1,curSubSong->ordersLen/8);
+  for (int i=step; i<curSubSong->ordersLen && ret; i+=step) {
+    seekRowFlags=true;
+    verifySeek(i,&fast);
+    seekRowFlags=false;
+    verifySeek(i,&slow);
+    seekRowFlags=true;
+    if (compareRender) {
+      verifySeek(i,&fast2);
+      if (fast.render!=fast2.render) {
+        logW("rows: seeking twice doesn't give the same output. only comparing the playback state.");
+        compareRender=false;
+      }
+    }
+
+    if (fast.curOrder!=slow.curOrder || fast.curRow!=slow.curRow || fast.ticks!=slow.ticks || fast.totalTicksR!=slow.totalTicksR) {
+      logE("rows: seeking to order %d lands on %d:%d (tick %d) instead of %d:%d (tick %d)",i,fast.curOrder,fast.curRow,fast.totalTicksR,slow.curOrder,slow.curRow,slow.totalTicksR);
+      ret=false;
+    } else if (fast.curSpeed!=slow.curSpeed || fast.tempoAccum!=slow.tempoAccum || fast.speeds.len!=slow.speeds.len || memcmp(fast.speeds.val,slow.speeds.val,16*sizeof(unsigned short))!=0) {
+      logE("rows: seeking to order %d leaves a different speed",i);
+      ret=false;
+    } else if (fast.chanState!=slow.chanState) {
+      logE("rows: seeking to order %d leaves different channel state",i);
+      ret=false;
+    } else if (compareRender && !_verifyCompareRenders("rows (after seeking)",slow.render,fast.render)) {
+      ret=false;
+    }
+  }
+  seekRowFlags=true;
+  clearCheckpoints();
+  return ret;
+}
+
+bool DivEngine::verify(int which) {
+  bool ret=true;
+  if (which&DIV_VERIFY_POOL) {
+    bool result=verifyPool();
+    printf("[VERIFY] pool: %s\n",result?"OK":"FAIL");
+    if (!result) ret=false;
+  }
+  if (which&DIV_VERIFY_WALK) {
+    bool result=verifyWalk();
+    printf("[VERIFY] walk: %s\n",result?"OK":"FAIL");
+    if (!result) ret=false;
+  }
+  if (which&DIV_VERIFY_PATTERNS) {
+    bool result=verifyPatterns();
+    printf("[VERIFY] patterns: %s\n",result?"OK":"FAIL");
+    if (!result) ret=false;
+  }
+  if (which&DIV_VERIFY_EDITS) {
+    bool result=verifyEdits();
+    printf("[VERIFY] edits: %s\n",result?"OK":"FAIL");
+    if (!result) ret=false;
+  }
+  if (which&DIV_VERIFY_ROWS) {
+    bool result=verifyRows();
+    printf("[VERIFY] rows: %s\n",result?"OK":"FAIL");
+    if (!result) ret=false;
+  }
+  return ret;
+}
@@ -19,6 +19,8 @@
 
 #include "engine.h"
 #include "../ta-log.h"
+#include "mixKernel.h"
+#include "workPool.h"
 #ifdef HAVE_SNDFILE
 #include "sfWrapper.h"
 #endif
@@ -33,6 +35,10 @@ bool DivEngine::isExporting() {
   return exporting;
 }
 
+bool DivEngine::hasExportFailed() {
+  return exportFailed;
+}
+
 void DivEngine::getLoopsLeft(int &loops) {
   if (totalLoops<0 || exportLoopCount==0) {
     loops=0;
@@ -63,6 +69,10 @@ void DivEngine::getTotalAudioFiles(int &files) {
       break;
     }
     case DIV_EXPORT_MODE_MANY_CHAN: {
+      if (exportOnePass) {
+        files=1; // rendered in a single pass, so we think of them as one file
+        break;
+      }
       for (int i=0; i<song.chans; i++) {
         if (!exportChannelMask[i]) continue;
 
@@ -110,6 +120,185 @@ bool DivEngine::getIsFadingOut() {
   return isFadingOut;
 }
 
+bool DivEngine::initExportStems() {
+  quitExportStems();
+
+  bool any=false;
+  for (int i=0; i<song.chans; i++) {
+    if (!exportChannelMask[i]) continue;
+
+    // FM operator channels are exported along with their parent channel
+    int groupEnd=i;
+    if (getChannelType(i)==5) {
+      while (groupEnd+1<song.chans) {
+        if (getChannelType(groupEnd+1)!=5) break;
+        groupEnd++;
+      }
+    }
+
+    int sys=song.dispatchOfChan[i];
+    any=true;
+
+    // the chip itself renders its first channel
+    if (exportStemMain[sys]<0 && disCont[sys].dispatch!=NULL) {
+      exportStemMain[sys]=i;
+      for (int j=0; j<song.chans; j++) {
+        if (song.dispatchOfChan[j]!=sys || song.dispatchChanOfChan[j]<0) continue;
+        disCont[sys].dispatch->muteChannel(song.dispatchChanOfChan[j],j<i || j>groupEnd);
+      }
+      i=groupEnd;
+      continue;
+    }
+
+    DivExportStem* stem=new DivExportStem;
+    stem->sys=sys;
+    stem->chan=i;
+    exportStems.push_back(stem);
+
+    stem->cont.init(song.system[sys],this,song.systemChans[sys],got.rate,song.systemFlags[sys],true);
+    stem->cont.setRates(got.rate);
+    stem->cont.setQuality(lowQuality,dcHiPass);
+    if (stem->cont.dispatch==NULL || stem->cont.bb[0]==NULL) {
+      logW("could not create stem for channel %d! rendering channels separately.",i+1);
+      quitExportStems();
+      return false;
+    }
+    stem->cont.dispatch->renderSamples(sys);
+
+    // mute everything but this channel
+    for (int j=0; j<song.chans; j++) {
+      if (song.dispatchOfChan[j]!=sys || song.dispatchChanOfChan[j]<0) continue;
+      stem->cont.dispatch->muteChannel(song.dispatchChanOfChan[j],j<i || j>groupEnd);
+    }
+
+    i=groupEnd;
+  }
+
+  // the render pool has to be recreated to account for the stems
+  if (renderPool!=NULL) {
+    delete renderPool;
+    renderPool=NULL;
+  }
+
+  logV("created %d export stems",(int)exportStems.size());
+  return any;
+}
+
+void DivEngine::quitExportStems() {
+  // unmute the chips which rendered a channel
+  for (int i=0; i<song.chans; i++) {
+    int sys=song.dispatchOfChan[i];
+    if (exportStemMain[sys]<0 || song.dispatchChanOfChan[i]<0) continue;
+    if (disCont[sys].dispatch==NULL) continue;
+    disCont[sys].dispatch->muteChannel(song.dispatchChanOfChan[i],isMuted[i]);
+  }
+  memset(exportStemMain,-1,DIV_MAX_CHIPS*sizeof(int));
+
+  if (exportStems.empty()) return;
+  for (DivExportStem* i: exportStems) {
+    i->cont.quit();
+    delete i;
+  }
+  exportStems.clear();
+
+  if (renderPool!=NULL) {
+    delete renderPool;
+    renderPool=NULL;
+  }
+}
+
+DivEngine* DivEngine::createExportHelper() {
+  // copy the song through a .fur in memory
+  SafeWriter* w=saveFur(true);
+  if (w==NULL) {
+    logE("could not save song for export helper!");
+    return NULL;
+  }
+  return loadExportHelper(conf,w,curSubSongIndex);
+}
+
+DivEngine* DivEngine::loadExportHelper(DivConfig& helperConf, SafeWriter* snapshot, int subSong) {
+  size_t len=snapshot->size();
+  unsigned char* buf=new unsigned char[len];
+  memcpy(buf,snapshot->getFinalBuf(),len);
+  snapshot->finish();
+  delete snapshot;
+
+  DivEngine* helper=new DivEngine;
+  helper->conf=helperConf;
+  helper->configLoaded=true;
+  // system and ROM export definitions are shared (registered by the first engine)
+  helper->setAudio(DIV_AUDIO_DUMMY);
+  if (!helper->load(buf,len)) {
+    logE("could not load song into export helper! (%s)",helper->getLastError().c_str());
+    delete helper;
+    return NULL;
+  }
+  if (!helper->init()) {
+    logE("could not initialize export helper!");
+    helper->quit(false);
+    delete helper;
+    return NULL;
+  }
+  helper->changeSongP(subSong);
+  return helper;
+}
+
+void DivEngine::finishExportHelpers() {
+  if (exportHelpers.empty()) return;
+  logI("waiting for export helpers...");
+  for (DivEngine* i: exportHelpers) {
+    i->waitAudioFile();
+    if (i->exportFailed) exportFailed=true;
+  }
+
+  BUSY_BEGIN;
+  for (DivEngine* i: exportHelpers) {
+    i->quit(false);
+    delete i;
+  }
+  exportHelpers.clear();
+  BUSY_END;
+}
+
+void DivEngine::mixExportStem(int sys, DivDispatchContainer& cont, float** out, int outChans, unsigned int size) {
+  for (int i=0; i<outChans; i++) {
+    memset(out[i],0,size*sizeof(float));
+  }
+  if (!playing || halted) return;
+
+  // only the chip outputs of the system this stem mirrors are taken into account
+  for (unsigned int i: song.patchbay) {
+    const unsigned short srcPort=i>>16;
+    const unsigned short destPort=i&0xffff;
+
+    if ((srcPort>>4)!=sys) continue;
+    if ((destPort>>4)!=0x000) continue;
+
+    const unsigned char srcSubPort=srcPort&15;
+    const unsigned char destSubPort=destPort&15;
+    if (destSubPort>=outChans) continue;
+    if (srcSubPort>=cont.dispatch->getOutputCount()) continue;
+
+    if (cont.bbOut[srcSubPort]==NULL) continue;
+    mixShortToFloat(out[destSubPort],cont.bbOut[srcSubPort],getChipOutputVol(sys,destSubPort)/32768.0f,size);
+  }
+
+  // force mono audio (if enabled)
+  if (forceMono && outChans>1) {
+    for (size_t i=0; i<size; i++) {
+      float chanSum=out[0][i];
+      for (int j=1; j<outChans; j++) {
+        chanSum+=out[j][i];
+      }
+      out[0][i]=chanSum/outChans;
+      for (int j=1; j<outChans; j++) {
+        out[j][i]=out[0][i];
+      }
+    }
+  }
+}
+
 #ifdef HAVE_SNDFILE
 
 #define MAP_BITRATE \
@@ -165,6 +354,39 @@ bool DivEngine::getIsFadingOut() {
     } \
   }
 
+#define MAP_FORMAT(si) \
+  switch (exportFormat) { \
+    case DIV_EXPORT_FORMAT_WAV: \
+      si.format=SF_FORMAT_WAV; \
+      switch (wavFormat) { \
+        case DIV_EXPORT_WAV_U8: \
+          si.format|=SF_FORMAT_PCM_U8; \
+          break; \
+        case DIV_EXPORT_WAV_S16: \
+          si.format|=SF_FORMAT_PCM_16; \
+          break; \
+        case DIV_EXPORT_WAV_F32: \
+          si.format|=SF_FORMAT_FLOAT; \
+          break; \
+        default: \
+          si.format|=SF_FORMAT_PCM_U8; \
+          break; \
+      } \
+      break; \
+    case DIV_EXPORT_FORMAT_OPUS: \
+      si.format=SF_FORMAT_OGG|SF_FORMAT_OPUS; \
+      break; \
+    case DIV_EXPORT_FORMAT_FLAC: \
+      si.format=SF_FORMAT_FLAC|SF_FORMAT_PCM_16; \
+      break; \
+    case DIV_EXPORT_FORMAT_VORBIS: \
+      si.format=SF_FORMAT_OGG|SF_FORMAT_VORBIS; \
+      break; \
+    case DIV_EXPORT_FORMAT_MPEG_L3: \
+      si.format=SF_FORMAT_MPEG|SF_FORMAT_MPEG_LAYER_III; \
+      break; \
+  }
+
 void DivEngine::runExportThread() {
   size_t fadeOutSamples=got.rate*exportFadeOut;
   size_t curFadeOutSample=0;
@@ -178,41 +400,12 @@ void DivEngine::runExportThread() {
       memset(&si,0,sizeof(SF_INFO));
       si.samplerate=got.rate;
       si.channels=exportOutputs;
-      switch (exportFormat) {
-        case DIV_EXPORT_FORMAT_WAV:
-          si.format=SF_FORMAT_WAV;
-          switch (wavFormat) {
-            case DIV_EXPORT_WAV_U8:
-              si.format|=SF_FORMAT_PCM_U8;
-              break;
-            case DIV_EXPORT_WAV_S16:
-              si.format|=SF_FORMAT_PCM_16;
-              break;
-            case DIV_EXPORT_WAV_F32:
-              si.format|=SF_FORMAT_FLOAT;
-              break;
-            default:
-              si.format|=SF_FORMAT_PCM_U8;
-              break;
-          }
-          break;
-        case DIV_EXPORT_FORMAT_OPUS:
-          si.format=SF_FORMAT_OGG|SF_FORMAT_OPUS;
-          break;
-        case DIV_EXPORT_FORMAT_FLAC:
-          si.format=SF_FORMAT_FLAC|SF_FORMAT_PCM_16;
-          break;
-        case DIV_EXPORT_FORMAT_VORBIS:
-          si.format=SF_FORMAT_OGG|SF_FORMAT_VORBIS;
-          break;
-        case DIV_EXPORT_FORMAT_MPEG_L3:
-          si.format=SF_FORMAT_MPEG|SF_FORMAT_MPEG_LAYER_III;
-          break;
-      }
+      MAP_FORMAT(si);
 
       sf=sfWrap.doOpen(exportPath.c_str(),SFM_WRITE,&si);
       if (sf==NULL) {
         logE("could not open file for writing! (%s)",sf_strerror(NULL));
+        exportFailed=true;
         exporting=false;
         return;
       }
@@ -268,6 +461,7 @@ void DivEngine::runExportThread() {
         
         if (sf_writef_float(sf,outBufFinal,total)!=(int)total) {
           logE("error: failed to write entire buffer!");
+          exportFailed=true;
           break;
         }
       }
@@ -313,6 +507,7 @@ void DivEngine::runExportThread() {
         sf[i]=sfWrap[i].doOpen(fname[i].c_str(),SFM_WRITE,&si[i]);
         if (sf[i]==NULL) {
           logE("could not open file for writing! (%s)",sf_strerror(NULL));
+          exportFailed=true;
           for (int j=0; j<i; j++) {
             sfWrap[i].doClose();
           }
@@ -382,6 +577,7 @@ void DivEngine::runExportThread() {
         for (int i=0; i<song.systemLen; i++) {
           if (sf_writef_short(sf[i],sysBuf[i],total)!=(int)total) {
             logE("error: failed to write entire buffer! (%d)",i);
+            exportFailed=true;
             break;
           }
         }
@@ -424,139 +620,247 @@ void DivEngine::runExportThread() {
       outBufFinal=new float[EXPORT_BUFSIZE*exportOutputs];
 
       logI("rendering to files...");
-      
-      for (int i=0; i<song.chans; i++) {
-        if (!exportChannelMask[i]) continue;
 
-        SNDFILE* sf;
-        SF_INFO si;
-        SFWrapper sfWrap;
-        memset(&si,0,sizeof(SF_INFO));
-        String fname=fmt::sprintf("%s_c%02d.wav",exportPath,i+1);
-        logI("- %s",fname.c_str());
-        si.samplerate=got.rate;
-        si.channels=exportOutputs;
-        switch (exportFormat) {
-          case DIV_EXPORT_FORMAT_WAV:
-            si.format=SF_FORMAT_WAV;
-            switch (wavFormat) {
-              case DIV_EXPORT_WAV_U8:
-                si.format|=SF_FORMAT_PCM_U8;
-                break;
-              case DIV_EXPORT_WAV_S16:
-                si.format|=SF_FORMAT_PCM_16;
-                break;
-              case DIV_EXPORT_WAV_F32:
-                si.format|=SF_FORMAT_FLOAT;
-                break;
-              default:
-                si.format|=SF_FORMAT_PCM_U8;
-                break;
-            }
-            break;
-          case DIV_EXPORT_FORMAT_OPUS:
-            si.format=SF_FORMAT_OGG|SF_FORMAT_OPUS;
-            break;
-          case DIV_EXPORT_FORMAT_FLAC:
-            si.format=SF_FORMAT_FLAC|SF_FORMAT_PCM_16;
-            break;
-          case DIV_EXPORT_FORMAT_VORBIS:
-            si.format=SF_FORMAT_OGG|SF_FORMAT_VORBIS;
-            break;
-          case DIV_EXPORT_FORMAT_MPEG_L3:
-            si.format=SF_FORMAT_MPEG|SF_FORMAT_MPEG_LAYER_III;
-            break;
+      // render all channels in a single pass if possible (see initExportStems()).
+      // otherwise render each channel separately.
+      if (exportOnePass) {
+        // one file for every chip which renders a channel, and for every stem
+        std::vector<int> stemChan;
+        std::vector<int> stemSys;
+        std::vector<DivDispatchContainer*> stemCont;
+        for (int i=0; i<song.systemLen; i++) {
+          if (exportStemMain[i]<0) continue;
+          stemChan.push_back(exportStemMain[i]);
+          stemSys.push_back(i);
+          stemCont.push_back(&disCont[i]);
         }
-
-        sf=sfWrap.doOpen(fname.c_str(),SFM_WRITE,&si);
-        if (sf==NULL) {
-          logE("could not open file for writing! (%s)",sf_strerror(NULL));
-          break;
+        for (DivExportStem* i: exportStems) {
+          stemChan.push_back(i->chan);
+          stemSys.push_back(i->sys);
+          stemCont.push_back(&i->cont);
         }
 
-        MAP_BITRATE;
+        size_t stemCount=stemCont.size();
+        SNDFILE** stemFile=new SNDFILE*[stemCount];
+        memset(stemFile,0,stemCount*sizeof(SNDFILE*));
+        SF_INFO* si=new SF_INFO[stemCount];
+        SFWrapper* sfWrap=new SFWrapper[stemCount];
+        float** stemBuf=new float*[stemCount*DIV_MAX_OUTPUTS];
+        float** stemBufFinal=new float*[stemCount];
 
-        for (int j=0; j<song.chans; j++) {
-          bool mute=(j!=i);
-          isMuted[j]=mute;
-        }
-        if (getChannelType(i)==5) {
-          for (int j=i; j<song.chans; j++) {
-            if (getChannelType(j)!=5) break;
-            isMuted[j]=false;
+        for (size_t i=0; i<stemCount; i++) {
+          memset(&si[i],0,sizeof(SF_INFO));
+          String fname=fmt::sprintf("%s_c%02d.wav",exportPath,stemChan[i]+1);
+          logI("- %s",fname.c_str());
+          si[i].samplerate=got.rate;
+          si[i].channels=exportOutputs;
+          MAP_FORMAT(si[i]);
+
+          SNDFILE* sf=sfWrap[i].doOpen(fname.c_str(),SFM_WRITE,&si[i]);
+          if (sf==NULL) {
+            logE("could not open file for writing! (%s)",sf_strerror(NULL));
+            exportFailed=true;
+            break;
           }
+          stemFile[i]=sf;
+
+          MAP_BITRATE;
         }
-        for (int j=0; j<song.chans; j++) {
-          if (disCont[song.dispatchOfChan[j]].dispatch!=NULL && song.dispatchChanOfChan[j]>=0) {
-            disCont[song.dispatchOfChan[j]].dispatch->muteChannel(song.dispatchChanOfChan[j],isMuted[j]);
+
+        for (size_t i=0; i<stemCount; i++) {
+          for (int j=0; j<exportOutputs; j++) {
+            stemBuf[i*DIV_MAX_OUTPUTS+j]=new float[EXPORT_BUFSIZE];
           }
+          stemBufFinal[i]=new float[EXPORT_BUFSIZE*exportOutputs];
         }
-        
-        curOrder=0;
-        prevOrder=0;
-        curFadeOutSample=0;
-        lastLoopPos=-1;
-        totalLoops=0;
-        isFadingOut=false;
-        remainingLoops=-1;
-        freelance=false;
-        playSub(false);
-        freelance=false;
-
-        while (playing) {
-          size_t total=0;
-          nextBuf(NULL,outBuf,0,exportOutputs,EXPORT_BUFSIZE);
-          if (totalProcessed>EXPORT_BUFSIZE) {
-            logE("error: total processed is bigger than export bufsize! %d>%d",totalProcessed,EXPORT_BUFSIZE);
-            totalProcessed=EXPORT_BUFSIZE;
-          }
-          int fi=0;
-          for (int j=0; j<(int)totalProcessed; j++) {
-            total++;
-            if (isFadingOut) {
-              double mul=(1.0-((double)curFadeOutSample/(double)fadeOutSamples));
-              if (fadeOutSamples<1.0) mul=0.0;
-              for (int k=0; k<exportOutputs; k++) {
-                outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]))*mul;
-              }
-              if (++curFadeOutSample>=fadeOutSamples) {
-                playing=false;
-                break;
+
+        if (!exportFailed) {
+          curOrder=0;
+          prevOrder=0;
+          curFadeOutSample=0;
+          lastLoopPos=-1;
+          totalLoops=0;
+          isFadingOut=false;
+          remainingLoops=-1;
+          freelance=false;
+          playSub(false);
+          freelance=false;
+
+          while (playing && !stopExport) {
+            size_t total=0;
+            nextBuf(NULL,outBuf,0,exportOutputs,EXPORT_BUFSIZE);
+            if (totalProcessed>EXPORT_BUFSIZE) {
+              logE("error: total processed is bigger than export bufsize! %d>%d",totalProcessed,EXPORT_BUFSIZE);
+              totalProcessed=EXPORT_BUFSIZE;
+            }
+            for (size_t i=0; i<stemCount; i++) {
+              mixExportStem(stemSys[i],*stemCont[i],&stemBuf[i*DIV_MAX_OUTPUTS],exportOutputs,EXPORT_BUFSIZE);
+            }
+            int fi=0;
+            for (int j=0; j<(int)totalProcessed; j++) {
+              total++;
+              double mul=1.0;
+              if (isFadingOut) {
+                mul=(1.0-((double)curFadeOutSample/(double)fadeOutSamples));
+                if (fadeOutSamples<1.0) mul=0.0;
               }
-            } else {
-              for (int k=0; k<exportOutputs; k++) {
-                outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]));
+              for (size_t i=0; i<stemCount; i++) {
+                float** buf=&stemBuf[i*DIV_MAX_OUTPUTS];
+                for (int k=0; k<exportOutputs; k++) {
+                  stemBufFinal[i][fi+k]=MAX(-1.0f,MIN(1.0f,buf[k][j]))*mul;
+                }
               }
-              if (lastLoopPos>-1 && j>=lastLoopPos && totalLoops>=exportLoopCount) {
+              fi+=exportOutputs;
+              if (isFadingOut) {
+                if (++curFadeOutSample>=fadeOutSamples) {
+                  playing=false;
+                  break;
+                }
+              } else if (lastLoopPos>-1 && j>=lastLoopPos && totalLoops>=exportLoopCount) {
                 logD("start fading out...");
                 isFadingOut=true;
                 if (fadeOutSamples==0) break;
               }
             }
+            for (size_t i=0; i<stemCount; i++) {
+              if (sf_writef_float(stemFile[i],stemBufFinal[i],total)!=(int)total) {
+                logE("error: failed to write entire buffer! (%d)",(int)i);
+                exportFailed=true;
+                break;
+              }
+            }
+            if (exportFailed) break;
           }
-          if (sf_writef_float(sf,outBufFinal,total)!=(int)total) {
-            logE("error: failed to write entire buffer!");
-            break;
+        }
+
+        for (size_t i=0; i<stemCount; i++) {
+          if (stemFile[i]!=NULL) {
+            if (sfWrap[i].doClose()!=0) {
+              logE("could not close audio file!");
+              exportFailed=true;
+            }
+          }
+          for (int j=0; j<exportOutputs; j++) {
+            delete[] stemBuf[i*DIV_MAX_OUTPUTS+j];
           }
+          delete[] stemBufFinal[i];
         }
+        delete[] stemFile;
+        delete[] si;
+        delete[] sfWrap;
+        delete[] stemBuf;
+        delete[] stemBufFinal;
 
-        curExportChan++;
+        BUSY_BEGIN;
+        quitExportStems();
+        BUSY_END;
+      } else {
+        for (int i=0; i<song.chans; i++) {
+          if (!exportChannelMask[i]) continue;
 
-        if (sfWrap.doClose()!=0) {
-          logE("could not close audio file!");
-        }
+          SNDFILE* sf;
+          SF_INFO si;
+          SFWrapper sfWrap;
+          memset(&si,0,sizeof(SF_INFO));
+          String fname=fmt::sprintf("%s_c%02d.wav",exportPath,i+1);
+          logI("- %s",fname.c_str());
+          si.samplerate=got.rate;
+          si.channels=exportOutputs;
+          MAP_FORMAT(si);
 
-        if (getChannelType(i)==5) {
-          i++;
-          while (true) {
-            if (i>=song.chans) break;
-            if (getChannelType(i)!=5) break;
+          sf=sfWrap.doOpen(fname.c_str(),SFM_WRITE,&si);
+          if (sf==NULL) {
+            logE("could not open file for writing! (%s)",sf_strerror(NULL));
+            exportFailed=true;
+            break;
+          }
+
+          MAP_BITRATE;
+
+          for (int j=0; j<song.chans; j++) {
+            bool mute=(j!=i);
+            isMuted[j]=mute;
+          }
+          if (getChannelType(i)==5) {
+            for (int j=i; j<song.chans; j++) {
+              if (getChannelType(j)!=5) break;
+              isMuted[j]=false;
+            }
+          }
+          for (int j=0; j<song.chans; j++) {
+            if (disCont[song.dispatchOfChan[j]].dispatch!=NULL && song.dispatchChanOfChan[j]>=0) {
+              disCont[song.dispatchOfChan[j]].dispatch->muteChannel(song.dispatchChanOfChan[j],isMuted[j]);
+            }
+          }
+        
+          curOrder=0;
+          prevOrder=0;
+          curFadeOutSample=0;
+          lastLoopPos=-1;
+          totalLoops=0;
+          isFadingOut=false;
+          remainingLoops=-1;
+          freelance=false;
+          playSub(false);
+          freelance=false;
+
+          while (playing) {
+            size_t total=0;
+            nextBuf(NULL,outBuf,0,exportOutputs,EXPORT_BUFSIZE);
+            if (totalProcessed>EXPORT_BUFSIZE) {
+              logE("error: total processed is bigger than export bufsize! %d>%d",totalProcessed,EXPORT_BUFSIZE);
+              totalProcessed=EXPORT_BUFSIZE;
+            }
+            int fi=0;
+            for (int j=0; j<(int)totalProcessed; j++) {
+              total++;
+              if (isFadingOut) {
+                double mul=(1.0-((double)curFadeOutSample/(double)fadeOutSamples));
+                if (fadeOutSamples<1.0) mul=0.0;
+                for (int k=0; k<exportOutputs; k++) {
+                  outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]))*mul;
+                }
+                if (++curFadeOutSample>=fadeOutSamples) {
+                  playing=false;
+                  break;
+                }
+              } else {
+                for (int k=0; k<exportOutputs; k++) {
+                  outBufFinal[fi++]=MAX(-1.0f,MIN(1.0f,outBuf[k][j]));
+                }
+                if (lastLoopPos>-1 && j>=lastLoopPos && totalLoops>=exportLoopCount) {
+                  logD("start fading out...");
+                  isFadingOut=true;
+                  if (fadeOutSamples==0) break;
+                }
+              }
+            }
+            if (sf_writef_float(sf,outBufFinal,total)!=(int)total) {
+              logE("error: failed to write entire buffer!");
+              exportFailed=true;
+              break;
+            }
+          }
+
+          curExportChan++;
+
+          if (sfWrap.doClose()!=0) {
+            logE("could not close audio file!");
+            exportFailed=true;
+          }
+
+          if (getChannelType(i)==5) {
             i++;
+            while (true) {
+              if (i>=song.chans) break;
+              if (getChannelType(i)!=5) break;
+              i++;
+            }
+            i--;
           }
-          i--;
-        }
 
-        if (stopExport) break;
+          if (stopExport || exportFailed) break;
+        }
       }
 
       delete[] outBufFinal;
@@ -571,6 +875,8 @@ void DivEngine::runExportThread() {
         }
       }
 
+      finishExportHelpers();
+
       if (initAudioBackend()) {
         for (int i=0; i<song.systemLen; i++) {
           disCont[i].setRates(got.rate);
@@ -625,6 +931,55 @@ bool DivEngine::saveAudio(const char* path, DivAudioExportOptions options) {
   }
   exporting=true;
   stopExport=false;
+  exportFailed=false;
+  exportOnePass=false;
+
+  // split per-channel export across helper engines if requested.
+  // each one takes every Nth channel (or FM operator group) and renders it on its own thread.
+  if (exportMode==DIV_EXPORT_MODE_MANY_CHAN && options.threads>1) {
+    std::vector<int> groups;
+    for (int i=0; i<song.chans; i++) {
+      if (!exportChannelMask[i]) continue;
+      groups.push_back(i);
+      if (getChannelType(i)==5) {
+        while (i+1<song.chans) {
+          if (getChannelType(i+1)!=5) break;
+          i++;
+        }
+      }
+    }
+
+    int engines=MIN(options.threads,(int)groups.size());
+    for (int i=1; i<engines; i++) {
+      DivAudioExportOptions helperOptions=options;
+      helperOptions.threads=1;
+      memset(helperOptions.channelMask,0,DIV_MAX_CHANS*sizeof(bool));
+      for (size_t j=i; j<groups.size(); j+=engines) {
+        helperOptions.channelMask[groups[j]]=true;
+      }
+
+      DivEngine* helper=createExportHelper();
+      if (helper==NULL) {
+        logW("rendering the remaining channels in this engine.");
+        break;
+      }
+      if (!helper->saveAudio(path,helperOptions)) {
+        helper->quit(false);
+        delete helper;
+        break;
+      }
+      exportHelpers.push_back(helper);
+
+      // this engine no longer renders these channels
+      for (size_t j=i; j<groups.size(); j+=engines) {
+        exportChannelMask[groups[j]]=false;
+      }
+    }
+    if (!exportHelpers.empty()) {
+      logI("exporting with %d engines",(int)exportHelpers.size()+1);
+    }
+  }
+
   stop();
   repeatPattern=false;
   setOrder(0);
@@ -653,6 +1008,13 @@ bool DivEngine::saveAudio(const char* path, DivAudioExportOptions options) {
   if (exportOutputs<1) exportOutputs=1;
   if (exportOutputs>DIV_MAX_OUTPUTS) exportOutputs=DIV_MAX_OUTPUTS;
 
+  // try to create stems for rendering all channels in a single pass
+  if (exportMode==DIV_EXPORT_MODE_MANY_CHAN) {
+    BUSY_BEGIN;
+    exportOnePass=initExportStems();
+    BUSY_END;
+  }
+
   exportLoopCount=options.loops+1;
   exportThread=new std::thread(_runExportThread,this);
   return true;
@@ -666,6 +1028,12 @@ void DivEngine::waitAudioFile() {
 }
 
 bool DivEngine::haltAudioFile() {
+  BUSY_BEGIN;
+  for (DivEngine* i: exportHelpers) {
+    i->stopExport=true;
+    i->stop();
+  }
+  BUSY_END;
   stopExport=true;
   stop();
   waitAudioFile();
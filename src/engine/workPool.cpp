@@ -26,86 +26,62 @@ void* _workThread(void* inst) {
   return NULL;
 }
 
+bool DivWorkQueue::push(const DivPendingTask& task) {
+  unsigned int t=tail.load(std::memory_order_relaxed);
+  if (t-head.load()>=DIV_WORK_QUEUE_SIZE) return false;
+  func[t&(DIV_WORK_QUEUE_SIZE-1)].store(task.func,std::memory_order_relaxed);
+  funcArg[t&(DIV_WORK_QUEUE_SIZE-1)].store(task.funcArg,std::memory_order_relaxed);
+  tail.store(t+1);
+  return true;
+}
+
+bool DivWorkQueue::pop(DivPendingTask& task) {
+  unsigned int h=head.load();
+  while (true) {
+    if ((int)(tail.load()-h)<=0) return false;
+    task.func=func[h&(DIV_WORK_QUEUE_SIZE-1)].load(std::memory_order_relaxed);
+    task.funcArg=funcArg[h&(DIV_WORK_QUEUE_SIZE-1)].load(std::memory_order_relaxed);
+    // if another thread took it first, h is updated and we try again
+    if (head.compare_exchange_weak(h,h+1)) return true;
+  }
+}
+
+bool DivWorkQueue::empty() {
+  return (int)(tail.load()-head.load())<=0;
+}
+
 void DivWorkThread::run() {
-  //std::unique_lock<std::mutex> unique(selfLock);
-  DivPendingTask task;
-  bool setFuckingPromise=false;
+  unsigned int idle=0;
 
   logV("running work thread");
 
   while (true) {
-    lock.lock();
-    if (tasks.empty()) {
-      lock.unlock();
-      isBusy=false;
-      if (setFuckingPromise) {
-        parent->notify.set_value();
-        setFuckingPromise=false;
-        //std::this_thread::yield();
-      }
-      if (terminate) {
-        break;
-      }
-      std::future<void> future=notify.get_future();
-      future.wait();
-      lock.lock();
-      notify=std::promise<void>();
-      promiseAlreadySet=false;
-      lock.unlock();
+    if (parent->runTask(index)) {
+      idle=0;
       continue;
-    } else {
-      task=tasks.front();
-      tasks.pop();
-      lock.unlock();
-
-      task.func(task.funcArg);
-
-      int busyCount=--parent->busyCount;
-      if (busyCount<0) {
-        logE("oh no PROBLEM...");
-      }
-      if (busyCount==0) {
-        setFuckingPromise=true;
-      }
     }
-  }
-}
+    if (parent->terminate) break;
 
-bool DivWorkThread::assign(void (*what)(void*), void* arg) {
-  lock.lock();
-  if (tasks.size()>=30) {
-    lock.unlock();
-    return false;
+    // spin for a while before sleeping (never sleep during a burst)
+    if (parent->burst || ++idle<DIV_WORK_SPIN) {
+      std::this_thread::yield();
+      continue;
+    }
+    idle=0;
+    parent->sleep();
   }
-  tasks.push(DivPendingTask(what,arg));
-  parent->busyCount++;
-  isBusy=true;
-  lock.unlock();
-  return true;
-}
-
-void DivWorkThread::wait() {
-  if (!isBusy) return;
-}
-
-bool DivWorkThread::busy() {
-  return isBusy;
 }
 
 void DivWorkThread::finish() {
-  lock.lock();
-  terminate=true;
-  try {
-    notify.set_value();
-  } catch (std::future_error& e) {
-    logE("future error! beware!");
-  }
-  lock.unlock();
+  if (thread==NULL) return;
   thread->join();
+  delete thread;
+  thread=NULL;
 }
 
-bool DivWorkThread::init(DivWorkPool* p) {
+bool DivWorkThread::init(DivWorkPool* p, unsigned int idx) {
   parent=p;
+  index=idx;
   try {
     thread=new std::thread(_workThread,this);
   } catch (std::system_error& e) {
@@ -116,6 +92,52 @@ bool DivWorkThread::init(DivWorkPool* p) {
   return true;
 }
 
+bool DivWorkPool::runTask(unsigned int index) {
+  DivPendingTask task;
+  bool found=false;
+
+  // try our own queue first
+  if (index<count) {
+    found=workThreads[index].tasks.pop(task);
+  }
+  // then take from the others
+  for (unsigned int i=1; i<=count && !found; i++) {
+    unsigned int victim=(index+i)%count;
+    if (victim==index) continue;
+    found=workThreads[victim].tasks.pop(task);
+  }
+  if (!found) return false;
+
+  task.func(task.funcArg);
+
+  int busyNow=--busyCount;
+  if (busyNow<0) {
+    logE("oh no PROBLEM...");
+  }
+  if (busyNow==0 && waiting) {
+    std::lock_guard<std::mutex> guard(doneLock);
+    doneCond.notify_all();
+  }
+  return true;
+}
+
+bool DivWorkPool::hasTasks() {
+  for (unsigned int i=0; i<count; i++) {
+    if (!workThreads[i].tasks.empty()) return true;
+  }
+  return false;
+}
+
+void DivWorkPool::sleep() {
+  std::unique_lock<std::mutex> unique(sleepLock);
+  sleeping++;
+  // check again after announcing that we are sleeping, so that push() doesn't miss us
+  while (!terminate && !burst && !hasTasks()) {
+    sleepCond.wait(unique);
+  }
+  sleeping--;
+}
+
 void DivWorkPool::push(void (*what)(void*), void* arg) {
   // if no work threads, just execute
   if (!threaded) {
@@ -123,66 +145,85 @@ void DivWorkPool::push(void (*what)(void*), void* arg) {
     return;
   }
 
+  busyCount++;
   for (unsigned int tryCount=0; tryCount<count; tryCount++) {
     if (pos>=count) pos=0;
-    if (workThreads[pos++].assign(what,arg)) return;
+    if (workThreads[pos++].tasks.push(DivPendingTask(what,arg))) {
+      if (sleeping>0) {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        sleepCond.notify_one();
+      }
+      return;
+    }
   }
+  busyCount--;
 
-  // all threads are busy
-  logW("DivWorkPool: all work threads busy!");
+  // all queues are full
+  logW("DivWorkPool: all work queues full!");
   what(arg);
 }
 
 bool DivWorkPool::busy() {
   if (!threaded) return false;
-  for (unsigned int i=0; i<count; i++) {
-    if (workThreads[i].busy()) return true;
-  }
-  return false;
+  return busyCount>0;
 }
 
 void DivWorkPool::wait() {
   if (!threaded) return;
 
-  if (busyCount==0) {
-    return;
-  }
-
-  std::future<void> future=notify.get_future();
-
-  // start running
-  for (unsigned int i=0; i<count; i++) {
-    if (!workThreads[i].promiseAlreadySet && !workThreads[i].tasks.empty()) {
-      try {
-        workThreads[i].lock.lock();
-        workThreads[i].promiseAlreadySet=true;
-        workThreads[i].notify.set_value();
-        workThreads[i].lock.unlock();
-      } catch (std::exception& e) {
-        logE("ERROR IN THREAD SYNC! %s",e.what());
-        abort();
+  // help running tasks, then spin for a while
+  for (unsigned int spin=0; busyCount>0; spin++) {
+    if (runTask(count)) {
+      spin=0;
+      continue;
+    }
+    if (!burst && spin>=DIV_WORK_SPIN) {
+      // sleep until the last task is done
+      std::unique_lock<std::mutex> unique(doneLock);
+      waiting=true;
+      while (busyCount>0) {
+        doneCond.wait(unique);
       }
+      waiting=false;
+      break;
     }
+    std::this_thread::yield();
   }
-  //std::this_thread::yield();
 
-  // wait
-  future.wait();
+  pos=0;
+}
 
-  notify=std::promise<void>();
+void DivWorkPool::beginBurst() {
+  if (!threaded) return;
+  if (burst) return;
+  burst=true;
 
-  pos=0;
+  // wake up all work threads
+  if (sleeping>0) {
+    std::lock_guard<std::mutex> guard(sleepLock);
+    sleepCond.notify_all();
+  }
+}
+
+void DivWorkPool::endBurst() {
+  if (!threaded) return;
+  burst=false;
 }
 
 DivWorkPool::DivWorkPool(unsigned int threads):
   threaded(threads>0),
   count(threads),
   pos(0),
-  busyCount(0) {
+  workThreads(NULL),
+  sleeping(0),
+  terminate(false),
+  waiting(false),
+  busyCount(0),
+  burst(false) {
   if (threaded) {
     workThreads=new DivWorkThread[threads];
     for (unsigned int i=0; i<count; i++) {
-      if (!workThreads[i].init(this)) { 
+      if (!workThreads[i].init(this,i)) { 
         count=i;
         break;
       }
@@ -193,14 +234,17 @@ DivWorkPool::DivWorkPool(unsigned int threads):
       threaded=false;
       workThreads=NULL;
     }
-  } else {
-    workThreads=NULL;
   }
 }
 
 DivWorkPool::~DivWorkPool() {
   if (threaded) {
     if (workThreads!=NULL) {
+      terminate=true;
+      {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        sleepCond.notify_all();
+      }
       for (unsigned int i=0; i<count; i++) {
         workThreads[i].finish();
       }
@@ -22,10 +22,13 @@
 
 #include <thread>
 #include <atomic>
-#include <functional>
-#include <future>
+#include <mutex>
+#include <condition_variable>
 
-#include "../fixedQueue.h"
+// must be a power of 2
+#define DIV_WORK_QUEUE_SIZE 256
+// how many times an idle thread looks for work before sleeping
+#define DIV_WORK_SPIN 1024
 
 class DivWorkPool;
 
@@ -40,32 +43,43 @@ struct DivPendingTask {
     funcArg(NULL) {}
 };
 
+/**
+ * a bounded task queue which does not lock.
+ * only one thread may push to it, but any thread may pop from it.
+ */
+struct DivWorkQueue {
+  std::atomic<void (*)(void*)> func[DIV_WORK_QUEUE_SIZE];
+  std::atomic<void*> funcArg[DIV_WORK_QUEUE_SIZE];
+  std::atomic<unsigned int> head, tail;
+
+  bool push(const DivPendingTask& task);
+  bool pop(DivPendingTask& task);
+  bool empty();
+  DivWorkQueue():
+    head(0),
+    tail(0) {}
+};
+
 struct DivWorkThread {
   DivWorkPool* parent;
-  std::mutex lock;
   std::thread* thread;
-  std::promise<void> notify;
-  FixedQueue<DivPendingTask,32> tasks;
-  std::atomic<bool> isBusy;
-  bool terminate;
-  bool promiseAlreadySet;
+  DivWorkQueue tasks;
+  unsigned int index;
 
   void run();
-  bool assign(void (*what)(void*), void* arg);
-  void wait();
-  bool busy();
   void finish();
 
-  bool init(DivWorkPool* p);
+  bool init(DivWorkPool* p, unsigned int idx);
   DivWorkThread():
     parent(NULL),
-    isBusy(false),
-    terminate(false),
-    promiseAlreadySet(false) {}
+    thread(NULL),
+    index(0) {}
 };
 
 /**
  * this class provides an implementation of a "thread pool" for executing tasks in parallel.
+ * every work thread has its own queue, and idle threads take tasks from the queues of busy ones.
+ * push() and wait() shall only be called from one thread at a time.
  * it is highly recommended to use `new` when allocating a DivWorkPool.
  */
 class DivWorkPool {
@@ -73,13 +87,43 @@ class DivWorkPool {
   unsigned int count;
   unsigned int pos;
   DivWorkThread* workThreads;
+
+  // idle work threads sleep on this
+  std::mutex sleepLock;
+  std::condition_variable sleepCond;
+  std::atomic<int> sleeping;
+  std::atomic<bool> terminate;
+
+  // wait() sleeps on this
+  std::mutex doneLock;
+  std::condition_variable doneCond;
+  std::atomic<bool> waiting;
+
+  friend struct DivWorkThread;
+
+  /**
+   * run a task from the queue of a work thread, or from any other queue if that one is empty.
+   * use the thread count as index to only take from other queues.
+   * returns false if there was nothing to do.
+   */
+  bool runTask(unsigned int index);
+
+  /**
+   * check whether there are tasks in any queue.
+   */
+  bool hasTasks();
+
+  /**
+   * sleep until there are tasks. called by idle work threads.
+   */
+  void sleep();
   public:
-    std::promise<void> notify;
     std::atomic<int> busyCount;
+    std::atomic<bool> burst;
     
     /**
      * push a new job to this work pool.
-     * if all work threads are busy, this will block until one is free.
+     * this does not block. if all queues are full, the job is executed immediately.
      */
     void push(void (*what)(void*), void* arg);
     
@@ -89,10 +133,28 @@ class DivWorkPool {
     bool busy();
 
     /**
-     * wait for all work threads to finish.
+     * wait for all jobs to finish.
+     * the calling thread helps running them in the meantime.
      */
     void wait();
 
+    /**
+     * begin a burst.
+     * during a burst, work threads stay awake and poll for jobs instead of sleeping,
+     * and wait() never sleeps.
+     * this makes push()/wait() much cheaper when they are called many times in a row.
+     * jobs go to the work threads in the order they are pushed after every wait(), so the Nth job
+     * lands on the same thread unless another one takes it.
+     * only call this while the work pool is idle.
+     */
+    void beginBurst();
+
+    /**
+     * end a burst. idle work threads may sleep again.
+     * only call this after wait().
+     */
+    void endBurst();
+
     DivWorkPool(unsigned int threads=0);
     ~DivWorkPool();
 };
@@ -28,6 +28,11 @@
 #define FURNACE_CHANOSC_FFT_RATE 80.0
 #define FURNACE_CHANOSC_FFT_CUTOFF 0.1
 
+// window of the input and of the auto-correlation
+static double chanOscInWindow[FURNACE_CHANOSC_FFT_SIZE];
+static double chanOscCorrWindow[FURNACE_CHANOSC_FFT_SIZE>>1];
+static bool chanOscWindowsReady=false;
+
 const char* chanOscRefs[]={
   _N("None (0%)"),
   _N("None (50%)"),
@@ -102,7 +107,7 @@ void FurnaceGUI::calcChanOsc() {
       if (e->isRunning()) {
         short minLevel=32767;
         short maxLevel=-32768;
-        unsigned short needlePos=buf->needle>>16;
+        unsigned short needlePos=buf->snapshot();
         for (unsigned short i=needlePos-displaySize; i!=needlePos; i++) {
           short y=buf->data[i];
           if (y==-1) continue;
@@ -433,6 +438,16 @@ void FurnaceGUI::drawChanOsc() {
           chanOscWorkPool=new DivWorkPool(settings.chanOscThreads);
         }
 
+        if (!chanOscWindowsReady) {
+          for (int j=0; j<FURNACE_CHANOSC_FFT_SIZE; j++) {
+            chanOscInWindow[j]=0.55-0.45*cos(M_PI*(double)j/(double)(FURNACE_CHANOSC_FFT_SIZE>>1));
+          }
+          for (int j=0; j<(FURNACE_CHANOSC_FFT_SIZE>>1); j++) {
+            chanOscCorrWindow[j]=1.0-((double)j/(double)(FURNACE_CHANOSC_FFT_SIZE<<1));
+          }
+          chanOscWindowsReady=true;
+        }
+
         // fill buffers
         for (int i=0; i<chans; i++) {
           DivDispatchOscBuffer* buf=e->getOscBuffer(i);
@@ -451,7 +466,7 @@ void FurnaceGUI::drawChanOsc() {
           if (fft_->relatedBuf!=NULL) {
             // prepare
             if (centerSettingReset) {
-              fft_->relatedBuf->readNeedle=fft_->relatedBuf->needle>>16;
+              fft_->relatedBuf->readNeedle=fft_->relatedBuf->snapshot();
             }
 
             // check FFT status existence
@@ -460,20 +475,43 @@ void FurnaceGUI::drawChanOsc() {
               fft_->inBuf=(double*)fftw_malloc(FURNACE_CHANOSC_FFT_SIZE*sizeof(double));
               fft_->outBuf=(fftw_complex*)fftw_malloc(FURNACE_CHANOSC_FFT_SIZE*sizeof(fftw_complex));
               fft_->corrBuf=(double*)fftw_malloc(FURNACE_CHANOSC_FFT_SIZE*sizeof(double));
-              fft_->plan=fftw_plan_dft_r2c_1d(FURNACE_CHANOSC_FFT_SIZE,fft_->inBuf,fft_->outBuf,FFTW_ESTIMATE);
-              fft_->planI=fftw_plan_dft_c2r_1d(FURNACE_CHANOSC_FFT_SIZE,fft_->outBuf,fft_->corrBuf,FFTW_ESTIMATE);
-              if (fft_->plan==NULL) {
-                logE(_("failed to create plan!"));
-              } else if (fft_->planI==NULL) {
-                logE(_("failed to create inverse plan!"));
-              } else if (fft_->inBuf==NULL || fft_->outBuf==NULL || fft_->corrBuf==NULL) {
+              if (fft_->inBuf==NULL || fft_->outBuf==NULL || fft_->corrBuf==NULL) {
                 logE(_("failed to create FFT buffers"));
               } else {
-                fft_->ready=true;
+                // the plans are shared. every buffer comes from fftw_malloc() so the alignment matches
+                if (chanOscPlan==NULL) {
+                  chanOscPlan=fftw_plan_dft_r2c_1d(FURNACE_CHANOSC_FFT_SIZE,fft_->inBuf,fft_->outBuf,FFTW_ESTIMATE);
+                }
+                if (chanOscPlanI==NULL) {
+                  chanOscPlanI=fftw_plan_dft_c2r_1d(FURNACE_CHANOSC_FFT_SIZE,fft_->outBuf,fft_->corrBuf,FFTW_ESTIMATE);
+                }
+                if (chanOscPlan==NULL) {
+                  logE(_("failed to create plan!"));
+                } else if (chanOscPlanI==NULL) {
+                  logE(_("failed to create inverse plan!"));
+                } else {
+                  fft_->plan=chanOscPlan;
+                  fft_->planI=chanOscPlanI;
+                  fft_->ready=true;
+                }
               }
             }
 
+            if (!e->isRunning()) fft_->analyzed=false;
+
             if (fft_->ready && e->isRunning()) {
+              // skip if the buffer didn't move and nothing else changed
+              unsigned int snap=fft_->relatedBuf->snapshot();
+              if (fft_->analyzed &&
+                  fft_->snap==snap &&
+                  fft_->windowSize==chanOscWindowSize &&
+                  fft_->waveCorr==chanOscWaveCorr &&
+                  fft_->lastPhaseOff==fft_->phaseOff) {
+                continue;
+              }
+              fft_->snap=snap;
+              fft_->lastPhaseOff=fft_->phaseOff;
+              fft_->analyzed=true;
               fft_->windowSize=chanOscWindowSize;
               fft_->waveCorr=chanOscWaveCorr;
               chanOscWorkPool->push([](void* fft_v) {
@@ -495,7 +533,8 @@ void FurnaceGUI::drawChanOsc() {
                 int displaySize=65536.0f*(fft->windowSize/1000.0f);
                 int displaySize2=65536.0f*(fft->windowSize/500.0f);
                 fft->loudEnough=false;
-                fft->needle=buf->needle>>16;
+                unsigned int snap=fft->snap;
+                fft->needle=(unsigned short)snap;
 
                 // first FFT
                 int k=0;
@@ -508,7 +547,7 @@ void FurnaceGUI::drawChanOsc() {
                     if (j<0) continue;
                     fft->inBuf[j]=(double)lastSample/32768.0;
                     if (fft->inBuf[j]>0.001 || fft->inBuf[j]<-0.001) fft->loudEnough=true;
-                    fft->inBuf[j]*=0.55-0.45*cos(M_PI*(double)j/(double)(FURNACE_CHANOSC_FFT_SIZE>>1));
+                    fft->inBuf[j]*=chanOscInWindow[j];
                   }
                 } else {
                   for (unsigned short j=fft->needle-displaySize2; j!=fft->needle; j++, k++) {
@@ -517,16 +556,20 @@ void FurnaceGUI::drawChanOsc() {
                     if (buf->data[j]!=-1) lastSample=buf->data[j];
                     fft->inBuf[kIn]=(double)lastSample/32768.0;
                     if (fft->inBuf[kIn]>0.001 || fft->inBuf[kIn]<-0.001) fft->loudEnough=true;
-                    fft->inBuf[kIn]*=0.55-0.45*cos(M_PI*(double)kIn/(double)(FURNACE_CHANOSC_FFT_SIZE>>1));
+                    fft->inBuf[kIn]*=chanOscInWindow[kIn];
                   }
                 }
 
+                // the dispatch wrote over what we read (very slow frame?). don't lock into garbage
+                if (!buf->intact(snap,displaySize2)) fft->loudEnough=false;
+
                 // only proceed if not quiet
                 if (fft->loudEnough) {
-                  fftw_execute(fft->plan);
+                  fftw_execute_dft_r2c(fft->plan,fft->inBuf,fft->outBuf);
 
                   // auto-correlation and second FFT
-                  for (int j=0; j<FURNACE_CHANOSC_FFT_SIZE; j++) {
+                  // (only the first half plus one bins are used by a real transform)
+                  for (int j=0; j<=(FURNACE_CHANOSC_FFT_SIZE>>1); j++) {
                     fft->outBuf[j][0]/=FURNACE_CHANOSC_FFT_SIZE;
                     fft->outBuf[j][1]/=FURNACE_CHANOSC_FFT_SIZE;
                     fft->outBuf[j][0]=fft->outBuf[j][0]*fft->outBuf[j][0]+fft->outBuf[j][1]*fft->outBuf[j][1];
@@ -536,11 +579,11 @@ void FurnaceGUI::drawChanOsc() {
                   fft->outBuf[0][1]=0;
                   fft->outBuf[1][0]=0;
                   fft->outBuf[1][1]=0;
-                  fftw_execute(fft->planI);
+                  fftw_execute_dft_c2r(fft->planI,fft->outBuf,fft->corrBuf);
 
                   // window
                   for (int j=0; j<(FURNACE_CHANOSC_FFT_SIZE>>1); j++) {
-                    fft->corrBuf[j]*=1.0-((double)j/(double)(FURNACE_CHANOSC_FFT_SIZE<<1));
+                    fft->corrBuf[j]*=chanOscCorrWindow[j];
                   }
 
                   // find size of period
@@ -575,17 +618,25 @@ void FurnaceGUI::drawChanOsc() {
                     fft->waveLen*=(double)displaySize*2.0/(double)FURNACE_CHANOSC_FFT_SIZE;
 
                     // DFT of one period (x_1)
+                    // the twiddle factor is rotated by one step per sample instead of calling sin/cos
                     double dft[2];
                     dft[0]=0.0;
                     dft[1]=0.0;
+                    const double stepAngle=-2.0*M_PI/fft->waveLen;
+                    const double stepRe=cos(stepAngle);
+                    const double stepIm=sin(stepAngle);
+                    double twRe=1.0;
+                    double twIm=0.0;
                     lastSample=0;
                     for (int j=fft->needle-1-displaySize-(int)fft->waveLen, k=-(displaySize>>1); k<fft->waveLen; j++, k++) {
                       if (buf->data[j&0xffff]!=-1) lastSample=buf->data[j&0xffff];
                       if (k<0) continue;
                       double one=((double)lastSample/32768.0);
-                      double two=(double)k*(-2.0*M_PI)/fft->waveLen;
-                      dft[0]+=one*cos(two);
-                      dft[1]+=one*sin(two);
+                      dft[0]+=one*twRe;
+                      dft[1]+=one*twIm;
+                      const double nextRe=twRe*stepRe-twIm*stepIm;
+                      twIm=twRe*stepIm+twIm*stepRe;
+                      twRe=nextRe;
                     }
 
                     // calculate and lock into phase
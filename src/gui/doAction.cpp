@@ -1256,12 +1256,10 @@ void FurnaceGUI::doAction(int what) {
       sampleClipboardLen=end-start;
       memcpy(sampleClipboard,&(sample->data16[start]),sizeof(short)*(end-start));
 
-      e->lockEngine([this,sample,start,end]() {
+      editSample(sample,[this,start,end](DivSample* sample) {
         sample->strip(start,end);
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       sampleSelStart=-1;
       sampleSelEnd=-1;
@@ -1295,7 +1293,7 @@ void FurnaceGUI::doAction(int what) {
       if (pos<0) pos=0;
       logV("paste position: %d",pos);
 
-      e->lockEngine([this,sample,pos]() {
+      editSample(sample,[this,pos](DivSample* sample) {
         if (!sample->insert(pos,sampleClipboardLen)) {
           showError(_("couldn't paste! make sure your sample is 8 or 16-bit."));
         } else {
@@ -1307,7 +1305,6 @@ void FurnaceGUI::doAction(int what) {
             memcpy(&(sample->data16[pos]),sampleClipboard,sizeof(short)*sampleClipboardLen);
           }
         }
-        e->renderSamples(curSample);
       });
       sampleSelStart=pos;
       sampleSelEnd=pos+sampleClipboardLen;
@@ -1326,7 +1323,8 @@ void FurnaceGUI::doAction(int what) {
       if (pos>=(int)sample->samples) pos=sample->samples-1;
       if (pos<0) pos=0;
 
-      e->lockEngine([this,sample,pos]() {
+      editSample(sample,[this,pos](DivSample* sample) {
+        sample->invalidatePeaks(pos,pos+sampleClipboardLen);
         if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
           for (size_t i=0; i<sampleClipboardLen; i++) {
             if (pos+i>=sample->samples) break;
@@ -1338,7 +1336,6 @@ void FurnaceGUI::doAction(int what) {
             sample->data16[pos+i]=sampleClipboard[i];
           }
         }
-        e->renderSamples(curSample);
       });
       sampleSelStart=pos;
       sampleSelEnd=pos+sampleClipboardLen;
@@ -1358,7 +1355,8 @@ void FurnaceGUI::doAction(int what) {
       if (pos>=(int)sample->samples) pos=sample->samples-1;
       if (pos<0) pos=0;
 
-      e->lockEngine([this,sample,pos]() {
+      editSample(sample,[this,pos](DivSample* sample) {
+        sample->invalidatePeaks(pos,pos+sampleClipboardLen);
         if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
           for (size_t i=0; i<sampleClipboardLen; i++) {
             if (pos+i>=sample->samples) break;
@@ -1376,7 +1374,6 @@ void FurnaceGUI::doAction(int what) {
             sample->data16[pos+i]=val;
           }
         }
-        e->renderSamples(curSample);
       });
       sampleSelStart=pos;
       sampleSelEnd=pos+sampleClipboardLen;
@@ -1411,8 +1408,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
         float maxVal=0.0f;
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
@@ -1449,8 +1447,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1460,8 +1456,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1481,8 +1478,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1492,8 +1487,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1513,8 +1509,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1528,8 +1522,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1543,8 +1538,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1554,14 +1547,12 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
 
         sample->strip(start,end);
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       sampleSelStart=-1;
       sampleSelEnd=-1;
@@ -1573,14 +1564,12 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
 
         sample->trim(start,end);
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       sampleSelStart=-1;
       sampleSelEnd=-1;
@@ -1592,8 +1581,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1615,8 +1605,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1626,8 +1614,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1643,8 +1632,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1654,8 +1641,9 @@ void FurnaceGUI::doAction(int what) {
       DivSample* sample=e->song.sample[curSample];
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
+        sample->invalidatePeaks(start,end);
 
         if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
           for (unsigned int i=start; i<end; i++) {
@@ -1669,8 +1657,6 @@ void FurnaceGUI::doAction(int what) {
 
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1795,7 +1781,7 @@ void FurnaceGUI::doAction(int what) {
       if (curSample<0 || curSample>=(int)e->song.sample.size()) break;
       DivSample* sample=e->song.sample[curSample];
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         SAMPLE_OP_BEGIN;
 
         sample->loopStart=start;
@@ -1803,8 +1789,6 @@ void FurnaceGUI::doAction(int what) {
         sample->loop=true;
         updateSampleTex=true;
         notifySampleChange=true;
-
-        e->renderSamples(curSample);
       });
       MARK_MODIFIED;
       break;
@@ -1902,11 +1886,10 @@ void FurnaceGUI::doAction(int what) {
       if (!sample->isLoopable()) break;
       if ((unsigned int)sample->loopEnd>=sample->samples) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         sample->trim(0,sample->loopEnd);
         updateSampleTex=true;
         notifySampleChange=true;
-        e->renderSamples(curSample);
       });
       sampleSelStart=-1;
       sampleSelEnd=-1;
@@ -1920,14 +1903,13 @@ void FurnaceGUI::doAction(int what) {
       if (sample->depth!=DIV_SAMPLE_DEPTH_8BIT && sample->depth!=DIV_SAMPLE_DEPTH_16BIT) break;
       if (!sample->isLoopable()) break;
       sample->prepareUndo(true);
-      e->lockEngine([this,sample]() {
+      editSample(sample,[this](DivSample* sample) {
         int loopLen=sample->loopEnd-sample->loopStart;
         sample->trim(sample->loopStart,sample->loopEnd);
         sample->loopStart=0;
         sample->loopEnd=loopLen;
         updateSampleTex=true;
         notifySampleChange=true;
-        e->renderSamples(curSample);
       });
       sampleSelStart=-1;
       sampleSelEnd=-1;
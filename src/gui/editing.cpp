@@ -185,7 +185,13 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
       if (!s.ord.empty()) {
         doPush=true;
       }
-      recalcTimestamps=true;
+      if (oldOrdersLen!=e->curSubSong->ordersLen) {
+        recalcTimestamps=true;
+      } else {
+        for (UndoOrderData& i: s.ord) {
+          markTimestampsOrder(i.ord);
+        }
+      }
       break;
     case GUI_UNDO_PATTERN_EDIT:
     case GUI_UNDO_PATTERN_DELETE:
@@ -238,7 +244,10 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
                       op->newData[j][fxCol]==0xc1 ||
                       op->newData[j][fxCol]==0xc2 ||
                       op->newData[j][fxCol]==0xc3 ||
+                      op->newData[j][fxCol]==0xed ||
                       op->newData[j][fxCol]==0xf0 ||
+                      op->newData[j][fxCol]==0xfd ||
+                      op->newData[j][fxCol]==0xfe ||
                       op->newData[j][fxCol]==0xff ||
                       p->newData[j][fxCol]==0x09 ||
                       p->newData[j][fxCol]==0x0b ||
@@ -248,10 +257,13 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
                       p->newData[j][fxCol]==0xc1 ||
                       p->newData[j][fxCol]==0xc2 ||
                       p->newData[j][fxCol]==0xc3 ||
+                      p->newData[j][fxCol]==0xed ||
                       p->newData[j][fxCol]==0xf0 ||
+                      p->newData[j][fxCol]==0xfd ||
+                      p->newData[j][fxCol]==0xfe ||
                       p->newData[j][fxCol]==0xff) {
                     logV("recalcTimestamps due to speed effect.");
-                    recalcTimestamps=true;
+                    markTimestampsPat(i,e->curOrders->ord[i][h]);
                   }
                 }
 
@@ -261,6 +273,7 @@ void FurnaceGUI::makeUndo(ActionType action, UndoRegion region) {
         }
       }
       if (!s.pat.empty()) {
+        invalidateRowFlags(s);
         doPush=true;
       }
       break;
@@ -1866,6 +1879,7 @@ void FurnaceGUI::doCollapseSong(int divider) {
   }
 
   if (!us.pat.empty()) {
+    invalidateRowFlags(us);
     undoHist.push_back(us);
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
@@ -1943,6 +1957,7 @@ void FurnaceGUI::doExpandSong(int multiplier) {
   }
 
   if (!us.pat.empty()) {
+    invalidateRowFlags(us);
     undoHist.push_back(us);
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
@@ -2146,6 +2161,50 @@ void FurnaceGUI::moveSelected(int x, int y) {
   makeUndo(GUI_UNDO_PATTERN_DRAG,UndoRegion(firstOrder,0,0,lastOrder,e->getTotalChannelCount()-1,e->curSubSong->patLen-1));
 }
 
+void FurnaceGUI::markTimestampsOrder(int order) {
+  if (order<0 || order>=DIV_MAX_PATTERNS) return;
+  recalcTimestampsOrders[order]=true;
+  recalcTimestampsPartial=true;
+}
+
+void FurnaceGUI::markTimestampsPat(int chan, int pat) {
+  // patterns may be shared, so every order using it is affected
+  for (int i=0; i<e->curSubSong->ordersLen; i++) {
+    if (e->curOrders->ord[chan][i]==pat) recalcTimestampsOrders[i]=true;
+  }
+  recalcTimestampsPartial=true;
+}
+
+void FurnaceGUI::invalidateRowFlags(const UndoStep& us) {
+  for (const UndoPatternData& i: us.pat) {
+    if (i.subSong<0 || i.subSong>=(int)e->song.subsong.size()) continue;
+    e->song.subsong[i.subSong]->pat[i.chan].getPattern(i.pat,false)->invalidateRowFlags();
+  }
+}
+
+void FurnaceGUI::markTimestampsUndo(const UndoStep& us) {
+  // anything other than pattern/order data requires a full recalculation
+  if (!us.other.empty() || us.oldOrdersLen!=us.newOrdersLen || us.type==GUI_UNDO_REPLACE || us.type==GUI_UNDO_PATTERN_COLLAPSE_SONG || us.type==GUI_UNDO_PATTERN_EXPAND_SONG) {
+    recalcTimestamps=true;
+    return;
+  }
+  int subSong=e->getCurrentSubSong();
+  for (const UndoOrderData& i: us.ord) {
+    if (i.subSong!=subSong) {
+      recalcTimestamps=true;
+      return;
+    }
+    markTimestampsOrder(i.ord);
+  }
+  for (const UndoPatternData& i: us.pat) {
+    if (i.subSong!=subSong) {
+      recalcTimestamps=true;
+      return;
+    }
+    markTimestampsPat(i.chan,i.pat);
+  }
+}
+
 void FurnaceGUI::doUndo() {
   if (undoHist.empty()) return;
   UndoStep& us=undoHist.back();
@@ -2184,6 +2243,7 @@ void FurnaceGUI::doUndo() {
         DivPattern* p=e->curPat[i.chan].getPattern(i.pat,true);
         p->newData[i.row][i.col]=i.oldVal;
       }
+      invalidateRowFlags(us);
       if (us.type!=GUI_UNDO_REPLACE) {
         if (!e->isPlaying() || !followPattern) {
           cursor=us.oldCursor;
@@ -2199,7 +2259,7 @@ void FurnaceGUI::doUndo() {
       break;
   }
 
-  recalcTimestamps=true;
+  markTimestampsUndo(us);
 
   bool shallReplay=false;
   for (UndoOtherData& i: us.other) {
@@ -2263,6 +2323,7 @@ void FurnaceGUI::doRedo() {
         DivPattern* p=e->curPat[i.chan].getPattern(i.pat,true);
         p->newData[i.row][i.col]=i.newVal;
       }
+      invalidateRowFlags(us);
       if (us.type!=GUI_UNDO_REPLACE) {
         if (!e->isPlaying() || !followPattern) {
           cursor=us.newCursor;
@@ -2278,7 +2339,7 @@ void FurnaceGUI::doRedo() {
       break;
   }
 
-  recalcTimestamps=true;
+  markTimestampsUndo(us);
 
   bool shallReplay=false;
   for (UndoOtherData& i: us.other) {
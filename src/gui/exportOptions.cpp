@@ -56,6 +56,9 @@ void FurnaceGUI::drawExportAudio(bool onWindow) {
   if (ImGui::RadioButton(_("multiple files (one per channel)"),audioExportOptions.mode==DIV_EXPORT_MODE_MANY_CHAN)) {
     audioExportOptions.mode=DIV_EXPORT_MODE_MANY_CHAN;
   }
+  if (ImGui::IsItemHovered()) {
+    ImGui::SetTooltip(_("the song is only played once, but every exported channel is emulated by its own copy of the chip.\nexporting many channels of a chip takes as long as emulating that many chips."));
+  }
   ImGui::Unindent();
   ImGui::Separator();
 
@@ -159,6 +162,14 @@ void FurnaceGUI::drawExportAudio(bool onWindow) {
 
   bool isOneOn=false;
   if (audioExportOptions.mode==DIV_EXPORT_MODE_MANY_CHAN) {
+    if (ImGui::InputInt(_("Threads"),&audioExportOptions.threads,1,4)) {
+      if (audioExportOptions.threads<1) audioExportOptions.threads=1;
+      if (audioExportOptions.threads>DIV_MAX_CHANS) audioExportOptions.threads=DIV_MAX_CHANS;
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(_("render this many channels at once, each in its own copy of the song.\nuses more memory."));
+    }
+
     ImGui::Text(_("Channels to export:"));
     ImGui::SameLine();
     if (ImGui::SmallButton(_("All"))) {
@@ -536,6 +547,14 @@ void FurnaceGUI::commandExportOptions() {
   ImGui::Checkbox(_("Don't optimize command calls"),&csExportOptions.noCmdCallOpt);
   ImGui::Checkbox(_("Don't condense delays"),&csExportOptions.noDelayCondense);
   ImGui::Checkbox(_("Don't perform sub-block search"),&csExportOptions.noSubBlock);
+  ImGui::BeginDisabled(csExportOptions.noSubBlock);
+  int subBlockThreads=csExportOptions.subBlockThreads;
+  if (ImGui::InputInt(_("Sub-block search threads (0: auto)"),&subBlockThreads)) {
+    if (subBlockThreads<0) subBlockThreads=0;
+    if (subBlockThreads>32) subBlockThreads=32;
+    csExportOptions.subBlockThreads=subBlockThreads;
+  }
+  ImGui::EndDisabled();
 }
 
 void FurnaceGUI::drawExportCommand(bool onWindow) {
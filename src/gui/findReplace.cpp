@@ -462,6 +462,7 @@ void FurnaceGUI::doReplace() {
   recalcTimestamps=true;
 
   if (!us.pat.empty()) {
+    invalidateRowFlags(us);
     undoHist.push_back(us);
     redoHist.clear();
     if (undoHist.size()>settings.maxUndoSteps) undoHist.pop_front();
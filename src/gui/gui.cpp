@@ -1460,12 +1460,13 @@ void FurnaceGUI::noteInput(int num, int key, int vol, int chanOff) {
 
   logV("noteInput: chan %d, offset %d, %d:%d %d/%d",ch,chanOff,ord,y,tick,speed);
 
+  // prepare undo first, as getting the pattern for writing un-shares it from the undo snapshot
+  prepareUndo(GUI_UNDO_PATTERN_EDIT,UndoRegion(ord,ch,y,ord,ch,y));
+
   DivPattern* pat=e->curPat[ch].getPattern(e->curOrders->ord[ch][ord],true);
   bool removeIns=false;
   bool doNotAdvance=false;
 
-  prepareUndo(GUI_UNDO_PATTERN_EDIT,UndoRegion(ord,ch,y,ord,ch,y));
-
   if (key==GUI_NOTE_OFF) { // note off
     pat->newData[y][DIV_PAT_NOTE]=DIV_NOTE_OFF;
     removeIns=true;
@@ -1535,8 +1536,8 @@ void FurnaceGUI::valueInput(int num, bool direct, int target) {
     e->getPlayPos(ord,y);
   }
 
-  DivPattern* pat=e->curPat[ch].getPattern(e->curOrders->ord[ch][ord],true);
   prepareUndo(GUI_UNDO_PATTERN_EDIT);
+  DivPattern* pat=e->curPat[ch].getPattern(e->curOrders->ord[ch][ord],true);
   if (target==-1) target=cursor.xFine;
   if (direct) {
     pat->newData[y][target]=num&0xff;
@@ -1642,8 +1643,8 @@ void FurnaceGUI::rawFreqInput(int num) {
     e->getPlayPos(ord,y);
   }
 
-  DivPattern* pat=e->curPat[ch].getPattern(e->curOrders->ord[ch][ord],true);
   prepareUndo(GUI_UNDO_PATTERN_EDIT);
+  DivPattern* pat=e->curPat[ch].getPattern(e->curOrders->ord[ch][ord],true);
 
   unsigned int val=(
     pat->newData[y][DIV_PAT_RAW0]|
@@ -2944,17 +2945,100 @@ void FurnaceGUI::exportAudio(String path, DivAudioExportModes mode) {
 }
 
 void FurnaceGUI::exportCmdStream(bool target, String path) {
+  if (csExportJob!=NULL) {
+    showError(_("a command stream export is already in progress."));
+    return;
+  }
   csExportPath=path;
   csExportTarget=target;
-  csExportDone=false;
-  csExportThread=new std::thread([this]() {
-    SafeWriter* w=e->saveCommand(&csProgress,csExportOptions);
-    csExportResult=w;
-    csExportDone=true;
-  });
+  csExportJob=new DivExportJob(DIV_EXPORT_JOB_CMD_STREAM);
+  csExportJob->csOptions=csExportOptions;
+  if (!csExportJob->go(e)) {
+    showError(fmt::sprintf(_("could not write command stream! (%s)"),csExportJob->getLastError()));
+    delete csExportJob;
+    csExportJob=NULL;
+    return;
+  }
   displayExportingCS=true;
 }
 
+void FurnaceGUI::runExportJob(DivExportJob* job, String path, bool multiFile) {
+  if (!job->go(e)) {
+    showError(fmt::sprintf(_("could not begin exporting process! (%s)"),job->getLastError()));
+    delete job;
+    return;
+  }
+  exportJobs.push_back(FurnaceGUIExportJob(job,path,multiFile));
+}
+
+void FurnaceGUI::drawExportJobs() {
+  if (exportJobs.empty()) return;
+
+  // save the results of finished jobs
+  for (size_t i=0; i<exportJobs.size(); i++) {
+    FurnaceGUIExportJob& j=exportJobs[i];
+    if (j.job->isRunning()) continue;
+    j.job->wait();
+    if (j.job->hasFailed()) {
+      showError(fmt::sprintf(_("could not export %s! (%s)"),j.path,j.job->getLastError()));
+    } else {
+      for (DivROMExportOutput& k: j.job->getResult()) {
+        String path=j.path;
+        if (j.multiFile) {
+          path+=DIR_SEPARATOR_STR;
+          path+=k.name;
+        }
+        FILE* outFile=ps_fopen(path.c_str(),"wb");
+        if (outFile!=NULL) {
+          fwrite(k.data->getFinalBuf(),1,k.data->size(),outFile);
+          fclose(outFile);
+        } else {
+          showError(fmt::sprintf(_("could not open file! (%s)"),path));
+        }
+        k.data->finish();
+        delete k.data;
+      }
+      if (!j.multiFile) pushRecentSys(j.path.c_str());
+      if (!j.job->getWarnings().empty()) {
+        showWarning(j.job->getWarnings(),GUI_WARN_GENERIC);
+      }
+    }
+    delete j.job;
+    exportJobs.erase(exportJobs.begin()+i);
+    i--;
+  }
+  if (exportJobs.empty()) return;
+
+  WAKE_UP;
+  if (ImGui::Begin("Exports",NULL,ImGuiWindowFlags_AlwaysAutoResize|ImGuiWindowFlags_NoDocking,_("Exports"))) {
+    for (size_t i=0; i<exportJobs.size(); i++) {
+      FurnaceGUIExportJob& j=exportJobs[i];
+      ImGui::PushID((int)i);
+      ImGui::TextUnformatted(j.path.c_str());
+      int progIndex=0;
+      while (true) {
+        DivROMExportProgress p=j.job->getProgress(progIndex);
+        if (p.name.empty()) break;
+        ImGui::ProgressBar(p.amount,ImVec2(300.0f*dpiScale,0),p.name.c_str());
+        progIndex++;
+      }
+      if (ImGui::Button(_("Abort"))) {
+        j.job->abort();
+        for (DivROMExportOutput& k: j.job->getResult()) {
+          k.data->finish();
+          delete k.data;
+        }
+        delete j.job;
+        exportJobs.erase(exportJobs.begin()+i);
+        i--;
+      }
+      ImGui::PopID();
+      ImGui::Separator();
+    }
+  }
+  ImGui::End();
+}
+
 void FurnaceGUI::editStr(String* which) {
   editString=which;
   displayEditString=true;
@@ -3421,6 +3505,9 @@ void FurnaceGUI::processDrags(int dragX, int dragY) {
           if (val>127) val=127;
           for (int i=x; i<=x1; i++) ((signed char*)sampleDragTarget)[i]=val;
         }
+        if (curSample>=0 && curSample<(int)e->song.sample.size()) {
+          e->song.sample[curSample]->invalidatePeaks(x,x1+1);
+        }
         updateSampleTex=true;
         notifySampleChange=true;
       }
@@ -5659,6 +5746,9 @@ bool FurnaceGUI::loop() {
 
     }
 
+    // free pattern data which edits let go of, once the audio thread is done with it
+    e->freeRetiredPatterns();
+
     // release selection if mouse released
     if (ImGui::IsMouseReleased(ImGuiMouseButton_Left) && selecting) {
       if (!selectingFull) cursor=selEnd;
@@ -6335,29 +6425,21 @@ bool FurnaceGUI::loop() {
               break;
             }
             case GUI_FILE_EXPORT_VGM: {
-              SafeWriter* w=e->saveVGM(willExport,vgmExportLoop,vgmExportVersion,vgmExportPatternHints,vgmExportDirectStream,vgmExportTrailingTicks,vgmExportDPCM07,vgmExportCorrectedRate);
-              if (w!=NULL) {
-                FILE* f=ps_fopen(copyOfName.c_str(),"wb");
-                if (f!=NULL) {
-                  fwrite(w->getFinalBuf(),1,w->size(),f);
-                  fclose(f);
-                  pushRecentSys(copyOfName.c_str());
-                } else {
-                  showError(_("could not open file!"));
-                }
-                w->finish();
-                delete w;
-                if (!e->getWarnings().empty()) {
-                  showWarning(e->getWarnings(),GUI_WARN_GENERIC);
-                }
-              } else {
-                showError(fmt::sprintf(_("could not write VGM! (%s)"),e->getLastError()));
-              }
+              DivExportJob* job=new DivExportJob(DIV_EXPORT_JOB_VGM);
+              memcpy(job->vgmSystems,willExport,DIV_MAX_CHIPS*sizeof(bool));
+              job->vgmLoop=vgmExportLoop;
+              job->vgmVersion=vgmExportVersion;
+              job->vgmPatternHints=vgmExportPatternHints;
+              job->vgmDirectStream=vgmExportDirectStream;
+              job->vgmTrailingTicks=vgmExportTrailingTicks;
+              job->vgmDPCM07=vgmExportDPCM07;
+              job->vgmCorrectedRate=vgmExportCorrectedRate;
+              runExportJob(job,copyOfName,false);
               break;
             }
             case GUI_FILE_EXPORT_ROM:
               romExportPath=copyOfName;
-              pendingExport=e->buildROM(romTarget);
+              pendingExport=new DivExportJob(DIV_EXPORT_JOB_ROM,e->buildROM(romTarget));
               if (pendingExport==NULL) {
                 showError("could not create exporter! you may want to report this issue...");
               } else {
@@ -6671,7 +6753,9 @@ bool FurnaceGUI::loop() {
     if (ImGui::BeginPopupModal(_("Rendering..."),NULL,ImGuiWindowFlags_NoResize|ImGuiWindowFlags_NoMove|ImGuiWindowFlags_NoSavedSettings)) {
       // WHAT the HELL?!
       WAKE_UP;
-      if (audioExportOptions.mode!=DIV_EXPORT_MODE_MANY_CHAN) {
+      // per-channel export shows the current channel unless all channels are rendered at once
+      bool showChannel=(audioExportOptions.mode==DIV_EXPORT_MODE_MANY_CHAN && totalFiles>1);
+      if (!showChannel) {
         ImGui::Text(_("Please wait..."));
       }
       int curFile=0;
@@ -6689,7 +6773,7 @@ bool FurnaceGUI::loop() {
       if (curProgress<0.0f) curProgress=0.0f;
       if (curProgress>1.0f) curProgress=1.0f;
 
-      if (audioExportOptions.mode==DIV_EXPORT_MODE_MANY_CHAN) ImGui::Text(_("Channel %d of %d"),curFile+1,totalFiles);
+      if (showChannel) ImGui::Text(_("Channel %d of %d"),curFile+1,totalFiles);
 
       ImGui::ProgressBar(curProgress,ImVec2(320.0f*dpiScale,0),fmt::sprintf("%.2f%%",curProgress*100.0f).c_str());
 
@@ -6700,6 +6784,9 @@ bool FurnaceGUI::loop() {
       }
       if (!e->isExporting()) {
         e->finishAudioFile();
+        if (e->hasExportFailed()) {
+          showError(_("could not write audio file! open Log Viewer for more information."));
+        }
         ImGui::CloseCurrentPopup();
       }
       ImGui::EndPopup();
@@ -6744,13 +6831,20 @@ bool FurnaceGUI::loop() {
         ImGui::EndChild();
         if (pendingExport->isRunning()) {
           WAKE_UP;
-          if (ImGui::Button(_("Abort"),ImVec2(ImGui::GetContentRegionAvail().x,0.0f))) {
+          if (ImGui::Button(_("Abort"),ImVec2(ImGui::GetContentRegionAvail().x*0.5f,0.0f))) {
             pendingExport->abort();
             delete pendingExport;
             pendingExport=NULL;
             romExportSave=false;
             ImGui::CloseCurrentPopup();
           }
+          ImGui::SameLine();
+          if (ImGui::Button(_("Continue in background"),ImVec2(ImGui::GetContentRegionAvail().x,0.0f))) {
+            exportJobs.push_back(FurnaceGUIExportJob(pendingExport,romExportPath,romMultiFile));
+            pendingExport=NULL;
+            romExportSave=false;
+            ImGui::CloseCurrentPopup();
+          }
         } else {
           if (romExportSave) {
             pendingExport->wait();
@@ -6796,7 +6890,7 @@ bool FurnaceGUI::loop() {
     centerNextWindow(_("CmdStream Export Progress"),canvasW,canvasH);
     ImGui::SetNextWindowSizeConstraints(romExportMinSize,romExportMaxSize);
     if (ImGui::BeginPopupModal(_("CmdStream Export Progress"),NULL)) {
-      if (csExportThread==NULL) {
+      if (csExportJob==NULL) {
         ImGui::TextWrapped("%s",_("it appears your Furnace has too many bugs in it. any song you can export?"));
         ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x);
         if (ImGui::Button(_("Talk With Devs"),ImVec2(ImGui::GetContentRegionAvail().x/3.0f,0.0f))) {
@@ -6813,6 +6907,7 @@ bool FurnaceGUI::loop() {
       } else {
         WAKE_UP;
         ImGui::Text("Exporting...");
+        DivCSProgress& csProgress=csExportJob->csProgress;
         ImGui::Text("opt stage: %d",csProgress.optStage);
         ImGui::Text("pass: %d/%d",csProgress.optCurrent,csProgress.optTotal);
         ImGui::Text("find: %d/%d",csProgress.findCurrent,csProgress.findTotal);
@@ -6820,10 +6915,12 @@ bool FurnaceGUI::loop() {
         ImGui::Text("benefit: %d/%d",csProgress.origCurrent,csProgress.origCount);
 
         // check whether we're done
-        if (csExportDone) {
-          csExportThread->join();
-          delete csExportThread;
-          csExportThread=NULL;
+        if (!csExportJob->isRunning()) {
+          csExportJob->wait();
+          SafeWriter* csExportResult=NULL;
+          if (!csExportJob->hasFailed() && !csExportJob->getResult().empty()) {
+            csExportResult=csExportJob->getResult()[0].data;
+          }
 
           if (csExportTarget) { // command stream player
             if (csExportResult!=NULL) {
@@ -6851,14 +6948,16 @@ bool FurnaceGUI::loop() {
               }
               csExportResult->finish();
               delete csExportResult;
-              if (!e->getWarnings().empty()) {
-                showWarning(e->getWarnings(),GUI_WARN_GENERIC);
+              if (!csExportJob->getWarnings().empty()) {
+                showWarning(csExportJob->getWarnings(),GUI_WARN_GENERIC);
               }
             } else {
-              showError(fmt::sprintf(_("could not write command stream! (%s)"),e->getLastError()));
+              showError(fmt::sprintf(_("could not write command stream! (%s)"),csExportJob->getLastError()));
             }
             csExportResult=NULL;
           }
+          delete csExportJob;
+          csExportJob=NULL;
 
           ImGui::CloseCurrentPopup();
         }
@@ -6866,6 +6965,8 @@ bool FurnaceGUI::loop() {
       ImGui::EndPopup();
     }
 
+    drawExportJobs();
+
     drawTutorial();
 
     ImVec2 newSongMinSize=mobileUI?ImVec2(canvasW-(portrait?0:(60.0*dpiScale)),canvasH-60.0*dpiScale):ImVec2(400.0f*dpiScale,200.0f*dpiScale);
@@ -7719,6 +7820,13 @@ bool FurnaceGUI::loop() {
       logV("need to recalc timestamps...");
       e->calcSongTimestamps();
       recalcTimestamps=false;
+      recalcTimestampsPartial=false;
+      memset(recalcTimestampsOrders,0,DIV_MAX_PATTERNS*sizeof(bool));
+    } else if (recalcTimestampsPartial) {
+      logV("need to recalc timestamps (partially)...");
+      e->calcSongTimestamps(recalcTimestampsOrders);
+      recalcTimestampsPartial=false;
+      memset(recalcTimestampsOrders,0,DIV_MAX_PATTERNS*sizeof(bool));
     }
 
     if (!e->isPlaying() && e->getFilePlayerSync()) {
@@ -8899,6 +9007,13 @@ bool FurnaceGUI::finish(bool saveConfig) {
       e->saveConf();
     }
   }
+  // stop exports which are still running
+  for (FurnaceGUIExportJob& i: exportJobs) {
+    i.job->abort();
+    delete i.job;
+  }
+  exportJobs.clear();
+
   rend->quitGUI();
   ImGui_ImplSDL2_Shutdown();
   quitRender();
@@ -8914,6 +9029,10 @@ bool FurnaceGUI::finish(bool saveConfig) {
       delete[] oscValues[i];
       oscValues[i]=NULL;
     }
+    if (oscValuesNext[i]) {
+      delete[] oscValuesNext[i];
+      oscValuesNext[i]=NULL;
+    }
   }
   if (oscValuesAverage) {
     delete[] oscValuesAverage;
@@ -8927,6 +9046,14 @@ bool FurnaceGUI::finish(bool saveConfig) {
   if (chanOscWorkPool!=NULL) {
     delete chanOscWorkPool;
   }
+  if (chanOscPlan!=NULL) {
+    fftw_destroy_plan(chanOscPlan);
+    chanOscPlan=NULL;
+  }
+  if (chanOscPlanI!=NULL) {
+    fftw_destroy_plan(chanOscPlanI);
+    chanOscPlanI=NULL;
+  }
 
   delete[] opTouched;
   opTouched=NULL;
@@ -9024,6 +9151,7 @@ FurnaceGUI::FurnaceGUI():
   notifyWaveChange(false),
   notifySampleChange(false),
   recalcTimestamps(true),
+  recalcTimestampsPartial(false),
   wantScrollListIns(false),
   wantScrollListWave(false),
   wantScrollListSample(false),
@@ -9504,6 +9632,8 @@ FurnaceGUI::FurnaceGUI():
   chanOscGrad(64,64),
   chanOscGradTex(NULL),
   chanOscWorkPool(NULL),
+  chanOscPlan(NULL),
+  chanOscPlanI(NULL),
   xyOscPointTex(NULL),
   xyOscOptions(false),
   xyOscXChannel(0),
@@ -9572,10 +9702,8 @@ FurnaceGUI::FurnaceGUI():
   curTutorial(-1),
   curTutorialStep(0),
   csDisAsmAddr(0),
-  csExportThread(NULL),
-  csExportResult(NULL),
+  csExportJob(NULL),
   csExportTarget(false),
-  csExportDone(false),
   audioExportFilterName("???"),
   audioExportFilterExt("*"),
   dmfExportVersion(0),
@@ -9621,6 +9749,7 @@ FurnaceGUI::FurnaceGUI():
   memset(willExport,1,DIV_MAX_CHIPS*sizeof(bool));
 
   memset(peak,0,DIV_MAX_OUTPUTS*sizeof(float));
+  memset(recalcTimestampsOrders,0,DIV_MAX_PATTERNS*sizeof(bool));
 
   opMaskTransposeNote.note=true;
   opMaskTransposeNote.ins=false;
@@ -9638,6 +9767,7 @@ FurnaceGUI::FurnaceGUI():
   memset(patChanSlideY,0,sizeof(float)*(DIV_MAX_CHANS+1));
   memset(lastIns,-1,sizeof(int)*DIV_MAX_CHANS);
   memset(oscValues,0,sizeof(void*)*DIV_MAX_OUTPUTS);
+  memset(oscValuesNext,0,sizeof(void*)*DIV_MAX_OUTPUTS);
 
   memset(chanOscLP0,0,sizeof(float)*DIV_MAX_CHANS);
   memset(chanOscLP1,0,sizeof(float)*DIV_MAX_CHANS);
@@ -21,6 +21,7 @@
 #define _FUR_GUI_H
 
 #include "../engine/engine.h"
+#include "../engine/exportJob.h"
 #include "../engine/workPool.h"
 #include "../engine/waveSynth.h"
 #include "imgui.h"
@@ -50,7 +51,7 @@
 #define handleUnimportant if (settings.insFocusesPattern && patternOpen) {nextWindow=GUI_WINDOW_PATTERN;}
 #define unimportant(x) if (x) {handleUnimportant}
 
-#define MARK_MODIFIED modified=true;
+#define MARK_MODIFIED modified=true; e->invalidateCheckpoints();
 #define WAKE_UP drawHalt=5;
 
 #define RESET_WAVE_MACRO_ZOOM \
@@ -1746,6 +1747,20 @@ struct CSDisAsmIns {
   }
 };
 
+struct FurnaceGUIExportJob {
+  DivExportJob* job;
+  String path;
+  bool multiFile;
+  FurnaceGUIExportJob(DivExportJob* j, String p, bool m):
+    job(j),
+    path(p),
+    multiFile(m) {}
+  FurnaceGUIExportJob():
+    job(NULL),
+    path(""),
+    multiFile(false) {}
+};
+
 enum NoteInputModes: unsigned char {
   GUI_NOTE_INPUT_MONO=0,
   GUI_NOTE_INPUT_POLY,
@@ -1806,6 +1821,10 @@ class FurnaceGUI {
   unsigned char noteInputMode;
   bool notifyWaveChange, notifySampleChange;
   bool recalcTimestamps;
+  // orders changed by pattern/order edits since the last timestamp calculation.
+  // if only these changed, timestamps are recalculated incrementally.
+  bool recalcTimestampsPartial;
+  bool recalcTimestampsOrders[DIV_MAX_PATTERNS];
   bool wantScrollListIns, wantScrollListWave, wantScrollListSample;
   bool displayPendingIns, pendingInsSingle, displayPendingRawSample, snesFilterHex, modTableHex, displayEditString;
   bool displayPendingSamples, replacePendingSample;
@@ -2126,6 +2145,7 @@ class FurnaceGUI {
     int exportOptionsLayout;
     int chanOscThreads;
     int renderPoolThreads;
+    bool renderPoolBurst;
     int fontBackend;
     int fontHinting;
     int fontAutoHint;
@@ -2377,6 +2397,7 @@ class FurnaceGUI {
       exportOptionsLayout(1),
       chanOscThreads(0),
       renderPoolThreads(0),
+      renderPoolBurst(true),
       fontBackend(1),
       fontHinting(0),
       fontAutoHint(1),
@@ -2761,6 +2782,7 @@ class FurnaceGUI {
   // oscilloscope
   int oscTotal, oscWidth;
   float* oscValues[DIV_MAX_OUTPUTS];
+  float* oscValuesNext[DIV_MAX_OUTPUTS];
   float* oscValuesAverage;
   float oscZoom;
   float oscWindowSize;
@@ -2777,6 +2799,8 @@ class FurnaceGUI {
   Gradient2D chanOscGrad;
   FurnaceGUITexture* chanOscGradTex;
   DivWorkPool* chanOscWorkPool;
+  // shared by all channels (executed on their own buffers)
+  fftw_plan chanOscPlan, chanOscPlanI;
   float chanOscLP0[DIV_MAX_CHANS];
   float chanOscLP1[DIV_MAX_CHANS];
   float chanOscVol[DIV_MAX_CHANS];
@@ -2794,7 +2818,12 @@ class FurnaceGUI {
     int waveLenBottom, waveLenTop, relatedCh;
     float pitch, windowSize, phaseOff, debugPhase, dcOff;
     unsigned short needle;
-    bool ready, loudEnough, waveCorr;
+    // snapshot of the osc buffer at the last analysis.
+    // the analysis is skipped if neither it nor the parameters changed.
+    unsigned int snap;
+    float lastPhaseOff;
+    bool ready, loudEnough, waveCorr, analyzed;
+    // chanOscPlan and chanOscPlanI
     fftw_plan plan;
     fftw_plan planI;
     PendingDrawOsc drawOp;
@@ -2816,9 +2845,12 @@ class FurnaceGUI {
       debugPhase(0.0f),
       dcOff(0.0f),
       needle(0),
+      snap(0),
+      lastPhaseOff(0.0f),
       ready(false),
       loudEnough(false),
       waveCorr(false),
+      analyzed(false),
       plan(NULL),
       planI(NULL) {}
   } chanOscChan[DIV_MAX_CHANS];
@@ -2835,6 +2867,8 @@ class FurnaceGUI {
   float xyOscDecayTime;
   float xyOscIntensity;
   float xyOscThickness;
+  // points read from the oscilloscope buffer (X, Y), newest first
+  std::vector<ImVec2> xyOscPoints, xyOscPointsNext;
 
   // register view
   int regViewColumns;
@@ -2975,18 +3009,19 @@ class FurnaceGUI {
   ImGuiListClipper csClipper;
   unsigned int csDisAsmAddr;
   std::vector<CSDisAsmIns> csDisAsm;
-  std::thread* csExportThread;
-  SafeWriter* csExportResult;
-  bool csExportTarget, csExportDone;
+  DivExportJob* csExportJob;
+  bool csExportTarget;
   String csExportPath;
 
+  // exports running in the background
+  std::vector<FurnaceGUIExportJob> exportJobs;
+
   // export options
   DivAudioExportOptions audioExportOptions;
   String audioExportFilterName, audioExportFilterExt;
   int dmfExportVersion;
   FurnaceGUIExportTypes curExportType;
   DivCSOptions csExportOptions;
-  DivCSProgress csProgress;
 
   // ROM export specific
   DivROMExportOptions romTarget;
@@ -2995,7 +3030,7 @@ class FurnaceGUI {
   bool romExportSave;
   String romFilterName, romFilterExt;
   String romExportPath;
-  DivROMExport* pendingExport;
+  DivExportJob* pendingExport;
   bool romExportAvail[DIV_ROM_MAX];
   bool romExportExists;
   int insCompileType;
@@ -3266,6 +3301,11 @@ class FurnaceGUI {
   void doCollapseSong(int divider);
   void doExpandSong(int multiplier);
   void doAbsorbInstrument();
+  void markTimestampsOrder(int order);
+  void markTimestampsPat(int chan, int pat);
+  void markTimestampsUndo(const UndoStep& us);
+  // throw away the row summaries of the patterns written to by an undo step (after writing)
+  void invalidateRowFlags(const UndoStep& us);
   void doUndo();
   void doRedo();
   void doFind();
@@ -3286,6 +3326,8 @@ class FurnaceGUI {
   void doCursorUndo();
   void doCursorRedo();
 
+  // edit a copy of the sample and render it, then put it into place while the engine is locked
+  void editSample(DivSample* sample, const std::function<void(DivSample*)>& what);
   void doUndoSample();
   void doRedoSample();
 
@@ -3317,6 +3359,8 @@ class FurnaceGUI {
   void pushRecentSys(const char* path);
   void exportAudio(String path, DivAudioExportModes mode);
   void exportCmdStream(bool target, String path);
+  void runExportJob(DivExportJob* job, String path, bool multiFile);
+  void drawExportJobs();
   void delFirstBackup(String name);
 
   bool parseSysEx(unsigned char* data, size_t len);
@@ -302,7 +302,9 @@ void FurnaceGUI::drawMixer() {
               ImGui::Dummy(ImVec2(dpiScale,maxY));
               ImGui::SameLine();
             }
-            if (chipMixer(i,ImVec2(itemWidth,maxY))) MARK_MODIFIED;
+            if (chipMixer(i,ImVec2(itemWidth,maxY))) {
+              MARK_MODIFIED;
+            }
             if (settings.mixerLayout==0) ImGui::SameLine();
           }
         }
@@ -24,7 +24,8 @@
 #include "../engine/filter.h"
 
 void FurnaceGUI::readOsc() {
-  int writePos=e->oscWritePos;
+  unsigned int seq=e->getOscSeq();
+  int writePos=seq&0x7fff;
   int readPos=e->oscReadPos;
   int avail=0;
   int total=0;
@@ -50,18 +51,24 @@ void FurnaceGUI::readOsc() {
   int winSize=e->getAudioDescGot().rate*(oscWindowSize/1000.0);
   int oscReadPos=(writePos-winSize)&0x7fff;
 
+  // the frame is rendered to oscValuesNext, and only shown if the audio thread didn't overwrite what we read
   for (int ch=0; ch<e->getAudioDescGot().outChans; ch++) {
     if (oscValues[ch]==NULL) {
       oscValues[ch]=new float[2048];
+      memset(oscValues[ch],0,2048*sizeof(float));
     }
-    memset(oscValues[ch],0,2048*sizeof(float));
+    if (oscValuesNext[ch]==NULL) {
+      oscValuesNext[ch]=new float[2048];
+    }
+    float* oscValuesCh=oscValuesNext[ch];
+    memset(oscValuesCh,0,2048*sizeof(float));
     float* sincITable=DivFilterTables::getSincIntegralSmallTable();
 
     float posFrac=0.0;
     float factor=(float)oscWidth/(float)winSize;
     int posInt=oscReadPos-(8.0f/factor);
     for (int i=7; i<oscWidth-9; i++) {
-      oscValues[ch][i]+=e->oscBuf[ch][posInt&0x7fff];
+      oscValuesCh[i]+=e->oscBuf[ch][posInt&0x7fff];
 
       posFrac+=1.0;
       while (posFrac>=1.0) {
@@ -73,26 +80,37 @@ void FurnaceGUI::readOsc() {
         float* t2=&sincITable[n<<3];
         float delta=e->oscBuf[ch][posInt&0x7fff]-e->oscBuf[ch][(posInt-1)&0x7fff];
 
-        oscValues[ch][i-7]+=t1[7]*-delta;
-        oscValues[ch][i-6]+=t1[6]*-delta;
-        oscValues[ch][i-5]+=t1[5]*-delta;
-        oscValues[ch][i-4]+=t1[4]*-delta;
-        oscValues[ch][i-3]+=t1[3]*-delta;
-        oscValues[ch][i-2]+=t1[2]*-delta;
-        oscValues[ch][i-1]+=t1[1]*-delta;
-        oscValues[ch][i]  +=t1[0]*-delta;
-
-        oscValues[ch][i+1]+=t2[0]*delta;
-        oscValues[ch][i+2]+=t2[1]*delta;
-        oscValues[ch][i+3]+=t2[2]*delta;
-        oscValues[ch][i+4]+=t2[3]*delta;
-        oscValues[ch][i+5]+=t2[4]*delta;
-        oscValues[ch][i+6]+=t2[5]*delta;
-        oscValues[ch][i+7]+=t2[6]*delta;
-        oscValues[ch][i+8]+=t2[7]*delta;
+        oscValuesCh[i-7]+=t1[7]*-delta;
+        oscValuesCh[i-6]+=t1[6]*-delta;
+        oscValuesCh[i-5]+=t1[5]*-delta;
+        oscValuesCh[i-4]+=t1[4]*-delta;
+        oscValuesCh[i-3]+=t1[3]*-delta;
+        oscValuesCh[i-2]+=t1[2]*-delta;
+        oscValuesCh[i-1]+=t1[1]*-delta;
+        oscValuesCh[i]  +=t1[0]*-delta;
+
+        oscValuesCh[i+1]+=t2[0]*delta;
+        oscValuesCh[i+2]+=t2[1]*delta;
+        oscValuesCh[i+3]+=t2[2]*delta;
+        oscValuesCh[i+4]+=t2[3]*delta;
+        oscValuesCh[i+5]+=t2[4]*delta;
+        oscValuesCh[i+6]+=t2[5]*delta;
+        oscValuesCh[i+7]+=t2[6]*delta;
+        oscValuesCh[i+8]+=t2[7]*delta;
       }
     }
+  }
+
+  // keep the previous frame if the audio thread caught up with us
+  if (e->isOscIntact(seq,winSize+16)) {
+    for (int ch=0; ch<e->getAudioDescGot().outChans; ch++) {
+      float* t=oscValues[ch];
+      oscValues[ch]=oscValuesNext[ch];
+      oscValuesNext[ch]=t;
+    }
+  }
 
+  for (int ch=0; ch<e->getAudioDescGot().outChans; ch++) {
     for (int i=0; i<oscWidth; i++) {
       if (oscValues[ch][i]>0.001f || oscValues[ch][i]<-0.001f) {
         WAKE_UP;
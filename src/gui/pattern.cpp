@@ -732,10 +732,12 @@ void FurnaceGUI::drawPattern() {
         }
 
         if (patChannelNames) {
-          DivPattern* pat=e->curPat[i].getPattern(e->curOrders->ord[i][curOrder],true);
+          DivPattern* pat=e->curPat[i].getPattern(e->curOrders->ord[i][curOrder],false);
           ImGui::PushFont(mainFont);
           snprintf(chanID,2048," %s###PatName%d",pat->name.c_str(),i);
           if (ImGui::Selectable(chanID,true,ImGuiSelectableFlags_NoPadWithHalfSpacing,ImVec2(sizeHeader.x,lineHeight+1.0f*dpiScale))) {
+            // only create the pattern when its name is edited
+            pat=e->curPat[i].getPattern(e->curOrders->ord[i][curOrder],true);
             editStr(&pat->name);
           }
           ImGui::PopFont();
@@ -1296,7 +1298,7 @@ void FurnaceGUI::drawPattern() {
         int chanVolMax=e->getMaxVolumeChan(i);
         if (chanVolMax<1) chanVolMax=1;
 
-        const DivPattern* pat=e->curSubSong->pat[i].getPattern(e->curOrders->ord[i][ord&0xff],true);
+        const DivPattern* pat=e->curSubSong->pat[i].getPattern(e->curOrders->ord[i][ord&0xff],false);
 
         unsigned int maxFreq=e->getMaxFreqChan(i);
 
@@ -1456,7 +1458,7 @@ void FurnaceGUI::drawPattern() {
           if (++row>=e->curSubSong->patLen) {
             row=0;
             ord++;
-            pat=e->curSubSong->pat[i].getPattern(e->curOrders->ord[i][ord&0xff],true);
+            pat=e->curSubSong->pat[i].getPattern(e->curOrders->ord[i][ord&0xff],false);
           }
           pos.x=thisTop.x;
           pos.y+=lineHeight;
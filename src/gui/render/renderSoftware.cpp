@@ -49,6 +49,8 @@ bool FurnaceGUIRenderSoftware::lockTexture(FurnaceGUITexture* which, void** data
 }
 
 bool FurnaceGUIRenderSoftware::unlockTexture(FurnaceGUITexture* which) {
+  FurnaceSoftwareTexture* t=(FurnaceSoftwareTexture*)which;
+  t->tex->touch();
   return true;
 }
 
@@ -56,6 +58,7 @@ bool FurnaceGUIRenderSoftware::updateTexture(FurnaceGUITexture* which, void* dat
   FurnaceSoftwareTexture* t=(FurnaceSoftwareTexture*)which;
   if (!t->tex->managed) return false;
   memcpy(t->tex->pixels,data,pitch*t->tex->height);
+  t->tex->touch();
   return true;
 }
 
@@ -92,6 +95,9 @@ void FurnaceGUIRenderSoftware::clear(ImVec4 color) {
   ImU32 clearToWhat=ImGui::ColorConvertFloat4ToU32(color);
   clearToWhat=(clearToWhat&0xff00ff00)|((clearToWhat&0xff)<<16)|((clearToWhat&0xff0000)>>16);
 
+  // the renderer clears while painting, skipping what didn't change
+  if (ImGui_ImplSW_SetClearColor(clearToWhat)) return;
+
   bool mustLock=SDL_MUSTLOCK(surf);
   if (mustLock) {
     if (SDL_LockSurface(surf)!=0) return;
@@ -122,6 +128,8 @@ void FurnaceGUIRenderSoftware::wipe(float alpha) {
 }
 
 void FurnaceGUIRenderSoftware::present() {
+  // in case nothing was rendered after clear()
+  ImGui_ImplSW_FlushClear();
   SDL_UpdateWindowSurface(sdlWin);
 }
 
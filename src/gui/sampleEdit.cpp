@@ -677,9 +677,8 @@ void FurnaceGUI::drawSampleEdit() {
               if (sampleDepths[i]==NULL) continue;
               if (ImGui::Selectable(sampleDepths[i],sample->depth==(DivSampleDepth)i)) {
                 sample->prepareUndo(true);
-                e->lockEngine([this,sample,i]() {
+                editSample(sample,[this,i](DivSample* sample) {
                   sample->convert((DivSampleDepth)i,e->getSampleFormatMask());
-                  e->renderSamples(curSample);
                 });
                 updateSampleTex=true;
                 notifySampleChange=true;
@@ -1096,11 +1095,10 @@ void FurnaceGUI::drawSampleEdit() {
         }
         if (ImGui::Button(_("Resize"))) {
           sample->prepareUndo(true);
-          e->lockEngine([this,sample]() {
+          editSample(sample,[this](DivSample* sample) {
             if (!sample->resize(resizeSize)) {
               showError(_("couldn't resize! make sure your sample is 8 or 16-bit."));
             }
-            e->renderSamples(curSample);
           });
           updateSampleTex=true;
           notifySampleChange=true;
@@ -1161,11 +1159,10 @@ void FurnaceGUI::drawSampleEdit() {
         ImGui::Combo(_("Filter"),&resampleStrat,LocalizedComboGetter,resampleStrats,6);
         if (ImGui::Button(_("Resample"))) {
           sample->prepareUndo(true);
-          e->lockEngine([this,sample,targetRate]() {
+          editSample(sample,[this,targetRate](DivSample* sample) {
             if (!sample->resample(targetRate,resampleTarget,resampleStrat)) {
               showError(_("couldn't resample! make sure your sample is 8 or 16-bit and that the target rate is at least 100Hz."));
             }
-            e->renderSamples(curSample);
           });
           e->notifySampleChange(curSample);
           updateSampleTex=true;
@@ -1223,8 +1220,9 @@ void FurnaceGUI::drawSampleEdit() {
         }
         if (ImGui::Button(_("Apply"))) {
           sample->prepareUndo(true);
-          e->lockEngine([this,sample]() {
+          editSample(sample,[this](DivSample* sample) {
             SAMPLE_OP_BEGIN;
+            sample->invalidatePeaks(start,end);
             float vol=amplifyVol/100.0f;
 
             if (sample->depth==DIV_SAMPLE_DEPTH_16BIT) {
@@ -1247,8 +1245,6 @@ void FurnaceGUI::drawSampleEdit() {
 
             updateSampleTex=true;
             notifySampleChange=true;
-
-            e->renderSamples(curSample);
           });
           MARK_MODIFIED;
           ImGui::CloseCurrentPopup();
@@ -1293,11 +1289,10 @@ void FurnaceGUI::drawSampleEdit() {
         if (ImGui::Button(_("Go"))) {
           int pos=(sampleSelStart==-1 || sampleSelStart==sampleSelEnd)?sample->samples:sampleSelStart;
           sample->prepareUndo(true);
-          e->lockEngine([this,sample,pos]() {
+          editSample(sample,[this,pos](DivSample* sample) {
             if (!sample->insert(pos,silenceSize)) {
               showError(_("couldn't insert! make sure your sample is 8 or 16-bit."));
             }
-            e->renderSamples(curSample);
           });
           updateSampleTex=true;
           notifySampleChange=true;
@@ -1347,7 +1342,7 @@ void FurnaceGUI::drawSampleEdit() {
         }
         if (ImGui::Button(_("Apply"))) {
           sample->prepareUndo(true);
-          e->lockEngine([this,sample]() {
+          editSample(sample,[this](DivSample* sample) {
             if (sample->depth==DIV_SAMPLE_DEPTH_16BIT && sample->data16!=NULL && sample->samples>0) {
               SAMPLE_OP_BEGIN;
               float linThreshold=powf(10.0f,noiseGateThreshold/20.0f)*32767.0f;
@@ -1402,8 +1397,6 @@ void FurnaceGUI::drawSampleEdit() {
 
             updateSampleTex=true;
             notifySampleChange=true;
-
-            e->renderSamples(curSample);
           });
           MARK_MODIFIED;
           ImGui::CloseCurrentPopup();
@@ -1509,8 +1502,9 @@ void FurnaceGUI::drawSampleEdit() {
 
         if (ImGui::Button(_("Apply"))) {
           sample->prepareUndo(true);
-          e->lockEngine([this,sample]() {
+          editSample(sample,[this](DivSample* sample) {
             SAMPLE_OP_BEGIN;
+            sample->invalidatePeaks(start,end);
             float res=1.0-pow(sampleFilterRes,0.5f);
             float low=0;
             float band=0;
@@ -1559,8 +1553,6 @@ void FurnaceGUI::drawSampleEdit() {
 
             updateSampleTex=true;
             notifySampleChange=true;
-
-            e->renderSamples(curSample);
           });
           MARK_MODIFIED;
           ImGui::CloseCurrentPopup();
@@ -1610,10 +1602,11 @@ void FurnaceGUI::drawSampleEdit() {
             ImGui::CloseCurrentPopup();
           } else {
             sample->prepareUndo(true);
-            e->lockEngine([this,sample] {
+            editSample(sample,[this](DivSample* sample) {
               SAMPLE_OP_BEGIN;
               double l=1.0/(double)sampleCrossFadeLoopLength;
               double evar=1.0-sampleCrossFadeLoopLaw/200.0;
+              sample->invalidatePeaks(sample->loopEnd-sampleCrossFadeLoopLength,sample->loopEnd);
               if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
                 unsigned int crossFadeInput=sample->loopStart-sampleCrossFadeLoopLength;
                 unsigned int crossFadeOutput=sample->loopEnd-sampleCrossFadeLoopLength;
@@ -1639,8 +1632,6 @@ void FurnaceGUI::drawSampleEdit() {
               }
               updateSampleTex=true;
               notifySampleChange=true;
-
-              e->renderSamples(curSample);
             });
             MARK_MODIFIED;
             ImGui::CloseCurrentPopup();
@@ -1891,6 +1882,8 @@ void FurnaceGUI::drawSampleEdit() {
               }
             }
 
+            // the peak summary makes every column cost the same regardless of zoom
+            sample->updatePeaks();
             unsigned int xCoarse=samplePos;
             unsigned int xFine=0;
             unsigned int xAdvanceCoarse=sampleZoom;
@@ -1898,41 +1891,19 @@ void FurnaceGUI::drawSampleEdit() {
             for (unsigned int i=0; i<(unsigned int)availX; i++) {
               if (xCoarse>=sample->samples) break;
               int y1, y2;
-              int candMin=INT_MAX;
-              int candMax=INT_MIN;
-              int totalAdvance=0;
-              if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                if (candMin>sample->data8[xCoarse]) candMin=sample->data8[xCoarse];
-                if (candMax<sample->data8[xCoarse]) candMax=sample->data8[xCoarse];
-              } else {
-                if (candMin>sample->data16[xCoarse]) candMin=sample->data16[xCoarse];
-                if (candMax<sample->data16[xCoarse]) candMax=sample->data16[xCoarse];
-              }
+              int candMin=0;
+              int candMax=0;
+              unsigned int totalAdvance=0;
               xFine+=xAdvanceFine;
               if (xFine>=16777216) {
                 xFine-=16777216;
                 totalAdvance++;
               }
               totalAdvance+=xAdvanceCoarse;
-              if (xCoarse>=sample->samples) break;
-              do {
-                if (xCoarse>=sample->samples) break;
-                if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                  if (candMin>sample->data8[xCoarse]) candMin=sample->data8[xCoarse];
-                  if (candMax<sample->data8[xCoarse]) candMax=sample->data8[xCoarse];
-                } else {
-                  if (candMin>sample->data16[xCoarse]) candMin=sample->data16[xCoarse];
-                  if (candMax<sample->data16[xCoarse]) candMax=sample->data16[xCoarse];
-                }
-                if (totalAdvance>0) xCoarse++;
-              } while ((totalAdvance--)>0);
-              if (sample->depth==DIV_SAMPLE_DEPTH_8BIT) {
-                y1=(((unsigned char)candMin^0x80)*availY)>>8;
-                y2=(((unsigned char)candMax^0x80)*availY)>>8;
-              } else {
-                y1=(((unsigned short)candMin^0x8000)*availY)>>16;
-                y2=(((unsigned short)candMax^0x8000)*availY)>>16;
-              }
+              if (!sample->getPeak(xCoarse,xCoarse+totalAdvance+1,candMin,candMax)) break;
+              xCoarse+=totalAdvance;
+              y1=(((unsigned short)candMin^0x8000)*availY)>>16;
+              y2=(((unsigned short)candMax^0x8000)*availY)>>16;
               if (y1>y2) {
                 y2^=y1;
                 y1^=y2;
@@ -2606,6 +2577,17 @@ void FurnaceGUI::drawSampleEdit() {
   ImGui::End();
 }
 
+void FurnaceGUI::editSample(DivSample* sample, const std::function<void(DivSample*)>& what) {
+  DivSample* copy=sample->makeEditCopy();
+  what(copy);
+  copy->render(e->getSampleFormatMask());
+  e->lockEngine([sample,copy]() {
+    sample->takeEditCopy(copy);
+  });
+  delete copy;
+  e->renderSamplesP(curSample);
+}
+
 void FurnaceGUI::doUndoSample() {
   if (!sampleEditOpen) return;
   if (curSample<0 || curSample>=(int)e->song.sample.size()) return;
@@ -360,7 +360,7 @@ void FurnaceGUI::initSettings() {
             for (int i=0; i<e->getTotalChannelCount(); i++) {
               for (int j=0; j<DIV_MAX_PATTERNS; j++) {
                 if (e->curSubSong->pat[i].data[j]!=NULL) {
-                  DivPattern* p=e->curSubSong->pat[i].data[j];
+                  DivPattern* p=e->curSubSong->pat[i].getPattern(j,true);
                   for (int k=0; k<DIV_MAX_ROWS; k++) {
                     if (p->newData[k][DIV_PAT_NOTE]>=0 && p->newData[k][DIV_PAT_NOTE]<180) {
                       int newNote=((6+p->newData[k][DIV_PAT_NOTE])/12)*12;
@@ -385,7 +385,7 @@ void FurnaceGUI::initSettings() {
             for (int i=0; i<e->getTotalChannelCount(); i++) {
               for (int j=0; j<DIV_MAX_PATTERNS; j++) {
                 if (e->curSubSong->pat[i].data[j]!=NULL) {
-                  DivPattern* p=e->curSubSong->pat[i].data[j];
+                  DivPattern* p=e->curSubSong->pat[i].getPattern(j,true);
                   for (int k=0; k<DIV_MAX_ROWS; k++) {
                     if (p->newData[k][DIV_PAT_NOTE]>=0 && p->newData[k][DIV_PAT_NOTE]<180) {
                       int newNote=p->newData[k][DIV_PAT_NOTE]+(rand()%40)-18;
@@ -1065,6 +1065,13 @@ void FurnaceGUI::initSettings() {
             }
           }
           popWarningColor();
+
+          if (ImGui::Checkbox(_("Keep threads awake while rendering"),&settings.renderPoolBurst)) {
+            ret=true;
+          }
+          if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip(_("render threads poll for work until the audio buffer is filled instead of sleeping after every tick.\nreduces overhead at high tick rates, at the cost of higher CPU usage."));
+          }
         }
         return ret;
       }),
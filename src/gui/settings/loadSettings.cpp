@@ -143,6 +143,7 @@ void FurnaceGUI::readConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     settings.chanOscThreads=conf.getInt("chanOscThreads",0);
     settings.renderPoolThreads=conf.getInt("renderPoolThreads",0);
+    settings.renderPoolBurst=conf.getBool("renderPoolBurst",1);
     settings.shaderOsc=conf.getBool("shaderOsc",0);
     settings.writeInsNames=conf.getBool("writeInsNames",0);
     settings.readInsNames=conf.getBool("readInsNames",1);
@@ -653,6 +654,7 @@ void FurnaceGUI::writeConfig(DivConfig& conf, FurnaceGUISettingGroups groups) {
 
     conf.set("chanOscThreads",settings.chanOscThreads);
     conf.set("renderPoolThreads",settings.renderPoolThreads);
+    conf.set("renderPoolBurst",settings.renderPoolBurst);
     conf.set("shaderOsc",settings.shaderOsc);
     conf.set("writeInsNames",settings.writeInsNames);
     conf.set("readInsNames",settings.readInsNames);
@@ -134,7 +134,11 @@ void FurnaceGUI::drawSpectrum() {
       }
       for (int i=0; i<(spectrum.mono?1:chans); i++) {
         spectrum.buffer[i]=(fftw_complex*)fftw_malloc(sizeof(fftw_complex)*spectrum.bins);
-        if (!spectrum.buffer[i]) spectrum.running=false;
+        if (!spectrum.buffer[i]) {
+          spectrum.running=false;
+        } else {
+          memset(spectrum.buffer[i],0,sizeof(fftw_complex)*spectrum.bins);
+        }
         spectrum.in[i]=new double[spectrum.bins];
         if (!spectrum.in[i]) spectrum.running=false;
         spectrum.plan[i]=fftw_plan_dft_r2c_1d(spectrum.bins,spectrum.in[i],spectrum.buffer[i],FFTW_ESTIMATE);
@@ -159,7 +163,11 @@ void FurnaceGUI::drawSpectrum() {
       for (int z=spectrum.mono?0:(chans-1); z>=0; z--) {
         if (!spectrum.buffer[z]) {
           spectrum.buffer[z]=(fftw_complex*)fftw_malloc(sizeof(fftw_complex)*spectrum.bins);
-          if (!spectrum.buffer[z]) spectrum.running=false;
+          if (!spectrum.buffer[z]) {
+            spectrum.running=false;
+          } else {
+            memset(spectrum.buffer[z],0,sizeof(fftw_complex)*spectrum.bins);
+          }
         }
         if (!spectrum.in[z]) {
           spectrum.in[z]=new double[spectrum.bins];
@@ -179,6 +187,7 @@ void FurnaceGUI::drawSpectrum() {
         }
         // get buffer
         memset(spectrum.in[z],0,sizeof(double)*spectrum.bins);
+        unsigned int seq=e->getOscSeq();
         int needle=e->oscReadPos-spectrum.bins;
 
         for (int j=0; j<spectrum.bins; j++) {
@@ -194,7 +203,10 @@ void FurnaceGUI::drawSpectrum() {
           }
           spectrum.in[z][j]=sample*(0.5*(1.0-cos(2.0*M_PI*j/(spectrum.bins-1))));
         }
-        fftw_execute(spectrum.plan[z]);
+        // if the audio thread overwrote what we read, keep the previous spectrum
+        if (e->isOscIntact(seq,(((seq&0x7fff)-needle)&0x7fff))) {
+          fftw_execute(spectrum.plan[z]);
+        }
         unsigned int count=0;
         double mag=0.0f;
         float x=0.0f, y=0.0f;
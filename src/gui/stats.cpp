@@ -21,6 +21,9 @@
 #include <fmt/printf.h>
 #include <imgui.h>
 
+// recent frames from the profiler
+static DivProfileFrame profileFrames[DIV_PROFILE_FRAMES];
+
 void FurnaceGUI::drawStats() {
   if (nextWindow==GUI_WINDOW_STATS) {
     statsOpen=true;
@@ -37,6 +40,92 @@ void FurnaceGUI::drawStats() {
     ImGui::ProgressBar((double)lastProcTime/maxGot,ImVec2(ImGui::GetContentRegionAvail().x-ImGui::CalcTextSize("100.0%").x,0),"");
     ImGui::SameLine();
     ImGui::Text("%.1f%%",100.0*((double)lastProcTime/(double)maxGot));
+
+    bool profiling=e->profiler.isEnabled();
+    if (ImGui::Checkbox(_("Profile"),&profiling)) {
+      e->profiler.enable(profiling);
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip(_("measure the time taken by every chip and stage of audio processing."));
+    }
+    if (profiling) {
+      ImGui::SameLine();
+      if (ImGui::Button(_("Reset"))) {
+        e->profiler.reset();
+      }
+      ImGui::SameLine();
+      ImGui::Text(_("%u overruns in %u buffers"),e->profiler.getOverruns(),e->profiler.getCount());
+
+      int frameCount=e->profiler.getFrames(profileFrames,DIV_PROFILE_FRAMES);
+      int chipCount=0;
+      if (frameCount>0) chipCount=profileFrames[frameCount-1].chips;
+
+      if (ImGui::BeginTable("ProfileTable",5,ImGuiTableFlags_Borders|ImGuiTableFlags_SizingStretchSame)) {
+        ImGui::TableSetupColumn("c0",ImGuiTableColumnFlags_WidthStretch,2.0f);
+        ImGui::TableSetupColumn("c1",ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("c2",ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("c3",ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("c4",ImGuiTableColumnFlags_WidthStretch);
+
+        ImGui::TableNextRow(ImGuiTableRowFlags_Headers);
+        ImGui::TableNextColumn();
+        ImGui::Text(_("Stage"));
+        ImGui::TableNextColumn();
+        ImGui::Text(_("Load"));
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("average over the last %d buffers"),frameCount);
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text(_("Peak"));
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("maximum over the last %d buffers"),frameCount);
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text(_("99%%"));
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("99%% of buffers took less than this time (since the last reset)"));
+        }
+        ImGui::TableNextColumn();
+        ImGui::Text(_("Overruns"));
+        if (ImGui::IsItemHovered()) {
+          ImGui::SetTooltip(_("how many times this was the slowest part of a buffer which took too long"));
+        }
+
+        for (int i=0; i<DIV_PROFILE_STAGE_MAX+chipCount; i++) {
+          // load relative to the time available for each buffer
+          double avgLoad=0.0;
+          double peakLoad=0.0;
+          for (int j=0; j<frameCount; j++) {
+            DivProfileFrame& f=profileFrames[j];
+            if (f.budget==0) continue;
+            unsigned int t=(i<DIV_PROFILE_STAGE_MAX)?f.stage[i]:(f.chipAcquire[i-DIV_PROFILE_STAGE_MAX]+f.chipFill[i-DIV_PROFILE_STAGE_MAX]);
+            double load=(double)t/(double)f.budget;
+            avgLoad+=load;
+            if (load>peakLoad) peakLoad=load;
+          }
+          if (frameCount>0) avgLoad/=frameCount;
+
+          ImGui::TableNextRow();
+          ImGui::TableNextColumn();
+          if (i<DIV_PROFILE_STAGE_MAX) {
+            ImGui::TextUnformatted(DivProfiler::getStageName(i));
+          } else if (i-DIV_PROFILE_STAGE_MAX<e->song.systemLen) {
+            ImGui::Text("#%d: %s",i-DIV_PROFILE_STAGE_MAX+1,e->getSystemName(e->song.system[i-DIV_PROFILE_STAGE_MAX]));
+          } else {
+            ImGui::Text("#%d",i-DIV_PROFILE_STAGE_MAX+1);
+          }
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f%%",avgLoad*100.0);
+          ImGui::TableNextColumn();
+          ImGui::Text("%.1f%%",peakLoad*100.0);
+          ImGui::TableNextColumn();
+          ImGui::Text("<%.0fµs",e->profiler.getPercentile(i,0.99)/1000.0);
+          ImGui::TableNextColumn();
+          ImGui::Text("%u",e->profiler.getBlame(i));
+        }
+        ImGui::EndTable();
+      }
+    }
     if (ImGui::GetContentRegionAvail().y>8.0f*dpiScale) {
       // draw a chart
       lastAudioLoads[lastAudioLoadsPos]=(double)lastProcTime/maxGot;
@@ -36,13 +36,17 @@ void FurnaceGUI::drawTuner() {
   if (ImGui::Begin("Tuner",&tunerOpen,globalWinFlags|ImGuiWindowFlags_NoScrollbar,_("Tuner"))) {
     // fft buffer
     if (!tunerFFTInBuf) tunerFFTInBuf=new double[FURNACE_TUNER_FFT_SIZE];
-    if (!tunerFFTOutBuf) tunerFFTOutBuf=(fftw_complex*)fftw_malloc(sizeof(fftw_complex)*FURNACE_TUNER_FFT_SIZE);
+    if (!tunerFFTOutBuf) {
+      tunerFFTOutBuf=(fftw_complex*)fftw_malloc(sizeof(fftw_complex)*FURNACE_TUNER_FFT_SIZE);
+      memset(tunerFFTOutBuf,0,sizeof(fftw_complex)*FURNACE_TUNER_FFT_SIZE);
+    }
 
     if (!tunerPlan) {
       tunerPlan=fftw_plan_dft_r2c_1d(FURNACE_TUNER_FFT_SIZE,tunerFFTInBuf,tunerFFTOutBuf,FFTW_ESTIMATE);
     }
 
     int chans=e->getAudioDescGot().outChans;
+    unsigned int seq=e->getOscSeq();
     int needle=e->oscReadPos;
 
     for (int j=0; j<FURNACE_TUNER_FFT_SIZE; j++) {
@@ -56,7 +60,11 @@ void FurnaceGUI::drawTuner() {
       tunerFFTInBuf[j]=sample*(0.5*(1.0-cos(2.0*M_PI*j/(FURNACE_TUNER_FFT_SIZE-1))));
     }
 
-    fftw_execute(tunerPlan);
+    // the read position lags behind the write position.
+    // if the audio thread overwrote what we read, keep the previous result.
+    if (e->isOscIntact(seq,FURNACE_TUNER_FFT_SIZE+(((seq&0x7fff)-needle)&0x7fff))) {
+      fftw_execute(tunerPlan);
+    }
 
     std::vector<double> mag(FURNACE_TUNER_FFT_SIZE/2);
     mag[0]=0;
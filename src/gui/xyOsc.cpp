@@ -165,7 +165,18 @@ void FurnaceGUI::drawXYOsc() {
         const float* oscBufX=e->oscBuf[xyOscXChannel];
         const float* oscBufY=e->oscBuf[xyOscYChannel];
         if (oscBufX!=NULL && oscBufY!=NULL) {
-          int pos=e->oscWritePos;
+          // read the points first, and keep the previous ones if the audio thread overwrote them meanwhile
+          unsigned int seq=e->getOscSeq();
+          int pos=seq&0x7fff;
+          xyOscPointsNext.resize(xyOscSamples);
+          for (int i=0; i<xyOscSamples; i++) {
+            pos=(pos-1)&32767;
+            xyOscPointsNext[i]=ImVec2(oscBufX[pos],oscBufY[pos]);
+          }
+          if (e->isOscIntact(seq,xyOscSamples+1)) {
+            xyOscPoints.swap(xyOscPointsNext);
+          }
+
           float lx=inSqrCenter.x;
           float ly=inSqrCenter.y;
           float maxA=xyOscIntensity*256.f;
@@ -178,10 +189,9 @@ void FurnaceGUI::drawXYOsc() {
           if (settings.oscEscapesBoundary) {
             dl->PushClipRectFullScreen();
           }
-          for (int i=0; i<xyOscSamples; i++) {
-            pos=(pos-1)&32767;
-            float x=oscBufX[pos]*scaleX+inSqrCenter.x;
-            float y=oscBufY[pos]*scaleY+inSqrCenter.y;
+          for (int i=0; i<(int)xyOscPoints.size(); i++) {
+            float x=xyOscPoints[i].x*scaleX+inSqrCenter.x;
+            float y=xyOscPoints[i].y*scaleY+inSqrCenter.y;
             if (i != 0) {
               float a=maxA/sqrtf((x-lx)*(x-lx)+(y-ly)*(y-ly));
               if (a>=1) {
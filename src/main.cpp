@@ -91,7 +91,13 @@ String vgmOutName;
 String cmdOutName;
 String romOutName;
 String txtOutName;
+String benchJSONName;
+String streamTarget="stdout";
+TAAudioFormat streamFormat=TA_AUDIO_FORMAT_F32;
+bool streamClockPace=false;
 int benchMode=0;
+int verifyMode=0;
+bool profileMode=false;
 int subsong=-1;
 DivCSOptions csExportOptions;
 DivAudioExportOptions exportOptions;
@@ -185,13 +191,59 @@ TAParamResult pAudio(String val) {
   } else if (val=="pipe") {
     e.setAudio(DIV_AUDIO_PIPE);
     changeLogOutput(stderr);
+  } else if (val=="stream") {
+    e.setAudio(DIV_AUDIO_STREAM);
+    e.setAudioStream(streamTarget,streamFormat,streamClockPace);
+    if (streamTarget=="stdout") changeLogOutput(stderr);
   } else {
-    logE("invalid value for audio engine! valid values are: jack, sdl, portaudio, asio, pipe.");
+    logE("invalid value for audio engine! valid values are: jack, sdl, portaudio, asio, pipe, stream.");
     return TA_PARAM_ERROR;
   }
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pStream(String val) {
+  if (outName!="") {
+    logE("can't use -stream and -output at the same time.");
+    return TA_PARAM_ERROR;
+  }
+  if (val!="stdout" && val.find("unix:")!=0 && val.find("shm:")!=0) {
+    logE("invalid stream target! valid values are: stdout, unix:<path>, shm:<path>.");
+    return TA_PARAM_ERROR;
+  }
+  streamTarget=val;
+  e.setAudio(DIV_AUDIO_STREAM);
+  e.setAudioStream(streamTarget,streamFormat,streamClockPace);
+  if (streamTarget=="stdout") changeLogOutput(stderr);
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pStreamFormat(String val) {
+  if (val=="f32") {
+    streamFormat=TA_AUDIO_FORMAT_F32;
+  } else if (val=="s16") {
+    streamFormat=TA_AUDIO_FORMAT_S16;
+  } else {
+    logE("invalid stream format! valid values are: f32, s16.");
+    return TA_PARAM_ERROR;
+  }
+  e.setAudioStream(streamTarget,streamFormat,streamClockPace);
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pStreamPace(String val) {
+  if (val=="consumer") {
+    streamClockPace=false;
+  } else if (val=="clock") {
+    streamClockPace=true;
+  } else {
+    logE("invalid stream pacing! valid values are: consumer, clock.");
+    return TA_PARAM_ERROR;
+  }
+  e.setAudioStream(streamTarget,streamFormat,streamClockPace);
+  return TA_PARAM_SUCCESS;
+}
+
 TAParamResult pView(String val) {
   if (val=="pattern") {
     e.setView(DIV_STATUS_PATTERN);
@@ -453,6 +505,21 @@ TAParamResult pOutMode(String val) {
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pExportThreads(String val) {
+  try {
+    int count=std::stoi(val);
+    if (count<1) {
+      logE("thread count shall be 1 or higher.");
+      return TA_PARAM_ERROR;
+    }
+    exportOptions.threads=count;
+  } catch (std::exception& e) {
+    logE("thread count shall be a number.");
+    return TA_PARAM_ERROR;
+  }
+  return TA_PARAM_SUCCESS;
+}
+
 TAParamResult pOutFormat(String val) {
   if (hasOutFormat) {
     logE("the output format is already set.");
@@ -541,14 +608,50 @@ TAParamResult pBenchmark(String val) {
     benchMode=2;
   } else if (val=="walk") {
     benchMode=3;
+  } else if (val=="cores") {
+    benchMode=4;
+  } else if (val=="threads") {
+    benchMode=5;
   } else {
-    logE("invalid value for benchmark! valid values are: render, seek and walk.");
+    logE("invalid value for benchmark! valid values are: render, seek, walk, cores and threads.");
     return TA_PARAM_ERROR;
   }
   e.setAudio(DIV_AUDIO_DUMMY);
   return TA_PARAM_SUCCESS;
 }
 
+TAParamResult pVerify(String val) {
+  if (val=="all") {
+    verifyMode=DIV_VERIFY_ALL;
+  } else if (val=="pool") {
+    verifyMode=DIV_VERIFY_POOL;
+  } else if (val=="walk") {
+    verifyMode=DIV_VERIFY_WALK;
+  } else if (val=="patterns") {
+    verifyMode=DIV_VERIFY_PATTERNS;
+  } else if (val=="edits") {
+    verifyMode=DIV_VERIFY_EDITS;
+  } else if (val=="rows") {
+    verifyMode=DIV_VERIFY_ROWS;
+  } else {
+    logE("invalid value for verify! valid values are: all, pool, walk, patterns, edits and rows.");
+    return TA_PARAM_ERROR;
+  }
+  e.setAudio(DIV_AUDIO_DUMMY);
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pProfile(String val) {
+  profileMode=true;
+  e.profiler.enable(true);
+  return TA_PARAM_SUCCESS;
+}
+
+TAParamResult pBenchJSON(String val) {
+  benchJSONName=val;
+  return TA_PARAM_SUCCESS;
+}
+
 TAParamResult pOutput(String val) {
   outName=val;
   e.setAudio(DIV_AUDIO_DUMMY);
@@ -627,7 +730,10 @@ bool needsValue(String param) {
 void initParams() {
   params.push_back(TAParam("h","help",false,pHelp,"","display this help"));
 
-  params.push_back(TAParam("a","audio",true,pAudio,"jack|sdl|portaudio|pipe","set audio engine (SDL by default)"));
+  params.push_back(TAParam("a","audio",true,pAudio,"jack|sdl|portaudio|pipe|stream","set audio engine (SDL by default)"));
+  params.push_back(TAParam("","stream",true,pStream,"stdout|unix:<path>|shm:<path>","stream framed audio to stdout, a UNIX socket or a memory-mapped ring buffer"));
+  params.push_back(TAParam("","streamformat",true,pStreamFormat,"f32|s16","set stream sample format (f32 by default)"));
+  params.push_back(TAParam("","streampace",true,pStreamPace,"consumer|clock","pace the stream to the consumer or to real time (consumer by default)"));
   params.push_back(TAParam("o","output",true,pOutput,"<filename>","output audio to file"));
   params.push_back(TAParam("f","outformat",true,pOutFormat,"u8|s16|f32|opus|flac|vorbis|mp3","set audio output format"));
   params.push_back(TAParam("b","bitrate",true,pBitRate,"<rate>","set output file bit rate (lossy compression only)"));
@@ -652,10 +758,14 @@ void initParams() {
   params.push_back(TAParam("l","loops",true,pLoops,"<count>","set number of loops"));
   params.push_back(TAParam("s","subsong",true,pSubSong,"<number>","set sub-song"));
   params.push_back(TAParam("o","outmode",true,pOutMode,"one|persys|perchan","set file output mode"));
+  params.push_back(TAParam("T","exportthreads",true,pExportThreads,"<count>","set how many channels are rendered at once in per-channel mode"));
   params.push_back(TAParam("S","safemode",false,pSafeMode,"","enable safe mode (software rendering and no audio)"));
   params.push_back(TAParam("A","safeaudio",false,pSafeModeAudio,"","enable safe mode (with audio"));
 
-  params.push_back(TAParam("B","benchmark",true,pBenchmark,"render|seek|walk","run performance test"));
+  params.push_back(TAParam("B","benchmark",true,pBenchmark,"render|seek|walk|cores|threads","run performance test"));
+  params.push_back(TAParam("J","benchjson",true,pBenchJSON,"<filename>","write benchmark results (render, cores and threads) to a JSON file"));
+  params.push_back(TAParam("","verify",true,pVerify,"all|pool|walk|patterns|edits|rows","compare the optimized playback paths against plain ones using the song, and exit with an error if they differ"));
+  params.push_back(TAParam("","profile",false,pProfile,"","measure the time taken by every chip and stage of audio processing, and print a summary when quitting"));
 
   params.push_back(TAParam("V","version",false,pVersion,"","view information about Furnace."));
   params.push_back(TAParam("W","warranty",false,pWarranty,"","view warranty disclaimer."));
@@ -909,7 +1019,7 @@ int main(int argc, char** argv) {
 
   const bool outputMode = outName!="" || vgmOutName!="" || cmdOutName!="" || romOutName!="" || txtOutName!="";
 
-  if (fileName.empty() && (benchMode || infoMode || outputMode)) {
+  if (fileName.empty() && (benchMode || verifyMode || infoMode || outputMode)) {
     logE("provide a file!");
     return 1;
   }
@@ -921,8 +1031,8 @@ int main(int argc, char** argv) {
 #endif
 
 #ifdef HAVE_GUI
-  if (e.preInit(consoleMode || benchMode || infoMode || outputMode)) {
-    if (consoleMode || benchMode || infoMode || outputMode) {
+  if (e.preInit(consoleMode || benchMode || verifyMode || infoMode || outputMode)) {
+    if (consoleMode || benchMode || verifyMode || infoMode || outputMode) {
       logW("engine wants safe mode, but Furnace GUI is not going to start.");
     } else {
       safeMode=true;
@@ -934,7 +1044,7 @@ int main(int argc, char** argv) {
   }
 #endif
 
-  if (safeMode && (consoleMode || benchMode || infoMode || outputMode)) {
+  if (safeMode && (consoleMode || benchMode || verifyMode || infoMode || outputMode)) {
     logE("you can't use safe mode and console/export mode together.");
     return 1;
   }
@@ -950,7 +1060,7 @@ int main(int argc, char** argv) {
   }
 #endif
 
-  if (!fileName.empty() && ((!e.getConfBool("tutIntroPlayed",TUT_INTRO_PLAYED)) || e.getConfInt("alwaysPlayIntro",0)!=3 || consoleMode || benchMode || infoMode || outputMode)) {
+  if (!fileName.empty() && ((!e.getConfBool("tutIntroPlayed",TUT_INTRO_PLAYED)) || e.getConfInt("alwaysPlayIntro",0)!=3 || consoleMode || benchMode || verifyMode || infoMode || outputMode)) {
     logI("loading module...");
     FILE* f=ps_fopen(fileName.c_str(),"rb");
     if (f==NULL) {
@@ -1031,14 +1141,25 @@ int main(int argc, char** argv) {
     e.changeSongP(subsong);
   }
 
+  if (verifyMode) {
+    logI("starting self-test!");
+    bool result=e.verify(verifyMode);
+    finishLogFile();
+    return result?0:1;
+  }
+
   if (benchMode) {
     logI("starting benchmark!");
-    if (benchMode==3) {
+    if (benchMode==5) {
+      e.benchmarkThreads(benchJSONName);
+    } else if (benchMode==4) {
+      e.benchmarkCores(benchJSONName);
+    } else if (benchMode==3) {
       e.benchmarkWalk();
     } else if (benchMode==2) {
       e.benchmarkSeek();
     } else {
-      e.benchmarkPlayback();
+      e.benchmarkPlayback(benchJSONName);
     }
     finishLogFile();
     return 0;
@@ -1081,6 +1202,9 @@ int main(int argc, char** argv) {
       e.setConsoleMode(true);
       e.saveAudio(outName.c_str(),exportOptions);
       e.waitAudioFile();
+      if (e.hasExportFailed()) {
+        reportError(_("could not write audio file! open the log for more information."));
+      }
     }
     if (romOutName!="") {
       e.setConsoleMode(true);
@@ -1179,6 +1303,9 @@ int main(int argc, char** argv) {
     if (cliSuccess) {
       cli.loop();
       cli.finish();
+      if (profileMode) {
+        printf("%s",e.profileResult().c_str());
+      }
       e.quit();
       finishLogFile();
       return 0;
@@ -0,0 +1,22 @@
+#!/bin/bash
+# runs the self-tests (see DivEngine::verify()) on all files in songs/.
+# they compare the optimized playback paths against plain ones.
+# the output of failed tests is kept in verify/.
+# usage: furnace-verify.sh [all|pool|walk|patterns|edits|rows]
+
+which=${1:-all}
+
+echo "furnace self-test begin..."
+mkdir -p "verify" || exit 1
+failed=0
+for i in $(ls "songs/"); do
+  echo -n "$i... "
+  if ../build/furnace -loglevel warning -verify "$which" "songs/$i" > "verify/$i.log" 2>&1; then
+    echo "[1;32mOK[m"
+    rm "verify/$i.log"
+  else
+    echo "[1;31mFAIL FAIL FAIL[m"
+    failed=1
+  fi
+done
+exit $failed